@@ -22,6 +22,7 @@
 #include<iostream>
 #include<algorithm>
 #include<chrono>
+#include<fstream>
 
 #include<opencv2/core/core.hpp>
 
@@ -33,12 +34,17 @@ void LoadImages(const string &strAssociationFilename, vector<string> &vstrImageF
                 vector<string> &vstrImageFilenamesD, vector<double> &vTimestamps);
 
 int main(int argc, char **argv) {
-    if (argc != 5) {
-        cerr << endl << "Usage: ./track path_to_vocabulary path_to_settings path_to_sequence path_to_association"
-             << endl;
+    if (argc != 5 && argc != 6) {
+        cerr << endl << "Usage: ./track path_to_vocabulary path_to_settings path_to_sequence path_to_association "
+                        "[path_to_map]" << endl;
         return 1;
     }
 
+    // With a map argument the sequence is localized in the map if the file exists, otherwise the map built from
+    // the sequence is saved to it
+    string strMapFilename = argc == 6 ? string(argv[5]) : string();
+    bool bLoadMap = !strMapFilename.empty() && ifstream(strMapFilename.c_str()).good();
+
     // Retrieve paths to images
     vector<string> vstrImageFilenamesRGB;
     vector<string> vstrImageFilenamesD;
@@ -59,6 +65,14 @@ int main(int argc, char **argv) {
     // Create SLAM system. It initializes all system threads and gets ready to process frames.
     ORB_SLAM2::System SLAM(argv[1], argv[2], true);
 
+    if (bLoadMap) {
+        if (!SLAM.LoadMap(strMapFilename)) {
+            SLAM.Shutdown();
+            return 1;
+        }
+        SLAM.ActivateLocalizationMode();
+    }
+
     // Vector for tracking time statistics
     vector<float> vTimesTrack;
     vTimesTrack.resize(nImages);
@@ -116,6 +130,9 @@ int main(int argc, char **argv) {
     SLAM.SaveTrajectoryTUM("CameraTrajectory.txt");
     SLAM.SaveKeyFrameTrajectoryTUM("KeyFrameTrajectory.txt");
 
+    if (!strMapFilename.empty() && !bLoadMap)
+        SLAM.SaveMap(strMapFilename);
+
     return 0;
 }
 
@@ -13,6 +13,7 @@
 #include <opencv2/core/core.hpp>
 #include <vector>
 #include <string>
+#include <stdint.h>
 
 #include "FClass.h"
 
@@ -28,7 +29,7 @@ public:
   /// Pointer to a single descriptor
   typedef const TDescriptor *pDescriptor;
   /// Descriptor length (in bytes)
-  static const int L;
+  static const int L = 32;
 
   /**
    * Calculates the mean value of a set of descriptors
@@ -46,6 +47,28 @@ public:
    */
   static int distance(const TDescriptor &a, const TDescriptor &b);
 
+  /**
+   * Calculates the distance between two descriptors stored as L/8 64-bit
+   * words, as in the flat tree of TemplatedVocabulary
+   * @param a
+   * @param b
+   * @return distance
+   */
+  static inline int distance(const uint64_t *a, const uint64_t *b)
+  {
+    // Bit set count operation from
+    // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+    int dist = 0;
+    for(int i = 0; i < L / 8; i++)
+    {
+      uint64_t v = a[i] ^ b[i];
+      v = v - ((v >> 1) & 0x5555555555555555ULL);
+      v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+      dist += (int)((((v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * 0x0101010101010101ULL) >> 56);
+    }
+    return dist;
+  }
+
   /**
    * Returns a string version of the descriptor
    * @param a descriptor
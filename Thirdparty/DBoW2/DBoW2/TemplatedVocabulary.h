@@ -3,6 +3,9 @@
  * Added functions: Save and Load from text files without using cv::FileStorage.
  * Date: August 2015
  * Raúl Mur-Artal
+ *
+ * Added functions: Save and Load from binary files, and a flat copy of the
+ * tree used by transform().
  */
 
 /**
@@ -26,6 +29,8 @@
 #include <algorithm>
 #include <opencv2/core/core.hpp>
 #include <limits>
+#include <cstring>
+#include <stdint.h>
 
 #include "FeatureVector.h"
 #include "BowVector.h"
@@ -246,6 +251,30 @@ public:
    */
   void saveToTextFile(const std::string &filename) const;  
 
+  /**
+   * Loads the vocabulary from a binary file written by saveToBinaryFile
+   * @param filename
+   * @return false if the file could not be read or is not a binary vocabulary
+   */
+  bool loadFromBinaryFile(const std::string &filename);
+
+  /**
+   * Saves the vocabulary into a binary file. The file is a fixed-size header
+   * followed by one fixed-size record per node (parent id, leaf flag, weight
+   * and descriptor bytes), so it can also be memory-mapped and read in place.
+   * Descriptors must be cv::Mat rows of F::L bytes, as with FORB.
+   * @param filename
+   * @return false if the file could not be written
+   */
+  bool saveToBinaryFile(const std::string &filename) const;
+
+  /**
+   * Checks whether the file starts like a binary vocabulary
+   * @param filename
+   * @return true iff the file was written by saveToBinaryFile
+   */
+  static bool isBinaryFile(const std::string &filename);
+
   /**
    * Saves the vocabulary into a file
    * @param filename
@@ -401,6 +430,21 @@ protected:
    * @param features
    */
   void setNodeWeights(const vector<vector<TDescriptor> > &features);
+
+  /**
+   * Builds the flat copy of the tree used by transform() from m_nodes.
+   * Must be called whenever the tree structure or descriptors change
+   */
+  void createFlatTree();
+
+  /// Magic string starting binary vocabulary files
+  static const char *binaryMagic() { return "DBoW2BIN"; }
+
+  /// Version of the binary vocabulary files
+  static const uint32_t BINARY_VERSION = 1;
+
+  /// Longest descriptor, in 64-bit words, for which the flat tree is built
+  static const unsigned int MAX_FLAT_WORDS = 8;
   
 protected:
 
@@ -425,6 +469,19 @@ protected:
   /// Words of the vocabulary (tree leaves)
   /// this condition holds: m_words[wid]->word_id == wid
   std::vector<Node*> m_words;
+
+  /// Flat copy of the tree for transform(). The children of node i are
+  /// m_flat_children[m_flat_first[i] .. m_flat_first[i+1]), and the
+  /// descriptor of the j-th entry of m_flat_children is stored in
+  /// m_flat_descriptors at j * m_flat_words, as m_flat_words 64-bit words.
+  /// Siblings are thus contiguous in memory and a whole level is compared
+  /// with no indirection. Empty if the descriptors are not a multiple of
+  /// 64 bits or longer than MAX_FLAT_WORDS, in which case the nodes are
+  /// used directly
+  std::vector<unsigned int> m_flat_first;
+  std::vector<NodeId> m_flat_children;
+  std::vector<uint64_t> m_flat_descriptors;
+  unsigned int m_flat_words;
   
 };
 
@@ -434,7 +491,7 @@ template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
   (int k, int L, WeightingType weighting, ScoringType scoring)
   : m_k(k), m_L(L), m_weighting(weighting), m_scoring(scoring),
-  m_scoring_object(NULL)
+  m_scoring_object(NULL), m_flat_words(0)
 {
   createScoringObject();
 }
@@ -443,7 +500,7 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const std::string &filename): m_scoring_object(NULL)
+  (const std::string &filename): m_scoring_object(NULL), m_flat_words(0)
 {
   load(filename);
 }
@@ -452,7 +509,7 @@ TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
 
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary
-  (const char *filename): m_scoring_object(NULL)
+  (const char *filename): m_scoring_object(NULL), m_flat_words(0)
 {
   load(filename);
 }
@@ -516,7 +573,7 @@ void TemplatedVocabulary<TDescriptor,F>::setWeightingType(WeightingType type)
 template<class TDescriptor, class F>
 TemplatedVocabulary<TDescriptor,F>::TemplatedVocabulary(
   const TemplatedVocabulary<TDescriptor, F> &voc)
-  : m_scoring_object(NULL)
+  : m_scoring_object(NULL), m_flat_words(0)
 {
   *this = voc;
 }
@@ -935,6 +992,55 @@ void TemplatedVocabulary<TDescriptor,F>::createWords()
       }
     }
   }
+
+  createFlatTree();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+void TemplatedVocabulary<TDescriptor,F>::createFlatTree()
+{
+  m_flat_first.clear();
+  m_flat_children.clear();
+  m_flat_descriptors.clear();
+  m_flat_words = 0;
+
+  const unsigned int words = F::L / sizeof(uint64_t);
+  if(m_nodes.empty() || F::L % sizeof(uint64_t) != 0 ||
+    words > MAX_FLAT_WORDS) return;
+
+  m_flat_first.resize(m_nodes.size() + 1);
+  m_flat_children.reserve(m_nodes.size());
+  m_flat_descriptors.reserve(m_nodes.size() * words);
+
+  for(size_t i = 0; i < m_nodes.size(); ++i)
+  {
+    m_flat_first[i] = m_flat_children.size();
+
+    const vector<NodeId> &children = m_nodes[i].children;
+    for(size_t c = 0; c < children.size(); ++c)
+    {
+      const TDescriptor &d = m_nodes[children[c]].descriptor;
+      if(d.empty() || (size_t)d.cols * d.elemSize() != (size_t)F::L ||
+        !d.isContinuous())
+      {
+        // not a binary descriptor of the expected size, use the nodes
+        m_flat_first.clear();
+        m_flat_children.clear();
+        m_flat_descriptors.clear();
+        return;
+      }
+
+      m_flat_children.push_back(children[c]);
+      m_flat_descriptors.resize(m_flat_descriptors.size() + words);
+      memcpy(&m_flat_descriptors[m_flat_descriptors.size() - words],
+        d.data, F::L);
+    }
+  }
+  m_flat_first[m_nodes.size()] = m_flat_children.size();
+
+  m_flat_words = words;
 }
 
 // --------------------------------------------------------------------------
@@ -1229,6 +1335,48 @@ void TemplatedVocabulary<TDescriptor,F>::transform(const TDescriptor &feature,
   NodeId final_id = 0; // root
   int current_level = 0;
 
+  if(m_flat_words > 0)
+  {
+    // compare with the contiguous descriptors of the children
+    const uint64_t *q = reinterpret_cast<const uint64_t*>(feature.data);
+    uint64_t aligned_q[MAX_FLAT_WORDS];
+    if(reinterpret_cast<size_t>(q) % sizeof(uint64_t) != 0)
+    {
+      memcpy(aligned_q, feature.data, F::L);
+      q = aligned_q;
+    }
+
+    unsigned int first = m_flat_first[0];
+    unsigned int last = m_flat_first[1];
+    while(first < last)
+    {
+      ++current_level;
+
+      unsigned int best = first;
+      int best_d = F::distance(q, &m_flat_descriptors[first * m_flat_words]);
+      for(unsigned int c = first + 1; c < last; ++c)
+      {
+        int d = F::distance(q, &m_flat_descriptors[c * m_flat_words]);
+        if(d < best_d)
+        {
+          best_d = d;
+          best = c;
+        }
+      }
+
+      final_id = m_flat_children[best];
+      if(nid != NULL && current_level == nid_level)
+        *nid = final_id;
+
+      first = m_flat_first[final_id];
+      last = m_flat_first[final_id + 1];
+    }
+
+    word_id = m_nodes[final_id].word_id;
+    weight = m_nodes[final_id].weight;
+    return;
+  }
+
   do
   {
     ++current_level;
@@ -1419,6 +1567,8 @@ bool TemplatedVocabulary<TDescriptor,F>::loadFromTextFile(const std::string &fil
         }
     }
 
+    createFlatTree();
+
     return true;
 
 }
@@ -1450,6 +1600,175 @@ void TemplatedVocabulary<TDescriptor,F>::saveToTextFile(const std::string &filen
 
 // --------------------------------------------------------------------------
 
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::isBinaryFile(const std::string &filename)
+{
+  ifstream f(filename.c_str(), ios::binary);
+  char magic[8];
+  return f.read(magic, sizeof(magic)) && memcmp(magic, binaryMagic(), sizeof(magic)) == 0;
+}
+
+// --------------------------------------------------------------------------
+
+// Binary file layout, little endian as written by the host:
+//   header (48 bytes): char magic[8], uint32 version, int32 k, int32 L,
+//     int32 scoring, int32 weighting, uint32 descriptor bytes,
+//     uint64 number of nodes (root excluded), 8 reserved bytes
+//   one record per node, in id order from 1: uint32 parent, uint32 leaf,
+//     double weight, descriptor bytes padded to a multiple of 8
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::saveToBinaryFile(const std::string &filename) const
+{
+  ofstream f(filename.c_str(), ios::binary);
+  if(!f.is_open()) return false;
+
+  const uint32_t version = BINARY_VERSION;
+  const int32_t header[4] = { m_k, m_L, m_scoring, m_weighting };
+  const uint32_t descriptor_bytes = F::L;
+  const uint64_t nnodes = m_nodes.empty() ? 0 : m_nodes.size() - 1;
+  const char reserved[8] = { 0 };
+
+  f.write(binaryMagic(), 8);
+  f.write(reinterpret_cast<const char*>(&version), sizeof(version));
+  f.write(reinterpret_cast<const char*>(header), sizeof(header));
+  f.write(reinterpret_cast<const char*>(&descriptor_bytes), sizeof(descriptor_bytes));
+  f.write(reinterpret_cast<const char*>(&nnodes), sizeof(nnodes));
+  f.write(reserved, sizeof(reserved));
+
+  const size_t padded_bytes = (F::L + 7) / 8 * 8;
+  vector<char> record(16 + padded_bytes, 0);
+
+  for(size_t i = 1; i < m_nodes.size(); ++i)
+  {
+    const Node &node = m_nodes[i];
+    const uint32_t parent = node.parent;
+    const uint32_t leaf = node.isLeaf() ? 1 : 0;
+    const double weight = node.weight;
+
+    if(node.descriptor.empty() || !node.descriptor.isContinuous() ||
+      (size_t)node.descriptor.cols * node.descriptor.elemSize() != (size_t)F::L)
+      return false;
+
+    memcpy(&record[0], &parent, sizeof(parent));
+    memcpy(&record[4], &leaf, sizeof(leaf));
+    memcpy(&record[8], &weight, sizeof(weight));
+    memcpy(&record[16], node.descriptor.data, F::L);
+    f.write(&record[0], record.size());
+  }
+
+  return f.good();
+}
+
+// --------------------------------------------------------------------------
+
+template<class TDescriptor, class F>
+bool TemplatedVocabulary<TDescriptor,F>::loadFromBinaryFile(const std::string &filename)
+{
+  ifstream f(filename.c_str(), ios::binary);
+  if(!f.is_open()) return false;
+
+  char magic[8];
+  uint32_t version, descriptor_bytes;
+  int32_t header[4];
+  uint64_t nnodes;
+  char reserved[8];
+
+  if(!f.read(magic, sizeof(magic)) ||
+    memcmp(magic, binaryMagic(), sizeof(magic)) != 0 ||
+    !f.read(reinterpret_cast<char*>(&version), sizeof(version)) ||
+    !f.read(reinterpret_cast<char*>(header), sizeof(header)) ||
+    !f.read(reinterpret_cast<char*>(&descriptor_bytes), sizeof(descriptor_bytes)) ||
+    !f.read(reinterpret_cast<char*>(&nnodes), sizeof(nnodes)) ||
+    !f.read(reserved, sizeof(reserved)))
+  {
+    std::cerr << "Vocabulary loading failure: This is not a binary vocabulary file!" << endl;
+    return false;
+  }
+
+  if(version != BINARY_VERSION || descriptor_bytes != (uint32_t)F::L ||
+    header[0] < 0 || header[0] > 20 || header[1] < 1 || header[1] > 10 ||
+    header[2] < 0 || header[2] > 5 || header[3] < 0 || header[3] > 3)
+  {
+    std::cerr << "Vocabulary loading failure: Unsupported binary vocabulary "
+      "(version " << version << ", " << descriptor_bytes << " bytes descriptors)" << endl;
+    return false;
+  }
+
+  // all the records are read at once
+  const size_t padded_bytes = (F::L + 7) / 8 * 8;
+  const size_t record_bytes = 16 + padded_bytes;
+  if(nnodes > (uint64_t)std::numeric_limits<int>::max()) return false;
+
+  vector<char> records(nnodes * record_bytes);
+  if(!records.empty() && !f.read(&records[0], records.size()))
+  {
+    std::cerr << "Vocabulary loading failure: Truncated binary vocabulary file!" << endl;
+    return false;
+  }
+
+  m_k = header[0];
+  m_L = header[1];
+  m_scoring = (ScoringType)header[2];
+  m_weighting = (WeightingType)header[3];
+  createScoringObject();
+
+  m_words.clear();
+  m_nodes.clear();
+  m_nodes.resize(nnodes + 1);
+  m_nodes[0].id = 0;
+
+  // the node descriptors are rows of a single matrix, with no allocation per node
+  cv::Mat descriptors((int)nnodes + 1, F::L, CV_8U);
+
+  size_t nwords = 0;
+  for(size_t i = 0; i < nnodes; ++i)
+    if(records[i * record_bytes + 4]) ++nwords;
+  m_words.resize(nwords);
+  nwords = 0;
+
+  for(size_t i = 0; i < nnodes; ++i)
+  {
+    const char *record = &records[i * record_bytes];
+    const NodeId nid = i + 1;
+
+    uint32_t parent, leaf;
+    double weight;
+    memcpy(&parent, record, sizeof(parent));
+    memcpy(&leaf, record + 4, sizeof(leaf));
+    memcpy(&weight, record + 8, sizeof(weight));
+
+    if(parent >= nid)
+    {
+      std::cerr << "Vocabulary loading failure: Corrupted binary vocabulary file!" << endl;
+      m_nodes.clear();
+      m_words.clear();
+      createFlatTree();
+      return false;
+    }
+
+    Node &node = m_nodes[nid];
+    node.id = nid;
+    node.parent = parent;
+    node.weight = weight;
+    node.descriptor = descriptors.row(nid);
+    memcpy(node.descriptor.data, record + 16, F::L);
+    m_nodes[parent].children.push_back(nid);
+
+    if(leaf)
+    {
+      node.word_id = nwords;
+      m_words[nwords++] = &node;
+    }
+  }
+
+  createFlatTree();
+
+  return true;
+}
+
+// --------------------------------------------------------------------------
+
 template<class TDescriptor, class F>
 void TemplatedVocabulary<TDescriptor,F>::save(const std::string &filename) const
 {
@@ -1619,6 +1938,8 @@ void TemplatedVocabulary<TDescriptor,F>::load(const cv::FileStorage &fs,
     m_nodes[nid].word_id = wid;
     m_words[wid] = &m_nodes[nid];
   }
+
+  createFlatTree();
 }
 
 // --------------------------------------------------------------------------
@@ -74,6 +74,36 @@ namespace g2o {
         }
     };
 
+    class EdgeSE3ProjectXYZ : public BaseBinaryEdge<2, Vector2d, VertexSBAPointXYZ, VertexSE3Expmap> {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        EdgeSE3ProjectXYZ() {}
+
+        bool read(std::istream &is);
+
+        bool write(std::ostream &os) const;
+
+        void computeError() {
+            const VertexSE3Expmap *v1 = static_cast<const VertexSE3Expmap *>(_vertices[1]);
+            const VertexSBAPointXYZ *v2 = static_cast<const VertexSBAPointXYZ *>(_vertices[0]);
+            Vector2d obs(_measurement);
+            _error = obs - cam_project(v1->estimate().map(v2->estimate()));
+        }
+
+        bool isDepthPositive() {
+            const VertexSE3Expmap *v1 = static_cast<const VertexSE3Expmap *>(_vertices[1]);
+            const VertexSBAPointXYZ *v2 = static_cast<const VertexSBAPointXYZ *>(_vertices[0]);
+            return (v1->estimate().map(v2->estimate()))(2) > 0.0;
+        }
+
+        virtual void linearizeOplus();
+
+        Vector2d cam_project(const Vector3d &trans_xyz) const;
+
+        double fx, fy, cx, cy;
+    };
+
     class EdgeSE3ProjectXYZOnlyPose : public BaseUnaryEdge<2, Vector2d, VertexSE3Expmap> {
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -123,6 +153,36 @@ namespace g2o {
         double fx, fy, cx, cy;
     };
 
+    class EdgeStereoSE3ProjectXYZ : public BaseBinaryEdge<3, Vector3d, VertexSBAPointXYZ, VertexSE3Expmap> {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+        EdgeStereoSE3ProjectXYZ() {}
+
+        bool read(std::istream &is);
+
+        bool write(std::ostream &os) const;
+
+        void computeError() {
+            const VertexSE3Expmap *v1 = static_cast<const VertexSE3Expmap *>(_vertices[1]);
+            const VertexSBAPointXYZ *v2 = static_cast<const VertexSBAPointXYZ *>(_vertices[0]);
+            Vector3d obs(_measurement);
+            _error = obs - cam_project(v1->estimate().map(v2->estimate()));
+        }
+
+        bool isDepthPositive() {
+            const VertexSE3Expmap *v1 = static_cast<const VertexSE3Expmap *>(_vertices[1]);
+            const VertexSBAPointXYZ *v2 = static_cast<const VertexSBAPointXYZ *>(_vertices[0]);
+            return (v1->estimate().map(v2->estimate()))(2) > 0.0;
+        }
+
+        virtual void linearizeOplus();
+
+        Vector3d cam_project(const Vector3d &trans_xyz) const;
+
+        double fx, fy, cx, cy, bf;
+    };
+
     class EdgeStereoSE3ProjectXYZOnlyPose : public BaseUnaryEdge<3, Vector3d, VertexSE3Expmap> {
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -171,6 +231,137 @@ namespace g2o {
         double fx, fy, cx, cy, bf;
     };
 
+    // Distance of the projected endpoint (vertex 0) to the observed line l = (a, b, c), as in
+    // EdgeLineProjectXYZOnlyPose but with the endpoint also being optimized.
+    class EdgeLineProjectXYZ : public g2o::BaseBinaryEdge<3, Eigen::Vector3d, g2o::VertexSBAPointXYZ, g2o::VertexSE3Expmap> {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        EdgeLineProjectXYZ() {}
+
+        virtual void computeError() {
+            const g2o::VertexSE3Expmap *v1 = static_cast<const g2o::VertexSE3Expmap *>(_vertices[1]);
+            const g2o::VertexSBAPointXYZ *v2 = static_cast<const g2o::VertexSBAPointXYZ *>(_vertices[0]);
+            Eigen::Vector3d obs = _measurement;
+            Eigen::Vector2d proj = cam_project(v1->estimate().map(v2->estimate()));
+            _error(0) = obs(0) * proj(0) + obs(1) * proj(1) + obs(2);
+            _error(1) = 0;
+            _error(2) = 0;
+        }
+
+        double chiline() {
+            return _error(0) * _error(0);
+        }
+
+        virtual void linearizeOplus() {
+            const g2o::VertexSE3Expmap *vj = static_cast<const g2o::VertexSE3Expmap *>(_vertices[1]);
+            const g2o::VertexSBAPointXYZ *vi = static_cast<const g2o::VertexSBAPointXYZ *>(_vertices[0]);
+            const g2o::SE3Quat T(vj->estimate());
+            Eigen::Vector3d xyz_trans = T.map(vi->estimate());
+
+            double x = xyz_trans[0];
+            double y = xyz_trans[1];
+            double invz = 1.0 / xyz_trans[2];
+            double invz_2 = invz * invz;
+
+            double lx = _measurement(0);
+            double ly = _measurement(1);
+
+            // Derivative of the error w.r.t. the endpoint in camera coordinates
+            Eigen::Matrix<double, 1, 3> J;
+            J << fx * lx * invz, fy * ly * invz, -(fx * lx * x + fy * ly * y) * invz_2;
+
+            _jacobianOplusXi.setZero();
+            _jacobianOplusXi.row(0) = J * T.rotation().toRotationMatrix();
+
+            _jacobianOplusXj.setZero();
+            _jacobianOplusXj(0, 0) = -fy * ly - fx * lx * x * y * invz_2 - fy * ly * y * y * invz_2;
+            _jacobianOplusXj(0, 1) = fx * lx + fx * lx * x * x * invz_2 + fy * ly * x * y * invz_2;
+            _jacobianOplusXj(0, 2) = -fx * lx * y * invz + fy * ly * x * invz;
+            _jacobianOplusXj(0, 3) = J(0);
+            _jacobianOplusXj(0, 4) = J(1);
+            _jacobianOplusXj(0, 5) = J(2);
+        }
+
+        bool read(std::istream &is) {
+            for (int i = 0; i < 3; i++) {
+                is >> _measurement[i];
+            }
+
+            for (int i = 0; i < 3; ++i) {
+                for (int j = i; j < 3; ++j) {
+                    is >> information()(i, j);
+                    if (i != j)
+                        information()(j, i) = information()(i, j);
+                }
+            }
+            return true;
+        }
+
+        bool write(std::ostream &os) const {
+            for (int i = 0; i < 3; i++) {
+                os << measurement()[i] << " ";
+            }
+
+            for (int i = 0; i < 3; ++i) {
+                for (int j = i; j < 3; ++j) {
+                    os << " " << information()(i, j);
+                }
+            }
+            return os.good();
+        }
+
+        Eigen::Vector2d cam_project(const Eigen::Vector3d &trans_xyz) {
+            Eigen::Vector2d proj = g2o::project(trans_xyz);
+            Eigen::Vector2d res;
+            res[0] = proj[0] * fx + cx;
+            res[1] = proj[1] * fy + cy;
+            return res;
+        }
+
+        double fx, fy, cx, cy;
+    };
+
+    // Displacement of a line endpoint (vertex 0) along its 3D line from the measured position. The point-to-line
+    // residuals of EdgeLineProjectXYZ leave this direction unobservable, a weak prior on it keeps the endpoint
+    // in place without pulling it off the line.
+    class EdgeLineEndpointPrior : public g2o::BaseUnaryEdge<1, Eigen::Vector3d, g2o::VertexSBAPointXYZ> {
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
+
+        EdgeLineEndpointPrior() {}
+
+        virtual void computeError() {
+            const g2o::VertexSBAPointXYZ *v1 = static_cast<const g2o::VertexSBAPointXYZ *>(_vertices[0]);
+            _error(0) = direction.dot(v1->estimate() - _measurement);
+        }
+
+        virtual void linearizeOplus() {
+            _jacobianOplusXi = direction.transpose();
+        }
+
+        bool read(std::istream &is) {
+            for (int i = 0; i < 3; i++)
+                is >> _measurement[i];
+            for (int i = 0; i < 3; i++)
+                is >> direction[i];
+            is >> information()(0, 0);
+            return true;
+        }
+
+        bool write(std::ostream &os) const {
+            for (int i = 0; i < 3; i++)
+                os << measurement()[i] << " ";
+            for (int i = 0; i < 3; i++)
+                os << direction[i] << " ";
+            os << information()(0, 0);
+            return os.good();
+        }
+
+        // Unit direction of the line
+        Eigen::Vector3d direction;
+    };
+
     class EdgeLineProjectXYZOnlyPose : public g2o::BaseUnaryEdge<3, Eigen::Vector3d, g2o::VertexSE3Expmap> {
     public:
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW;
@@ -0,0 +1,60 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef DEPTHPREPROCESSOR_H
+#define DEPTHPREPROCESSOR_H
+
+#include <opencv2/core/core.hpp>
+#include <Eigen/Core>
+
+namespace ORB_SLAM2 {
+
+    // Turns the raw depthmap of a frame into everything the depth consumers need (ORB stereo, line depth,
+    // plane detection and surfel fusion) in a single pass over the image, so none of them has to convert
+    // or back-project the depth again.
+    class DepthPreprocessor {
+    public:
+        // depthMapFactor converts raw depth values to metres.
+        DepthPreprocessor(const cv::Mat &K, float depthMapFactor);
+
+        // imDepth: metric depth (CV_32F).
+        // imPointCloud: organized point cloud in camera coordinates (CV_32FC3). Pixels without valid depth
+        // hold (0, 0, depth).
+        void Process(const cv::Mat &imRawDepth, cv::Mat &imDepth, cv::Mat &imPointCloud);
+
+    protected:
+
+        void ComputeRays(int width, int height);
+
+        float fx, fy, cx, cy;
+        float mDepthMapFactor;
+
+        // Normalized image coordinates (u-cx)/fx per column and (v-cy)/fy per row
+        Eigen::ArrayXf mRayX;
+        Eigen::ArrayXf mRayY;
+
+        // Row buffers of the vectorized back-projection
+        Eigen::ArrayXf mRowDepth, mRowX, mRowY;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // DEPTHPREPROCESSOR_H
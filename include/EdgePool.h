@@ -0,0 +1,81 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef EDGEPOOL_H
+#define EDGEPOOL_H
+
+#include <vector>
+#include <limits>
+
+#include "Thirdparty/g2o/g2o/core/sparse_optimizer.h"
+#include "Thirdparty/g2o/g2o/core/robust_kernel_impl.h"
+
+namespace ORB_SLAM2 {
+
+    // Unary edges of one type recycled across calls on a persistent g2o graph. Edges are created with a Huber
+    // kernel, attached to the vertex and added to the optimizer once. Edges not in use are parked on
+    // PARKED_LEVEL so that initializeOptimization(0) skips them; the optimizer keeps ownership.
+    template<class EdgeT>
+    class EdgePool {
+    public:
+        static const int PARKED_LEVEL = 2;
+
+        EdgePool() : mnUsed(0) {}
+
+        // Park the edges handed out since the last call.
+        void Reset() {
+            for (size_t i = 0; i < mnUsed; i++)
+                mvpEdges[i]->setLevel(PARKED_LEVEL);
+            mnUsed = 0;
+        }
+
+        // Next free edge, on level 0. The caller sets measurement, information and the kernel delta.
+        EdgeT *Get(g2o::SparseOptimizer &optimizer, g2o::OptimizableGraph::Vertex *pVertex) {
+            if (mnUsed == mvpEdges.size()) {
+                EdgeT *e = new EdgeT();
+                e->setVertex(0, pVertex);
+                e->setRobustKernel(new g2o::RobustKernelHuber);
+                optimizer.addEdge(e);
+                mvpEdges.push_back(e);
+            }
+
+            EdgeT *e = mvpEdges[mnUsed++];
+            e->setLevel(0);
+            return e;
+        }
+
+        size_t size() const {
+            return mnUsed;
+        }
+
+    protected:
+        std::vector<EdgeT *> mvpEdges;
+        size_t mnUsed;
+    };
+
+    // The kernel of a pooled edge cannot be removed without freeing it. An infinite Huber threshold leaves every
+    // residual in the quadratic region, which gives the same system as no kernel.
+    inline void DisableRobustKernel(g2o::OptimizableGraph::Edge *e) {
+        e->robustKernel()->setDelta(std::numeric_limits<double>::infinity());
+    }
+
+} //namespace ORB_SLAM
+
+#endif // EDGEPOOL_H
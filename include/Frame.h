@@ -40,6 +40,7 @@
 
 #include "MapPlane.h"
 #include "PlaneExtractor.h"
+#include "ThreadPool.h"
 
 #include <pcl/point_types.h>
 #include <pcl/sample_consensus/method_types.h>
@@ -73,10 +74,13 @@ namespace ORB_SLAM2 {
         // Copy constructor.
         Frame(const Frame &frame);
 
-        // Constructor for RGB-D cameras.
-        Frame(const cv::Mat &imRGB, const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp,
-              ORBextractor *extractor, ORBVocabulary *voc, cv::Mat &K, cv::Mat &distCoef, const float &bf,
-              const float &thDepth, const float &depthMapFactor, const float mfDisTh);
+        // Constructor for RGB-D cameras. imDepth is the metric depth (CV_32F) and imPointCloud its organized
+        // point cloud (CV_32FC3), see DepthPreprocessor. ORB, line and plane extraction run on the thread pool.
+        Frame(const cv::Mat &imRGB, const cv::Mat &imGray, const cv::Mat &imDepth, const cv::Mat &imPointCloud,
+              const double &timeStamp,
+              ORBextractor *extractor, LineSegment *pLineSegment, ORBVocabulary *voc, cv::Mat &K,
+              cv::Mat &distCoef, const float &bf, const float &thDepth, const float mfDisTh, ThreadPool *pThreadPool,
+              const ahc::PlanePrior *pPlanePrior = NULL);
 
         // Extract ORB on the image.
         void ExtractORB(const cv::Mat &im);
@@ -84,7 +88,7 @@ namespace ORB_SLAM2 {
         // Extract line features.
         void ExtractLSD(const cv::Mat &im);
 
-        void ExtractPlanes(const cv::Mat &imRGB, const cv::Mat &imDepth, const cv::Mat &K, const float &depthMapFactor);
+        void ExtractPlanes(const cv::Mat &imRGB, const cv::Mat &imPointCloud, const ahc::PlanePrior *pPlanePrior);
 
         void GetLineDepth(const cv::Mat &imDepth);
 
@@ -107,6 +111,19 @@ namespace ORB_SLAM2 {
             return mRwc.clone();
         }
 
+        // Fixed-size copies of the pose for per-point projections, they never allocate.
+        inline const Eigen::Matrix3f &GetRotationEigen() const {
+            return mRcwEig;
+        }
+
+        inline const Eigen::Vector3f &GetTranslationEigen() const {
+            return mtcwEig;
+        }
+
+        inline const Eigen::Vector3f &GetCameraCenterEigen() const {
+            return mOwEig;
+        }
+
         // Check if a MapPoint is in the frustum of the camera
         // and fill variables of the MapPoint to be used by the tracking
         bool isInFrustum(MapPoint *pMP, float viewingCosLimit);
@@ -132,7 +149,11 @@ namespace ORB_SLAM2 {
 
         cv::Mat ComputePlaneWorldCoeff(const int &idx);
 
-        bool MaxPointDistanceFromPlane(cv::Mat &plane, PointCloud::Ptr pointCloud);
+        // Reject the plane if a point is too far from it, otherwise refine it with a closed-form least-squares fit
+        // to the moments of all its pixels. RANSAC is only run if that fit does not explain the points.
+        bool MaxPointDistanceFromPlane(cv::Mat &plane, PointCloud::Ptr pointCloud, const ahc::PlaneSeg::Stats &stats);
+
+        void RefinePlaneRANSAC(cv::Mat &plane, PointCloud::Ptr pointCloud);
 
     public:
         // Vocabulary used for relocalization.
@@ -140,7 +161,7 @@ namespace ORB_SLAM2 {
 
         // Feature extractor. The right is used only in the stereo case.
         ORBextractor *mpORBextractorLeft;
-        // line feature extractor, 自己添加的
+        // Line feature extractor, owned by Tracking.
         LineSegment *mpLineSegment;
         // Frame timestamp.
         double mTimeStamp;
@@ -265,6 +286,10 @@ namespace ORB_SLAM2 {
         cv::Mat mtcw;
         cv::Mat mRwc;
         cv::Mat mOw; //==mtwc
+
+        Eigen::Matrix3f mRcwEig;
+        Eigen::Vector3f mtcwEig;
+        Eigen::Vector3f mOwEig;
     };
 
 }// namespace ORB_SLAM
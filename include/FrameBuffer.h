@@ -0,0 +1,71 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <memory>
+
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+    // Images of one frame shared between Tracking, Surfel Mapping and the Frame Drawer.
+    // The images are never written after construction, so the buffer is passed between threads
+    // by reference count only and no consumer needs its own copy of the pixels.
+    class FrameBuffer {
+    public:
+        typedef std::shared_ptr<const FrameBuffer> Ptr;
+
+        // imDepth and imPointCloud are the outputs of DepthPreprocessor and imPlaneMembership the
+        // plane segmentation (CV_32S, half resolution). The caller must not write to the images afterwards.
+        static Ptr Create(const cv::Mat &imGray, const cv::Mat &imDepth, const cv::Mat &imPointCloud,
+                          const cv::Mat &imPlaneMembership);
+
+        const cv::Mat &GetGray() const {
+            return mImGray;
+        }
+
+        const cv::Mat &GetDepth() const {
+            return mImDepth;
+        }
+
+        const cv::Mat &GetPointCloud() const {
+            return mImPointCloud;
+        }
+
+        const cv::Mat &GetPlaneMembership() const {
+            return mImPlaneMembership;
+        }
+
+    protected:
+        FrameBuffer(const cv::Mat &imGray, const cv::Mat &imDepth, const cv::Mat &imPointCloud,
+                    const cv::Mat &imPlaneMembership);
+
+        const cv::Mat mImGray;
+        const cv::Mat mImDepth;
+        const cv::Mat mImPointCloud;
+        const cv::Mat mImPlaneMembership;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // FRAMEBUFFER_H
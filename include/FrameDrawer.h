@@ -24,6 +24,7 @@
 #include "Tracking.h"
 #include "MapPoint.h"
 #include "Map.h"
+#include "FrameBuffer.h"
 
 #include<opencv2/core/core.hpp>
 #include<opencv2/features2d/features2d.hpp>
@@ -53,6 +54,7 @@ namespace ORB_SLAM2 {
 
         // Info of the frame to be drawn
         cv::Mat mIm;
+        FrameBuffer::Ptr mpFrameBuffer;
         int N;
         std::vector<cv::KeyPoint> mvCurrentKeys;
         std::vector<bool> mvbMap, mvbVO;
@@ -0,0 +1,87 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef HAMMINGDISTANCE_H
+#define HAMMINGDISTANCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+    // Hamming distance between 256-bit binary descriptors, shared by the ORB and the LBD matchers. The kernels are
+    // selected once at start-up: AVX2 or hardware popcount on x86 CPUs supporting them, NEON when built for ARM
+    // and a portable bit-twiddling version otherwise.
+    class HammingDistance {
+    public:
+        static const int DESCRIPTOR_BYTES = 32;
+
+        // Distance between two descriptors of DESCRIPTOR_BYTES bytes.
+        static inline int Distance(const uint8_t *a, const uint8_t *b) {
+            return mpDistance(a, b);
+        }
+
+        static inline int Distance(const cv::Mat &a, const cv::Mat &b) {
+            return mpDistance(a.ptr<uint8_t>(), b.ptr<uint8_t>());
+        }
+
+        // Distances from the query to n descriptors stored one after the other, stride bytes apart
+        // (e.g. consecutive rows of a descriptor matrix).
+        static inline void DistanceToMany(const uint8_t *query, const uint8_t *candidates, size_t stride, int n,
+                                          int *distances) {
+            mpDistanceToMany(query, candidates, stride, n, distances);
+        }
+
+        // Distances from the query to the descriptors at rows indices[0], ..., indices[n - 1] of a block stored
+        // stride bytes apart (e.g. the candidates of a search window in a descriptor matrix).
+        static inline void DistanceToMany(const uint8_t *query, const uint8_t *rows, size_t stride,
+                                          const size_t *indices, int n, int *distances) {
+            mpDistanceToRows(query, rows, stride, indices, n, distances);
+        }
+
+        // Distances from the query to every row of candidates.
+        static void DistanceToMany(const cv::Mat &query, const cv::Mat &candidates, std::vector<int> &distances);
+
+        // Name of the kernels selected for this CPU.
+        static const char *GetImplementation() {
+            return mpImplementation;
+        }
+
+    protected:
+        typedef int (*DistanceFunction)(const uint8_t *, const uint8_t *);
+
+        typedef void (*DistanceToManyFunction)(const uint8_t *, const uint8_t *, size_t, int, int *);
+
+        typedef void (*DistanceToRowsFunction)(const uint8_t *, const uint8_t *, size_t, const size_t *, int, int *);
+
+        static bool SelectImplementation();
+
+        static DistanceFunction mpDistance;
+        static DistanceToManyFunction mpDistanceToMany;
+        static DistanceToRowsFunction mpDistanceToRows;
+        static const char *mpImplementation;
+        static const bool mbSelected;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // HAMMINGDISTANCE_H
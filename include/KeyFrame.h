@@ -69,6 +69,13 @@ namespace ORB_SLAM2 {
 
         cv::Mat GetTranslation();
 
+        // Fixed-size copies of the pose, for projecting many points without allocating.
+        Eigen::Matrix3f GetRotationEigen();
+
+        Eigen::Vector3f GetTranslationEigen();
+
+        Eigen::Vector3f GetCameraCenterEigen();
+
 
         // Bag of Words Representation
         void ComputeBoW();
@@ -128,6 +135,8 @@ namespace ORB_SLAM2 {
         // Enable/Disable bad flag changes
         void SetNotErase();
 
+        void SetErase();
+
         // Set/check bad flag
         void SetBadFlag();
 
@@ -171,6 +180,10 @@ namespace ORB_SLAM2 {
         long unsigned int mnTrackReferenceForFrame;
         long unsigned int mnFuseTargetForKF;
 
+        // Variables used by the local mapping
+        long unsigned int mnBALocalForKF;
+        long unsigned int mnBAFixedForKF;
+
         // Variables used by the keyframe database
         long unsigned int mnRelocQuery;
         int mnRelocWords;
@@ -190,6 +203,7 @@ namespace ORB_SLAM2 {
         const cv::Mat mDescriptors;
         const std::vector<cv::line_descriptor::KeyLine> mvKeyLines;
         const cv::Mat mLineDescriptors;
+        const std::vector<Eigen::Vector3d> mvKeyLineFunctions;
 
         //BoW
         DBoW2::BowVector mBowVec;
@@ -231,12 +245,19 @@ namespace ORB_SLAM2 {
 
         std::vector<MapPlane *> GetMapPlaneMatches();
 
+        // Restores the protected state of loaded maps
+        friend class MapSerializer;
+        friend class MappedMap;
+
     protected:
 
         // SE3 Pose and camera center
         cv::Mat Tcw;
         cv::Mat Twc;
         cv::Mat Ow;
+        Eigen::Matrix3f mRcwEig;
+        Eigen::Vector3f mtcwEig;
+        Eigen::Vector3f mOwEig;
 
         // MapPoints associated to keypoints
         std::vector<MapPoint *> mvpMapPoints;
@@ -260,6 +281,7 @@ namespace ORB_SLAM2 {
 
         // Bad flags
         bool mbNotErase;
+        bool mbToBeErased;
         bool mbBad;
 
         float mHalfBaseline; // Only for visualization
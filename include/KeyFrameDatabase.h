@@ -24,6 +24,7 @@
 #include <vector>
 #include <list>
 #include <set>
+#include <memory>
 
 #include "KeyFrame.h"
 #include "Frame.h"
@@ -38,6 +39,7 @@ namespace ORB_SLAM2 {
 
     class Frame;
 
+    class MappedMap;
 
     class KeyFrameDatabase {
     public:
@@ -50,8 +52,14 @@ namespace ORB_SLAM2 {
 
         void clear();
 
-        // Relocalization
-        std::vector<KeyFrame *> DetectRelocalizationCandidates(Frame *F);
+        // Map file opened for relocalization, whose keyframes are queried in place
+        void SetMappedMap(const std::shared_ptr<MappedMap> &pMappedMap);
+
+        std::shared_ptr<MappedMap> GetMappedMap();
+
+        // Relocalization. Candidates of the mapped file are returned by their index in vnMappedCandidates, they are
+        // only built once matched.
+        std::vector<KeyFrame *> DetectRelocalizationCandidates(Frame *F, std::vector<size_t> &vnMappedCandidates);
 
     protected:
 
@@ -61,6 +69,8 @@ namespace ORB_SLAM2 {
         // Inverted file
         std::vector<list<KeyFrame *> > mvInvertedFile;
 
+        std::shared_ptr<MappedMap> mpMappedMap;
+
         // Mutex
         std::mutex mMutex;
     };
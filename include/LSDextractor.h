@@ -30,12 +30,35 @@ namespace ORB_SLAM2 {
         };
 
     public:
-        LineSegment();
+        // The LSD detector and the LBD descriptor are created once and reused for every frame. They keep internal
+        // buffers, so an instance must not be used by two threads at the same time.
+        // At most nFeatures lines are kept per frame, spread over a gridCols x gridRows grid of the image.
+        LineSegment(int nFeatures = 40, int gridCols = 1, int gridRows = 1, float scale = 1.2, int numOctaves = 1);
 
         ~LineSegment() = default;
 
         void ExtractLineSegment(const cv::Mat &img, std::vector<cv::line_descriptor::KeyLine> &keylines, cv::Mat &ldesc,
-                                std::vector<Eigen::Vector3d> &keylineFunctions, float scale = 1.2, int numOctaves = 1);
+                                std::vector<Eigen::Vector3d> &keylineFunctions);
+
+    protected:
+
+        void ComputePyramid(const cv::Mat &img);
+
+        // Keep the strongest lines within the budget. Each grid cell first keeps its own strongest lines up to an
+        // equal share of the budget, the budget left by sparse cells goes to the strongest remaining lines.
+        void SelectLines(std::vector<cv::line_descriptor::KeyLine> &keylines, int cols, int rows);
+
+        cv::Ptr<cv::line_descriptor::LSDDetector> mpLSD;
+        cv::Ptr<cv::line_descriptor::BinaryDescriptor> mpLBD;
+
+        int mnFeatures;
+        int mnGridCols;
+        int mnGridRows;
+        float mfScale;
+        int mnOctaves;
+
+        // Pyramid consumed by both the detector and the descriptor, level 0 is the input image
+        std::vector<cv::Mat> mvImagePyramid;
     };
 }
 
@@ -0,0 +1,77 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef LOCALMAPPOINTS_H
+#define LOCALMAPPOINTS_H
+
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace ORB_SLAM2 {
+
+    class MapPoint;
+
+    class Frame;
+
+    // Structure-of-arrays copy of the local map points, taken once per frame so that the projection search
+    // reads positions, normals and descriptors from contiguous memory instead of locking and cloning every
+    // MapPoint. The projection results are kept here too, one entry per visible point, in place of the
+    // tracking variables of MapPoint.
+    class LocalMapPoints {
+    public:
+        // Copy the state of the given points. Bad points are left out.
+        void Update(const std::vector<MapPoint *> &vpMapPoints);
+
+        // Project the points not yet seen in F and still good and keep those inside the frustum, within their scale
+        // invariance region and seen under a viewing angle with cosine above viewingCosLimit. Returns the number
+        // of them.
+        int Project(Frame &F, float viewingCosLimit);
+
+        size_t size() const {
+            return mvpMapPoints.size();
+        }
+
+        size_t NumVisible() const {
+            return mvnVisible.size();
+        }
+
+    public:
+        std::vector<MapPoint *> mvpMapPoints;
+
+        // One row per point: world position and mean viewing direction (CV_32F, 3 columns) and descriptor
+        cv::Mat mPositions;
+        cv::Mat mNormals;
+        cv::Mat mDescriptors;
+
+        std::vector<float> mvMinDistance;
+        std::vector<float> mvMaxDistance;
+
+        // Result of the last projection, indexed by visible point
+        std::vector<int> mvnVisible;
+        std::vector<float> mvProjX;
+        std::vector<float> mvProjY;
+        std::vector<float> mvProjXR;
+        std::vector<int> mvnScaleLevel;
+        std::vector<float> mvViewCos;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // LOCALMAPPOINTS_H
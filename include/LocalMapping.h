@@ -25,8 +25,11 @@
 #include "Map.h"
 #include "Tracking.h"
 #include "KeyFrameDatabase.h"
+#include "ThreadPool.h"
+#include "Optimizer.h"
 
 #include <mutex>
+#include <condition_variable>
 
 
 namespace ORB_SLAM2 {
@@ -37,11 +40,13 @@ namespace ORB_SLAM2 {
 
     class LocalMapping {
     public:
-        LocalMapping(Map *pMap, const string &strSettingPath);
+        LocalMapping(Map *pMap, ThreadPool *pThreadPool, const string &strSettingPath);
 
         // Main function
         void Run();
 
+        void SetOptimizer(Optimizer *pOptimizer);
+
         void InsertKeyFrame(KeyFrame *pKF);
 
         // Thread Synch
@@ -59,6 +64,8 @@ namespace ORB_SLAM2 {
 
         bool AcceptKeyFrames();
 
+        void InterruptBA();
+
         void SetAcceptKeyFrames(bool flag);
 
         bool SetNotStop(bool flag);
@@ -96,6 +103,16 @@ namespace ORB_SLAM2 {
 
         void ResetIfRequested();
 
+        // Signal the Local Mapping thread that a keyframe or a stop/release/reset/finish request arrived.
+        void WakeUp();
+
+        // Block until WakeUp() has been called since the last wait.
+        void WaitForWork();
+
+        bool mbWakeUp;
+        std::mutex mMutexWakeUp;
+        std::condition_variable mCondWakeUp;
+
         bool mbResetRequested;
         std::mutex mMutexReset;
 
@@ -109,6 +126,10 @@ namespace ORB_SLAM2 {
 
         Map *mpMap;
 
+        ThreadPool *mpThreadPool;
+
+        Optimizer *mpOptimizer;
+
         std::list<KeyFrame *> mlNewKeyFrames;
 
         KeyFrame *mpCurrentKeyFrame;
@@ -121,6 +142,8 @@ namespace ORB_SLAM2 {
 
         std::mutex mMutexNewKFs;
 
+        bool mbAbortBA;
+
         bool mbStopped;
         bool mbStopRequested;
         bool mbNotStop;
@@ -0,0 +1,101 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MANHATTANREGISTRY_H
+#define MANHATTANREGISTRY_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstddef>
+
+namespace ORB_SLAM2 {
+
+    class MapPlane;
+
+    class KeyFrame;
+
+    // A set of three mutually orthogonal map planes, or two for a partial Manhattan frame, together with the
+    // first keyframe in which they were observed.
+    struct ManhattanFrame {
+        unsigned long mnId;
+        // The third plane is NULL for a partial Manhattan frame
+        MapPlane *mvpPlanes[3];
+        KeyFrame *mpKF;
+    };
+
+    // Manhattan frames of the map with stable ids, looked up by their planes in any order, plus an inverted
+    // index from each plane to the frames that include it so that the frames of a culled plane can be dropped.
+    // Not thread safe, the Map guards it with its own mutex.
+    class ManhattanRegistry {
+    public:
+        ManhattanRegistry();
+
+        // Register the frame formed by the planes if it is not known yet (pMP3 is NULL for a partial frame).
+        // Returns false if it was already registered, in which case its keyframe is kept. The keyframe of a
+        // registered frame must not be erased until Erase returns it.
+        bool Add(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3, KeyFrame *pKF);
+
+        // Frame formed by the planes, in any order, or NULL.
+        const ManhattanFrame *Find(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3) const;
+
+        // Frames including pMP.
+        std::vector<ManhattanFrame> GetFrames(MapPlane *pMP) const;
+
+        size_t NumFrames(MapPlane *pMP) const;
+
+        // All the frames, in id order.
+        std::vector<ManhattanFrame> GetAllFrames() const;
+
+        // Drop all the frames including pMP. Returns the keyframes no remaining frame refers to.
+        std::vector<KeyFrame *> Erase(MapPlane *pMP);
+
+        void clear();
+
+        size_t size() const {
+            return mmFrames.size();
+        }
+
+    protected:
+        // Sorted plane ids, a missing third plane sorts last
+        struct Key {
+            unsigned long ids[3];
+
+            bool operator==(const Key &other) const {
+                return ids[0] == other.ids[0] && ids[1] == other.ids[1] && ids[2] == other.ids[2];
+            }
+        };
+
+        struct KeyHash {
+            size_t operator()(const Key &key) const;
+        };
+
+        static Key MakeKey(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3);
+
+        unsigned long mnNextId;
+
+        std::unordered_map<unsigned long, ManhattanFrame> mmFrames;
+        std::unordered_map<Key, unsigned long, KeyHash> mmFrameOfKey;
+        std::unordered_map<MapPlane *, std::vector<unsigned long> > mmFramesOfPlane;
+        std::unordered_map<KeyFrame *, int> mmNumFramesOfKeyFrame;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // MANHATTANREGISTRY_H
@@ -25,6 +25,7 @@
 #include "KeyFrame.h"
 #include <set>
 #include <unordered_map>
+#include <memory>
 
 #include <mutex>
 
@@ -33,6 +34,8 @@
 #include "Surfel.h"
 
 #include "MapPlane.h"
+#include "MapPlaneIndex.h"
+#include "ManhattanRegistry.h"
 #include <eigen3/Eigen/Core>
 
 namespace ORB_SLAM2 {
@@ -47,30 +50,8 @@ namespace ORB_SLAM2 {
 
     class Frame;
 
-    struct PartialManhattanMapHash {
-        size_t operator()(const std::pair<MapPlane *, MapPlane *> &key) const;
-    };
-
-    struct PartialManhattanMapEqual {
-        bool operator()(const std::pair<MapPlane *, MapPlane *> &a, const std::pair<MapPlane *, MapPlane *> &b) const;
-    };
-
-    struct ManhattanMapHash {
-        size_t operator()(const std::tuple<MapPlane *, MapPlane *, MapPlane *> &key) const;
-    };
-
-    struct ManhattanMapEqual {
-        bool operator()(const std::tuple<MapPlane *, MapPlane *, MapPlane *> &a,
-                        const std::tuple<MapPlane *, MapPlane *, MapPlane *> &b) const;
-    };
-
     class Map {
     public:
-        typedef std::pair<MapPlane *, MapPlane *> PartialManhattan;
-        typedef std::tuple<MapPlane *, MapPlane *, MapPlane *> Manhattan;
-        typedef std::unordered_map<PartialManhattan, KeyFrame *, PartialManhattanMapHash, PartialManhattanMapEqual> PartialManhattans;
-        typedef std::unordered_map<Manhattan, KeyFrame *, ManhattanMapHash, ManhattanMapEqual> Manhattans;
-
         Map();
 
         void AddKeyFrame(KeyFrame *pKF);
@@ -105,6 +86,9 @@ namespace ORB_SLAM2 {
 
         void clear();
 
+        // Keep alive memory the map elements point into (e.g. a memory-mapped map file) until the map is cleared.
+        void AddStorage(const std::shared_ptr<void> &pStorage);
+
         vector<KeyFrame *> mvpKeyFrameOrigins;
 
         std::mutex mMutexMapUpdate;
@@ -119,6 +103,9 @@ namespace ORB_SLAM2 {
 
         std::vector<MapPlane *> GetAllMapPlanes();
 
+        // Planes whose normal n satisfies minCos < normal.dot(n) < maxCos, in the order of GetAllMapPlanes.
+        std::vector<MapPlane *> GetMapPlanesByNormal(const Eigen::Vector3f &normal, float minCos, float maxCos);
+
         void AddManhattanObservation(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3, KeyFrame *pKF);
 
         KeyFrame *GetManhattanObservation(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3);
@@ -127,6 +114,14 @@ namespace ORB_SLAM2 {
 
         KeyFrame *GetPartialManhattanObservation(MapPlane *pMP1, MapPlane *pMP2);
 
+        // Manhattan frames, full or partial, including pMP.
+        std::vector<ManhattanFrame> GetManhattanFrames(MapPlane *pMP);
+
+        size_t GetNumManhattanFrames(MapPlane *pMP);
+
+        // All the Manhattan frames, in the order they were registered.
+        std::vector<ManhattanFrame> GetAllManhattanFrames();
+
         std::vector<Surfel> mvLocalSurfels;
         std::vector<Surfel> mvInactiveSurfels;
 
@@ -136,17 +131,18 @@ namespace ORB_SLAM2 {
         std::set<MapLine *> mspMapLines;
 
         std::set<MapPlane *> mspMapPlanes;
+        MapPlaneIndex mPlaneIndex;
 
         std::set<KeyFrame *> mspKeyFrames;
 
-        PartialManhattans mmpPartialManhattanObservations;
-
-        Manhattans mmpManhattanObservations;
+        ManhattanRegistry mManhattanRegistry;
 
         std::vector<MapPoint *> mvpReferenceMapPoints;
         std::vector<MapLine *> mvpReferenceMapLines;
         long unsigned int mnMaxKFid;
 
+        std::vector<std::shared_ptr<void> > mvpStorage;
+
         std::mutex mMutexMap;
     };
 
@@ -31,10 +31,14 @@ namespace ORB_SLAM2 {
 
         MapLine(Vector6d &Pos, Map *pMap, Frame *pFrame, const int &idxF);
 
+        void SetWorldPos(const Vector6d &Pos);
+
         Vector6d GetWorldPos();
 
         Eigen::Vector3d GetNormal();
 
+        std::map<KeyFrame *, size_t> GetObservations();
+
         int Observations();
 
 
@@ -90,6 +94,7 @@ namespace ORB_SLAM2 {
         long unsigned int mnLastFrameSeen;
 
         // Variables used by local mapping
+        long unsigned int mnBALocalForKF;
         long unsigned int mnFuseCandidateForKF;
 
         static std::mutex mGlobalMutex;
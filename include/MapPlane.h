@@ -80,12 +80,18 @@ namespace ORB_SLAM2 {
 
         void UpdateCoefficientsAndPoints(Frame &pF, int id);
 
+        // Axis-aligned bounds of mvPlanePoints. Returns false if the plane has no points.
+        bool GetBoundingBox(Eigen::Vector3f &minPt, Eigen::Vector3f &maxPt);
+
     public:
         long unsigned int mnId;
         static long unsigned int nNextId;
         long int mnFirstKFid;
         int nObs;
 
+        // Variables used by the tracking
+        long unsigned int mnTrackReferenceForFrame;
+
         static std::mutex mGlobalMutex;
 
         // Used for visualization
@@ -99,9 +105,20 @@ namespace ORB_SLAM2 {
         int mnVisible;
         int mnFound;
 
+        // Restores the protected state of loaded maps
+        friend class MapSerializer;
+        friend class MappedMap;
+
     protected:
         cv::Mat mWorldPos;
 
+        // Bounds of mvPlanePoints, kept next to the points so the matcher can reject far planes without a scan
+        Eigen::Vector3f mMinBound;
+        Eigen::Vector3f mMaxBound;
+        bool mbHasBounds;
+
+        void UpdateBoundingBox();
+
         std::map<KeyFrame *, size_t> mObservations;
         std::map<KeyFrame *, size_t> mParObservations;
         std::map<KeyFrame *, size_t> mVerObservations;
@@ -0,0 +1,81 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MAPPLANEINDEX_H
+#define MAPPLANEINDEX_H
+
+#include <vector>
+#include <unordered_map>
+#include <eigen3/Eigen/Core>
+
+namespace ORB_SLAM2 {
+
+    class MapPlane;
+
+    // Map planes bucketed by normal direction on a cube map: each face of the unit cube is split in
+    // NUM_CELLS x NUM_CELLS cells and a plane goes to the cell its normal points through. A query visits only the
+    // cells whose angular extent can hold a normal in the requested range of cosines, so finding the planes close
+    // to (or perpendicular to) a direction does not depend on the total number of planes in the map.
+    // Plane coefficients do not change after creation, so planes are only inserted and removed.
+    // Not thread safe, the Map guards it with its own mutex.
+    class MapPlaneIndex {
+    public:
+        MapPlaneIndex();
+
+        void Insert(MapPlane *pMP);
+
+        void Erase(MapPlane *pMP);
+
+        void clear();
+
+        // Append to vpMapPlanes the planes whose unit normal n satisfies minCos < normal.dot(n) < maxCos.
+        void Search(const Eigen::Vector3f &normal, float minCos, float maxCos,
+                    std::vector<MapPlane *> &vpMapPlanes) const;
+
+        size_t size() const {
+            return mBinOfPlane.size();
+        }
+
+    protected:
+        static const int NUM_CELLS = 4;
+        static const int NUM_BINS = 6 * NUM_CELLS * NUM_CELLS;
+
+        struct Entry {
+            MapPlane *pMP;
+            Eigen::Vector3f normal;
+        };
+
+        static int ComputeBin(const Eigen::Vector3f &normal);
+
+        // Unit direction of the cube face point (face, u, v), with u, v in [-1, 1]
+        static Eigen::Vector3f FaceDirection(int face, float u, float v);
+
+        std::vector<Entry> mvBins[NUM_BINS];
+
+        // Center direction and angular radius of each cell
+        Eigen::Vector3f mvBinCenters[NUM_BINS];
+        float mvBinRadius[NUM_BINS];
+
+        std::unordered_map<MapPlane *, int> mBinOfPlane;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // MAPPLANEINDEX_H
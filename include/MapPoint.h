@@ -26,6 +26,7 @@
 #include"Map.h"
 
 #include<opencv2/core/core.hpp>
+#include<Eigen/Core>
 #include<mutex>
 
 namespace ORB_SLAM2 {
@@ -43,10 +44,17 @@ namespace ORB_SLAM2 {
 
         MapPoint(const cv::Mat &Pos, Map *pMap, Frame *pFrame, const int &idxF);
 
+        void SetWorldPos(const cv::Mat &Pos);
+
         cv::Mat GetWorldPos();
 
         cv::Mat GetNormal();
 
+        // Same as GetWorldPos and GetNormal without allocating a cv::Mat.
+        Eigen::Vector3f GetWorldPosEigen();
+
+        Eigen::Vector3f GetNormalEigen();
+
         std::map<KeyFrame *, size_t> GetObservations();
 
         int Observations();
@@ -85,6 +93,11 @@ namespace ORB_SLAM2 {
 
         int PredictScale(const float &currentDist, Frame *pF);
 
+        // Copy position, mean viewing direction, scale invariance distances and descriptor in one go, without
+        // allocating. Returns false if the point is bad.
+        bool CopyTrackingData(float *pPos, float *pNormal, float &minDistance, float &maxDistance,
+                              uchar *pDescriptor);
+
     public:
         long unsigned int mnId;
         static long unsigned int nNextId;
@@ -102,10 +115,15 @@ namespace ORB_SLAM2 {
         long unsigned int mnLastFrameSeen;
 
         // Variables used by local mapping
+        long unsigned int mnBALocalForKF;
         long unsigned int mnFuseCandidateForKF;
 
         static std::mutex mGlobalMutex;
 
+        // Restores the protected state of loaded maps
+        friend class MapSerializer;
+        friend class MappedMap;
+
     protected:
 
         // Position in absolute coordinates
@@ -0,0 +1,203 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef MAPSERIALIZER_H
+#define MAPSERIALIZER_H
+
+#include <string>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <tuple>
+
+#include "Map.h"
+#include "KeyFrameDatabase.h"
+#include "ORBVocabulary.h"
+
+namespace ORB_SLAM2 {
+
+    // Matching view of a keyframe of a map file, pointing into the mapping: its feature vector as sorted nodes with
+    // the features of each one, and the angle, landmark index and ORB descriptor of each feature.
+    struct MappedKeyFrame {
+        static const uint32_t NO_LANDMARK;
+
+        uint64_t nNodes;
+        const uint32_t *pNodes;
+        const uint64_t *pNodeBegin;
+        const uint32_t *pFeatures;
+
+        uint64_t N;
+        const float *pAngles;
+        const uint32_t *pMapPoints;
+        const uint8_t *pDescriptors;
+        size_t descriptorStep;
+    };
+
+    // Map file opened in place. Relocalization reads the inverted file, the bag of words, the covisibility and the
+    // features of its keyframes straight from the mapping. A KeyFrame and its landmarks are only built the first
+    // time relocalization settles on that keyframe, and are then owned by the Map like any other.
+    class MappedMap {
+    public:
+        MappedMap(Map *pMap, KeyFrameDatabase *pKFDB, ORBVocabulary *pVoc);
+
+        size_t NumKeyFrames() const;
+
+        // Mapped keyframes holding the word, as a range of indices
+        void GetKeyFramesWithWord(DBoW2::WordId wordId, const uint32_t *&pBegin, const uint32_t *&pEnd) const;
+
+        // Vocabulary score between the bag of words and the one of the mapped keyframe
+        float Score(const DBoW2::BowVector &bowVec, size_t idx) const;
+
+        // Up to 10 most covisible mapped keyframes, by decreasing weight
+        void GetBestCovisibles(size_t idx, const uint32_t *&pBegin, const uint32_t *&pEnd) const;
+
+        // Empty (no nodes) if the stored features are inconsistent
+        MappedKeyFrame GetMappedKeyFrame(size_t idx) const;
+
+        // The keyframe was built and culled since
+        bool IsBad(size_t idx);
+
+        // Build the keyframe, with the landmarks it observes, on its first request. Keyframes and landmarks built
+        // before are linked to it. The caller holds mMutexMapUpdate. Returns NULL if its record is corrupted.
+        KeyFrame *GetKeyFrame(size_t idx);
+
+        // Build everything not built yet
+        void BuildAll();
+
+    protected:
+        friend class MapSerializer;
+
+        KeyFrame *Build(uint32_t idx);
+
+        // Built keyframe still in the map, or NULL
+        KeyFrame *GetBuiltKeyFrame(uint32_t idx);
+
+        MapPoint *BuildMapPoint(uint32_t idx, KeyFrame *pKF);
+
+        MapLine *BuildMapLine(uint32_t idx, KeyFrame *pKF);
+
+        MapPlane *BuildMapPlane(uint32_t idx, KeyFrame *pKF);
+
+        Map *mpMap;
+        KeyFrameDatabase *mpKeyFrameDB;
+        ORBVocabulary *mpVocabulary;
+
+        std::shared_ptr<void> mpFile;
+        const char *mpData;
+        size_t mnSize;
+
+        // Calibration of the map, shared by all its keyframes
+        float fx, fy, cx, cy;
+        float mnMinX, mnMinY, mnMaxX, mnMaxY;
+        float mfGridElementWidthInv, mfGridElementHeightInv;
+        float mbf, mb, mThDepth;
+        cv::Mat mK;
+        int mnScaleLevels;
+        float mfScaleFactor, mfLogScaleFactor;
+        std::vector<float> mvScaleFactors, mvLevelSigma2, mvInvLevelSigma2;
+
+        // Record offsets
+        uint64_t mnKeyFrames, mnMapPoints, mnMapLines, mnMapPlanes;
+        const uint64_t *mpKeyFrameOffsets, *mpMapPointOffsets, *mpMapLineOffsets, *mpMapPlaneOffsets;
+
+        // Bag of words of each keyframe, as sorted words and their values
+        const uint64_t *mpBowBegin;
+        const uint32_t *mpBowWords;
+        const double *mpBowValues;
+
+        // Inverted file: sorted words, each with the keyframes holding it
+        uint64_t mnInvertedWords;
+        const uint32_t *mpInvertedWords;
+        const uint64_t *mpInvertedBegin;
+        const uint32_t *mpInvertedKeyFrames;
+
+        const uint64_t *mpCovisiblesBegin;
+        const uint32_t *mpCovisibles;
+
+        // Feature vector of each keyframe
+        const uint64_t *mpNodesBegin;
+        const uint32_t *mpNodes;
+        uint64_t mnNodes;
+        const uint64_t *mpNodeFeaturesBegin;
+        const uint32_t *mpNodeFeatures;
+        uint64_t mnNodeFeatures;
+
+        // Features of each keyframe
+        const uint64_t *mpFeaturesBegin;
+        uint64_t mnFeatures;
+        const float *mpAngles;
+        const uint32_t *mpFeatureMapPoints;
+        const uint8_t *mpDescriptors;
+        size_t mnDescriptorBytes;
+
+        // Manhattan frames of each keyframe, as 3 plane indices (the last one NO_LANDMARK for partial frames)
+        const uint64_t *mpFramesBegin;
+        const uint32_t *mpFramePlanes;
+        uint64_t mnFrames;
+
+        const uint32_t *mpOrigins;
+        uint64_t mnOrigins;
+
+        // Elements built so far
+        std::unordered_map<uint32_t, KeyFrame *> mmKeyFrames;
+        std::unordered_map<uint32_t, MapPoint *> mmMapPoints;
+        std::unordered_map<uint32_t, MapLine *> mmMapLines;
+        std::unordered_map<uint32_t, MapPlane *> mmMapPlanes;
+
+        // Plane links of the built keyframes to planes not built yet: (keyframe, plane of the keyframe, vertical)
+        std::unordered_multimap<uint32_t, std::tuple<KeyFrame *, int, bool> > mmPendingPlaneLinks;
+
+        std::mutex mMutex;
+    };
+
+    // Binary map file holding the keyframes with their features and plane observations, the MapPoints, MapLines,
+    // MapPlanes with their points and the Manhattan frames. Elements refer to each other by their index in the
+    // file. The file starts with a magic string and a format version, files of another version are rejected.
+    //
+    // The records of the elements come first. They are followed by flat, aligned arrays indexing them: record
+    // offsets, the bag of words, feature vectors, ORB descriptors and best covisibles of the keyframes and the
+    // inverted file of the vocabulary words. The file ends with the offset of these arrays. Loading maps the file
+    // and reads this offset, nothing else: relocalization uses the arrays in place through a MappedMap, which
+    // builds the keyframes it settles on. Line and landmark descriptors, positions and plane coefficients of the
+    // built elements point into the mapping, which the Map keeps alive.
+    class MapSerializer {
+    public:
+        static const uint32_t VERSION;
+
+        MapSerializer(Map *pMap, KeyFrameDatabase *pKFDB, ORBVocabulary *pVoc);
+
+        // Write the good keyframes and landmarks of the map, after building those of a loaded map file that were
+        // not built yet. Nothing else may modify the map meanwhile. The file is replaced once fully written.
+        bool Save(const std::string &filename);
+
+        // Open a file written by Save for relocalization, the map and the keyframe database must be empty. K, bf and
+        // the ORB scale pyramid are those of the settings, a map built with another calibration is rejected.
+        bool Load(const std::string &filename, const cv::Mat &K, float bf, int nScaleLevels, float scaleFactor);
+
+    protected:
+        Map *mpMap;
+        KeyFrameDatabase *mpKeyFrameDB;
+        ORBVocabulary *mpVocabulary;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // MAPSERIALIZER_H
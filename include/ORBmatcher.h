@@ -29,10 +29,13 @@
 #include"MapPoint.h"
 #include"KeyFrame.h"
 #include"Frame.h"
+#include"LocalMapPoints.h"
 
 
 namespace ORB_SLAM2 {
 
+    struct MappedKeyFrame;
+
     class ORBmatcher {
     public:
 
@@ -45,6 +48,9 @@ namespace ORB_SLAM2 {
         // Used to track the local map (Tracking)
         int SearchByProjection(Frame &F, const std::vector<MapPoint *> &vpMapPoints, const float th = 3);
 
+        // Same search over the points of a local map snapshot visible in F after LocalMapPoints::Project.
+        int SearchByProjection(Frame &F, const LocalMapPoints &localMapPoints, const float th = 3);
+
         // Project MapPoints tracked in last frame into the current frame and search matches.
         // Used to track from previous frame (Tracking)
         int SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame, const float th);
@@ -59,6 +65,10 @@ namespace ORB_SLAM2 {
         // Used in Relocalisation
         int SearchByBoW(KeyFrame *pKF, Frame &F, std::vector<MapPoint *> &vpMapPointMatches);
 
+        // Same search against a keyframe of a map file, read in place. Matches are the features of the keyframe
+        // with a MapPoint, -1 for unmatched features of F.
+        int SearchByBoW(const MappedKeyFrame &KF, Frame &F, std::vector<int> &vnMatchesKF);
+
         // Matching to triangulate new MapPoints. Check Epipolar Constraint.
         int SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F12,
                                    std::vector<pair<size_t, size_t> > &vMatchedPairs, const bool bOnlyStereo);
@@ -25,6 +25,11 @@
 #include "MapPoint.h"
 #include "KeyFrame.h"
 #include "Frame.h"
+#include "EdgePool.h"
+#include "PoseSolver.h"
+
+#include "Thirdparty/g2o/g2o/core/sparse_optimizer.h"
+#include "Thirdparty/g2o/g2o/types/types_six_dof_expmap.h"
 
 namespace ORB_SLAM2 {
 
@@ -32,14 +37,57 @@ namespace ORB_SLAM2 {
     public:
 
         Optimizer(double angleInfo, double disInfo, double parInfo, double verInfo, double planeChi, double planeChiVP,
-                  double aTh, double parTh);
+                  double aTh, double parTh, bool bG2oPoseOptimization = true);
 
+        // Runs the g2o graph, or the dedicated PoseSolver when it was selected at construction.
         int PoseOptimization(Frame *pFrame);
 
+        // Implementation on a pooled g2o graph, the default.
+        int PoseOptimizationG2o(Frame *pFrame);
+
         int TranslationOptimization(Frame *pFrame);
 
+        // Windowed bundle adjustment of pKF and its covisible keyframes together with the MapPoints and MapLine
+        // endpoints they observe. Keyframes observing those landmarks outside the window are kept fixed. Plane,
+        // parallel and vertical plane observations of the window constrain the poses. Stops early once *pbStopFlag
+        // is set.
+        void LocalBundleAdjustment(KeyFrame *pKF, bool *pbStopFlag, Map *pMap);
+
     protected:
         double angleInfo, disInfo, parInfo, verInfo, planeChi, planeChiVP, aTh, parTh;
+
+        bool mbG2oPoseOptimization;
+        PoseSolver mPoseSolver;
+
+        // Single pose problem shared by PoseOptimization and TranslationOptimization, which are only called from
+        // the tracking thread. The graph, its dense 6x6 solver and the edges are allocated once and reused.
+        g2o::SparseOptimizer mPoseOptimizer;
+        g2o::VertexSE3Expmap *mpPoseVertex;
+
+        EdgePool<g2o::EdgeSE3ProjectXYZOnlyPose> mPoolMono;
+        EdgePool<g2o::EdgeStereoSE3ProjectXYZOnlyPose> mPoolStereo;
+        EdgePool<g2o::EdgeLineProjectXYZOnlyPose> mPoolLine;
+        EdgePool<g2o::EdgePlaneOnlyPose> mPoolPlane;
+        EdgePool<g2o::EdgeParallelPlaneOnlyPose> mPoolParPlane;
+        EdgePool<g2o::EdgeVerticalPlaneOnlyPose> mPoolVerPlane;
+
+        EdgePool<g2o::EdgeSE3ProjectXYZOnlyTranslation> mPoolMonoTrans;
+        EdgePool<g2o::EdgeStereoSE3ProjectXYZOnlyTranslation> mPoolStereoTrans;
+        EdgePool<g2o::EdgeLineProjectXYZOnlyTranslation> mPoolLineTrans;
+        EdgePool<g2o::EdgePlaneOnlyTranslation> mPoolPlaneTrans;
+
+        // Park every pooled edge, leaving the pose vertex without active edges.
+        void ResetPosePools();
+
+        // Edges handed out by the pools since the last reset.
+        size_t NumPoseEdges() const;
+
+        // Local bundle adjustment graph, only used by the local mapping thread. Vertices change with every call,
+        // so the graph is cleared but the sparse Cholesky solver is kept.
+        g2o::SparseOptimizer mLocalBAOptimizer;
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
     };
 
 } //namespace ORB_SLAM
@@ -0,0 +1,73 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef ORTHOGONALPLANES_H
+#define ORTHOGONALPLANES_H
+
+#include <vector>
+#include <cmath>
+#include <opencv2/core/core.hpp>
+#include <eigen3/Eigen/Core>
+
+namespace ORB_SLAM2 {
+
+    class MapPlane;
+
+    // Planes of a frame grouped in clusters of parallel normals, used to form Manhattan frames from one plane
+    // per cluster. In structured scenes the planes fall in a few clusters, so walking the clusters instead of
+    // the plane pairs and triples keeps the work close to linear in the number of planes.
+    class OrthogonalPlanes {
+    public:
+        // Cluster the normals of the planes. Planes without a map plane or with a bad one are left out.
+        void Compute(const std::vector<cv::Mat> &vCoefficients, const std::vector<MapPlane *> &vpMapPlanes,
+                     float verTh);
+
+        // Whether the normals of two distinct clustered planes satisfy |n_i.dot(n_j)| <= verTh
+        bool IsOrthogonal(int i, int j) const {
+            return i != j && mvCluster[i] != -1 && mvCluster[j] != -1 &&
+                   std::abs(mvNormals[i].dot(mvNormals[j])) <= mfVerTh;
+        }
+
+        int NumClusters() const {
+            return static_cast<int>(mvClusterPlanes.size());
+        }
+
+        // Cluster of plane i, -1 if the plane was left out
+        int GetCluster(int i) const {
+            return mvCluster[i];
+        }
+
+        const std::vector<int> &GetClusterPlanes(int c) const {
+            return mvClusterPlanes[c];
+        }
+
+    protected:
+        // Angular radius of a cluster of parallel normals (10 degrees)
+        static constexpr float CLUSTER_RADIUS = 0.1745f;
+
+        float mfVerTh = 0;
+        std::vector<Eigen::Vector3f> mvNormals;
+        std::vector<int> mvCluster;
+        std::vector<std::vector<int> > mvClusterPlanes;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // ORTHOGONALPLANES_H
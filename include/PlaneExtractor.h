@@ -29,29 +29,38 @@
 #include "include/peac/AHCPlaneFitter.hpp"
 #include <unordered_map>
 
-typedef Eigen::Vector3d VertexType;
-typedef cv::Vec3d VertexColour;
-
 #ifdef __linux__
 #define _isnan(x) isnan(x)
 #endif
 
+// Organized point cloud in structure-of-arrays layout, read by ahc::PlaneFitter through get()
 struct ImagePointCloud {
-    std::vector<VertexType> vertices; // 3D vertices
-    std::vector<VertexColour> verticesColour;
+    std::vector<float> x, y, z; // 3D vertices
+    std::vector<cv::Vec3b> colours;
     int w, h;
 
     inline int width() const { return w; }
 
     inline int height() const { return h; }
 
-    inline bool get(const int row, const int col, double &x, double &y, double &z) const {
+    inline int size() const { return w * h; }
+
+    inline void resize(const int width, const int height) {
+        w = width;
+        h = height;
+        x.resize(w * h);
+        y.resize(w * h);
+        z.resize(w * h);
+        colours.resize(w * h);
+    }
+
+    inline bool get(const int row, const int col, double &px, double &py, double &pz) const {
         const int pixIdx = row * w + col;
-        z = vertices[pixIdx][2];
+        pz = z[pixIdx];
         // Remove points with 0 or invalid depth in case they are detected as a plane
-        if (z == 0 || std::_isnan(z)) return false;
-        x = vertices[pixIdx][0];
-        y = vertices[pixIdx][1];
+        if (pz == 0 || std::_isnan(pz)) return false;
+        px = x[pixIdx];
+        py = y[pixIdx];
         return true;
     }
 };
@@ -72,9 +81,15 @@ public:
 
     bool readColorImage(cv::Mat RGBImg);
 
-    bool readDepthImage(const cv::Mat depthImg, const cv::Mat &K, const float &depthMapFactor);
+    // Read the organized point cloud (CV_32FC3, camera coordinates) at half resolution
+    bool readPointCloud(const cv::Mat &pointCloud);
+
+    // pPrior warm-starts the clustering from the segmentation of a previous frame, NULL for a cold start
+    void runPlaneDetection(const ahc::PlanePrior *pPrior = NULL);
 
-    void runPlaneDetection();
+    // Export the segmentation of the last run to warm-start the next frame. K are the intrinsics of the full
+    // resolution image, the prior motion is set to identity.
+    void exportPrior(ahc::PlanePrior &prior, const cv::Mat &K) const;
 
 };
 
@@ -24,6 +24,7 @@
 #include "MapPlane.h"
 #include "KeyFrame.h"
 #include "Frame.h"
+#include "Map.h"
 #include <pcl/common/transforms.h>
 #include <pcl/point_types.h>
 
@@ -37,10 +38,20 @@ namespace ORB_SLAM2 {
 
         int SearchMapByCoefficients(Frame &pF, const std::vector<MapPlane *> &vpMapPlanes);
 
+        // Same association against the whole map, only visiting the planes that the normal index of the map
+        // returns as possible matches, vertical or parallel planes of each frame plane.
+        int SearchMapByCoefficients(Frame &pF, Map *pMap);
+
     protected:
         float dTh, aTh, verTh, parTh;
 
+        // Associate the i-th plane of pF, with world coefficients pM, to vpMapPlanes. Returns true if matched.
+        bool SearchPlane(Frame &pF, int i, const cv::Mat &pM, const std::vector<MapPlane *> &vpMapPlanes);
+
         double PointDistanceFromPlane(const cv::Mat &plane, PointCloud::Ptr pointCloud);
+
+        // Lower bound of PointDistanceFromPlane from the bounding box of the map plane points
+        double PointDistanceLowerBound(const cv::Mat &plane, MapPlane *pMP);
     };
 }
 
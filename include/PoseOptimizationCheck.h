@@ -0,0 +1,67 @@
+/**
+* This file is part of ORB-SLAM2.
+*
+* Copyright (C) 2014-2016 Raúl Mur-Artal <raulmur at unizar dot es> (University of Zaragoza)
+* For more information see <https://github.com/raulmur/ORB_SLAM2>
+*
+* ORB-SLAM2 is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ORB-SLAM2 is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ORB-SLAM2. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POSEOPTIMIZATIONCHECK_H
+#define POSEOPTIMIZATIONCHECK_H
+
+#include "Frame.h"
+#include "Optimizer.h"
+
+namespace ORB_SLAM2 {
+
+    // Checks the pose optimization of the tracking against the original implementation: a g2o graph built from
+    // scratch for every frame, with newly allocated edges whose robust kernels are removed for the last rounds.
+    // This covers both the pooled g2o graph and PoseSolver. Differences are accumulated, not printed per frame.
+    class PoseOptimizationCheck {
+    public:
+        struct Stats {
+            int nFrames;
+            // Frames where both implementations disagree on the number of inliers
+            int nInlierMismatches;
+            double sumRotation, maxRotation; // degrees
+            double sumTranslation, maxTranslation; // meters
+
+            Stats() : nFrames(0), nInlierMismatches(0), sumRotation(0), maxRotation(0), sumTranslation(0),
+                      maxTranslation(0) {}
+        };
+
+        PoseOptimizationCheck(double angleInfo, double disInfo, double parInfo, double verInfo, double planeChi,
+                              double planeChiVP, double aTh, double parTh);
+
+        // Optimize pFrame with pOptimizer and a copy of it with the reference implementation, and accumulate the
+        // difference of the poses. Returns the inliers of pOptimizer.
+        int PoseOptimization(Optimizer *pOptimizer, Frame *pFrame);
+
+        Stats GetStats() const {
+            return mStats;
+        }
+
+    protected:
+        // Original Optimizer::PoseOptimization
+        int ReferencePoseOptimization(Frame *pFrame);
+
+        double angleInfo, disInfo, parInfo, verInfo, planeChi, planeChiVP, aTh, parTh;
+
+        Stats mStats;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // POSEOPTIMIZATIONCHECK_H
@@ -0,0 +1,133 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef POSESOLVER_H
+#define POSESOLVER_H
+
+#include <vector>
+#include <Eigen/Core>
+#include <Eigen/Cholesky>
+#include <Eigen/StdVector>
+
+#include "Frame.h"
+
+#include "Thirdparty/g2o/g2o/types/se3quat.h"
+#include "Thirdparty/g2o/g2o/types/plane_3d.h"
+
+namespace ORB_SLAM2 {
+
+    // Frame pose optimization without a g2o graph. The problem has a single 6-DoF vertex, so the normal equations
+    // are a fixed size 6x6 system accumulated directly from the point, line and plane residuals and solved with the
+    // same Levenberg-Marquardt schedule as g2o. Residual data is kept in contiguous arrays that are reused between
+    // frames, so once their capacity has grown no memory is allocated. The normal equations are accumulated by plain
+    // scalar loops over those arrays. Only used by the tracking thread.
+    class PoseSolver {
+    public:
+        PoseSolver(double angleInfo, double disInfo, double parInfo, double verInfo, double planeChi,
+                   double planeChiVP, double aTh, double parTh);
+
+        // Same observations, robust kernels, outlier classification and return value as the g2o version of
+        // Optimizer::PoseOptimization.
+        int PoseOptimization(Frame *pFrame);
+
+    protected:
+        typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+        typedef Eigen::Matrix<double, 6, 1> Vector6d;
+
+        // Point or line endpoint residuals: world position and a measurement of up to three values (u, v, u right
+        // for points, the line function for line endpoints).
+        struct PointTerms {
+            std::vector<double> vX, vY, vZ;
+            std::vector<double> vM0, vM1, vM2;
+            std::vector<double> vInfo;
+            std::vector<double> vChi2;
+            std::vector<char> vbInlier;
+            std::vector<size_t> vnIndex;
+
+            void Clear();
+
+            void Add(const Eigen::Vector3d &Xw, double m0, double m1, double m2, double info, size_t idx);
+
+            size_t Size() const {
+                return vnIndex.size();
+            }
+        };
+
+        // Plane residuals: world plane, already flipped towards the observation, and the observed plane.
+        struct PlaneTerms {
+            std::vector<g2o::Plane3D, Eigen::aligned_allocator<g2o::Plane3D> > vXw, vObs;
+            std::vector<double> vChi2;
+            std::vector<char> vbInlier;
+            std::vector<size_t> vnIndex;
+
+            void Clear();
+
+            void Add(const g2o::Plane3D &Xw, const g2o::Plane3D &obs, size_t idx);
+
+            size_t Size() const {
+                return vnIndex.size();
+            }
+        };
+
+        // Robust cost of the inliers at T. With bLinearize the normal equations at T are accumulated in mH and mb.
+        // The plain chi2 of every term, inlier or not, is stored for the outlier classification.
+        double Evaluate(const g2o::SE3Quat &T, bool bLinearize);
+
+        double EvaluateMono(const Eigen::Matrix3d &R, const Eigen::Vector3d &t, bool bLinearize);
+
+        double EvaluateStereo(const Eigen::Matrix3d &R, const Eigen::Vector3d &t, bool bLinearize);
+
+        double EvaluateLines(const Eigen::Matrix3d &R, const Eigen::Vector3d &t, bool bLinearize);
+
+        // Plane residuals are differentiated numerically like their g2o edges, with the poses perturbed along each
+        // axis that Evaluate prepares once for all planes.
+        template<int D, class ErrorFunction>
+        double EvaluatePlanes(PlaneTerms &terms, const Eigen::Isometry3d &T, const Eigen::Matrix<double, D, D> &info,
+                              double delta, ErrorFunction error, bool bLinearize);
+
+        // Levenberg-Marquardt iterations from T, following g2o::OptimizationAlgorithmLevenberg.
+        void Optimize(g2o::SE3Quat &T, int nIterations);
+
+        // Reclassify every term with the chi2 stored by the last Evaluate. Returns the number of outliers.
+        int Classify(Frame *pFrame);
+
+        size_t NumTerms() const;
+
+        double angleInfo, disInfo, parInfo, verInfo, planeChi, planeChiVP, aTh, parTh;
+
+        PointTerms mMono, mStereo, mLines;
+        PlaneTerms mPlanes, mParPlanes, mVerPlanes;
+
+        float fx, fy, cx, cy, bf;
+
+        bool mbRobust;
+
+        Matrix6d mH;
+        Vector6d mb;
+        Eigen::Isometry3d mTPlus[6], mTMinus[6];
+        Eigen::LDLT<Matrix6d> mLDLT;
+
+    public:
+        EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+    };
+
+} //namespace ORB_SLAM
+
+#endif // POSESOLVER_H
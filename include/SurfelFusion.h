@@ -29,9 +29,11 @@
 #include <opencv2/opencv.hpp>
 
 #include <Surfel.h>
+#include "ThreadPool.h"
+
+#include <functional>
 
 #define ITERATION_NUM 3
-#define THREAD_NUM 10
 #define SP_SIZE 8
 #define MAX_ANGLE_COS 0.1
 
@@ -40,6 +42,11 @@
 #define DISPARITY_ERROR 4.0
 #define MIN_TOLERATE_DIFF 0.1
 
+// Work items handed to a worker at a time by the parallel kernels
+#define ROW_GRAIN 8
+#define SEED_GRAIN 64
+#define SURFEL_GRAIN 1024
+
 class SurfelFusion {
 private:
 
@@ -64,9 +71,9 @@ private:
 
     cv::Mat image;
     cv::Mat depth;
+    cv::Mat pointCloud;
     cv::Mat planeMembershipImg;
 
-    std::vector<double> spaceMap;
     std::vector<float> normMap;
     std::vector<SuperpixelSeed> superpixelSeeds;
     std::vector<int> superpixelIndex;
@@ -74,6 +81,12 @@ private:
     std::vector<Surfel> *localSurfelsPtr;
     std::vector<Surfel> *newSurfelsPtr;
 
+    // Workers for the kernels. NULL runs all kernels in the calling thread.
+    ORB_SLAM2::ThreadPool *threadPool;
+
+    // Run kernel(begin, end) over [begin, end) on the thread pool in chunks of grain indices.
+    void parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &kernel);
+
     void generateSuperPixels();
 
     void backProject(
@@ -85,17 +98,15 @@ private:
             const int &x, const int &y,
             const int &spX, const int &spY);
 
-    void updatePixelsKernel(int thread, int threadNum);
+    void updatePixelsKernel(int begin, int end);
 
     void updatePixels();
 
-    void updateSeedsKernel(
-            int thread, int threadNum);
+    void updateSeedsKernel(int begin, int end);
 
     void updateSeeds();
 
-    void initializeSeedsKernel(
-            int thread, int threadNum);
+    void initializeSeedsKernel(int begin, int end);
 
     void getHuberNorm(
             float &nx, float &ny, float &nz, float &nb,
@@ -103,16 +114,14 @@ private:
 
     void initializeSeeds();
 
-    void calculateSpacesKernel(int thread, int threadNum);
-
-    void calculateSpDepthNormsKernel(int thread, int threadNum);
+    void calculateSpDepthNormsKernel(int begin, int end);
 
-    void calculatePixelsNormsKernel(int thread, int threadNum);
+    void calculatePixelsNormsKernel(int begin, int end);
 
     void calculateNorms();
 
     void fuseSurfelsKernel(
-            const int thread, const int threadNum,
+            const int begin, const int end,
             const int referenceFrameIndex, const Eigen::Matrix4f &pose, const Eigen::Matrix4f &invPose);
 
     void initializeSurfels(
@@ -126,12 +135,13 @@ private:
 public:
     SurfelFusion(int width, int height,
                  float _fx, float _fy, float _cx, float _cy,
-                 float _fuseFar, float _fuseNear);
+                 float _fuseFar, float _fuseNear, ORB_SLAM2::ThreadPool *_threadPool);
 
     void fuseInitializeMap(
             const int referenceFrameIndex,
             const cv::Mat &inputImage,
             const cv::Mat &inputDepth,
+            const cv::Mat &inputPointCloud,
             const cv::Mat &inputPlaneMembershipImg,
             const Eigen::Matrix4f &pose,
             std::vector<Surfel> &localSurfels,
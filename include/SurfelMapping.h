@@ -29,8 +29,12 @@
 #include "Map.h"
 #include "Surfel.h"
 #include "SurfelFusion.h"
+#include "ThreadPool.h"
+#include "FrameBuffer.h"
 #include <pcl/point_types.h>
 
+#include <condition_variable>
+
 
 namespace ORB_SLAM2 {
     typedef pcl::PointXYZRGB PointType;
@@ -45,22 +49,53 @@ namespace ORB_SLAM2 {
         PoseElement() : pointsBeginIndex(-1), pointsPoseIndex(-1) {}
     };
 
+    struct KeyFrameElement {
+        FrameBuffer::Ptr pFrameBuffer;
+        cv::Mat pose;
+        int referenceIndex;
+        // Position of the keyframe in the sequence of inserted keyframes
+        int sequenceIndex;
+    };
+
     class SurfelMapping {
     public:
 
+        // What InsertKeyFrame does when Surfel.QueueSize keyframes are already waiting for fusion
+        enum eQueuePolicy {
+            QUEUE_BLOCK = 0,                // Wait in WaitForQueueSpace() until the thread frees a slot
+            QUEUE_DROP_OLDEST = 1,          // Discard the oldest queued keyframe
+            QUEUE_NEWEST_PER_REFERENCE = 2  // Keep only the newest keyframe per reference, then drop the oldest
+        };
+
         SurfelMapping(Map *map, const string &strSettingsFile);
 
         void Run();
 
         pcl::PointCloud<pcl::PointSurfel>::Ptr Stop();
 
-        void InsertKeyFrame(const cv::Mat &imRGB, const cv::Mat &imDepth, const cv::Mat planeMembershipImg,
-                            const cv::Mat &pose, const int referenceIndex);
+        // Never blocks, so it can be called while holding the map mutex. With QUEUE_BLOCK the queue may exceed
+        // Surfel.QueueSize until the inserting thread calls WaitForQueueSpace().
+        void InsertKeyFrame(const FrameBuffer::Ptr &pFrameBuffer, const cv::Mat &pose, const int referenceIndex);
+
+        // With QUEUE_BLOCK, wait until the queue is below Surfel.QueueSize. Call it without holding any lock the
+        // Surfel Mapping thread may need, Tracking calls it after Track() has released the map mutex.
+        void WaitForQueueSpace();
+
+        int KeyframesInQueue();
+
+        // Number of keyframes discarded by the queue policy without being fused.
+        int DroppedKeyFrames();
 
     protected:
 
         bool CheckNewKeyFrames();
 
+        // Signal the Surfel Mapping thread that a keyframe or a stop request arrived.
+        void WakeUp();
+
+        // Block until WakeUp() has been called since the last wait.
+        void WaitForWork();
+
         void ProcessNewKeyFrame();
 
         void moveAddSurfels(int referenceIndex);
@@ -69,19 +104,37 @@ namespace ORB_SLAM2 {
 
         void getDriftfreePoses(int rootIndex, std::vector<int> &driftfreePoses, int driftfreeRange);
 
-        void fuseMap(cv::Mat image, cv::Mat depth, cv::Mat planeMembershipImg, Eigen::Matrix4f poseInput,
-                     int referenceIndex);
+        void fuseMap(const FrameBuffer::Ptr &pFrameBuffer, Eigen::Matrix4f poseInput, int referenceIndex);
 
-        std::list<std::tuple<cv::Mat, cv::Mat, cv::Mat, cv::Mat, int>> mlNewKeyFrames;
+        std::list<KeyFrameElement> mlNewKeyFrames;
 
         std::mutex mMutexNewKFs;
+        std::condition_variable mCondQueueSpace;
+
+        // Queue bound (0: unbounded) and eQueuePolicy applied once it is reached
+        int mnMaxQueuedKeyFrames;
+        int mnQueuePolicy;
+
+        int mnInsertedKeyFrames;
+        int mnDroppedKeyFrames;
+
+        // Pose database index of every inserted keyframe (-1 while queued or if dropped), only kept when the queue
+        // is bounded since otherwise no keyframe is dropped and the indices are the same. Like posesDatabase it has
+        // one entry per keyframe ever fused.
+        std::vector<int> mvKeyFramePoseIndex;
         bool mbStop;
         std::mutex mMutexStop;
 
+        bool mbWakeUp;
+        std::mutex mMutexWakeUp;
+        std::condition_variable mCondWakeUp;
+
         Map *mMap;
 
         SurfelFusion *mSurfelFusion;
 
+        ThreadPool *mThreadPool;
+
         std::vector<PoseElement> posesDatabase;
         std::set<int> localSurfelsIndexs;
         int driftFreePoses;
@@ -35,6 +35,7 @@
 #include "KeyFrameDatabase.h"
 #include "ORBVocabulary.h"
 #include "Viewer.h"
+#include "ThreadPool.h"
 
 
 namespace ORB_SLAM2 {
@@ -87,9 +88,13 @@ namespace ORB_SLAM2 {
         // See format details at: http://vision.in.tum.de/data/datasets/rgbd-dataset
         void SaveKeyFrameTrajectoryTUM(const string &filename);
 
-        // TODO: Save/Load functions
-        // SaveMap(const string &filename);
-        // LoadMap(const string &filename);
+        // Save the keyframes, landmarks and Manhattan frames of the map to a binary file.
+        // Call first Shutdown() or save in localization mode, when the map is not being modified.
+        bool SaveMap(const string &filename);
+
+        // Load a map saved with SaveMap(). Call before processing the first frame, the map must be empty.
+        // Tracking starts by relocalizing in the loaded map, whose keyframes are built as relocalization reaches them.
+        bool LoadMap(const string &filename);
 
     private:
 
@@ -98,6 +103,9 @@ namespace ORB_SLAM2 {
         // ORB vocabulary used for place recognition and feature matching.
         ORBVocabulary *mpVocabulary;
 
+        // Worker threads shared by Tracking, Frame extraction and Local Mapping.
+        ThreadPool *mpThreadPool;
+
         // KeyFrame database for place recognition (relocalization).
         KeyFrameDatabase *mpKeyFrameDatabase;
 
@@ -122,8 +130,9 @@ namespace ORB_SLAM2 {
         FrameDrawer *mpFrameDrawer;
         MapDrawer *mpMapDrawer;
 
-        // System threads: Local Mapping, Surfel Mapping, Viewer.
+        // System threads: Local Mapping, Surfel Mapping, Viewer and (optionally) the Tracking front-end.
         // The Tracking thread "lives" in the main execution thread that creates the System object.
+        std::thread *mptFrontEnd;
         std::thread *mptLocalMapping;
         std::thread *mptSurfelMapping;
         std::thread *mptViewer;
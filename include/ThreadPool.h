@@ -0,0 +1,82 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+
+namespace ORB_SLAM2 {
+
+    // Fixed pool of long-lived worker threads shared by Tracking, LocalMapping and Frame extraction.
+    // Tasks are submitted in groups and Run() blocks until the whole group has finished. The calling
+    // thread executes the tasks of its group that no worker has picked up yet, so Run() never waits
+    // on an idle queue and can be safely called from inside a task.
+    class ThreadPool {
+    public:
+        // nThreads <= 0 uses the number of hardware threads.
+        ThreadPool(int nThreads);
+
+        ~ThreadPool();
+
+        // Execute all tasks and wait until they have finished.
+        void Run(std::vector<std::function<void()> > &vTasks);
+
+        // Call f(chunkBegin, chunkEnd) over [begin, end) split in chunks of nGrain indices. Chunks are
+        // handed out dynamically, so threads that finish cheap chunks early pick up the remaining ones.
+        void ParallelFor(int begin, int end, int nGrain, const std::function<void(int, int)> &f);
+
+        int GetNumThreads() const {
+            return static_cast<int>(mvWorkers.size());
+        }
+
+    protected:
+
+        struct TaskGroup {
+            std::vector<std::function<void()> > vTasks;
+            std::unique_ptr<std::atomic<bool>[]> vbClaimed;
+            std::atomic<int> nRemaining;
+            std::mutex mMutexDone;
+            std::condition_variable mCondDone;
+        };
+
+        // Claim the idx-th task of the group and execute it. Returns false if it was already claimed.
+        static bool ExecuteTask(const std::shared_ptr<TaskGroup> &pGroup, size_t idx);
+
+        void WorkerLoop();
+
+        std::vector<std::thread> mvWorkers;
+
+        std::deque<std::pair<std::shared_ptr<TaskGroup>, size_t> > mqTasks;
+        std::mutex mMutexQueue;
+        std::condition_variable mCondQueue;
+        bool mbFinish;
+    };
+
+} //namespace ORB_SLAM
+
+#endif // THREADPOOL_H
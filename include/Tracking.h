@@ -39,6 +39,8 @@
 
 
 #include <mutex>
+#include <condition_variable>
+#include <chrono>
 
 #include "LSDextractor.h"
 #include "MapLine.h"
@@ -46,6 +48,11 @@
 #include "PlaneMatcher.h"
 #include "MapPlane.h"
 #include "Optimizer.h"
+#include "PoseOptimizationCheck.h"
+#include "ThreadPool.h"
+#include "LocalMapPoints.h"
+#include "FrameBuffer.h"
+#include "DepthPreprocessor.h"
 
 namespace ORB_SLAM2 {
 
@@ -66,12 +73,30 @@ namespace ORB_SLAM2 {
     public:
 
         Tracking(System *pSys, ORBVocabulary *pVoc, FrameDrawer *pFrameDrawer, MapDrawer *pMapDrawer, Map *pMap,
-                 KeyFrameDatabase *pKFDB, const string &strSettingPath);
+                 KeyFrameDatabase *pKFDB, ThreadPool *pThreadPool, const string &strSettingPath);
 
+        // Process the given rgbd frame. If the front-end pipeline is enabled (Tracking.PipelineDepth > 0)
+        // the frame is queued for extraction and the pose of the oldest frame in the pipeline is returned
+        // (empty while the pipeline fills up).
         cv::Mat GrabImage(const cv::Mat &imRGB, const cv::Mat &imD, const double &timestamp);
 
+        // Front-end stage of the pipeline. It builds Frames (ORB, LSD and plane extraction) from the
+        // queued rgbd pairs while Track() processes the previous ones. Only launched if IsPipelined().
+        void RunFrontEnd();
+
+        bool IsPipelined() {
+            return mnPipelineDepth > 0;
+        }
+
+        // Track all frames still in the pipeline and stop the front-end stage.
+        void FlushPipeline();
+
         void SetLocalMapper(LocalMapping *pLocalMapper);
 
+        Optimizer *GetOptimizer() {
+            return mpOptimizer;
+        }
+
         void SetSurfelMapper(SurfelMapping *pSurfelMapper);
 
         void SetViewer(Viewer *pViewer);
@@ -79,6 +104,12 @@ namespace ORB_SLAM2 {
         // Use this function if you have deactivated local mapping and you only want to localize the camera.
         void InformOnlyTracking(const bool &flag);
 
+        // Call after a map has been loaded into the empty map. Tracking starts by relocalizing in it.
+        void InformMapLoaded();
+
+        // Calibration and ORB scale pyramid from the settings, a map to load must have been built with the same.
+        void GetCalibration(cv::Mat &K, float &bf, int &nScaleLevels, float &scaleFactor);
+
     public:
 
         // Tracking states
@@ -98,6 +129,11 @@ namespace ORB_SLAM2 {
         cv::Mat mImRGB;
         cv::Mat mImGray;
         cv::Mat mImDepth;
+        cv::Mat mImPointCloud;
+
+        // Gray, metric depth and plane membership images of the current frame, shared with the
+        // Frame Drawer and Surfel Mapping without copying
+        FrameBuffer::Ptr mpFrameBuffer;
 
         // Lists used to recover the full camera trajectory at the end of the execution.
         // Basically we store the reference keyframe for each frame and its relative transformation
@@ -109,10 +145,58 @@ namespace ORB_SLAM2 {
         // True if local mapping is deactivated and we are performing only localization
         bool mbOnlyTracking;
 
+        // Accumulated per-stage latencies of the front-end pipeline (seconds)
+        struct PipelineStats {
+            int nFrames;
+            double extraction;
+            double queue;
+            double tracking;
+            double endToEnd;
+            double maxEndToEnd;
+
+            PipelineStats() : nFrames(0), extraction(0), queue(0), tracking(0), endToEnd(0), maxEndToEnd(0) {}
+        };
+
+        PipelineStats GetPipelineStats();
+
+        // Only with Tracking.CheckPoseOptimization, otherwise NULL
+        PoseOptimizationCheck *GetPoseOptimizationCheck() {
+            return mpPoseOptimizationCheck;
+        }
+
         void Reset();
 
     protected:
 
+        // Frame waiting in the front-end pipeline. pFrame is null until the front-end has built it.
+        struct PipelinedFrame {
+            Frame *pFrame;
+            cv::Mat imRGB;
+            cv::Mat imGray;
+            cv::Mat imDepth;
+            cv::Mat imPointCloud;
+            double timestamp;
+            std::chrono::steady_clock::time_point tGrab;
+            std::chrono::steady_clock::time_point tBuildStart;
+            std::chrono::steady_clock::time_point tBuilt;
+        };
+
+        // Convert the input image to grayscale and the depthmap to metric depth and point cloud.
+        void PreprocessImages(const cv::Mat &imRGB, const cv::Mat &imD, cv::Mat &imGray, cv::Mat &imDepth,
+                              cv::Mat &imPointCloud);
+
+        cv::Mat GrabImagePipelined(const cv::Mat &imRGB, const cv::Mat &imD, const double &timestamp);
+
+        // Wait for the oldest frame of the pipeline to be built and track it.
+        cv::Mat TrackNextPipelinedFrame();
+
+        // Plane segmentation of the last built frame warped by the motion model (Tcw_cur * Twc_last), used to
+        // warm-start the plane detection of the next frame. NULL if disabled or there is no previous frame.
+        const ahc::PlanePrior *PreparePlanePrior(const cv::Mat &velocity);
+
+        // Drop all frames still in the pipeline (used on reset).
+        void ClearPipeline();
+
         // Main tracking function.
         void Track();
 
@@ -129,6 +213,9 @@ namespace ORB_SLAM2 {
 
         bool TrackWithMotionModel();
 
+        // Optimize the pose of the current frame, checked against the reference if enabled
+        int PoseOptimization();
+
         bool TranslationEstimation();
 
         bool TranslationWithMotionModel();
@@ -141,6 +228,8 @@ namespace ORB_SLAM2 {
 
         void UpdateLocalLines();
 
+        void UpdateLocalPlanes();
+
         void UpdateLocalKeyFrames();
 
         bool TrackLocalMap();
@@ -151,6 +240,10 @@ namespace ORB_SLAM2 {
 
         void SearchLocalPlanes();
 
+        // Associate the planes of the current frame with the local map planes. The whole map is searched right
+        // after a relocalization or if no plane could be associated locally.
+        int SearchPlanes();
+
 
         bool NeedNewKeyFrame();
 
@@ -162,12 +255,17 @@ namespace ORB_SLAM2 {
         // "zero-drift" localization to the map.
         bool mbVO;
 
+        // A map was loaded and the camera has not been relocalized in it yet. There is no last frame to predict
+        // the pose from, so every frame is relocalized until one succeeds, also with Local Mapping active.
+        bool mbRelocalizeLoadedMap;
+
         // Other Thread Pointers
         LocalMapping *mpLocalMapper;
         SurfelMapping *mpSurfelMapper;
 
         // ORB
         ORBextractor *mpORBextractor;
+        LineSegment *mpLineSegment;
 
         // Matchers
         LSDmatcher *mpLineMatcher;
@@ -175,6 +273,7 @@ namespace ORB_SLAM2 {
 
         // Optimizer
         Optimizer *mpOptimizer;
+        PoseOptimizationCheck *mpPoseOptimizationCheck;
 
         // BoW
         ORBVocabulary *mpORBVocabulary;
@@ -184,11 +283,16 @@ namespace ORB_SLAM2 {
         KeyFrame *mpReferenceKF;
         std::vector<KeyFrame *> mvpLocalKeyFrames;
         std::vector<MapPoint *> mvpLocalMapPoints;
+        LocalMapPoints mLocalMapPoints;
         std::vector<MapLine *> mvpLocalMapLines;
+        std::vector<MapPlane *> mvpLocalMapPlanes;
 
         // System
         System *mpSystem;
 
+        // Worker threads shared with Local Mapping
+        ThreadPool *mpThreadPool;
+
         //Drawers
         Viewer *mpViewer;
         FrameDrawer *mpFrameDrawer;
@@ -215,6 +319,8 @@ namespace ORB_SLAM2 {
         // For RGB-D inputs only. For some datasets (e.g. TUM) the depthmap values are scaled.
         float mDepthMapFactor;
 
+        DepthPreprocessor *mpDepthPreprocessor;
+
         //Current matches in frame
         int mnMatchesInliers;
 
@@ -239,6 +345,25 @@ namespace ORB_SLAM2 {
 
         cv::Mat manhattanRcw;
 
+        // Warm-started plane detection, the prior is owned by the thread that builds the frames
+        bool mbPlaneWarmStart;
+        ahc::PlanePrior mPlanePrior;
+
+        // Front-end pipeline
+        int mnPipelineDepth;
+        std::list<PipelinedFrame> mlFramesToBuild;
+        std::list<PipelinedFrame> mlBuiltFrames;
+        bool mbBuildingFrame;
+        bool mbFrontEndFinishRequested;
+        bool mbFrontEndFinished;
+        std::mutex mMutexPipeline;
+        std::condition_variable mCondFrontEnd;
+        std::condition_variable mCondBuiltFrame;
+        cv::Mat mPipelineVelocity; // Motion model seen by the front-end
+
+        PipelineStats mPipelineStats;
+        std::mutex mMutexPipelineStats;
+
     };
 
 } //namespace ORB_SLAM
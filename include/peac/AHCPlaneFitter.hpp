@@ -81,6 +81,39 @@ namespace ahc {
         ERODE_ALL_BORDER = 2    //erode all borders, either between two segments or between segment and "black"
     };
 
+    /**
+     *  \brief PlanePrior holds the segmentation of a previous frame, used to warm-start ahc::PlaneFitter::run
+     *
+     *  \details R and t map a point from the current camera frame to the camera frame of the prior segmentation
+     *  (p_prior=R*p+t), usually predicted by a motion model; fx, fy, cx, cy are the pinhole intrinsics of the
+     *  organized point cloud, so that the points of the current frame can be projected into membershipImg
+     */
+    struct PlanePrior {
+        cv::Mat membershipImg;            //plane id of each pixel of the previous frame, negative if none
+        std::vector<cv::Vec3d> normals;    //normal of each previously extracted plane
+        std::vector<cv::Vec3d> centers;    //center of each previously extracted plane
+        double R[3][3];
+        double t[3];
+        double fx, fy, cx, cy;
+
+        PlanePrior() : fx(0), fy(0), cx(0), cy(0) {
+            setMotion(0, 0);
+        }
+
+        //set the motion from the current frame to the prior frame, identity if R or t is 0
+        void setMotion(const double R_[3][3], const double t_[3]) {
+            for (int i = 0; i < 3; ++i) {
+                for (int j = 0; j < 3; ++j)
+                    R[i][j] = R_ ? R_[i][j] : (i == j ? 1 : 0);
+                t[i] = t_ ? t_[i] : 0;
+            }
+        }
+
+        bool empty() const {
+            return membershipImg.empty() || normals.empty();
+        }
+    };
+
     /**
      *  \brief ahc::PlaneFitter implements the Agglomerative Hierarchical Clustering based fast plane extraction
      *
@@ -127,6 +160,8 @@ namespace ahc {
 
         ParamSet params;        //sets of parameters controlling dynamic thresholds T_mse, T_ang, T_dz
 
+        const PlanePrior *prior;    //no ownership, segmentation of the previous frame to warm-start from, 0 for a cold start
+
         //output
         ahc::shared_ptr<DisjointSet> ds;//with ownership, this disjoint set maintains membership of initial window/blocks during AHC merging
         std::vector<PlaneSeg::shared_ptr> extractedPlanes;//a set of extracted planes
@@ -156,7 +191,7 @@ namespace ahc {
         PlaneFitter() : points(0), width(0), height(0),
                         maxStep(100000), minSupport(3000),
                         windowWidth(10), windowHeight(10),
-                        doRefine(true), erodeType(ERODE_ALL_BORDER),
+                        doRefine(true), erodeType(ERODE_ALL_BORDER), prior(0),
                         dirtyBlkMbship(true), drawCoarseBorder(false) {
             static const unsigned char default_colors[10][3] =
                     {
@@ -189,9 +224,28 @@ namespace ahc {
             blkMap.clear();
             rfQueue.clear();
             //blkStats.clear();
+            //membershipImg may still be referenced by a PlanePrior or by other consumers of the last result,
+            //so it is reallocated instead of being overwritten in place
+            membershipImg.release();
             dirtyBlkMbship = true;
         }
 
+        /**
+         *  \brief export the segmentation of the last run as a prior to warm-start the run on the next frame
+         *
+         *  \param [out] out the prior, its intrinsics and motion are left to the caller
+         */
+        void exportPrior(PlanePrior &out) const {
+            out.membershipImg = this->membershipImg;
+            out.normals.resize(this->extractedPlanes.size());
+            out.centers.resize(this->extractedPlanes.size());
+            for (int i = 0; i < (int) this->extractedPlanes.size(); ++i) {
+                const PlaneSeg &pl = *this->extractedPlanes[i];
+                out.normals[i] = cv::Vec3d(pl.normal[0], pl.normal[1], pl.normal[2]);
+                out.centers[i] = cv::Vec3d(pl.center[0], pl.center[1], pl.center[2]);
+            }
+        }
+
         /**
          *  \brief run AHC plane fitting on one frame of point cloud pointsIn
          *
@@ -760,6 +814,9 @@ namespace ahc {
             //1. init nodes
             std::vector<PlaneSeg::Ptr> G(Nh * Nw, 0);
             //this->blkStats.resize(Nh*Nw);
+            //with a prior the blocks are queued only after seeding, until then they are kept alive here
+            const bool warmStart = this->prior && !this->prior->empty();
+            std::vector<PlaneSeg::shared_ptr> blocks(warmStart ? Nh * Nw : 0);
 
 #ifdef DEBUG_INIT
             dInit.create(this->height, this->width, CV_8UC3);
@@ -777,7 +834,8 @@ namespace ahc {
                     if (p->mse < params.T_mse(ParamSet::P_INIT, p->center[2])
                         && !p->nouse) {
                         G[i * Nw + j] = p.get();
-                        minQ.push(p);
+                        if (warmStart) blocks[i * Nw + j] = p;
+                        else minQ.push(p);
                         //this->blkStats[i*Nw+j]=p->stats;
 #ifdef DEBUG_INIT
                         //const uchar cl=uchar(p->mse*255/dynThresh);
@@ -829,6 +887,11 @@ namespace ahc {
 #ifdef DEBUG_INIT
             //cv::applyColorMap(dInit, dInit,  cv::COLORMAP_COOL);
 #endif
+
+            //warm start: merge the blocks still on a plane of the prior, they are removed from G so that
+            //the edges below only link distinct nodes
+            std::vector<PlaneSeg::Ptr> seedOf(warmStart ? Nh * Nw : 0, 0);
+            if (warmStart) this->seedFromPrior(blocks, G, seedOf, minQ);
 #ifdef DEBUG_CALC
             int nEdge=0;
             this->numEdges.clear();
@@ -909,6 +972,23 @@ namespace ahc {
                 }
             }
 
+            //third pass, connect the seeds with their neighboring seeds and blocks
+            for (int i = 0; warmStart && i < Nh; ++i) {
+                for (int j = 0; j < Nw; ++j) {
+                    const int cidx = i * Nw + j;
+                    PlaneSeg::Ptr c = seedOf[cidx] ? seedOf[cidx] : G[cidx];
+                    if (c == 0) continue;
+                    const int nidx[2] = {j < Nw - 1 ? cidx + 1 : -1, i < Nh - 1 ? cidx + Nw : -1};
+                    for (int k = 0; k < 2; ++k) {
+                        if (nidx[k] < 0 || (seedOf[cidx] == 0 && seedOf[nidx[k]] == 0)) continue;
+                        PlaneSeg::Ptr nb = seedOf[nidx[k]] ? seedOf[nidx[k]] : G[nidx[k]];
+                        if (nb == 0 || nb == c) continue;
+                        const double z = seedOf[cidx] ? nb->center[2] : c->center[2];
+                        if (c->normalSimilarity(*nb) >= params.T_ang(ParamSet::P_INIT, z))
+                            c->connect(nb);
+                    }
+                }
+            }
 
 #ifdef DEBUG_INIT
             static int cnt=0;
@@ -927,6 +1007,99 @@ namespace ahc {
 #endif
         }
 
+        /**
+         *  \brief merge the initial blocks that still agree with a plane of the prior segmentation into seed nodes
+         *
+         *  \param [in] blocks all valid initial blocks, 0 for invalid ones
+         *  \param [in/out] G graph nodes of the initial blocks, set to 0 for the blocks absorbed by a seed
+         *  \param [out] seedOf seed node of each block, 0 if the block is not seeded
+         *  \param [in/out] minQ a min MSE queue of PlaneSegs, receives the seeds and all remaining blocks
+         *
+         *  \details each block center is warped into the prior frame and looked up in the prior membershipImg;
+         *  the block keeps that label only if its center and normal still fit the prior plane (T_dz, and T_ang
+         *  of P_REFINE). 4-connected blocks with the same label are merged at once and the seed is rejected if it
+         *  fails the merging MSE test. Only blocks whose statistics changed are left to the regular clustering.
+         */
+        void seedFromPrior(const std::vector<PlaneSeg::shared_ptr> &blocks,
+                           std::vector<PlaneSeg::Ptr> &G,
+                           std::vector<PlaneSeg::Ptr> &seedOf,
+                           PlaneSegMinMSEQueue &minQ) {
+            const int Nh = this->height / this->windowHeight;
+            const int Nw = this->width / this->windowWidth;
+            const PlanePrior &pr = *this->prior;
+            const int nPriorPlanes = (int) pr.normals.size();
+
+            std::vector<int> label(Nh * Nw, -1);
+            for (int blkid = 0; blkid < Nh * Nw; ++blkid) {
+                const PlaneSeg::Ptr p = G[blkid];
+                if (p == 0) continue;
+                double X[3], n[3];
+                for (int k = 0; k < 3; ++k) {
+                    X[k] = pr.R[k][0] * p->center[0] + pr.R[k][1] * p->center[1] + pr.R[k][2] * p->center[2] + pr.t[k];
+                    n[k] = pr.R[k][0] * p->normal[0] + pr.R[k][1] * p->normal[1] + pr.R[k][2] * p->normal[2];
+                }
+                if (X[2] <= 0) continue;
+                const int u = (int) std::floor(pr.fx * X[0] / X[2] + pr.cx + 0.5);
+                const int v = (int) std::floor(pr.fy * X[1] / X[2] + pr.cy + 0.5);
+                if (u < 0 || v < 0 || u >= pr.membershipImg.cols || v >= pr.membershipImg.rows) continue;
+                const int plid = pr.membershipImg.at<int>(v, u);
+                if (plid < 0 || plid >= nPriorPlanes) continue;
+
+                const cv::Vec3d &pn = pr.normals[plid];
+                const cv::Vec3d &pc = pr.centers[plid];
+                const double similarity = std::abs(pn[0] * n[0] + pn[1] * n[1] + pn[2] * n[2]);
+                const double dist = std::abs(pn[0] * (X[0] - pc[0]) + pn[1] * (X[1] - pc[1]) + pn[2] * (X[2] - pc[2]));
+                if (similarity >= params.T_ang(ParamSet::P_REFINE, X[2]) && dist <= params.T_dz(X[2]))
+                    label[blkid] = plid;
+            }
+
+            std::vector<bool> visited(Nh * Nw, false);
+            std::vector<int> component;
+            for (int blkid = 0; blkid < Nh * Nw; ++blkid) {
+                if (label[blkid] < 0 || visited[blkid]) continue;
+                visited[blkid] = true;
+                component.clear();
+                component.push_back(blkid);
+                for (int k = 0; k < (int) component.size(); ++k) {
+                    const int i = component[k] / Nw;
+                    const int j = component[k] - i * Nw;
+                    int nbs[4] = {-1};
+                    const int nNbs = this->getValid4Neighbor(i, j, Nh, Nw, nbs);
+                    for (int m = 0; m < nNbs; ++m) {
+                        if (!visited[nbs[m]] && label[nbs[m]] == label[blkid]) {
+                            visited[nbs[m]] = true;
+                            component.push_back(nbs[m]);
+                        }
+                    }
+                }
+                if (component.size() < 2) continue;
+
+                PlaneSeg::shared_ptr seed(new PlaneSeg(*G[component[0]], *G[component[1]]));
+                if (component.size() > 2) {
+                    for (int k = 2; k < (int) component.size(); ++k)
+                        seed->stats.push(G[component[k]]->stats);
+                    seed->N = seed->stats.N;
+                    seed->update();
+                }
+                if (seed->mse >= params.T_mse(ParamSet::P_MERGING, seed->center[2]))
+                    continue; //the plane changed, cluster its blocks from scratch
+
+                int root = component[0];
+                for (int k = 1; k < (int) component.size(); ++k)
+                    root = this->ds->Union(root, component[k]);
+                seed->rid = root;
+                for (int k = 0; k < (int) component.size(); ++k) {
+                    seedOf[component[k]] = seed.get();
+                    G[component[k]] = 0;
+                }
+                minQ.push(seed);
+            }
+
+            for (int blkid = 0; blkid < Nh * Nw; ++blkid) {
+                if (G[blkid]) minQ.push(blocks[blkid]);
+            }
+        }
+
         /**
          *  \brief main clustering step
          *
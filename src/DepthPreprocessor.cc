@@ -0,0 +1,87 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "DepthPreprocessor.h"
+
+#include <limits>
+
+using namespace std;
+
+namespace ORB_SLAM2 {
+
+    DepthPreprocessor::DepthPreprocessor(const cv::Mat &K, float depthMapFactor) : mDepthMapFactor(depthMapFactor) {
+        fx = K.at<float>(0, 0);
+        fy = K.at<float>(1, 1);
+        cx = K.at<float>(0, 2);
+        cy = K.at<float>(1, 2);
+    }
+
+    void DepthPreprocessor::ComputeRays(int width, int height) {
+        mRayX = (Eigen::ArrayXf::LinSpaced(width, 0, width - 1) - cx) / fx;
+        mRayY = (Eigen::ArrayXf::LinSpaced(height, 0, height - 1) - cy) / fy;
+        mRowDepth.resize(width);
+        mRowX.resize(width);
+        mRowY.resize(width);
+    }
+
+    void DepthPreprocessor::Process(const cv::Mat &imRawDepth, cv::Mat &imDepth, cv::Mat &imPointCloud) {
+        const int width = imRawDepth.cols;
+        const int height = imRawDepth.rows;
+        if (mRayX.size() != width || mRayY.size() != height)
+            ComputeRays(width, height);
+
+        cv::Mat imRaw = imRawDepth;
+        float factor = mDepthMapFactor;
+        if (imRaw.type() != CV_16U && imRaw.type() != CV_32F) {
+            imRaw.convertTo(imRaw, CV_32F, mDepthMapFactor);
+            factor = 1;
+        }
+
+        // New buffers for every frame, consumers of the previous frame may still hold the old ones
+        imDepth = cv::Mat(height, width, CV_32F);
+        imPointCloud = cv::Mat(height, width, CV_32FC3);
+
+        typedef Eigen::Array<unsigned short, Eigen::Dynamic, 1> ArrayXus;
+        const float infinity = numeric_limits<float>::infinity();
+
+        for (int v = 0; v < height; v++) {
+            // Scale and back-project a whole row with packed SIMD operations (Eigen vectorizes these
+            // expressions with SSE/AVX or NEON), invalid depth gives x = y = 0
+            if (imRaw.type() == CV_16U)
+                mRowDepth = Eigen::Map<const ArrayXus>(imRaw.ptr<unsigned short>(v), width).cast<float>() * factor;
+            else
+                mRowDepth = Eigen::Map<const Eigen::ArrayXf>(imRaw.ptr<float>(v), width) * factor;
+
+            // NaN fails both comparisons
+            const auto valid = (mRowDepth > 0.f) && (mRowDepth < infinity);
+            mRowX = valid.select(mRayX * mRowDepth, 0.f);
+            mRowY = valid.select(mRayY[v] * mRowDepth, 0.f);
+
+            Eigen::Map<Eigen::ArrayXf>(imDepth.ptr<float>(v), width) = mRowDepth;
+
+            // Interleave into the organized point cloud
+            cv::Vec3f *pPoint = imPointCloud.ptr<cv::Vec3f>(v);
+            for (int u = 0; u < width; u++)
+                pPoint[u] = cv::Vec3f(mRowX[u], mRowY[u], mRowDepth[u]);
+        }
+    }
+
+} //namespace ORB_SLAM
@@ -21,7 +21,7 @@
 #include "Frame.h"
 #include "Converter.h"
 
-#include <thread>
+#include <functional>
 
 using namespace std;
 using namespace cv;
@@ -36,12 +36,16 @@ namespace ORB_SLAM2 {
     float Frame::mnMinX, Frame::mnMinY, Frame::mnMaxX, Frame::mnMaxY;
     float Frame::mfGridElementWidthInv, Frame::mfGridElementHeightInv;
 
-    Frame::Frame() {}
+    Frame::Frame()
+            : mpORBvocabulary(NULL), mpORBextractorLeft(NULL), mpLineSegment(NULL), mTimeStamp(0), mbf(0), mb(0),
+              mThDepth(0), N(0), NL(0), mnId(0), mpReferenceKF(NULL), mnScaleLevels(0), mfScaleFactor(1),
+              mfLogScaleFactor(0), mnPlaneNum(0), mbNewPlane(false), mfDisTh(0) {}
 
 //Copy Constructor
     Frame::Frame(const Frame &frame)
             : mpORBvocabulary(frame.mpORBvocabulary), mpORBextractorLeft(frame.mpORBextractorLeft),
-              mTimeStamp(frame.mTimeStamp), mK(frame.mK.clone()), mDistCoef(frame.mDistCoef.clone()),
+              mpLineSegment(frame.mpLineSegment), mTimeStamp(frame.mTimeStamp), mK(frame.mK.clone()),
+              mDistCoef(frame.mDistCoef.clone()),
               mbf(frame.mbf), mb(frame.mb), mThDepth(frame.mThDepth), N(frame.N), mvKeys(frame.mvKeys),
               mvKeysRight(frame.mvKeysRight), mvKeysUn(frame.mvKeysUn), mvuRight(frame.mvuRight),
               mvDepth(frame.mvDepth), mBowVec(frame.mBowVec), mFeatVec(frame.mFeatVec),
@@ -67,10 +71,12 @@ namespace ORB_SLAM2 {
             SetPose(frame.mTcw);
     }
 
-    Frame::Frame(const cv::Mat &imRGB, const cv::Mat &imGray, const cv::Mat &imDepth, const double &timeStamp,
-                 ORBextractor *extractor, ORBVocabulary *voc, cv::Mat &K, cv::Mat &distCoef, const float &bf,
-                 const float &thDepth, const float &depthMapFactor, const float mfDisTh)
-            : mpORBvocabulary(voc), mpORBextractorLeft(extractor),
+    Frame::Frame(const cv::Mat &imRGB, const cv::Mat &imGray, const cv::Mat &imDepth, const cv::Mat &imPointCloud,
+                 const double &timeStamp,
+                 ORBextractor *extractor, LineSegment *pLineSegment, ORBVocabulary *voc, cv::Mat &K,
+                 cv::Mat &distCoef, const float &bf, const float &thDepth, const float mfDisTh,
+                 ThreadPool *pThreadPool, const ahc::PlanePrior *pPlanePrior)
+            : mpORBvocabulary(voc), mpORBextractorLeft(extractor), mpLineSegment(pLineSegment),
               mTimeStamp(timeStamp), mK(K.clone()), mDistCoef(distCoef.clone()), mbf(bf), mThDepth(thDepth),
               mfDisTh(mfDisTh) {
         // Frame ID
@@ -92,17 +98,11 @@ namespace ORB_SLAM2 {
         invfx = 1.0f / fx;
         invfy = 1.0f / fy;
 
-        cv::Mat imDepthScaled;
-        if (depthMapFactor != 1 || imDepth.type() != CV_32F) {
-            imDepth.convertTo(imDepthScaled, CV_32F, depthMapFactor);
-        }
-
-        thread threadPoints(&ORB_SLAM2::Frame::ExtractORB, this, imGray);
-        thread threadLines(&ORB_SLAM2::Frame::ExtractLSD, this, imGray);
-        thread threadPlanes(&ORB_SLAM2::Frame::ExtractPlanes, this, imRGB, imDepth, K, depthMapFactor);
-        threadPoints.join();
-        threadLines.join();
-        threadPlanes.join();
+        vector<function<void()> > vTasks;
+        vTasks.emplace_back([&] { ExtractPlanes(imRGB, imPointCloud, pPlanePrior); });
+        vTasks.emplace_back([&] { ExtractORB(imGray); });
+        vTasks.emplace_back([&] { ExtractLSD(imGray); });
+        pThreadPool->Run(vTasks);
 
         N = mvKeys.size();
         NL = mvKeylinesUn.size();
@@ -115,14 +115,14 @@ namespace ORB_SLAM2 {
         mvbVerPlaneOutlier = vector<bool>(mnPlaneNum, false);
         mvbParPlaneOutlier = vector<bool>(mnPlaneNum, false);
 
-        GetLineDepth(imDepthScaled);
+        GetLineDepth(imDepth);
 
         if (mvKeys.empty())
             return;
 
         UndistortKeyPoints();
 
-        ComputeStereoFromRGBD(imDepthScaled);
+        ComputeStereoFromRGBD(imDepth);
 
         mvpMapPoints = vector<MapPoint *>(N, static_cast<MapPoint *>(NULL));
         mvpMapLines = vector<MapLine *>(NL, static_cast<MapLine *>(NULL));
@@ -199,19 +199,26 @@ namespace ORB_SLAM2 {
         mTwc = cv::Mat::eye(4, 4, mTcw.type());
         mRwc.copyTo(mTwc.rowRange(0, 3).colRange(0, 3));
         mOw.copyTo(mTwc.rowRange(0, 3).col(3));
+
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++)
+                mRcwEig(i, j) = mRcw.at<float>(i, j);
+            mtcwEig(i) = mtcw.at<float>(i);
+        }
+        mOwEig = -mRcwEig.transpose() * mtcwEig;
     }
 
     bool Frame::isInFrustum(MapPoint *pMP, float viewingCosLimit) {
         pMP->mbTrackInView = false;
 
         // 3D in absolute coordinates
-        cv::Mat P = pMP->GetWorldPos();
+        const Eigen::Vector3f P = pMP->GetWorldPosEigen();
 
         // 3D in camera coordinates
-        const cv::Mat Pc = mRcw * P + mtcw;
-        const float &PcX = Pc.at<float>(0);
-        const float &PcY = Pc.at<float>(1);
-        const float &PcZ = Pc.at<float>(2);
+        const Eigen::Vector3f Pc = mRcwEig * P + mtcwEig;
+        const float &PcX = Pc(0);
+        const float &PcY = Pc(1);
+        const float &PcZ = Pc(2);
 
         // Check positive depth
         if (PcZ < 0.0f)
@@ -230,14 +237,14 @@ namespace ORB_SLAM2 {
         // Check distance is in the scale invariance region of the MapPoint
         const float maxDistance = pMP->GetMaxDistanceInvariance();
         const float minDistance = pMP->GetMinDistanceInvariance();
-        const cv::Mat PO = P - mOw;
-        const float dist = cv::norm(PO);
+        const Eigen::Vector3f PO = P - mOwEig;
+        const float dist = PO.norm();
 
         if (dist < minDistance || dist > maxDistance)
             return false;
 
         // Check viewing angle
-        cv::Mat Pn = pMP->GetNormal();
+        const Eigen::Vector3f Pn = pMP->GetNormalEigen();
 
         const float viewCos = PO.dot(Pn) / dist;
 
@@ -263,18 +270,18 @@ namespace ORB_SLAM2 {
 
         Vector6d P = pML->GetWorldPos();
 
-        cv::Mat SP = (Mat_<float>(3, 1) << P(0), P(1), P(2));
-        cv::Mat EP = (Mat_<float>(3, 1) << P(3), P(4), P(5));
+        const Eigen::Vector3f SP = P.head<3>().cast<float>();
+        const Eigen::Vector3f EP = P.tail<3>().cast<float>();
 
-        const cv::Mat SPc = mRcw * SP + mtcw;
-        const float &SPcX = SPc.at<float>(0);
-        const float &SPcY = SPc.at<float>(1);
-        const float &SPcZ = SPc.at<float>(2);
+        const Eigen::Vector3f SPc = mRcwEig * SP + mtcwEig;
+        const float &SPcX = SPc(0);
+        const float &SPcY = SPc(1);
+        const float &SPcZ = SPc(2);
 
-        const cv::Mat EPc = mRcw * EP + mtcw;
-        const float &EPcX = EPc.at<float>(0);
-        const float &EPcY = EPc.at<float>(1);
-        const float &EPcZ = EPc.at<float>(2);
+        const Eigen::Vector3f EPc = mRcwEig * EP + mtcwEig;
+        const float &EPcX = EPc(0);
+        const float &EPcY = EPc(1);
+        const float &EPcZ = EPc(2);
 
         if (SPcZ < 0.0f || EPcZ < 0.0f)
             return false;
@@ -301,16 +308,15 @@ namespace ORB_SLAM2 {
         const float maxDistance = pML->GetMaxDistanceInvariance();
         const float minDistance = pML->GetMinDistanceInvariance();
 
-        const cv::Mat OM = 0.5 * (SP + EP) - mOw;
-        const float dist = cv::norm(OM);
+        const Eigen::Vector3f OM = 0.5f * (SP + EP) - mOwEig;
+        const float dist = OM.norm();
 
         if (dist < minDistance || dist > maxDistance)
             return false;
 
 
-        Vector3d Pn = pML->GetNormal();
-        cv::Mat pn = (Mat_<float>(3, 1) << Pn(0), Pn(1), Pn(2));
-        const float viewCos = OM.dot(pn) / dist;
+        const Eigen::Vector3f Pn = pML->GetNormal().cast<float>();
+        const float viewCos = OM.dot(Pn) / dist;
 
         if (viewCos < viewingCosLimit)
             return false;
@@ -603,24 +609,27 @@ namespace ORB_SLAM2 {
     }
 
     void
-    Frame::ExtractPlanes(const cv::Mat &imRGB, const cv::Mat &imDepth, const cv::Mat &K, const float &depthMapFactor) {
+    Frame::ExtractPlanes(const cv::Mat &imRGB, const cv::Mat &imPointCloud, const ahc::PlanePrior *pPlanePrior) {
         planeDetector.readColorImage(imRGB);
-        planeDetector.readDepthImage(imDepth, K, depthMapFactor);
-        planeDetector.runPlaneDetection();
+        planeDetector.readPointCloud(imPointCloud);
+        planeDetector.runPlaneDetection(pPlanePrior);
 
         for (int i = 0; i < planeDetector.plane_num_; i++) {
             auto &indices = planeDetector.plane_vertices_[i];
             PointCloud::Ptr inputCloud(new PointCloud());
+            inputCloud->points.reserve(indices.size());
+            ahc::PlaneSeg::Stats stats;
             for (int j : indices) {
                 PointT p;
-                p.x = (float) planeDetector.cloud.vertices[j][0];
-                p.y = (float) planeDetector.cloud.vertices[j][1];
-                p.z = (float) planeDetector.cloud.vertices[j][2];
-                p.r = static_cast<uint8_t>(planeDetector.cloud.verticesColour[j][0]);
-                p.g = static_cast<uint8_t>(planeDetector.cloud.verticesColour[j][1]);
-                p.b = static_cast<uint8_t>(planeDetector.cloud.verticesColour[j][2]);
+                p.x = planeDetector.cloud.x[j];
+                p.y = planeDetector.cloud.y[j];
+                p.z = planeDetector.cloud.z[j];
+                p.r = planeDetector.cloud.colours[j][0];
+                p.g = planeDetector.cloud.colours[j][1];
+                p.b = planeDetector.cloud.colours[j][2];
 
                 inputCloud->points.push_back(p);
+                stats.push(p.x, p.y, p.z);
             }
 
             auto extractedPlane = planeDetector.plane_filter.extractedPlanes[i];
@@ -642,7 +651,7 @@ namespace ORB_SLAM2 {
 
             cv::Mat coef = (cv::Mat_<float>(4, 1) << nx, ny, nz, d);
 
-            bool valid = MaxPointDistanceFromPlane(coef, coarseCloud);
+            bool valid = MaxPointDistanceFromPlane(coef, coarseCloud, stats);
 
             if (!valid) {
                 continue;
@@ -659,10 +668,8 @@ namespace ORB_SLAM2 {
         return temp * mvPlaneCoefficients[idx];
     }
 
-    bool Frame::MaxPointDistanceFromPlane(cv::Mat &plane, PointCloud::Ptr pointCloud) {
-        bool erased = false;
-        double threshold = 0.04;
-        int i = 0;
+    bool Frame::MaxPointDistanceFromPlane(cv::Mat &plane, PointCloud::Ptr pointCloud,
+                                          const ahc::PlaneSeg::Stats &stats) {
         auto &points = pointCloud->points;
 
         for (auto &p : points) {
@@ -673,13 +680,43 @@ namespace ORB_SLAM2 {
 
             if (absDis > mfDisTh)
                 return false;
-
-            i++;
         }
 
         if (points.size() < 4) {
             return false;
         }
+
+        // The plane equation of the segmenter does not include the pixels added when refining its borders, fit
+        // it again to the first and second order moments of all pixels (one 3x3 eigen-decomposition). As the
+        // normal of the segmenter it points towards the camera, so the sign convention of plane is kept.
+        if (stats.N >= 4) {
+            double center[3], normal[3], mse, curvature;
+            stats.compute(center, normal, mse, curvature);
+
+            float d = (float) -(normal[0] * center[0] + normal[1] * center[1] + normal[2] * center[2]);
+            cv::Mat refined = (cv::Mat_<float>(4, 1) << normal[0], normal[1], normal[2], d);
+
+            bool bInliers = true;
+            for (auto &p : points) {
+                if (abs(refined.at<float>(0) * p.x + refined.at<float>(1) * p.y + refined.at<float>(2) * p.z +
+                        refined.at<float>(3)) > mfDisTh) {
+                    bInliers = false;
+                    break;
+                }
+            }
+
+            if (bInliers) {
+                plane = refined;
+                return true;
+            }
+        }
+
+        RefinePlaneRANSAC(plane, pointCloud);
+
+        return true;
+    }
+
+    void Frame::RefinePlaneRANSAC(cv::Mat &plane, PointCloud::Ptr pointCloud) {
         pcl::ModelCoefficients::Ptr coefficients(new pcl::ModelCoefficients);
         pcl::PointIndices::Ptr inliers(new pcl::PointIndices);
         pcl::SACSegmentation<PointT> seg;
@@ -704,7 +741,5 @@ namespace ORB_SLAM2 {
         if ((newVal < 0 && oldVal > 0) || (newVal > 0 && oldVal < 0)) {
             plane = -plane;
         }
-
-        return true;
     }
 } //namespace ORB_SLAM
@@ -0,0 +1,36 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+
+#include "FrameBuffer.h"
+
+namespace ORB_SLAM2 {
+
+    FrameBuffer::FrameBuffer(const cv::Mat &imGray, const cv::Mat &imDepth, const cv::Mat &imPointCloud,
+                             const cv::Mat &imPlaneMembership)
+            : mImGray(imGray), mImDepth(imDepth), mImPointCloud(imPointCloud), mImPlaneMembership(imPlaneMembership) {
+    }
+
+    FrameBuffer::Ptr FrameBuffer::Create(const cv::Mat &imGray, const cv::Mat &imDepth, const cv::Mat &imPointCloud,
+                                         const cv::Mat &imPlaneMembership) {
+        return Ptr(new FrameBuffer(imGray, imDepth, imPointCloud, imPlaneMembership));
+    }
+
+} //namespace ORB_SLAM
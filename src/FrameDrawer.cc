@@ -54,7 +54,11 @@ namespace ORB_SLAM2 {
             if (mState == Tracking::SYSTEM_NOT_READY)
                 mState = Tracking::NO_IMAGES_YET;
 
-            mIm.copyTo(im);
+            // The frame buffer is immutable and converted to colour below, only the placeholder is copied
+            if (mpFrameBuffer)
+                im = mpFrameBuffer->GetGray();
+            else
+                mIm.copyTo(im);
 
             if (mState == Tracking::NOT_INITIALIZED) {
                 vCurrentKeys = mvCurrentKeys;
@@ -157,7 +161,7 @@ namespace ORB_SLAM2 {
 
     void FrameDrawer::Update(Tracking *pTracker) {
         unique_lock<mutex> lock(mMutex);
-        pTracker->mImGray.copyTo(mIm);
+        mpFrameBuffer = pTracker->mpFrameBuffer;
         mvCurrentKeys = pTracker->mCurrentFrame.mvKeys;
         N = mvCurrentKeys.size();
         mvbVO = vector<bool>(N, false);
@@ -0,0 +1,217 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "HammingDistance.h"
+
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAMMING_X86
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define HAMMING_NEON
+#include <arm_neon.h>
+#endif
+
+using namespace std;
+
+namespace ORB_SLAM2 {
+
+    namespace {
+
+        // Bit set count operation from
+        // http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
+        inline int PopCount64(uint64_t v) {
+            v = v - ((v >> 1) & 0x5555555555555555ULL);
+            v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+            return (int) ((((v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL) * 0x0101010101010101ULL) >> 56);
+        }
+
+        int DistanceScalar(const uint8_t *a, const uint8_t *b) {
+            uint64_t wa[4], wb[4];
+            memcpy(wa, a, sizeof(wa));
+            memcpy(wb, b, sizeof(wb));
+            return PopCount64(wa[0] ^ wb[0]) + PopCount64(wa[1] ^ wb[1]) +
+                   PopCount64(wa[2] ^ wb[2]) + PopCount64(wa[3] ^ wb[3]);
+        }
+
+        void DistanceToManyScalar(const uint8_t *query, const uint8_t *candidates, size_t stride, int n,
+                                  int *distances) {
+            for (int i = 0; i < n; i++, candidates += stride)
+                distances[i] = DistanceScalar(query, candidates);
+        }
+
+        void DistanceToRowsScalar(const uint8_t *query, const uint8_t *rows, size_t stride, const size_t *indices,
+                                  int n, int *distances) {
+            for (int i = 0; i < n; i++)
+                distances[i] = DistanceScalar(query, rows + indices[i] * stride);
+        }
+
+#ifdef HAMMING_X86
+
+        __attribute__((target("popcnt")))
+        int DistancePopcnt(const uint8_t *a, const uint8_t *b) {
+            uint64_t wa[4], wb[4];
+            memcpy(wa, a, sizeof(wa));
+            memcpy(wb, b, sizeof(wb));
+            return __builtin_popcountll(wa[0] ^ wb[0]) + __builtin_popcountll(wa[1] ^ wb[1]) +
+                   __builtin_popcountll(wa[2] ^ wb[2]) + __builtin_popcountll(wa[3] ^ wb[3]);
+        }
+
+        __attribute__((target("popcnt")))
+        void DistanceToManyPopcnt(const uint8_t *query, const uint8_t *candidates, size_t stride, int n,
+                                  int *distances) {
+            for (int i = 0; i < n; i++, candidates += stride)
+                distances[i] = DistancePopcnt(query, candidates);
+        }
+
+        __attribute__((target("popcnt")))
+        void DistanceToRowsPopcnt(const uint8_t *query, const uint8_t *rows, size_t stride, const size_t *indices,
+                                  int n, int *distances) {
+            for (int i = 0; i < n; i++)
+                distances[i] = DistancePopcnt(query, rows + indices[i] * stride);
+        }
+
+        // Per-byte bit count of v through a 4-bit lookup table
+        __attribute__((target("avx2")))
+        inline __m256i PopCountBytes(__m256i v) {
+            const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m256i lowMask = _mm256_set1_epi8(0x0f);
+            const __m256i lo = _mm256_and_si256(v, lowMask);
+            const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+            return _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+        }
+
+        __attribute__((target("avx2")))
+        inline int SumBytes(__m256i counts) {
+            const __m256i sums = _mm256_sad_epu8(counts, _mm256_setzero_si256());
+            const __m128i s = _mm_add_epi64(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+            return _mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_unpackhi_epi64(s, s));
+        }
+
+        // A whole descriptor fits in one 256-bit register, the query is loaded once for all candidates
+        __attribute__((target("avx2")))
+        void DistanceToManyAVX2(const uint8_t *query, const uint8_t *candidates, size_t stride, int n,
+                                int *distances) {
+            const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(query));
+            int i = 0;
+            for (; i + 1 < n; i += 2, candidates += 2 * stride) {
+                const __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(candidates));
+                const __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(candidates + stride));
+                distances[i] = SumBytes(PopCountBytes(_mm256_xor_si256(q, c0)));
+                distances[i + 1] = SumBytes(PopCountBytes(_mm256_xor_si256(q, c1)));
+            }
+            if (i < n) {
+                const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(candidates));
+                distances[i] = SumBytes(PopCountBytes(_mm256_xor_si256(q, c)));
+            }
+        }
+
+        __attribute__((target("avx2")))
+        void DistanceToRowsAVX2(const uint8_t *query, const uint8_t *rows, size_t stride, const size_t *indices,
+                                int n, int *distances) {
+            const __m256i q = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(query));
+            int i = 0;
+            for (; i + 1 < n; i += 2) {
+                const __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + indices[i] * stride));
+                const __m256i c1 = _mm256_loadu_si256(
+                        reinterpret_cast<const __m256i *>(rows + indices[i + 1] * stride));
+                distances[i] = SumBytes(PopCountBytes(_mm256_xor_si256(q, c0)));
+                distances[i + 1] = SumBytes(PopCountBytes(_mm256_xor_si256(q, c1)));
+            }
+            if (i < n) {
+                const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows + indices[i] * stride));
+                distances[i] = SumBytes(PopCountBytes(_mm256_xor_si256(q, c)));
+            }
+        }
+
+#endif
+
+#ifdef HAMMING_NEON
+
+        inline int DistanceNeon(const uint8_t *a, const uint8_t *b) {
+            const uint8x16_t x0 = veorq_u8(vld1q_u8(a), vld1q_u8(b));
+            const uint8x16_t x1 = veorq_u8(vld1q_u8(a + 16), vld1q_u8(b + 16));
+            const uint8x16_t counts = vaddq_u8(vcntq_u8(x0), vcntq_u8(x1));
+#if defined(__aarch64__)
+            return vaddlvq_u8(counts);
+#else
+            const uint64x2_t sums = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(counts)));
+            return (int) (vgetq_lane_u64(sums, 0) + vgetq_lane_u64(sums, 1));
+#endif
+        }
+
+        void DistanceToManyNeon(const uint8_t *query, const uint8_t *candidates, size_t stride, int n,
+                                int *distances) {
+            for (int i = 0; i < n; i++, candidates += stride)
+                distances[i] = DistanceNeon(query, candidates);
+        }
+
+        void DistanceToRowsNeon(const uint8_t *query, const uint8_t *rows, size_t stride, const size_t *indices,
+                                int n, int *distances) {
+            for (int i = 0; i < n; i++)
+                distances[i] = DistanceNeon(query, rows + indices[i] * stride);
+        }
+
+#endif
+
+    }
+
+    HammingDistance::DistanceFunction HammingDistance::mpDistance = DistanceScalar;
+    HammingDistance::DistanceToManyFunction HammingDistance::mpDistanceToMany = DistanceToManyScalar;
+    HammingDistance::DistanceToRowsFunction HammingDistance::mpDistanceToRows = DistanceToRowsScalar;
+    const char *HammingDistance::mpImplementation = "scalar";
+    const bool HammingDistance::mbSelected = HammingDistance::SelectImplementation();
+
+    bool HammingDistance::SelectImplementation() {
+#if defined(HAMMING_X86)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("popcnt")) {
+            // For a single pair four popcnt are as fast as the vector version and need no register setup
+            mpDistance = DistancePopcnt;
+            mpDistanceToMany = DistanceToManyPopcnt;
+            mpDistanceToRows = DistanceToRowsPopcnt;
+            mpImplementation = "popcnt";
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            mpDistanceToMany = DistanceToManyAVX2;
+            mpDistanceToRows = DistanceToRowsAVX2;
+            mpImplementation = mpDistance == DistancePopcnt ? "avx2+popcnt" : "avx2";
+        }
+#elif defined(HAMMING_NEON)
+        mpDistance = DistanceNeon;
+        mpDistanceToMany = DistanceToManyNeon;
+        mpDistanceToRows = DistanceToRowsNeon;
+        mpImplementation = "neon";
+#endif
+        return true;
+    }
+
+    void HammingDistance::DistanceToMany(const cv::Mat &query, const cv::Mat &candidates, vector<int> &distances) {
+        distances.resize(candidates.rows);
+        if (candidates.rows == 0)
+            return;
+
+        mpDistanceToMany(query.ptr<uint8_t>(), candidates.ptr<uint8_t>(), candidates.step[0], candidates.rows,
+                         distances.data());
+    }
+
+} //namespace ORB_SLAM
@@ -34,7 +34,7 @@ namespace ORB_SLAM2 {
     KeyFrame::KeyFrame(Frame &F, Map *pMap, KeyFrameDatabase *pKFDB) :
             mTimeStamp(F.mTimeStamp), mnGridCols(FRAME_GRID_COLS), mnGridRows(FRAME_GRID_ROWS),
             mfGridElementWidthInv(F.mfGridElementWidthInv), mfGridElementHeightInv(F.mfGridElementHeightInv),
-            mnTrackReferenceForFrame(0), mnFuseTargetForKF(0),
+            mnTrackReferenceForFrame(0), mnFuseTargetForKF(0), mnBALocalForKF(0), mnBAFixedForKF(0),
             mnRelocQuery(0), mnRelocWords(0),
             fx(F.fx), fy(F.fy), cx(F.cx), cy(F.cy), invfx(F.invfx), invfy(F.invfy),
             mbf(F.mbf), mb(F.mb), mThDepth(F.mThDepth), N(F.N), mvKeys(F.mvKeys), mvKeysUn(F.mvKeysUn),
@@ -44,9 +44,9 @@ namespace ORB_SLAM2 {
             mvInvLevelSigma2(F.mvInvLevelSigma2), mnMinX(F.mnMinX), mnMinY(F.mnMinY), mnMaxX(F.mnMaxX),
             mnMaxY(F.mnMaxY), mK(F.mK), mvpMapPoints(F.mvpMapPoints), mpKeyFrameDB(pKFDB),
             mpORBvocabulary(F.mpORBvocabulary), mbFirstConnection(true), mpParent(NULL), mbNotErase(false),
-            mbBad(false), mHalfBaseline(F.mb / 2), mpMap(pMap),
+            mbToBeErased(false), mbBad(false), mHalfBaseline(F.mb / 2), mpMap(pMap),
             mvKeyLines(F.mvKeylinesUn),
-            mLineDescriptors(F.mLdesc),
+            mLineDescriptors(F.mLdesc), mvKeyLineFunctions(F.mvKeyLineFunctions),
             mvpMapLines(F.mvpMapLines), mvPlaneCoefficients(F.mvPlaneCoefficients), mnPlaneNum(F.mnPlaneNum),
             mvpMapPlanes(F.mvpMapPlanes), mvPlanePoints(F.mvPlanePoints),
             mvpParallelPlanes(F.mvpParallelPlanes), mvpVerticalPlanes(F.mvpVerticalPlanes) {
@@ -83,6 +83,13 @@ namespace ORB_SLAM2 {
         Rwc.copyTo(Twc.rowRange(0, 3).colRange(0, 3));
         Ow.copyTo(Twc.rowRange(0, 3).col(3));
         cv::Mat center = (cv::Mat_<float>(4, 1) << mHalfBaseline, 0, 0, 1);
+
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++)
+                mRcwEig(i, j) = Rcw.at<float>(i, j);
+            mtcwEig(i) = tcw.at<float>(i);
+            mOwEig(i) = Ow.at<float>(i);
+        }
     }
 
     cv::Mat KeyFrame::GetPose() {
@@ -110,6 +117,21 @@ namespace ORB_SLAM2 {
         return Tcw.rowRange(0, 3).col(3).clone();
     }
 
+    Eigen::Matrix3f KeyFrame::GetRotationEigen() {
+        unique_lock<mutex> lock(mMutexPose);
+        return mRcwEig;
+    }
+
+    Eigen::Vector3f KeyFrame::GetTranslationEigen() {
+        unique_lock<mutex> lock(mMutexPose);
+        return mtcwEig;
+    }
+
+    Eigen::Vector3f KeyFrame::GetCameraCenterEigen() {
+        unique_lock<mutex> lock(mMutexPose);
+        return mOwEig;
+    }
+
     void KeyFrame::AddConnection(KeyFrame *pKF, const int &weight) {
         {
             unique_lock<mutex> lock(mMutexConnections);
@@ -346,12 +368,26 @@ namespace ORB_SLAM2 {
         mbNotErase = true;
     }
 
+    void KeyFrame::SetErase() {
+        {
+            unique_lock<mutex> lock(mMutexConnections);
+            mbNotErase = false;
+        }
+
+        if (mbToBeErased) {
+            SetBadFlag();
+        }
+    }
+
     void KeyFrame::SetBadFlag() {
         {
             unique_lock<mutex> lock(mMutexConnections);
-            if (mnId == 0)
+            // Keyframes without parent (the first one, or one built from a map file before its neighbours) are the
+            // root of their spanning tree
+            if (mnId == 0 || !mpParent)
                 return;
             else if (mbNotErase) {
+                mbToBeErased = true;
                 return;
             }
         }
@@ -21,9 +21,11 @@
 #include "KeyFrameDatabase.h"
 
 #include "KeyFrame.h"
+#include "MapSerializer.h"
 #include "Thirdparty/DBoW2/DBoW2/BowVector.h"
 
 #include<mutex>
+#include<unordered_map>
 
 using namespace std;
 
@@ -63,10 +65,23 @@ namespace ORB_SLAM2 {
     void KeyFrameDatabase::clear() {
         mvInvertedFile.clear();
         mvInvertedFile.resize(mpVoc->size());
+        mpMappedMap.reset();
     }
 
-    vector<KeyFrame *> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F) {
+    void KeyFrameDatabase::SetMappedMap(const shared_ptr<MappedMap> &pMappedMap) {
+        unique_lock<mutex> lock(mMutex);
+        mpMappedMap = pMappedMap;
+    }
+
+    shared_ptr<MappedMap> KeyFrameDatabase::GetMappedMap() {
+        unique_lock<mutex> lock(mMutex);
+        return mpMappedMap;
+    }
+
+    vector<KeyFrame *> KeyFrameDatabase::DetectRelocalizationCandidates(Frame *F, vector<size_t> &vnMappedCandidates) {
+        vnMappedCandidates.clear();
         list<KeyFrame *> lKFsSharingWords;
+        shared_ptr<MappedMap> pMappedMap;
 
         // Search all keyframes that share a word with current frame
         {
@@ -86,8 +101,24 @@ namespace ORB_SLAM2 {
                     pKFi->mnRelocWords++;
                 }
             }
+            pMappedMap = mpMappedMap;
+        }
+
+        // Same for the keyframes of the mapped file, read from its inverted file and counted by index
+        unordered_map<size_t, int> mMappedWords;
+        if (pMappedMap) {
+            const size_t nMappedKFs = pMappedMap->NumKeyFrames();
+            for (DBoW2::BowVector::const_iterator vit = F->mBowVec.begin(), vend = F->mBowVec.end();
+                 vit != vend; vit++) {
+                const uint32_t *pBegin, *pEnd;
+                pMappedMap->GetKeyFramesWithWord(vit->first, pBegin, pEnd);
+                for (const uint32_t *p = pBegin; p != pEnd; p++)
+                    if (*p < nMappedKFs)
+                        mMappedWords[*p]++;
+            }
         }
-        if (lKFsSharingWords.empty())
+
+        if (lKFsSharingWords.empty() && mMappedWords.empty())
             return vector<KeyFrame *>();
 
         // Only compare against those keyframes that share enough words
@@ -97,6 +128,8 @@ namespace ORB_SLAM2 {
             if ((*lit)->mnRelocWords > maxCommonWords)
                 maxCommonWords = (*lit)->mnRelocWords;
         }
+        for (const auto &words : mMappedWords)
+            maxCommonWords = max(maxCommonWords, words.second);
 
         int minCommonWords = maxCommonWords * 0.8f;
 
@@ -117,7 +150,16 @@ namespace ORB_SLAM2 {
             }
         }
 
-        if (lScoreAndMatch.empty())
+        // Keyframes of the mapped file already built and culled since are skipped
+        unordered_map<size_t, float> mMappedScores;
+        for (const auto &words : mMappedWords) {
+            if (words.second > minCommonWords && !pMappedMap->IsBad(words.first)) {
+                nscores++;
+                mMappedScores[words.first] = pMappedMap->Score(F->mBowVec, words.first);
+            }
+        }
+
+        if (lScoreAndMatch.empty() && mMappedScores.empty())
             return vector<KeyFrame *>();
 
         list<pair<float, KeyFrame *> > lAccScoreAndMatch;
@@ -149,6 +191,30 @@ namespace ORB_SLAM2 {
                 bestAccScore = accScore;
         }
 
+        list<pair<float, size_t> > lMappedAccScoreAndMatch;
+        for (const auto &score : mMappedScores) {
+            const uint32_t *pBegin, *pEnd;
+            pMappedMap->GetBestCovisibles(score.first, pBegin, pEnd);
+
+            float bestScore = score.second;
+            float accScore = bestScore;
+            size_t bestIdx = score.first;
+            for (const uint32_t *p = pBegin; p != pEnd; p++) {
+                unordered_map<size_t, float>::const_iterator it = mMappedScores.find(*p);
+                if (it == mMappedScores.end())
+                    continue;
+
+                accScore += it->second;
+                if (it->second > bestScore) {
+                    bestIdx = it->first;
+                    bestScore = it->second;
+                }
+            }
+            lMappedAccScoreAndMatch.push_back(make_pair(accScore, bestIdx));
+            if (accScore > bestAccScore)
+                bestAccScore = accScore;
+        }
+
         // Return all those keyframes with a score higher than 0.75*bestScore
         float minScoreToRetain = 0.75f * bestAccScore;
         set<KeyFrame *> spAlreadyAddedKF;
@@ -166,6 +232,13 @@ namespace ORB_SLAM2 {
             }
         }
 
+        set<size_t> snAlreadyAddedIdx;
+        for (list<pair<float, size_t> >::iterator it = lMappedAccScoreAndMatch.begin(),
+                     itend = lMappedAccScoreAndMatch.end(); it != itend; it++) {
+            if (it->first > minScoreToRetain && snAlreadyAddedIdx.insert(it->second).second)
+                vnMappedCandidates.push_back(it->second);
+        }
+
         return vpRelocCandidates;
     }
 
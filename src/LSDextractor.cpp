@@ -12,25 +12,161 @@ using namespace cv::line_descriptor;
 using namespace Eigen;
 
 namespace ORB_SLAM2 {
-    LineSegment::LineSegment() {}
+    LineSegment::LineSegment(int nFeatures, int gridCols, int gridRows, float scale, int numOctaves)
+            : mnFeatures(nFeatures), mnGridCols(max(1, gridCols)), mnGridRows(max(1, gridRows)), mfScale(scale),
+              mnOctaves(max(1, numOctaves)) {
+        mpLSD = LSDDetector::createLSDDetector();
+        mpLBD = BinaryDescriptor::createBinaryDescriptor();
+    }
+
+    void LineSegment::ComputePyramid(const Mat &img) {
+        mvImagePyramid.resize(mnOctaves);
+        mvImagePyramid[0] = img;
+        for (int level = 1; level < mnOctaves; level++) {
+            const float scale = pow(mfScale, level);
+            Size sz(cvRound((float) img.cols / scale), cvRound((float) img.rows / scale));
+            resize(mvImagePyramid[level - 1], mvImagePyramid[level], sz, 0, 0, INTER_LINEAR);
+        }
+    }
+
+    void LineSegment::SelectLines(vector<KeyLine> &keylines, int cols, int rows) {
+        if (keylines.size() <= static_cast<size_t>(mnFeatures))
+            return;
+
+        sort_lines_by_response cmp;
+
+        if (mnGridCols * mnGridRows == 1) {
+            nth_element(keylines.begin(), keylines.begin() + mnFeatures, keylines.end(), cmp);
+            keylines.resize(mnFeatures);
+            sort(keylines.begin(), keylines.end(), cmp);
+            return;
+        }
+
+        // Bucket the lines by their middle point
+        const int nCells = mnGridCols * mnGridRows;
+        vector<vector<KeyLine> > vCells(nCells);
+        for (const KeyLine &kl : keylines) {
+            const float mx = 0.5f * (kl.startPointX + kl.endPointX);
+            const float my = 0.5f * (kl.startPointY + kl.endPointY);
+            const int cx = min(mnGridCols - 1, max(0, static_cast<int>(mx * mnGridCols / cols)));
+            const int cy = min(mnGridRows - 1, max(0, static_cast<int>(my * mnGridRows / rows)));
+            vCells[cy * mnGridCols + cx].push_back(kl);
+        }
+
+        const size_t nPerCell = (mnFeatures + nCells - 1) / nCells;
+        vector<KeyLine> vLeft;
+        keylines.clear();
+        for (vector<KeyLine> &vCell : vCells) {
+            if (vCell.size() > nPerCell) {
+                nth_element(vCell.begin(), vCell.begin() + nPerCell, vCell.end(), cmp);
+                vLeft.insert(vLeft.end(), vCell.begin() + nPerCell, vCell.end());
+                vCell.resize(nPerCell);
+            }
+            keylines.insert(keylines.end(), vCell.begin(), vCell.end());
+        }
+
+        if (keylines.size() > static_cast<size_t>(mnFeatures)) {
+            nth_element(keylines.begin(), keylines.begin() + mnFeatures, keylines.end(), cmp);
+            keylines.resize(mnFeatures);
+        } else if (keylines.size() < static_cast<size_t>(mnFeatures)) {
+            const size_t nMissing = min(mnFeatures - keylines.size(), vLeft.size());
+            nth_element(vLeft.begin(), vLeft.begin() + nMissing, vLeft.end(), cmp);
+            keylines.insert(keylines.end(), vLeft.begin(), vLeft.begin() + nMissing);
+        }
+
+        sort(keylines.begin(), keylines.end(), cmp);
+    }
 
     void LineSegment::ExtractLineSegment(const Mat &img, vector<KeyLine> &keylines, Mat &ldesc,
-                                         vector<Vector3d> &keylineFunctions, float scale, int numOctaves) {
-        Ptr<BinaryDescriptor> lbd = BinaryDescriptor::createBinaryDescriptor();
-        Ptr<line_descriptor::LSDDetector> lsd = line_descriptor::LSDDetector::createLSDDetector();
-        lsd->detect(img, keylines, scale, numOctaves);
+                                         vector<Vector3d> &keylineFunctions) {
+        ComputePyramid(img);
 
-        unsigned int lsdNFeatures = 40;
+        // Detect on every level of the pyramid, the end points are scaled back to the input image
+        keylines.clear();
+        for (int level = 0; level < mnOctaves; level++) {
+            vector<KeyLine> vLevelKeylines;
+            mpLSD->detect(mvImagePyramid[level], vLevelKeylines, 1, 1);
 
-        // filter lines
-        if (keylines.size() > lsdNFeatures) {
-            sort(keylines.begin(), keylines.end(), sort_lines_by_response());
-            keylines.resize(lsdNFeatures);
-            for (unsigned int i = 0; i < lsdNFeatures; i++)
-                keylines[i].class_id = i;
+            const float scale = pow(mfScale, level);
+            for (KeyLine &kl : vLevelKeylines) {
+                kl.octave = level;
+                kl.startPointX = kl.sPointInOctaveX * scale;
+                kl.startPointY = kl.sPointInOctaveY * scale;
+                kl.endPointX = kl.ePointInOctaveX * scale;
+                kl.endPointY = kl.ePointInOctaveY * scale;
+                keylines.push_back(kl);
+            }
         }
 
-        lbd->compute(img, keylines, ldesc);
+        // filter lines, descriptors are only computed for the kept ones
+        SelectLines(keylines, img.cols, img.rows);
+        for (unsigned int i = 0; i < keylines.size(); i++)
+            keylines[i].class_id = i;
+
+        if (mnOctaves == 1) {
+            mpLBD->compute(img, keylines, ldesc);
+        } else {
+            // The descriptor of each line is computed on the level it was detected on
+            ldesc.release();
+            vector<bool> vbDescribed(keylines.size(), false);
+            bool bLevelsOK = true;
+            for (int level = 0; level < mnOctaves && bLevelsOK; level++) {
+                vector<int> vIndices;
+                vector<KeyLine> vLevelKeylines;
+                for (size_t i = 0; i < keylines.size(); i++) {
+                    if (keylines[i].octave != level)
+                        continue;
+                    KeyLine kl = keylines[i];
+                    kl.octave = 0;
+                    kl.startPointX = kl.sPointInOctaveX;
+                    kl.startPointY = kl.sPointInOctaveY;
+                    kl.endPointX = kl.ePointInOctaveX;
+                    kl.endPointY = kl.ePointInOctaveY;
+                    vIndices.push_back(i);
+                    vLevelKeylines.push_back(kl);
+                }
+                if (vLevelKeylines.empty())
+                    continue;
+
+                // compute may drop lines, the rows are mapped back through the class_id of the returned ones
+                Mat levelDesc;
+                mpLBD->compute(mvImagePyramid[level], vLevelKeylines, levelDesc);
+                if (vLevelKeylines.size() != vIndices.size() || levelDesc.rows != (int) vLevelKeylines.size()) {
+                    bLevelsOK = false;
+                    break;
+                }
+                if (ldesc.rows != (int) keylines.size())
+                    ldesc.create(keylines.size(), levelDesc.cols, levelDesc.type());
+                for (size_t k = 0; k < vLevelKeylines.size(); k++) {
+                    const int idx = vLevelKeylines[k].class_id;
+                    if (idx < 0 || idx >= (int) keylines.size() || keylines[idx].octave != level ||
+                        levelDesc.cols != ldesc.cols || levelDesc.type() != ldesc.type()) {
+                        bLevelsOK = false;
+                        break;
+                    }
+                    levelDesc.row(k).copyTo(ldesc.row(idx));
+                    vbDescribed[idx] = true;
+                }
+            }
+            for (size_t i = 0; i < vbDescribed.size() && bLevelsOK; i++)
+                bLevelsOK = vbDescribed[i];
+
+            // Fall back to the single octave descriptors on the input image, keeping the lines compute returns
+            if (!bLevelsOK) {
+                vector<KeyLine> vDescribed = keylines;
+                for (KeyLine &kl : vDescribed)
+                    kl.octave = 0;
+                mpLBD->compute(img, vDescribed, ldesc);
+
+                vector<KeyLine> vKept;
+                vKept.reserve(vDescribed.size());
+                for (const KeyLine &kl : vDescribed)
+                    vKept.push_back(keylines[kl.class_id]);
+                keylines.swap(vKept);
+                for (unsigned int i = 0; i < keylines.size(); i++)
+                    keylines[i].class_id = i;
+            }
+        }
 
         for (vector<KeyLine>::iterator it = keylines.begin(); it != keylines.end(); ++it) {
             Vector3d sp_l;
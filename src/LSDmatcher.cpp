@@ -5,6 +5,7 @@
 */
 
 #include "LSDmatcher.h"
+#include "HammingDistance.h"
 
 using namespace std;
 using namespace cv;
@@ -21,18 +22,15 @@ namespace ORB_SLAM2 {
     int LSDmatcher::SearchByProjection(Frame &CurrentFrame, const Frame &LastFrame, const float th) {
         int nmatches = 0;
 
-        const cv::Mat Rcw = CurrentFrame.mTcw.rowRange(0, 3).colRange(0, 3);
-        const cv::Mat tcw = CurrentFrame.mTcw.rowRange(0, 3).col(3);
+        const Eigen::Matrix3f &Rcw = CurrentFrame.GetRotationEigen();
+        const Eigen::Vector3f &tcw = CurrentFrame.GetTranslationEigen();
 
-        const cv::Mat twc = -Rcw.t() * tcw;
+        const Eigen::Vector3f &twc = CurrentFrame.GetCameraCenterEigen();
 
-        const cv::Mat Rlw = LastFrame.mTcw.rowRange(0, 3).colRange(0, 3);
-        const cv::Mat tlw = LastFrame.mTcw.rowRange(0, 3).col(3);
+        const Eigen::Vector3f tlc = LastFrame.GetRotationEigen() * twc + LastFrame.GetTranslationEigen();
 
-        const cv::Mat tlc = Rlw * twc + tlw;
-
-        const bool bForward = tlc.at<float>(2) > CurrentFrame.mb;
-        const bool bBackward = -tlc.at<float>(2) > CurrentFrame.mb;
+        const bool bForward = tlc(2) > CurrentFrame.mb;
+        const bool bBackward = -tlc(2) > CurrentFrame.mb;
 
         for (int i = 0; i < LastFrame.NL; i++) {
             MapLine *pML = LastFrame.mvpMapLines[i];
@@ -43,18 +41,18 @@ namespace ORB_SLAM2 {
 
             Vector6d P = pML->GetWorldPos();
 
-            cv::Mat SP = (Mat_<float>(3, 1) << P(0), P(1), P(2));
-            cv::Mat EP = (Mat_<float>(3, 1) << P(3), P(4), P(5));
+            const Eigen::Vector3f SP = P.head<3>().cast<float>();
+            const Eigen::Vector3f EP = P.tail<3>().cast<float>();
 
-            const cv::Mat SPc = Rcw * SP + tcw;
-            const auto &SPcX = SPc.at<float>(0);
-            const auto &SPcY = SPc.at<float>(1);
-            const auto &SPcZ = SPc.at<float>(2);
+            const Eigen::Vector3f SPc = Rcw * SP + tcw;
+            const auto &SPcX = SPc(0);
+            const auto &SPcY = SPc(1);
+            const auto &SPcZ = SPc(2);
 
-            const cv::Mat EPc = Rcw * EP + tcw;
-            const auto &EPcX = EPc.at<float>(0);
-            const auto &EPcY = EPc.at<float>(1);
-            const auto &EPcZ = EPc.at<float>(2);
+            const Eigen::Vector3f EPc = Rcw * EP + tcw;
+            const auto &EPcX = EPc(0);
+            const auto &EPcY = EPc(1);
+            const auto &EPcZ = EPc(2);
 
             if (SPcZ < 0.0f || EPcZ < 0.0f)
                 continue;
@@ -234,19 +232,9 @@ namespace ORB_SLAM2 {
     }
 
     int LSDmatcher::DescriptorDistance(const Mat &a, const Mat &b) {
-        const int *pa = a.ptr<int32_t>();
-        const int *pb = b.ptr<int32_t>();
-
-        int dist = 0;
-
-        for (int i = 0; i < 8; i++, pa++, pb++) {
-            unsigned int v = *pa ^ *pb;
-            v = v - ((v >> 1) & 0x55555555);
-            v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-            dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-        }
-
-        return dist;
+        if (a.cols != HammingDistance::DESCRIPTOR_BYTES)
+            return norm(a, b, NORM_HAMMING);
+        return HammingDistance::Distance(a, b);
     }
 
     float LSDmatcher::RadiusByViewingCos(const float &viewCos) {
@@ -257,8 +245,8 @@ namespace ORB_SLAM2 {
     }
 
     int LSDmatcher::Fuse(KeyFrame *pKF, const vector<MapLine *> &vpMapLines, const float th) {
-        cv::Mat Rcw = pKF->GetRotation();
-        cv::Mat tcw = pKF->GetTranslation();
+        const Eigen::Matrix3f Rcw = pKF->GetRotationEigen();
+        const Eigen::Vector3f tcw = pKF->GetTranslationEigen();
 
         const float &fx = pKF->fx;
         const float &fy = pKF->fy;
@@ -266,7 +254,7 @@ namespace ORB_SLAM2 {
         const float &cy = pKF->cy;
         const float &bf = pKF->mbf;
 
-        cv::Mat Ow = pKF->GetCameraCenter();
+        const Eigen::Vector3f Ow = pKF->GetCameraCenterEigen();
 
         int nFused = 0;
 
@@ -282,18 +270,18 @@ namespace ORB_SLAM2 {
 
             Vector6d P = pML->GetWorldPos();
 
-            cv::Mat SP = (Mat_<float>(3, 1) << P(0), P(1), P(2));
-            cv::Mat EP = (Mat_<float>(3, 1) << P(3), P(4), P(5));
+            const Eigen::Vector3f SP = P.head<3>().cast<float>();
+            const Eigen::Vector3f EP = P.tail<3>().cast<float>();
 
-            const cv::Mat SPc = Rcw * SP + tcw;
-            const auto &SPcX = SPc.at<float>(0);
-            const auto &SPcY = SPc.at<float>(1);
-            const auto &SPcZ = SPc.at<float>(2);
+            const Eigen::Vector3f SPc = Rcw * SP + tcw;
+            const auto &SPcX = SPc(0);
+            const auto &SPcY = SPc(1);
+            const auto &SPcZ = SPc(2);
 
-            const cv::Mat EPc = Rcw * EP + tcw;
-            const auto &EPcX = EPc.at<float>(0);
-            const auto &EPcY = EPc.at<float>(1);
-            const auto &EPcZ = EPc.at<float>(2);
+            const Eigen::Vector3f EPc = Rcw * EP + tcw;
+            const auto &EPcX = EPc(0);
+            const auto &EPcY = EPc(1);
+            const auto &EPcZ = EPc(2);
 
             if (SPcZ < 0.0f || EPcZ < 0.0f)
                 continue;
@@ -319,16 +307,15 @@ namespace ORB_SLAM2 {
             const float maxDistance = pML->GetMaxDistanceInvariance();
             const float minDistance = pML->GetMinDistanceInvariance();
 
-            const cv::Mat OM = 0.5 * (SP + EP) - Ow;
-            const float dist = cv::norm(OM);
+            const Eigen::Vector3f OM = 0.5f * (SP + EP) - Ow;
+            const float dist = OM.norm();
 
             if (dist < minDistance || dist > maxDistance)
                 continue;
 
-            Vector3d Pn = pML->GetNormal();
-            cv::Mat pn = (Mat_<float>(3, 1) << Pn(0), Pn(1), Pn(2));
+            const Eigen::Vector3f Pn = pML->GetNormal().cast<float>();
 
-            if (OM.dot(pn) < 0.5 * dist)
+            if (OM.dot(Pn) < 0.5 * dist)
                 continue;
 
             const int nPredictedLevel = pML->PredictScale(dist, pKF->mfLogScaleFactor);
@@ -0,0 +1,137 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "LocalMapPoints.h"
+#include "MapPoint.h"
+#include "Frame.h"
+#include "HammingDistance.h"
+
+#include <cmath>
+
+using namespace std;
+
+namespace ORB_SLAM2 {
+
+    void LocalMapPoints::Update(const vector<MapPoint *> &vpMapPoints) {
+        const int N = static_cast<int>(vpMapPoints.size());
+
+        mvpMapPoints.resize(N);
+        mvMinDistance.resize(N);
+        mvMaxDistance.resize(N);
+        mPositions.create(N, 3, CV_32F);
+        mNormals.create(N, 3, CV_32F);
+        mDescriptors.create(N, HammingDistance::DESCRIPTOR_BYTES, CV_8U);
+
+        int n = 0;
+        for (int i = 0; i < N; i++) {
+            MapPoint *pMP = vpMapPoints[i];
+            if (!pMP->CopyTrackingData(mPositions.ptr<float>(n), mNormals.ptr<float>(n), mvMinDistance[n],
+                                       mvMaxDistance[n], mDescriptors.ptr<uchar>(n)))
+                continue;
+            mvpMapPoints[n++] = pMP;
+        }
+
+        mvpMapPoints.resize(n);
+        mvMinDistance.resize(n);
+        mvMaxDistance.resize(n);
+        mPositions.resize(n);
+        mNormals.resize(n);
+        mDescriptors.resize(n);
+
+        mvnVisible.clear();
+    }
+
+    int LocalMapPoints::Project(Frame &F, float viewingCosLimit) {
+        const int N = static_cast<int>(mvpMapPoints.size());
+
+        mvnVisible.clear();
+        mvProjX.clear();
+        mvProjY.clear();
+        mvProjXR.clear();
+        mvnScaleLevel.clear();
+        mvViewCos.clear();
+
+        const Eigen::Matrix3f &Rcw = F.GetRotationEigen();
+        const Eigen::Vector3f &tcw = F.GetTranslationEigen();
+        const Eigen::Vector3f &Ow = F.GetCameraCenterEigen();
+
+        for (int i = 0; i < N; i++) {
+            MapPoint *pMP = mvpMapPoints[i];
+            if (pMP->mnLastFrameSeen == F.mnId)
+                continue;
+            // The point may have been culled by Local Mapping since the snapshot was taken
+            if (pMP->isBad())
+                continue;
+
+            const Eigen::Map<const Eigen::Vector3f> P(mPositions.ptr<float>(i));
+
+            // 3D in camera coordinates
+            const Eigen::Vector3f Pc = Rcw * P + tcw;
+            const float &PcX = Pc(0);
+            const float &PcY = Pc(1);
+            const float &PcZ = Pc(2);
+
+            // Check positive depth
+            if (PcZ < 0.0f)
+                continue;
+
+            // Project in image and check it is not outside
+            const float invz = 1.0f / PcZ;
+            const float u = Frame::fx * PcX * invz + Frame::cx;
+            const float v = Frame::fy * PcY * invz + Frame::cy;
+
+            if (u < Frame::mnMinX || u > Frame::mnMaxX)
+                continue;
+            if (v < Frame::mnMinY || v > Frame::mnMaxY)
+                continue;
+
+            // Check distance is in the scale invariance region of the MapPoint
+            const Eigen::Vector3f PO = P - Ow;
+            const float dist = PO.norm();
+
+            if (dist < 0.8f * mvMinDistance[i] || dist > 1.2f * mvMaxDistance[i])
+                continue;
+
+            // Check viewing angle
+            const Eigen::Map<const Eigen::Vector3f> Pn(mNormals.ptr<float>(i));
+            const float viewCos = PO.dot(Pn) / dist;
+
+            if (viewCos < viewingCosLimit)
+                continue;
+
+            // Predict scale in the image, as MapPoint::PredictScale
+            int nPredictedLevel = ceil(log(mvMaxDistance[i] / dist) / F.mfLogScaleFactor);
+            if (nPredictedLevel < 0)
+                nPredictedLevel = 0;
+            else if (nPredictedLevel >= F.mnScaleLevels)
+                nPredictedLevel = F.mnScaleLevels - 1;
+
+            mvnVisible.push_back(i);
+            mvProjX.push_back(u);
+            mvProjY.push_back(v);
+            mvProjXR.push_back(u - F.mbf * invz);
+            mvnScaleLevel.push_back(nPredictedLevel);
+            mvViewCos.push_back(viewCos);
+        }
+
+        return static_cast<int>(mvnVisible.size());
+    }
+
+} //namespace ORB_SLAM
@@ -20,6 +20,7 @@
 
 #include "LocalMapping.h"
 #include "ORBmatcher.h"
+#include "OrthogonalPlanes.h"
 
 #include<mutex>
 
@@ -30,9 +31,10 @@ using namespace Eigen;
 
 namespace ORB_SLAM2 {
 
-    LocalMapping::LocalMapping(Map *pMap, const string &strSettingPath) :
-            mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap), mbStopped(false),
-            mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true) {
+    LocalMapping::LocalMapping(Map *pMap, ThreadPool *pThreadPool, const string &strSettingPath) :
+            mbResetRequested(false), mbFinishRequested(false), mbFinished(true), mpMap(pMap),
+            mpThreadPool(pThreadPool), mpOptimizer(NULL), mbAbortBA(false), mbStopped(false),
+            mbStopRequested(false), mbNotStop(false), mbAcceptKeyFrames(true), mbWakeUp(false) {
         cv::FileStorage fSettings(strSettingPath, cv::FileStorage::READ);
         mfMFVerTh = fSettings["Plane.MFVerticalThreshold"];
     }
@@ -53,25 +55,28 @@ namespace ORB_SLAM2 {
 
                 // Check recent MapPoints
                 // VI-B recent map points culling
-                thread threadCullPoint(&LocalMapping::MapPointCulling, this);
-                thread threadCullLine(&LocalMapping::MapLineCulling, this);
-                thread threadCullPlane(&LocalMapping::MapPlaneCulling, this);
-                threadCullPoint.join();
-                threadCullLine.join();
-                threadCullPlane.join();
+                vector<function<void()> > vTasks;
+                vTasks.emplace_back([this] { MapPointCulling(); });
+                vTasks.emplace_back([this] { MapLineCulling(); });
+                vTasks.emplace_back([this] { MapPlaneCulling(); });
+                mpThreadPool->Run(vTasks);
 
                 // Triangulate new MapPoints
                 // VI-C new map points creation
-
-                thread threadCreatePoints(&LocalMapping::CreateNewMapPoints, this);
-                threadCreatePoints.join();
+                CreateNewMapPoints();
 
                 if (!CheckNewKeyFrames()) {
                     // Find more matches in neighbor keyframes and fuse point duplications
                     SearchInNeighbors();
                 }
 
+                mbAbortBA = false;
+
                 if (!CheckNewKeyFrames() && !stopRequested()) {
+                    // VI-D Local BA
+                    if (mpOptimizer && mpMap->KeyFramesInMap() > 2)
+                        mpOptimizer->LocalBundleAdjustment(mpCurrentKeyFrame, &mbAbortBA, mpMap);
+
                     // Check redundant local Keyframes
                     // VI-E local keyframes culling
                     KeyFrameCulling();
@@ -80,7 +85,7 @@ namespace ORB_SLAM2 {
             } else if (Stop()) {
                 // Safe area to stop
                 while (isStopped() && !CheckFinish()) {
-                    usleep(3000);
+                    WaitForWork();
                 }
                 if (CheckFinish())
                     break;
@@ -94,15 +99,37 @@ namespace ORB_SLAM2 {
             if (CheckFinish())
                 break;
 
-            usleep(3000);
+            if (!CheckNewKeyFrames())
+                WaitForWork();
         }
 
         SetFinish();
     }
 
+    void LocalMapping::SetOptimizer(Optimizer *pOptimizer) {
+        mpOptimizer = pOptimizer;
+    }
+
     void LocalMapping::InsertKeyFrame(KeyFrame *pKF) {
-        unique_lock<mutex> lock(mMutexNewKFs);
-        mlNewKeyFrames.push_back(pKF);
+        {
+            unique_lock<mutex> lock(mMutexNewKFs);
+            mlNewKeyFrames.push_back(pKF);
+            mbAbortBA = true;
+        }
+        WakeUp();
+    }
+
+    void LocalMapping::WakeUp() {
+        unique_lock<mutex> lock(mMutexWakeUp);
+        mbWakeUp = true;
+        mCondWakeUp.notify_one();
+    }
+
+    void LocalMapping::WaitForWork() {
+        unique_lock<mutex> lock(mMutexWakeUp);
+        while (!mbWakeUp)
+            mCondWakeUp.wait(lock);
+        mbWakeUp = false;
     }
 
 
@@ -169,51 +196,59 @@ namespace ORB_SLAM2 {
             }
         }
 
-        for (size_t i = 0; i < mpCurrentKeyFrame->mnPlaneNum; i++) {
-            cv::Mat p3Dc1 = mpCurrentKeyFrame->mvPlaneCoefficients[i];
-            MapPlane *pMP1 = mpCurrentKeyFrame->mvpMapPlanes[i];
+        OrthogonalPlanes orthogonalPlanes;
+        orthogonalPlanes.Compute(mpCurrentKeyFrame->mvPlaneCoefficients, mpCurrentKeyFrame->mvpMapPlanes,
+                                 mfMFVerTh);
+
+        // Each cluster of parallel planes is represented by its plane with the most points. Every plane is
+        // registered with the representatives of the clusters orthogonal to its own, so the number of Manhattan
+        // frames grows with the planes times the few cluster pairs, not with the product of the cluster sizes.
+        const int nClusters = orthogonalPlanes.NumClusters();
+        vector<int> vRepresentatives(nClusters, -1);
+        for (int c = 0; c < nClusters; c++) {
+            for (int i : orthogonalPlanes.GetClusterPlanes(c)) {
+                const int r = vRepresentatives[c];
+                if (r == -1 || mpCurrentKeyFrame->mvPlanePoints[i].size() > mpCurrentKeyFrame->mvPlanePoints[r].size())
+                    vRepresentatives[c] = i;
+            }
+        }
 
-            if (!pMP1 || pMP1->isBad()) {
+        for (size_t i = 0; i < mpCurrentKeyFrame->mnPlaneNum; i++) {
+            const int a = orthogonalPlanes.GetCluster(i);
+            if (a == -1) {
                 continue;
             }
 
-            for (size_t j = i + 1; j < mpCurrentKeyFrame->mnPlaneNum; j++) {
-                cv::Mat p3Dc2 = mpCurrentKeyFrame->mvPlaneCoefficients[j];
-                MapPlane *pMP2 = mpCurrentKeyFrame->mvpMapPlanes[j];
+            MapPlane *pMP1 = mpCurrentKeyFrame->mvpMapPlanes[i];
 
-                if (!pMP2 || pMP2->isBad() || pMP2->mnId == pMP1->mnId) {
+            for (int b = 0; b < nClusters; b++) {
+                const int j = vRepresentatives[b];
+                if (b == a || !orthogonalPlanes.IsOrthogonal(i, j)) {
                     continue;
                 }
 
-                float angle12 = p3Dc1.at<float>(0) * p3Dc2.at<float>(0) +
-                                p3Dc1.at<float>(1) * p3Dc2.at<float>(1) +
-                                p3Dc1.at<float>(2) * p3Dc2.at<float>(2);
-
-                if (angle12 < mfMFVerTh && angle12 > -mfMFVerTh) {
-                    for (size_t k = j + 1; k < mpCurrentKeyFrame->mnPlaneNum; k++) {
-                        cv::Mat p3Dc3 = mpCurrentKeyFrame->mvPlaneCoefficients[k];
-                        MapPlane *pMP3 = mpCurrentKeyFrame->mvpMapPlanes[k];
+                MapPlane *pMP2 = mpCurrentKeyFrame->mvpMapPlanes[j];
 
-                        if (!pMP3 || pMP3->isBad() || pMP3->mnId == pMP1->mnId || pMP3->mnId == pMP2->mnId) {
-                            continue;
-                        }
+                if (pMP2->mnId == pMP1->mnId) {
+                    continue;
+                }
 
-                        float angle13 = p3Dc1.at<float>(0) * p3Dc3.at<float>(0) +
-                                        p3Dc1.at<float>(1) * p3Dc3.at<float>(1) +
-                                        p3Dc1.at<float>(2) * p3Dc3.at<float>(2);
+                for (int c = b + 1; c < nClusters; c++) {
+                    const int k = vRepresentatives[c];
+                    if (c == a || !orthogonalPlanes.IsOrthogonal(i, k) || !orthogonalPlanes.IsOrthogonal(j, k)) {
+                        continue;
+                    }
 
-                        float angle23 = p3Dc2.at<float>(0) * p3Dc3.at<float>(0) +
-                                        p3Dc2.at<float>(1) * p3Dc3.at<float>(1) +
-                                        p3Dc2.at<float>(2) * p3Dc3.at<float>(2);
+                    MapPlane *pMP3 = mpCurrentKeyFrame->mvpMapPlanes[k];
 
-                        if (angle13 < mfMFVerTh && angle13 > -mfMFVerTh && angle23 < mfMFVerTh &&
-                            angle23 > -mfMFVerTh) {
-                            mpMap->AddManhattanObservation(pMP1, pMP2, pMP3, mpCurrentKeyFrame);
-                        }
+                    if (pMP3->mnId == pMP1->mnId || pMP3->mnId == pMP2->mnId) {
+                        continue;
                     }
 
-                    mpMap->AddPartialManhattanObservation(pMP1, pMP2, mpCurrentKeyFrame);
+                    mpMap->AddManhattanObservation(pMP1, pMP2, pMP3, mpCurrentKeyFrame);
                 }
+
+                mpMap->AddPartialManhattanObservation(pMP1, pMP2, mpCurrentKeyFrame);
             }
         }
 
@@ -640,9 +675,13 @@ namespace ORB_SLAM2 {
     }
 
     void LocalMapping::RequestStop() {
-        unique_lock<mutex> lock(mMutexStop);
-        mbStopRequested = true;
-        unique_lock<mutex> lock2(mMutexNewKFs);
+        {
+            unique_lock<mutex> lock(mMutexStop);
+            mbStopRequested = true;
+            unique_lock<mutex> lock2(mMutexNewKFs);
+            mbAbortBA = true;
+        }
+        WakeUp();
     }
 
     bool LocalMapping::Stop() {
@@ -667,15 +706,19 @@ namespace ORB_SLAM2 {
     }
 
     void LocalMapping::Release() {
-        unique_lock<mutex> lock(mMutexStop);
-        unique_lock<mutex> lock2(mMutexFinish);
-        if (mbFinished)
-            return;
-        mbStopped = false;
-        mbStopRequested = false;
-        for (list<KeyFrame *>::iterator lit = mlNewKeyFrames.begin(), lend = mlNewKeyFrames.end(); lit != lend; lit++)
-            delete *lit;
-        mlNewKeyFrames.clear();
+        {
+            unique_lock<mutex> lock(mMutexStop);
+            unique_lock<mutex> lock2(mMutexFinish);
+            if (mbFinished)
+                return;
+            mbStopped = false;
+            mbStopRequested = false;
+            for (list<KeyFrame *>::iterator lit = mlNewKeyFrames.begin(), lend = mlNewKeyFrames.end();
+                 lit != lend; lit++)
+                delete *lit;
+            mlNewKeyFrames.clear();
+        }
+        WakeUp();
 
         cout << "Local Mapping RELEASE" << endl;
     }
@@ -690,13 +733,23 @@ namespace ORB_SLAM2 {
         mbAcceptKeyFrames = flag;
     }
 
+    void LocalMapping::InterruptBA() {
+        mbAbortBA = true;
+    }
+
     bool LocalMapping::SetNotStop(bool flag) {
-        unique_lock<mutex> lock(mMutexStop);
+        {
+            unique_lock<mutex> lock(mMutexStop);
+
+            if (flag && mbStopped)
+                return false;
 
-        if (flag && mbStopped)
-            return false;
+            mbNotStop = flag;
+        }
 
-        mbNotStop = flag;
+        // A pending stop request can be served now
+        if (!flag)
+            WakeUp();
 
         return true;
     }
@@ -769,6 +822,7 @@ namespace ORB_SLAM2 {
             unique_lock<mutex> lock(mMutexReset);
             mbResetRequested = true;
         }
+        WakeUp();
 
         while (1) {
             {
@@ -791,8 +845,11 @@ namespace ORB_SLAM2 {
     }
 
     void LocalMapping::RequestFinish() {
-        unique_lock<mutex> lock(mMutexFinish);
-        mbFinishRequested = true;
+        {
+            unique_lock<mutex> lock(mMutexFinish);
+            mbFinishRequested = true;
+        }
+        WakeUp();
     }
 
     bool LocalMapping::CheckFinish() {
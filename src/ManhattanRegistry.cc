@@ -0,0 +1,155 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ManhattanRegistry.h"
+#include "MapPlane.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+
+namespace ORB_SLAM2 {
+
+    size_t ManhattanRegistry::KeyHash::operator()(const Key &key) const {
+        size_t hash = 0;
+        for (unsigned long id : key.ids)
+            hash ^= std::hash<unsigned long>()(id) + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+        return hash;
+    }
+
+    ManhattanRegistry::ManhattanRegistry() : mnNextId(0) {
+    }
+
+    ManhattanRegistry::Key ManhattanRegistry::MakeKey(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3) {
+        Key key;
+        key.ids[0] = pMP1->mnId;
+        key.ids[1] = pMP2->mnId;
+        key.ids[2] = pMP3 ? pMP3->mnId : numeric_limits<unsigned long>::max();
+        sort(key.ids, key.ids + 3);
+        return key;
+    }
+
+    bool ManhattanRegistry::Add(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3, KeyFrame *pKF) {
+        const Key key = MakeKey(pMP1, pMP2, pMP3);
+        if (mmFrameOfKey.count(key))
+            return false;
+
+        ManhattanFrame frame;
+        frame.mnId = mnNextId++;
+        frame.mvpPlanes[0] = pMP1;
+        frame.mvpPlanes[1] = pMP2;
+        frame.mvpPlanes[2] = pMP3;
+        frame.mpKF = pKF;
+
+        mmFrames[frame.mnId] = frame;
+        mmFrameOfKey[key] = frame.mnId;
+        for (MapPlane *pMP : frame.mvpPlanes)
+            if (pMP)
+                mmFramesOfPlane[pMP].push_back(frame.mnId);
+        mmNumFramesOfKeyFrame[pKF]++;
+
+        return true;
+    }
+
+    const ManhattanFrame *ManhattanRegistry::Find(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3) const {
+        auto itKey = mmFrameOfKey.find(MakeKey(pMP1, pMP2, pMP3));
+        if (itKey == mmFrameOfKey.end())
+            return nullptr;
+
+        return &mmFrames.at(itKey->second);
+    }
+
+    vector<ManhattanFrame> ManhattanRegistry::GetFrames(MapPlane *pMP) const {
+        vector<ManhattanFrame> vFrames;
+        auto it = mmFramesOfPlane.find(pMP);
+        if (it == mmFramesOfPlane.end())
+            return vFrames;
+
+        vFrames.reserve(it->second.size());
+        for (unsigned long id : it->second)
+            vFrames.push_back(mmFrames.at(id));
+        return vFrames;
+    }
+
+    size_t ManhattanRegistry::NumFrames(MapPlane *pMP) const {
+        auto it = mmFramesOfPlane.find(pMP);
+        return it == mmFramesOfPlane.end() ? 0 : it->second.size();
+    }
+
+    vector<ManhattanFrame> ManhattanRegistry::GetAllFrames() const {
+        vector<ManhattanFrame> vFrames;
+        vFrames.reserve(mmFrames.size());
+        for (const auto &frame : mmFrames)
+            vFrames.push_back(frame.second);
+
+        sort(vFrames.begin(), vFrames.end(), [](const ManhattanFrame &f1, const ManhattanFrame &f2) {
+            return f1.mnId < f2.mnId;
+        });
+        return vFrames;
+    }
+
+    vector<KeyFrame *> ManhattanRegistry::Erase(MapPlane *pMP) {
+        vector<KeyFrame *> vpReleasedKFs;
+        auto it = mmFramesOfPlane.find(pMP);
+        if (it == mmFramesOfPlane.end())
+            return vpReleasedKFs;
+
+        const vector<unsigned long> vIds = it->second;
+        mmFramesOfPlane.erase(it);
+
+        for (unsigned long id : vIds) {
+            const ManhattanFrame &frame = mmFrames.at(id);
+
+            for (MapPlane *pOther : frame.mvpPlanes) {
+                if (!pOther || pOther == pMP)
+                    continue;
+
+                auto itOther = mmFramesOfPlane.find(pOther);
+                if (itOther == mmFramesOfPlane.end())
+                    continue;
+
+                vector<unsigned long> &vOtherIds = itOther->second;
+                vOtherIds.erase(remove(vOtherIds.begin(), vOtherIds.end(), id), vOtherIds.end());
+                if (vOtherIds.empty())
+                    mmFramesOfPlane.erase(itOther);
+            }
+
+            auto itKF = mmNumFramesOfKeyFrame.find(frame.mpKF);
+            if (itKF != mmNumFramesOfKeyFrame.end() && --itKF->second == 0) {
+                vpReleasedKFs.push_back(frame.mpKF);
+                mmNumFramesOfKeyFrame.erase(itKF);
+            }
+
+            mmFrameOfKey.erase(MakeKey(frame.mvpPlanes[0], frame.mvpPlanes[1], frame.mvpPlanes[2]));
+            mmFrames.erase(id);
+        }
+
+        return vpReleasedKFs;
+    }
+
+    void ManhattanRegistry::clear() {
+        mmFrames.clear();
+        mmFrameOfKey.clear();
+        mmFramesOfPlane.clear();
+        mmNumFramesOfKeyFrame.clear();
+    }
+
+} //namespace ORB_SLAM
@@ -21,6 +21,7 @@
 #include "Map.h"
 
 #include<mutex>
+#include<algorithm>
 
 using namespace std;
 using namespace cv;
@@ -29,99 +30,6 @@ using namespace Eigen;
 
 namespace ORB_SLAM2 {
 
-    size_t PartialManhattanMapHash::operator()(const std::pair<MapPlane *, MapPlane *> &key) const {
-        int id1, id2;
-        if (key.first->mnId > key.second->mnId) {
-            id1 = key.second->mnId;
-            id2 = key.first->mnId;
-        } else {
-            id1 = key.first->mnId;
-            id2 = key.second->mnId;
-        }
-
-        size_t hash = 0;
-        hash += (71 * hash + id1) % 5;
-        hash += (71 * hash + id2) % 5;
-        return hash;
-    }
-
-    bool PartialManhattanMapEqual::operator()(const std::pair<MapPlane *, MapPlane *> &a,
-                                              const std::pair<MapPlane *, MapPlane *> &b) const {
-        MapPlane *pMP11, *pMP12, *pMP21, *pMP22;
-        if (a.first->mnId > a.second->mnId) {
-            pMP11 = a.second;
-            pMP12 = a.first;
-        } else {
-            pMP11 = a.first;
-            pMP12 = a.second;
-        }
-
-        if (b.first->mnId > b.second->mnId) {
-            pMP21 = b.second;
-            pMP22 = b.first;
-        } else {
-            pMP21 = b.first;
-            pMP22 = b.second;
-        }
-
-        std::pair<MapPlane *, MapPlane *> p1 = std::make_pair(pMP11, pMP12);
-        std::pair<MapPlane *, MapPlane *> p2 = std::make_pair(pMP21, pMP22);
-
-        return p1 == p2;
-    }
-
-    size_t ManhattanMapHash::operator()(const std::tuple<MapPlane *, MapPlane *, MapPlane *> &key) const {
-        vector<int> ids;
-        ids.push_back(get<0>(key)->mnId);
-        ids.push_back(get<1>(key)->mnId);
-        ids.push_back(get<2>(key)->mnId);
-        sort(ids.begin(), ids.end());
-
-        size_t hash = 0;
-        hash += (71 * hash + ids[0]) % 5;
-        hash += (71 * hash + ids[1]) % 5;
-        hash += (71 * hash + ids[2]) % 5;
-        return hash;
-    }
-
-    bool ManhattanMapEqual::operator()(const std::tuple<MapPlane *, MapPlane *, MapPlane *> &a,
-                                       const std::tuple<MapPlane *, MapPlane *, MapPlane *> &b) const {
-        MapPlane *pMP11, *pMP12, *pMP13, *pMP21, *pMP22, *pMP23;
-
-        pMP11 = get<0>(a);
-        pMP12 = get<1>(a);
-        pMP13 = get<2>(a);
-
-        if (pMP11 > pMP12) {
-            std::swap(pMP11, pMP12);
-        }
-        if (pMP12 > pMP13) {
-            std::swap(pMP12, pMP13);
-        }
-        if (pMP11 > pMP12) {
-            std::swap(pMP11, pMP12);
-        }
-
-        pMP21 = get<0>(b);
-        pMP22 = get<1>(b);
-        pMP23 = get<2>(b);
-
-        if (pMP21 > pMP22) {
-            std::swap(pMP21, pMP22);
-        }
-        if (pMP22 > pMP23) {
-            std::swap(pMP22, pMP23);
-        }
-        if (pMP21 > pMP22) {
-            std::swap(pMP21, pMP22);
-        }
-
-        std::tuple<MapPlane *, MapPlane *, MapPlane *> t1 = std::make_tuple(pMP11, pMP12, pMP13);
-        std::tuple<MapPlane *, MapPlane *, MapPlane *> t2 = std::make_tuple(pMP21, pMP22, pMP23);
-
-        return t1 == t2;
-    }
-
     Map::Map() : mnMaxKFid(0) {
     }
 
@@ -195,6 +103,8 @@ namespace ORB_SLAM2 {
             delete mspKeyFrame;
 
         mspMapPlanes.clear();
+        mPlaneIndex.clear();
+        mManhattanRegistry.clear();
         mspMapPoints.clear();
         mspKeyFrames.clear();
         mspMapLines.clear();
@@ -202,6 +112,15 @@ namespace ORB_SLAM2 {
         mvpReferenceMapPoints.clear();
         mvpReferenceMapLines.clear();
         mvpKeyFrameOrigins.clear();
+
+        // Unmaps the loaded files. The elements pointing into them were deleted above, everything else only holds
+        // clones of their matrices.
+        mvpStorage.clear();
+    }
+
+    void Map::AddStorage(const shared_ptr<void> &pStorage) {
+        unique_lock<mutex> lock(mMutexMap);
+        mvpStorage.push_back(pStorage);
     }
 
     void Map::AddMapLine(MapLine *pML) {
@@ -232,11 +151,21 @@ namespace ORB_SLAM2 {
     void Map::AddMapPlane(MapPlane *pMP) {
         unique_lock<mutex> lock(mMutexMap);
         mspMapPlanes.insert(pMP);
+        mPlaneIndex.Insert(pMP);
     }
 
     void Map::EraseMapPlane(MapPlane *pMP) {
-        unique_lock<mutex> lock(mMutexMap);
-        mspMapPlanes.erase(pMP);
+        vector<KeyFrame *> vpReleasedKFs;
+        {
+            unique_lock<mutex> lock(mMutexMap);
+            mspMapPlanes.erase(pMP);
+            mPlaneIndex.Erase(pMP);
+            vpReleasedKFs = mManhattanRegistry.Erase(pMP);
+        }
+
+        // Erasing a keyframe takes the map mutex again
+        for (KeyFrame *pKF : vpReleasedKFs)
+            pKF->SetErase();
     }
 
     vector<MapPlane *> Map::GetAllMapPlanes() {
@@ -244,44 +173,58 @@ namespace ORB_SLAM2 {
         return vector<MapPlane *>(mspMapPlanes.begin(), mspMapPlanes.end());
     }
 
+    vector<MapPlane *> Map::GetMapPlanesByNormal(const Eigen::Vector3f &normal, float minCos, float maxCos) {
+        vector<MapPlane *> vpMapPlanes;
+        {
+            unique_lock<mutex> lock(mMutexMap);
+            mPlaneIndex.Search(normal, minCos, maxCos, vpMapPlanes);
+        }
+        sort(vpMapPlanes.begin(), vpMapPlanes.end());
+        return vpMapPlanes;
+    }
+
     void Map::AddManhattanObservation(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3, KeyFrame *pKF) {
         unique_lock<mutex> lock(mMutexMap);
-
-        Manhattan manhattan = std::make_tuple(pMP1, pMP2, pMP3);
-        if (mmpManhattanObservations.count(manhattan) != 0)
+        // A plane culled meanwhile would never be removed again
+        if (!mspMapPlanes.count(pMP1) || !mspMapPlanes.count(pMP2) || !mspMapPlanes.count(pMP3))
             return;
-        pKF->SetNotErase();
-        mmpManhattanObservations[manhattan] = pKF;
+        if (mManhattanRegistry.Add(pMP1, pMP2, pMP3, pKF))
+            pKF->SetNotErase();
     }
 
     KeyFrame *Map::GetManhattanObservation(MapPlane *pMP1, MapPlane *pMP2, MapPlane *pMP3) {
         unique_lock<mutex> lock(mMutexMap);
-        Manhattan manhattan = std::make_tuple(pMP1, pMP2, pMP3);
-        if (mmpManhattanObservations.count(manhattan)) {
-            return mmpManhattanObservations[manhattan];
-        } else {
-            return static_cast<KeyFrame *>(nullptr);
-        }
+        const ManhattanFrame *pFrame = mManhattanRegistry.Find(pMP1, pMP2, pMP3);
+        return pFrame ? pFrame->mpKF : static_cast<KeyFrame *>(nullptr);
     }
 
     void Map::AddPartialManhattanObservation(MapPlane *pMP1, MapPlane *pMP2, KeyFrame *pKF) {
         unique_lock<mutex> lock(mMutexMap);
-
-        PartialManhattan manhattan = std::make_pair(pMP1, pMP2);
-        if (mmpPartialManhattanObservations.count(manhattan) != 0)
+        if (!mspMapPlanes.count(pMP1) || !mspMapPlanes.count(pMP2))
             return;
-        pKF->SetNotErase();
-        mmpPartialManhattanObservations[manhattan] = pKF;
+        if (mManhattanRegistry.Add(pMP1, pMP2, nullptr, pKF))
+            pKF->SetNotErase();
     }
 
     KeyFrame *Map::GetPartialManhattanObservation(MapPlane *pMP1, MapPlane *pMP2) {
         unique_lock<mutex> lock(mMutexMap);
-        PartialManhattan manhattan = std::make_pair(pMP1, pMP2);
-        if (mmpPartialManhattanObservations.count(manhattan)) {
-            return mmpPartialManhattanObservations[manhattan];
-        } else {
-            return static_cast<KeyFrame *>(nullptr);
-        }
+        const ManhattanFrame *pFrame = mManhattanRegistry.Find(pMP1, pMP2, nullptr);
+        return pFrame ? pFrame->mpKF : static_cast<KeyFrame *>(nullptr);
+    }
+
+    vector<ManhattanFrame> Map::GetManhattanFrames(MapPlane *pMP) {
+        unique_lock<mutex> lock(mMutexMap);
+        return mManhattanRegistry.GetFrames(pMP);
+    }
+
+    size_t Map::GetNumManhattanFrames(MapPlane *pMP) {
+        unique_lock<mutex> lock(mMutexMap);
+        return mManhattanRegistry.NumFrames(pMP);
+    }
+
+    vector<ManhattanFrame> Map::GetAllManhattanFrames() {
+        unique_lock<mutex> lock(mMutexMap);
+        return mManhattanRegistry.GetAllFrames();
     }
 
 } //namespace ORB_SLAM
@@ -5,6 +5,7 @@
 */
 
 #include "MapLine.h"
+#include "HammingDistance.h"
 
 #include <mutex>
 #include <map>
@@ -20,7 +21,7 @@ namespace ORB_SLAM2 {
 
     MapLine::MapLine(Vector6d &Pos, KeyFrame *pRefKF, Map *pMap) :
             mnFirstKFid(pRefKF->mnId), nObs(0), mnTrackReferenceForFrame(0),
-            mnLastFrameSeen(0), mnFuseCandidateForKF(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
+            mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
             mpReplaced(static_cast<MapLine *>(NULL)), mpMap(pMap) {
         mWorldPos = Pos;
 
@@ -33,7 +34,7 @@ namespace ORB_SLAM2 {
 
     MapLine::MapLine(Vector6d &Pos, Map *pMap, Frame *pFrame, const int &idxF) :
             mnFirstKFid(-1), nObs(0), mnTrackReferenceForFrame(0), mnLastFrameSeen(0),
-            mnFuseCandidateForKF(0), mpRefKF(static_cast<KeyFrame *>(NULL)), mnVisible(1),
+            mnBALocalForKF(0), mnFuseCandidateForKF(0), mpRefKF(static_cast<KeyFrame *>(NULL)), mnVisible(1),
             mnFound(1), mbBad(false), mpReplaced(NULL), mpMap(pMap) {
         mWorldPos = Pos;
         Mat Ow = pFrame->GetCameraCenter();
@@ -62,6 +63,14 @@ namespace ORB_SLAM2 {
         mnId = nNextId++;
     }
 
+    void MapLine::SetWorldPos(const Vector6d &Pos) {
+        unique_lock<mutex> lock2(mGlobalMutex);
+        unique_lock<mutex> lock(mMutexPos);
+        mWorldPos = Pos;
+        mStart3D = Pos.head(3);
+        mEnd3D = Pos.tail(3);
+    }
+
     Vector6d MapLine::GetWorldPos() {
         unique_lock<mutex> lock(mMutexPos);
         return mWorldPos;
@@ -102,6 +111,11 @@ namespace ORB_SLAM2 {
             SetBadFlag();
     }
 
+    map<KeyFrame *, size_t> MapLine::GetObservations() {
+        unique_lock<mutex> lock(mMutexFeatures);
+        return mObservations;
+    }
+
     int MapLine::Observations() {
         unique_lock<mutex> lock(mMutexFeatures);
         return nObs;
@@ -222,12 +236,27 @@ namespace ORB_SLAM2 {
 
         const size_t NL = vDescriptors.size();
 
+        Mat descriptors;
+        vconcat(vDescriptors, descriptors);
+        vector<int> vDistij(NL);
+
+        // The batched kernel compares 256-bit descriptors, LBD descriptors of any other length go through OpenCV
+        const bool bBatched = descriptors.cols == HammingDistance::DESCRIPTOR_BYTES;
+
         std::vector<std::vector<float>> Distances;
         Distances.resize(NL, vector<float>(NL, 0));
         for (size_t i = 0; i < NL; i++) {
             Distances[i][i] = 0;
-            for (size_t j = 0; j < NL; j++) {
-                int distij = norm(vDescriptors[i], vDescriptors[j], NORM_HAMMING);
+            if (bBatched) {
+                const uint8_t *pDesc = descriptors.ptr<uint8_t>(i);
+                HammingDistance::DistanceToMany(pDesc, pDesc + descriptors.step[0], descriptors.step[0], NL - i - 1,
+                                                vDistij.data());
+            } else {
+                for (size_t j = i + 1; j < NL; j++)
+                    vDistij[j - i - 1] = norm(descriptors.row(i), descriptors.row(j), NORM_HAMMING);
+            }
+            for (size_t j = i + 1; j < NL; j++) {
+                int distij = vDistij[j - i - 1];
                 Distances[i][j] = distij;
                 Distances[j][i] = distij;
             }
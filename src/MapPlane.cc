@@ -21,6 +21,7 @@
 #include "MapPlane.h"
 
 #include<mutex>
+#include<limits>
 
 using namespace std;
 using namespace cv;
@@ -33,8 +34,8 @@ namespace ORB_SLAM2 {
 
     MapPlane::MapPlane(const cv::Mat &Pos, KeyFrame *pRefKF, Map *pMap) :
             mnFirstKFid(pRefKF->mnId), mpRefKF(pRefKF), mnVisible(1), mnFound(1),
-            mvPlanePoints(new PointCloud()), mpMap(pMap), nObs(0),
-            mbBad(false) {
+            mvPlanePoints(new PointCloud()), mpMap(pMap), nObs(0), mnTrackReferenceForFrame(0),
+            mbBad(false), mbHasBounds(false) {
         mnId = nNextId++;
 
         Pos.copyTo(mWorldPos);
@@ -196,6 +197,7 @@ namespace ORB_SLAM2 {
         voxel.filter(*coarseCloud);
 
         mvPlanePoints = coarseCloud;
+        UpdateBoundingBox();
     }
 
     void MapPlane::UpdateCoefficientsAndPoints(ORB_SLAM2::Frame &pF, int id) {
@@ -215,5 +217,30 @@ namespace ORB_SLAM2 {
         voxel.filter(*coarseCloud);
 
         mvPlanePoints = coarseCloud;
+        UpdateBoundingBox();
     }
-}
\ No newline at end of file
+
+    bool MapPlane::GetBoundingBox(Eigen::Vector3f &minPt, Eigen::Vector3f &maxPt) {
+        unique_lock<mutex> lock(mMutexPos);
+        minPt = mMinBound;
+        maxPt = mMaxBound;
+        return mbHasBounds;
+    }
+
+    void MapPlane::UpdateBoundingBox() {
+        PointCloud::Ptr points = mvPlanePoints;
+
+        Eigen::Vector3f minPt, maxPt;
+        minPt.setConstant(numeric_limits<float>::max());
+        maxPt.setConstant(-numeric_limits<float>::max());
+        for (auto &p : points->points) {
+            minPt = minPt.cwiseMin(p.getVector3fMap());
+            maxPt = maxPt.cwiseMax(p.getVector3fMap());
+        }
+
+        unique_lock<mutex> lock(mMutexPos);
+        mMinBound = minPt;
+        mMaxBound = maxPt;
+        mbHasBounds = !points->empty();
+    }
+}
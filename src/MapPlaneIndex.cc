@@ -0,0 +1,150 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MapPlaneIndex.h"
+#include "MapPlane.h"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+namespace ORB_SLAM2 {
+
+    MapPlaneIndex::MapPlaneIndex() {
+        const float step = 2.0f / NUM_CELLS;
+        for (int face = 0; face < 6; face++) {
+            for (int iu = 0; iu < NUM_CELLS; iu++) {
+                for (int iv = 0; iv < NUM_CELLS; iv++) {
+                    const int bin = (face * NUM_CELLS + iu) * NUM_CELLS + iv;
+                    const float u0 = -1.0f + iu * step;
+                    const float v0 = -1.0f + iv * step;
+
+                    const Eigen::Vector3f center = FaceDirection(face, u0 + 0.5f * step, v0 + 0.5f * step);
+
+                    // Cells are convex on the sphere, the farthest direction from the center is a corner
+                    float minCos = 1.0f;
+                    for (int c = 0; c < 4; c++) {
+                        const Eigen::Vector3f corner = FaceDirection(face, u0 + (c & 1) * step, v0 + (c >> 1) * step);
+                        minCos = min(minCos, center.dot(corner));
+                    }
+
+                    // Small margin for normals that are not exactly unit length
+                    mvBinCenters[bin] = center;
+                    mvBinRadius[bin] = acos(max(-1.0f, min(1.0f, minCos))) + 1e-3f;
+                }
+            }
+        }
+    }
+
+    Eigen::Vector3f MapPlaneIndex::FaceDirection(int face, float u, float v) {
+        const int axis = face / 2;
+        Eigen::Vector3f d;
+        d(axis) = face % 2 ? -1.0f : 1.0f;
+        d((axis + 1) % 3) = u;
+        d((axis + 2) % 3) = v;
+        return d.normalized();
+    }
+
+    int MapPlaneIndex::ComputeBin(const Eigen::Vector3f &normal) {
+        int axis = 0;
+        for (int i = 1; i < 3; i++)
+            if (fabs(normal(i)) > fabs(normal(axis)))
+                axis = i;
+
+        const float major = fabs(normal(axis));
+        const int face = 2 * axis + (normal(axis) < 0 ? 1 : 0);
+        if (major == 0)
+            return 0;
+
+        const float u = normal((axis + 1) % 3) / major;
+        const float v = normal((axis + 2) % 3) / major;
+        const int iu = max(0, min(NUM_CELLS - 1, static_cast<int>((u + 1.0f) * 0.5f * NUM_CELLS)));
+        const int iv = max(0, min(NUM_CELLS - 1, static_cast<int>((v + 1.0f) * 0.5f * NUM_CELLS)));
+
+        return (face * NUM_CELLS + iu) * NUM_CELLS + iv;
+    }
+
+    void MapPlaneIndex::Insert(MapPlane *pMP) {
+        if (mBinOfPlane.count(pMP))
+            return;
+
+        const cv::Mat pW = pMP->GetWorldPos();
+        Entry entry;
+        entry.pMP = pMP;
+        entry.normal = Eigen::Vector3f(pW.at<float>(0), pW.at<float>(1), pW.at<float>(2));
+
+        const int bin = ComputeBin(entry.normal);
+        mvBins[bin].push_back(entry);
+        mBinOfPlane[pMP] = bin;
+    }
+
+    void MapPlaneIndex::Erase(MapPlane *pMP) {
+        auto it = mBinOfPlane.find(pMP);
+        if (it == mBinOfPlane.end())
+            return;
+
+        vector<Entry> &vEntries = mvBins[it->second];
+        for (size_t i = 0; i < vEntries.size(); i++) {
+            if (vEntries[i].pMP == pMP) {
+                vEntries[i] = vEntries.back();
+                vEntries.pop_back();
+                break;
+            }
+        }
+        mBinOfPlane.erase(it);
+    }
+
+    void MapPlaneIndex::clear() {
+        for (auto &vEntries : mvBins)
+            vEntries.clear();
+        mBinOfPlane.clear();
+    }
+
+    void MapPlaneIndex::Search(const Eigen::Vector3f &normal, float minCos, float maxCos,
+                               vector<MapPlane *> &vpMapPlanes) const {
+        const float norm = normal.norm();
+        if (norm == 0)
+            return;
+
+        // Cell selection works on unit directions
+        const Eigen::Vector3f direction = normal / norm;
+        const float minUnitCos = minCos / norm;
+        const float maxUnitCos = maxCos / norm;
+
+        for (int bin = 0; bin < NUM_BINS; bin++) {
+            if (mvBins[bin].empty())
+                continue;
+
+            const float angle = acos(max(-1.0f, min(1.0f, direction.dot(mvBinCenters[bin]))));
+            const float cosFar = cos(min(static_cast<float>(M_PI), angle + mvBinRadius[bin]));
+            const float cosNear = cos(max(0.0f, angle - mvBinRadius[bin]));
+            if (cosNear <= minUnitCos || cosFar >= maxUnitCos)
+                continue;
+
+            for (const Entry &entry : mvBins[bin]) {
+                const float c = normal.dot(entry.normal);
+                if (c > minCos && c < maxCos)
+                    vpMapPlanes.push_back(entry.pMP);
+            }
+        }
+    }
+
+} //namespace ORB_SLAM
@@ -20,8 +20,10 @@
 
 #include "MapPoint.h"
 #include "ORBmatcher.h"
+#include "HammingDistance.h"
 
 #include<mutex>
+#include<cstring>
 
 using namespace std;
 using namespace cv;
@@ -35,7 +37,7 @@ namespace ORB_SLAM2 {
 
     MapPoint::MapPoint(const cv::Mat &Pos, KeyFrame *pRefKF, Map *pMap) :
             mnFirstKFid(pRefKF->mnId), nObs(0), mnTrackReferenceForFrame(0),
-            mnLastFrameSeen(0), mnFuseCandidateForKF(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
+            mnLastFrameSeen(0), mnBALocalForKF(0), mnFuseCandidateForKF(0), mpRefKF(pRefKF), mnVisible(1), mnFound(1), mbBad(false),
             mpReplaced(static_cast<MapPoint *>(NULL)), mfMinDistance(0), mfMaxDistance(0), mpMap(pMap) {
         Pos.copyTo(mWorldPos);
         mNormalVector = cv::Mat::zeros(3, 1, CV_32F);
@@ -47,7 +49,7 @@ namespace ORB_SLAM2 {
 
     MapPoint::MapPoint(const cv::Mat &Pos, Map *pMap, Frame *pFrame, const int &idxF) :
             mnFirstKFid(-1), nObs(0), mnTrackReferenceForFrame(0), mnLastFrameSeen(0),
-            mnFuseCandidateForKF(0), mpRefKF(static_cast<KeyFrame *>(NULL)), mnVisible(1),
+            mnBALocalForKF(0), mnFuseCandidateForKF(0), mpRefKF(static_cast<KeyFrame *>(NULL)), mnVisible(1),
             mnFound(1), mbBad(false), mpReplaced(NULL), mpMap(pMap) {
         Pos.copyTo(mWorldPos);
         cv::Mat Ow = pFrame->GetCameraCenter();
@@ -70,6 +72,12 @@ namespace ORB_SLAM2 {
         mnId = nNextId++;
     }
 
+    void MapPoint::SetWorldPos(const cv::Mat &Pos) {
+        unique_lock<mutex> lock2(mGlobalMutex);
+        unique_lock<mutex> lock(mMutexPos);
+        Pos.copyTo(mWorldPos);
+    }
+
     cv::Mat MapPoint::GetWorldPos() {
         unique_lock<mutex> lock(mMutexPos);
         return mWorldPos.clone();
@@ -80,6 +88,16 @@ namespace ORB_SLAM2 {
         return mNormalVector.clone();
     }
 
+    Eigen::Vector3f MapPoint::GetWorldPosEigen() {
+        unique_lock<mutex> lock(mMutexPos);
+        return Eigen::Vector3f(mWorldPos.at<float>(0), mWorldPos.at<float>(1), mWorldPos.at<float>(2));
+    }
+
+    Eigen::Vector3f MapPoint::GetNormalEigen() {
+        unique_lock<mutex> lock(mMutexPos);
+        return Eigen::Vector3f(mNormalVector.at<float>(0), mNormalVector.at<float>(1), mNormalVector.at<float>(2));
+    }
+
     void MapPoint::AddObservation(KeyFrame *pKF, size_t idx) {
         unique_lock<mutex> lock(mMutexFeatures);
         if (mObservations.count(pKF))
@@ -236,14 +254,21 @@ namespace ORB_SLAM2 {
         if (vDescriptors.empty())
             return;
 
-        // Compute distances between them
+        // Compute distances between them, each descriptor against the following ones stored contiguously
         const size_t N = vDescriptors.size();
 
+        cv::Mat descriptors;
+        cv::vconcat(vDescriptors, descriptors);
+        vector<int> vDistij(N);
+
         float Distances[N][N];
         for (size_t i = 0; i < N; i++) {
             Distances[i][i] = 0;
+            const uint8_t *pDesc = descriptors.ptr<uint8_t>(i);
+            HammingDistance::DistanceToMany(pDesc, pDesc + descriptors.step[0], descriptors.step[0], N - i - 1,
+                                            vDistij.data());
             for (size_t j = i + 1; j < N; j++) {
-                int distij = ORBmatcher::DescriptorDistance(vDescriptors[i], vDescriptors[j]);
+                int distij = vDistij[j - i - 1];
                 Distances[i][j] = distij;
                 Distances[j][i] = distij;
             }
@@ -331,6 +356,24 @@ namespace ORB_SLAM2 {
         return 1.2f * mfMaxDistance;
     }
 
+    bool MapPoint::CopyTrackingData(float *pPos, float *pNormal, float &minDistance, float &maxDistance,
+                                    uchar *pDescriptor) {
+        unique_lock<mutex> lock(mMutexFeatures);
+        unique_lock<mutex> lock2(mMutexPos);
+        if (mbBad || mDescriptor.empty())
+            return false;
+
+        for (int i = 0; i < 3; i++) {
+            pPos[i] = mWorldPos.at<float>(i);
+            pNormal[i] = mNormalVector.at<float>(i);
+        }
+        minDistance = mfMinDistance;
+        maxDistance = mfMaxDistance;
+        memcpy(pDescriptor, mDescriptor.ptr<uchar>(), HammingDistance::DESCRIPTOR_BYTES);
+
+        return true;
+    }
+
     int MapPoint::PredictScale(const float &currentDist, KeyFrame *pKF) {
         float ratio;
         {
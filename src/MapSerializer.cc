@@ -0,0 +1,1362 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "MapSerializer.h"
+
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+#include <map>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "KeyFrame.h"
+#include "MapPoint.h"
+#include "MapLine.h"
+#include "MapPlane.h"
+
+using namespace std;
+using namespace cv::line_descriptor;
+
+namespace ORB_SLAM2 {
+
+    const uint32_t MapSerializer::VERSION = 4;
+
+    const uint32_t MappedKeyFrame::NO_LANDMARK = ~uint32_t(0);
+
+    namespace {
+
+        const char MAGIC[8] = {'M', 'S', 'L', 'A', 'M', 'M', 'A', 'P'};
+
+        // Index written for a missing keyframe or landmark
+        const uint32_t NO_INDEX = MappedKeyFrame::NO_LANDMARK;
+
+        // Bulk arrays start at offsets multiple of this, so that they can be used in place once mapped
+        const size_t ALIGNMENT = 16;
+
+        typedef pcl::PointCloud<pcl::PointXYZRGB> PointCloud;
+
+        // Read-only view of a file mapped in memory. The mapping is private, so matrices pointing into it can be
+        // modified without touching the file.
+        class MappedReader {
+        public:
+            MappedReader(const char *pBegin, size_t size) : mpBegin(pBegin), mpPos(pBegin), mpEnd(pBegin + size),
+                                                            mbOK(true) {}
+
+            // Next n bytes, or NULL past the end of the file
+            const char *Take(size_t n) {
+                if (!mbOK || n > size_t(mpEnd - mpPos)) {
+                    mbOK = false;
+                    return static_cast<const char *>(nullptr);
+                }
+                const char *p = mpPos;
+                mpPos += n;
+                return p;
+            }
+
+            // Move to an offset from the beginning of the file
+            bool Seek(size_t offset) {
+                if (offset > size_t(mpEnd - mpBegin))
+                    mbOK = false;
+                else
+                    mpPos = mpBegin + offset;
+                return mbOK;
+            }
+
+            void Align() {
+                size_t offset = (mpPos - mpBegin) % ALIGNMENT;
+                if (offset)
+                    Take(ALIGNMENT - offset);
+            }
+
+            size_t Remaining() const {
+                return mpEnd - mpPos;
+            }
+
+            bool Good() const {
+                return mbOK;
+            }
+
+            void Fail() {
+                mbOK = false;
+            }
+
+        protected:
+            const char *mpBegin;
+            const char *mpPos;
+            const char *mpEnd;
+            bool mbOK;
+        };
+
+        template<class T>
+        void Write(ostream &os, const T &value) {
+            os.write(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        template<class T>
+        bool Read(MappedReader &is, T &value) {
+            const char *p = is.Take(sizeof(T));
+            if (p)
+                memcpy(reinterpret_cast<char *>(&value), p, sizeof(T));
+            return p != nullptr;
+        }
+
+        void Align(ostream &os) {
+            static const char padding[ALIGNMENT] = {0};
+            size_t offset = size_t(os.tellp()) % ALIGNMENT;
+            if (offset)
+                os.write(padding, ALIGNMENT - offset);
+        }
+
+        // Element count of an array of elemSize bytes, rejected if the rest of the file is too short to hold it
+        bool ReadCount(MappedReader &is, uint64_t &n, size_t elemSize = 1) {
+            if (!Read(is, n))
+                return false;
+            if (n > is.Remaining() / max<size_t>(elemSize, 1)) {
+                is.Fail();
+                return false;
+            }
+            return true;
+        }
+
+        template<class T>
+        void WriteVector(ostream &os, const vector<T> &v) {
+            Write(os, uint64_t(v.size()));
+            Align(os);
+            if (!v.empty())
+                os.write(reinterpret_cast<const char *>(v.data()), v.size() * sizeof(T));
+        }
+
+        template<class T>
+        bool ReadVector(MappedReader &is, vector<T> &v) {
+            uint64_t n;
+            if (!ReadCount(is, n, sizeof(T)))
+                return false;
+            is.Align();
+            const char *p = is.Take(n * sizeof(T));
+            if (!p)
+                return false;
+            v.resize(n);
+            if (n)
+                memcpy(reinterpret_cast<char *>(v.data()), p, n * sizeof(T));
+            return true;
+        }
+
+        // The array is used in place, it must have been written by WriteVector
+        template<class T>
+        bool ReadArray(MappedReader &is, const T *&p, uint64_t &n) {
+            if (!ReadCount(is, n, sizeof(T)))
+                return false;
+            is.Align();
+            p = reinterpret_cast<const T *>(is.Take(n * sizeof(T)));
+            return p != nullptr;
+        }
+
+        // Continuous single-channel matrices of 8-bit or 32-bit elements (descriptors, poses, plane coefficients)
+        void WriteMat(ostream &os, const cv::Mat &m) {
+            const cv::Mat c = m.isContinuous() ? m : m.clone();
+            Write(os, int32_t(c.rows));
+            Write(os, int32_t(c.cols));
+            Write(os, int32_t(c.type()));
+            Align(os);
+            os.write(reinterpret_cast<const char *>(c.data), c.total() * c.elemSize());
+        }
+
+        // The matrix points into the mapped file, no data is copied
+        bool ReadMat(MappedReader &is, cv::Mat &m) {
+            int32_t rows, cols, type;
+            if (!Read(is, rows) || !Read(is, cols) || !Read(is, type) || rows < 0 || cols < 0 ||
+                CV_MAT_CN(type) != 1) {
+                is.Fail();
+                return false;
+            }
+            is.Align();
+
+            const size_t nBytes = size_t(rows) * cols * CV_ELEM_SIZE(type);
+            const char *p = is.Take(nBytes);
+            if (!p)
+                return false;
+
+            if (nBytes == 0)
+                m = cv::Mat(rows, cols, type);
+            else
+                m = cv::Mat(rows, cols, type, const_cast<char *>(p));
+            return true;
+        }
+
+        void WriteKeyPoints(ostream &os, const vector<cv::KeyPoint> &vKeys) {
+            Write(os, uint64_t(vKeys.size()));
+            for (const cv::KeyPoint &kp : vKeys) {
+                Write(os, kp.pt.x);
+                Write(os, kp.pt.y);
+                Write(os, kp.size);
+                Write(os, kp.angle);
+                Write(os, kp.response);
+                Write(os, int32_t(kp.octave));
+                Write(os, int32_t(kp.class_id));
+            }
+        }
+
+        bool ReadKeyPoints(MappedReader &is, vector<cv::KeyPoint> &vKeys) {
+            uint64_t n;
+            if (!ReadCount(is, n, 7 * 4))
+                return false;
+            vKeys.resize(n);
+            for (cv::KeyPoint &kp : vKeys) {
+                int32_t octave, classId;
+                Read(is, kp.pt.x);
+                Read(is, kp.pt.y);
+                Read(is, kp.size);
+                Read(is, kp.angle);
+                Read(is, kp.response);
+                Read(is, octave);
+                Read(is, classId);
+                kp.octave = octave;
+                kp.class_id = classId;
+            }
+            return is.Good();
+        }
+
+        void WriteKeyLines(ostream &os, const vector<KeyLine> &vKeyLines) {
+            Write(os, uint64_t(vKeyLines.size()));
+            for (const KeyLine &kl : vKeyLines) {
+                Write(os, kl.angle);
+                Write(os, int32_t(kl.class_id));
+                Write(os, int32_t(kl.octave));
+                Write(os, kl.pt.x);
+                Write(os, kl.pt.y);
+                Write(os, kl.response);
+                Write(os, kl.size);
+                Write(os, kl.startPointX);
+                Write(os, kl.startPointY);
+                Write(os, kl.endPointX);
+                Write(os, kl.endPointY);
+                Write(os, kl.sPointInOctaveX);
+                Write(os, kl.sPointInOctaveY);
+                Write(os, kl.ePointInOctaveX);
+                Write(os, kl.ePointInOctaveY);
+                Write(os, kl.lineLength);
+                Write(os, int32_t(kl.numOfPixels));
+            }
+        }
+
+        bool ReadKeyLines(MappedReader &is, vector<KeyLine> &vKeyLines) {
+            uint64_t n;
+            if (!ReadCount(is, n, 17 * 4))
+                return false;
+            vKeyLines.resize(n);
+            for (KeyLine &kl : vKeyLines) {
+                int32_t classId, octave, numOfPixels;
+                Read(is, kl.angle);
+                Read(is, classId);
+                Read(is, octave);
+                Read(is, kl.pt.x);
+                Read(is, kl.pt.y);
+                Read(is, kl.response);
+                Read(is, kl.size);
+                Read(is, kl.startPointX);
+                Read(is, kl.startPointY);
+                Read(is, kl.endPointX);
+                Read(is, kl.endPointY);
+                Read(is, kl.sPointInOctaveX);
+                Read(is, kl.sPointInOctaveY);
+                Read(is, kl.ePointInOctaveX);
+                Read(is, kl.ePointInOctaveY);
+                Read(is, kl.lineLength);
+                Read(is, numOfPixels);
+                kl.class_id = classId;
+                kl.octave = octave;
+                kl.numOfPixels = numOfPixels;
+            }
+            return is.Good();
+        }
+
+        // Points as (x, y, z, rgba) records of 16 bytes
+        void WriteCloud(ostream &os, const PointCloud &cloud) {
+            Write(os, uint64_t(cloud.size()));
+            Align(os);
+            for (const pcl::PointXYZRGB &p : cloud.points) {
+                Write(os, p.x);
+                Write(os, p.y);
+                Write(os, p.z);
+                Write(os, uint32_t(p.rgba));
+            }
+        }
+
+        bool ReadCloud(MappedReader &is, PointCloud &cloud) {
+            uint64_t n;
+            if (!ReadCount(is, n, 16))
+                return false;
+            is.Align();
+            const char *p = is.Take(n * 16);
+            if (!p)
+                return false;
+
+            cloud.resize(n);
+            for (uint64_t i = 0; i < n; i++, p += 16) {
+                pcl::PointXYZRGB &point = cloud.points[i];
+                uint32_t rgba;
+                memcpy(&point.x, p, sizeof(float));
+                memcpy(&point.y, p + 4, sizeof(float));
+                memcpy(&point.z, p + 8, sizeof(float));
+                memcpy(&rgba, p + 12, sizeof(uint32_t));
+                point.rgba = rgba;
+            }
+            return true;
+        }
+
+        template<class T>
+        uint32_t IndexOf(T *p, const unordered_map<T *, uint32_t> &indices) {
+            auto it = indices.find(p);
+            return it == indices.end() ? NO_INDEX : it->second;
+        }
+
+        template<class T>
+        vector<uint32_t> IndicesOf(const vector<T *> &vp, const unordered_map<T *, uint32_t> &indices) {
+            vector<uint32_t> vIndices(vp.size());
+            for (size_t i = 0; i < vp.size(); i++)
+                vIndices[i] = IndexOf(vp[i], indices);
+            return vIndices;
+        }
+
+        // Covisibility weight of a keyframe, by its index
+        struct IndexAndWeight {
+            uint32_t index;
+            uint32_t weight;
+        };
+
+        // Range [begin[i], begin[i + 1]) of an array of n elements. False if the stored bounds do not fit.
+        bool GetRange(const uint64_t *pBegin, size_t i, uint64_t n, uint64_t &begin, uint64_t &end) {
+            begin = pBegin[i];
+            end = pBegin[i + 1];
+            return begin <= end && end <= n;
+        }
+
+        // Calibration statics of Frame, which the KeyFrame constructor reads
+        struct FrameCalibration {
+            float fx, fy, cx, cy, invfx, invfy;
+            float minX, minY, maxX, maxY;
+            float gridElementWidthInv, gridElementHeightInv;
+
+            static FrameCalibration Current() {
+                return {Frame::fx, Frame::fy, Frame::cx, Frame::cy, Frame::invfx, Frame::invfy, Frame::mnMinX,
+                        Frame::mnMinY, Frame::mnMaxX, Frame::mnMaxY, Frame::mfGridElementWidthInv,
+                        Frame::mfGridElementHeightInv};
+            }
+
+            void Apply() const {
+                Frame::fx = fx;
+                Frame::fy = fy;
+                Frame::cx = cx;
+                Frame::cy = cy;
+                Frame::invfx = invfx;
+                Frame::invfy = invfy;
+                Frame::mnMinX = minX;
+                Frame::mnMinY = minY;
+                Frame::mnMaxX = maxX;
+                Frame::mnMaxY = maxY;
+                Frame::mfGridElementWidthInv = gridElementWidthInv;
+                Frame::mfGridElementHeightInv = gridElementHeightInv;
+            }
+        };
+
+        // Gives the keyframes built while it exists the calibration of the map, and puts back the previous one
+        // afterwards. Only used before the first frame, when the statics are not set yet.
+        class ScopedFrameCalibration {
+        public:
+            explicit ScopedFrameCalibration(const FrameCalibration &calibration)
+                    : mPrevious(FrameCalibration::Current()) {
+                calibration.Apply();
+            }
+
+            ~ScopedFrameCalibration() {
+                mPrevious.Apply();
+            }
+
+        protected:
+            const FrameCalibration mPrevious;
+        };
+
+        bool SameValue(float a, float b) {
+            return fabs(a - b) <= 1e-4f * max(1.f, fabs(b));
+        }
+
+        // Map the whole file privately. The returned pointer unmaps it when released. Pages are only read when
+        // relocalization touches them.
+        shared_ptr<void> MapFile(const string &filename, size_t &size) {
+            int fd = open(filename.c_str(), O_RDONLY);
+            if (fd < 0)
+                return shared_ptr<void>();
+
+            struct stat st;
+            if (fstat(fd, &st) != 0 || st.st_size == 0) {
+                close(fd);
+                return shared_ptr<void>();
+            }
+
+            size = st.st_size;
+            void *pData = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            close(fd);
+            if (pData == MAP_FAILED)
+                return shared_ptr<void>();
+
+            return shared_ptr<void>(pData, [size](void *p) { munmap(p, size); });
+        }
+
+    }
+
+    MappedMap::MappedMap(Map *pMap, KeyFrameDatabase *pKFDB, ORBVocabulary *pVoc) : mpMap(pMap),
+                                                                                     mpKeyFrameDB(pKFDB),
+                                                                                     mpVocabulary(pVoc),
+                                                                                     mpData(nullptr), mnSize(0) {
+    }
+
+    size_t MappedMap::NumKeyFrames() const {
+        return mnKeyFrames;
+    }
+
+    void MappedMap::GetKeyFramesWithWord(DBoW2::WordId wordId, const uint32_t *&pBegin, const uint32_t *&pEnd) const {
+        pBegin = pEnd = mpInvertedKeyFrames;
+
+        const uint32_t *pWord = lower_bound(mpInvertedWords, mpInvertedWords + mnInvertedWords, uint32_t(wordId));
+        uint64_t begin, end;
+        if (pWord == mpInvertedWords + mnInvertedWords || *pWord != wordId ||
+            !GetRange(mpInvertedBegin, pWord - mpInvertedWords, mpInvertedBegin[mnInvertedWords], begin, end))
+            return;
+
+        pBegin = mpInvertedKeyFrames + begin;
+        pEnd = mpInvertedKeyFrames + end;
+    }
+
+    float MappedMap::Score(const DBoW2::BowVector &bowVec, size_t idx) const {
+        uint64_t begin, end;
+        if (!GetRange(mpBowBegin, idx, mpBowBegin[mnKeyFrames], begin, end))
+            return 0;
+
+        if (mpVocabulary->getScoringType() != DBoW2::L1_NORM) {
+            DBoW2::BowVector bowVecKF;
+            for (uint64_t i = begin; i < end; i++)
+                bowVecKF.insert(bowVecKF.end(), make_pair(DBoW2::WordId(mpBowWords[i]), mpBowValues[i]));
+            return mpVocabulary->score(bowVec, bowVecKF);
+        }
+
+        // L1 score of DBoW2, computed over the stored words
+        double score = 0;
+        DBoW2::BowVector::const_iterator vit = bowVec.begin();
+        uint64_t i = begin;
+        while (vit != bowVec.end() && i < end) {
+            if (vit->first == mpBowWords[i]) {
+                const double vi = vit->second;
+                const double wi = mpBowValues[i];
+                score += fabs(vi - wi) - fabs(vi) - fabs(wi);
+                vit++;
+                i++;
+            } else if (vit->first < mpBowWords[i]) {
+                vit = bowVec.lower_bound(mpBowWords[i]);
+            } else {
+                i = lower_bound(mpBowWords + i, mpBowWords + end, uint32_t(vit->first)) - mpBowWords;
+            }
+        }
+        return -score / 2.0;
+    }
+
+    void MappedMap::GetBestCovisibles(size_t idx, const uint32_t *&pBegin, const uint32_t *&pEnd) const {
+        uint64_t begin, end;
+        if (!GetRange(mpCovisiblesBegin, idx, mpCovisiblesBegin[mnKeyFrames], begin, end))
+            begin = end = 0;
+        pBegin = mpCovisibles + begin;
+        pEnd = mpCovisibles + end;
+    }
+
+    MappedKeyFrame MappedMap::GetMappedKeyFrame(size_t idx) const {
+        MappedKeyFrame KF;
+        KF.nNodes = 0;
+        KF.N = 0;
+        KF.descriptorStep = mnDescriptorBytes;
+
+        uint64_t nodeBegin, nodeEnd, featBegin, featEnd;
+        if (idx >= mnKeyFrames || !GetRange(mpNodesBegin, idx, mnNodes, nodeBegin, nodeEnd) ||
+            !GetRange(mpFeaturesBegin, idx, mnFeatures, featBegin, featEnd))
+            return KF;
+
+        // The matcher indexes the features of the keyframe with the stored values
+        const uint64_t N = featEnd - featBegin;
+        for (uint64_t n = nodeBegin; n < nodeEnd; n++) {
+            uint64_t begin, end;
+            if (!GetRange(mpNodeFeaturesBegin, n, mnNodeFeatures, begin, end))
+                return KF;
+            for (uint64_t f = begin; f < end; f++)
+                if (mpNodeFeatures[f] >= N)
+                    return KF;
+        }
+
+        KF.nNodes = nodeEnd - nodeBegin;
+        KF.pNodes = mpNodes + nodeBegin;
+        KF.pNodeBegin = mpNodeFeaturesBegin + nodeBegin;
+        KF.pFeatures = mpNodeFeatures;
+        KF.N = N;
+        KF.pAngles = mpAngles + featBegin;
+        KF.pMapPoints = mpFeatureMapPoints + featBegin;
+        KF.pDescriptors = mpDescriptors + featBegin * mnDescriptorBytes;
+        return KF;
+    }
+
+    bool MappedMap::IsBad(size_t idx) {
+        unique_lock<mutex> lock(mMutex);
+        auto it = mmKeyFrames.find(idx);
+        return it != mmKeyFrames.end() && (!it->second || it->second->isBad());
+    }
+
+    KeyFrame *MappedMap::GetKeyFrame(size_t idx) {
+        unique_lock<mutex> lock(mMutex);
+        return idx < mnKeyFrames ? Build(idx) : static_cast<KeyFrame *>(nullptr);
+    }
+
+    void MappedMap::BuildAll() {
+        unique_lock<mutex> lock(mMutex);
+        for (uint64_t k = 0; k < mnKeyFrames; k++)
+            Build(k);
+    }
+
+    KeyFrame *MappedMap::GetBuiltKeyFrame(uint32_t idx) {
+        auto it = mmKeyFrames.find(idx);
+        if (it == mmKeyFrames.end() || !it->second || it->second->isBad())
+            return static_cast<KeyFrame *>(nullptr);
+        return it->second;
+    }
+
+    KeyFrame *MappedMap::Build(uint32_t idx) {
+        auto it = mmKeyFrames.find(idx);
+        if (it != mmKeyFrames.end())
+            return it->second;
+        // A corrupted record stays NULL
+        mmKeyFrames[idx] = static_cast<KeyFrame *>(nullptr);
+
+        // Before the first frame the statics of Frame are not set, the keyframe takes the calibration of the map.
+        // Afterwards the running calibration, already checked against the map, must also have its image bounds.
+        const FrameCalibration calibration = {fx, fy, cx, cy, 1.0f / fx, 1.0f / fy, mnMinX, mnMinY, mnMaxX, mnMaxY,
+                                              mfGridElementWidthInv, mfGridElementHeightInv};
+        unique_ptr<ScopedFrameCalibration> pScopedCalibration;
+        if (Frame::mbInitialComputations) {
+            pScopedCalibration.reset(new ScopedFrameCalibration(calibration));
+        } else if (!SameValue(mnMinX, Frame::mnMinX) || !SameValue(mnMinY, Frame::mnMinY) ||
+                   !SameValue(mnMaxX, Frame::mnMaxX) || !SameValue(mnMaxY, Frame::mnMaxY)) {
+            cerr << "The map was built with another image size than the one of the camera" << endl;
+            return static_cast<KeyFrame *>(nullptr);
+        }
+
+        // Keyframes are built from a Frame holding the stored data, so that they are initialized exactly like the
+        // keyframes created by the tracking
+        Frame F;
+        F.mpORBvocabulary = mpVocabulary;
+        F.mbf = mbf;
+        F.mb = mb;
+        F.mThDepth = mThDepth;
+        F.mK = mK;
+        F.mnScaleLevels = mnScaleLevels;
+        F.mfScaleFactor = mfScaleFactor;
+        F.mfLogScaleFactor = mfLogScaleFactor;
+        F.mvScaleFactors = mvScaleFactors;
+        F.mvLevelSigma2 = mvLevelSigma2;
+        F.mvInvLevelSigma2 = mvInvLevelSigma2;
+        F.mvInvScaleFactors.resize(mvScaleFactors.size());
+        for (size_t i = 0; i < mvScaleFactors.size(); i++)
+            F.mvInvScaleFactors[i] = 1.0f / mvScaleFactors[i];
+
+        MappedReader is(mpData, mnSize);
+        is.Seek(mpKeyFrameOffsets[idx]);
+
+        uint64_t id;
+        Read(is, id);
+        Read(is, F.mTimeStamp);
+        ReadMat(is, F.mTcw);
+
+        ReadKeyPoints(is, F.mvKeys);
+        ReadKeyPoints(is, F.mvKeysUn);
+        ReadVector(is, F.mvuRight);
+        ReadVector(is, F.mvDepth);
+
+        vector<uint32_t> vLineIndices;
+        ReadKeyLines(is, F.mvKeylinesUn);
+        ReadMat(is, F.mLdesc);
+        ReadVector(is, F.mvKeyLineFunctions);
+        ReadVector(is, vLineIndices);
+
+        uint64_t nPlanes;
+        vector<uint32_t> vPlaneIndices, vParallelIndices, vVerticalIndices;
+        bool bOK = ReadCount(is, nPlanes);
+        F.mvPlaneCoefficients.resize(bOK ? nPlanes : 0);
+        F.mvPlanePoints.resize(F.mvPlaneCoefficients.size());
+        vPlaneIndices.resize(F.mvPlaneCoefficients.size());
+        vParallelIndices.resize(F.mvPlaneCoefficients.size());
+        vVerticalIndices.resize(F.mvPlaneCoefficients.size());
+        for (size_t i = 0; i < F.mvPlaneCoefficients.size(); i++) {
+            ReadMat(is, F.mvPlaneCoefficients[i]);
+            ReadCloud(is, F.mvPlanePoints[i]);
+            Read(is, vPlaneIndices[i]);
+            Read(is, vParallelIndices[i]);
+            Read(is, vVerticalIndices[i]);
+        }
+
+        uint32_t parentIdx;
+        uint8_t bNotErase;
+        vector<IndexAndWeight> vConnections;
+        Read(is, parentIdx);
+        Read(is, bNotErase);
+
+        uint64_t featBegin, featEnd, bowBegin, bowEnd, nodeBegin, nodeEnd;
+        bOK = ReadVector(is, vConnections) && GetRange(mpFeaturesBegin, idx, mnFeatures, featBegin, featEnd) &&
+              GetRange(mpBowBegin, idx, mpBowBegin[mnKeyFrames], bowBegin, bowEnd) &&
+              GetRange(mpNodesBegin, idx, mnNodes, nodeBegin, nodeEnd) && featEnd - featBegin == F.mvKeys.size() &&
+              F.mvKeysUn.size() == F.mvKeys.size() && F.mvuRight.size() == F.mvKeys.size() &&
+              F.mvDepth.size() == F.mvKeys.size() && F.mvKeyLineFunctions.size() == F.mvKeylinesUn.size() &&
+              vLineIndices.size() == F.mvKeylinesUn.size();
+
+        // Descriptors, bag of words and feature vector of this keyframe only. Words and nodes are stored sorted,
+        // each one is inserted at the end of the map in constant time.
+        if (bOK) {
+            F.mDescriptors = cv::Mat(int(F.mvKeys.size()), int(mnDescriptorBytes), CV_8U,
+                                     const_cast<uint8_t *>(mpDescriptors + featBegin * mnDescriptorBytes));
+
+            for (uint64_t i = bowBegin; i < bowEnd; i++)
+                F.mBowVec.insert(F.mBowVec.end(), make_pair(DBoW2::WordId(mpBowWords[i]),
+                                                            DBoW2::WordValue(mpBowValues[i])));
+
+            for (uint64_t n = nodeBegin; bOK && n < nodeEnd; n++) {
+                uint64_t begin, end;
+                bOK = GetRange(mpNodeFeaturesBegin, n, mnNodeFeatures, begin, end);
+                vector<unsigned int> &vFeatures = F.mFeatVec.insert(
+                        F.mFeatVec.end(), make_pair(DBoW2::NodeId(mpNodes[n]), vector<unsigned int>()))->second;
+                for (uint64_t f = begin; bOK && f < end; f++) {
+                    bOK = mpNodeFeatures[f] < F.mvKeys.size();
+                    vFeatures.push_back(mpNodeFeatures[f]);
+                }
+            }
+        }
+
+        if (!bOK) {
+            cerr << "Corrupted keyframe " << idx << " in the map file" << endl;
+            return static_cast<KeyFrame *>(nullptr);
+        }
+
+        F.N = F.mvKeys.size();
+        F.NL = F.mvKeylinesUn.size();
+        F.mnPlaneNum = F.mvPlaneCoefficients.size();
+        F.mvpMapPoints.assign(F.N, static_cast<MapPoint *>(nullptr));
+        F.mvpMapLines.assign(F.NL, static_cast<MapLine *>(nullptr));
+        F.mvpMapPlanes.assign(F.mnPlaneNum, static_cast<MapPlane *>(nullptr));
+        F.mvpParallelPlanes.assign(F.mnPlaneNum, static_cast<MapPlane *>(nullptr));
+        F.mvpVerticalPlanes.assign(F.mnPlaneNum, static_cast<MapPlane *>(nullptr));
+
+        for (int i = 0; i < FRAME_GRID_COLS; i++)
+            for (int j = 0; j < FRAME_GRID_ROWS; j++)
+                F.mGrid[i][j].clear();
+        for (int i = 0; i < F.N; i++) {
+            int posX, posY;
+            if (F.PosInGrid(F.mvKeysUn[i], posX, posY))
+                F.mGrid[posX][posY].push_back(i);
+        }
+
+        KeyFrame *pKF = new KeyFrame(F, mpMap, mpKeyFrameDB);
+        pKF->mnId = id;
+        mpMap->AddKeyFrame(pKF);
+
+        // Landmarks seen by the keyframe. Those already built are seen by the built keyframes observing them, the
+        // others by none of them: the keyframes observing a landmark build it.
+        for (int i = 0; i < F.N; i++) {
+            const uint32_t mpIdx = mpFeatureMapPoints[featBegin + i];
+            MapPoint *pMP = mpIdx == NO_INDEX ? static_cast<MapPoint *>(nullptr) : BuildMapPoint(mpIdx, pKF);
+            if (!pMP || pMP->isBad())
+                continue;
+            pKF->AddMapPoint(pMP, i);
+            pMP->AddObservation(pKF, i);
+        }
+
+        for (int i = 0; i < F.NL; i++) {
+            MapLine *pML = vLineIndices[i] == NO_INDEX ? static_cast<MapLine *>(nullptr) :
+                           BuildMapLine(vLineIndices[i], pKF);
+            if (!pML || pML->isBad())
+                continue;
+            pKF->AddMapLine(pML, i);
+            pML->AddObservation(pKF, i);
+        }
+
+        for (int i = 0; i < F.mnPlaneNum; i++) {
+            MapPlane *pMP = vPlaneIndices[i] == NO_INDEX ? static_cast<MapPlane *>(nullptr) :
+                            BuildMapPlane(vPlaneIndices[i], pKF);
+            if (!pMP || pMP->isBad())
+                continue;
+            pKF->AddMapPlane(pMP, i);
+            pMP->AddObservation(pKF, i);
+        }
+
+        // Links to planes not built yet are set when they are
+        for (int i = 0; i < F.mnPlaneNum; i++) {
+            for (bool bVertical : {false, true}) {
+                const uint32_t planeIdx = bVertical ? vVerticalIndices[i] : vParallelIndices[i];
+                if (planeIdx == NO_INDEX)
+                    continue;
+                auto itPlane = mmMapPlanes.find(planeIdx);
+                if (itPlane == mmMapPlanes.end())
+                    mmPendingPlaneLinks.insert(make_pair(planeIdx, make_tuple(pKF, i, bVertical)));
+                else if (bVertical)
+                    pKF->mvpVerticalPlanes[i] = itPlane->second;
+                else
+                    pKF->mvpParallelPlanes[i] = itPlane->second;
+            }
+        }
+
+        // Covisibility with the built keyframes, in both directions
+        for (const IndexAndWeight &connection : vConnections) {
+            if (KeyFrame *pConnected = GetBuiltKeyFrame(connection.index)) {
+                pKF->AddConnection(pConnected, int(connection.weight));
+                pConnected->AddConnection(pKF, int(connection.weight));
+            }
+        }
+
+        // Without its stored parent the keyframe hangs from its best built covisible. The first keyframe built has
+        // none, it gets a parent at its next connection update and is never erased before.
+        KeyFrame *pParent = GetBuiltKeyFrame(parentIdx);
+        if (!pParent) {
+            const vector<KeyFrame *> vpBest = pKF->GetBestCovisibilityKeyFrames(1);
+            if (!vpBest.empty())
+                pParent = vpBest.front();
+        }
+        if (pParent) {
+            pKF->ChangeParent(pParent);
+            pKF->mbFirstConnection = false;
+        }
+
+        if (bNotErase)
+            pKF->SetNotErase();
+
+        uint64_t frameBegin, frameEnd;
+        if (GetRange(mpFramesBegin, idx, mnFrames, frameBegin, frameEnd)) {
+            for (uint64_t f = frameBegin; f < frameEnd; f++) {
+                MapPlane *vpPlanes[3] = {nullptr, nullptr, nullptr};
+                for (int i = 0; i < 3; i++) {
+                    auto itPlane = mmMapPlanes.find(mpFramePlanes[3 * f + i]);
+                    if (itPlane != mmMapPlanes.end())
+                        vpPlanes[i] = itPlane->second;
+                }
+                if (!vpPlanes[0] || !vpPlanes[1])
+                    continue;
+                if (vpPlanes[2])
+                    mpMap->AddManhattanObservation(vpPlanes[0], vpPlanes[1], vpPlanes[2], pKF);
+                else if (mpFramePlanes[3 * f + 2] == NO_INDEX)
+                    mpMap->AddPartialManhattanObservation(vpPlanes[0], vpPlanes[1], pKF);
+            }
+        }
+
+        for (uint64_t i = 0; i < mnOrigins; i++)
+            if (mpOrigins[i] == idx)
+                mpMap->mvpKeyFrameOrigins.push_back(pKF);
+
+        mmKeyFrames[idx] = pKF;
+        return pKF;
+    }
+
+    MapPoint *MappedMap::BuildMapPoint(uint32_t idx, KeyFrame *pKF) {
+        MapPoint *&pMP = mmMapPoints[idx];
+        if (pMP || idx >= mnMapPoints)
+            return pMP;
+
+        MappedReader is(mpData, mnSize);
+        is.Seek(mpMapPointOffsets[idx]);
+
+        uint64_t id;
+        int64_t firstKFId;
+        uint32_t refKFIdx;
+        cv::Mat pos, normal, descriptor;
+        float minDistance, maxDistance;
+        int32_t nVisible, nFound;
+
+        Read(is, id);
+        Read(is, firstKFId);
+        Read(is, refKFIdx);
+        ReadMat(is, pos);
+        ReadMat(is, normal);
+        ReadMat(is, descriptor);
+        Read(is, minDistance);
+        Read(is, maxDistance);
+        Read(is, nVisible);
+        if (!Read(is, nFound))
+            return pMP;
+
+        KeyFrame *pRefKF = GetBuiltKeyFrame(refKFIdx);
+        pMP = new MapPoint(pos, pRefKF ? pRefKF : pKF, mpMap);
+        pMP->mnId = id;
+        pMP->mnFirstKFid = firstKFId;
+        pMP->mNormalVector = normal;
+        pMP->mDescriptor = descriptor;
+        pMP->mfMinDistance = minDistance;
+        pMP->mfMaxDistance = maxDistance;
+        pMP->mnVisible = nVisible;
+        pMP->mnFound = nFound;
+
+        mpMap->AddMapPoint(pMP);
+        return pMP;
+    }
+
+    MapLine *MappedMap::BuildMapLine(uint32_t idx, KeyFrame *pKF) {
+        MapLine *&pML = mmMapLines[idx];
+        if (pML || idx >= mnMapLines)
+            return pML;
+
+        MappedReader is(mpData, mnSize);
+        is.Seek(mpMapLineOffsets[idx]);
+
+        uint64_t id;
+        uint32_t refKFIdx;
+        Vector6d pos;
+        Eigen::Vector3d normal;
+        cv::Mat descriptor;
+        float minDistance, maxDistance;
+        int32_t nVisible, nFound;
+
+        Read(is, id);
+        Read(is, refKFIdx);
+        Read(is, pos);
+        Read(is, normal);
+        ReadMat(is, descriptor);
+        Read(is, minDistance);
+        Read(is, maxDistance);
+        Read(is, nVisible);
+        if (!Read(is, nFound))
+            return pML;
+
+        KeyFrame *pRefKF = GetBuiltKeyFrame(refKFIdx);
+        pML = new MapLine(pos, pRefKF ? pRefKF : pKF, mpMap);
+        pML->mnId = id;
+        pML->mStart3D = pos.head(3);
+        pML->mEnd3D = pos.tail(3);
+        pML->mNormalVector = normal;
+        pML->mLDescriptor = descriptor;
+        pML->mfMinDistance = minDistance;
+        pML->mfMaxDistance = maxDistance;
+        pML->mnVisible = nVisible;
+        pML->mnFound = nFound;
+
+        mpMap->AddMapLine(pML);
+        return pML;
+    }
+
+    MapPlane *MappedMap::BuildMapPlane(uint32_t idx, KeyFrame *pKF) {
+        MapPlane *&pMP = mmMapPlanes[idx];
+        if (pMP || idx >= mnMapPlanes)
+            return pMP;
+
+        MappedReader is(mpData, mnSize);
+        is.Seek(mpMapPlaneOffsets[idx]);
+
+        uint64_t id;
+        int64_t firstKFId;
+        uint32_t refKFIdx;
+        cv::Mat pos;
+        int32_t red, green, blue, nVisible, nFound;
+        PointCloud::Ptr points(new PointCloud());
+
+        Read(is, id);
+        Read(is, firstKFId);
+        Read(is, refKFIdx);
+        ReadMat(is, pos);
+        Read(is, red);
+        Read(is, green);
+        Read(is, blue);
+        Read(is, nVisible);
+        Read(is, nFound);
+        if (!ReadCloud(is, *points))
+            return pMP;
+
+        KeyFrame *pRefKF = GetBuiltKeyFrame(refKFIdx);
+        pMP = new MapPlane(pos, pRefKF ? pRefKF : pKF, mpMap);
+        pMP->mnId = id;
+        pMP->mnFirstKFid = firstKFId;
+        pMP->mRed = red;
+        pMP->mGreen = green;
+        pMP->mBlue = blue;
+        pMP->mnVisible = nVisible;
+        pMP->mnFound = nFound;
+        pMP->mvPlanePoints = points;
+        pMP->UpdateBoundingBox();
+
+        mpMap->AddMapPlane(pMP);
+
+        auto links = mmPendingPlaneLinks.equal_range(idx);
+        for (auto it = links.first; it != links.second; it++) {
+            KeyFrame *pLinkedKF = get<0>(it->second);
+            if (get<2>(it->second))
+                pLinkedKF->mvpVerticalPlanes[get<1>(it->second)] = pMP;
+            else
+                pLinkedKF->mvpParallelPlanes[get<1>(it->second)] = pMP;
+        }
+        mmPendingPlaneLinks.erase(links.first, links.second);
+
+        return pMP;
+    }
+
+    MapSerializer::MapSerializer(Map *pMap, KeyFrameDatabase *pKFDB, ORBVocabulary *pVoc) : mpMap(pMap),
+                                                                                          mpKeyFrameDB(pKFDB),
+                                                                                          mpVocabulary(pVoc) {
+    }
+
+    bool MapSerializer::Save(const string &filename) {
+        // The loaded map file may be the one being replaced, it stays mapped until then
+        const string tmpFilename = filename + ".tmp";
+        ofstream os(tmpFilename.c_str(), ios::binary);
+        if (!os.is_open()) {
+            cerr << "Failed to open map file for writing: " << tmpFilename << endl;
+            return false;
+        }
+
+        unique_lock<mutex> lock(mpMap->mMutexMapUpdate);
+
+        // Keyframes of a loaded map file that relocalization did not need are saved as well
+        if (shared_ptr<MappedMap> pMappedMap = mpKeyFrameDB->GetMappedMap())
+            pMappedMap->BuildAll();
+
+        vector<KeyFrame *> vpKFs;
+        for (KeyFrame *pKF : mpMap->GetAllKeyFrames())
+            if (!pKF->isBad())
+                vpKFs.push_back(pKF);
+        sort(vpKFs.begin(), vpKFs.end(), KeyFrame::lId);
+
+        if (vpKFs.empty()) {
+            cerr << "The map has no keyframes, nothing to save" << endl;
+            return false;
+        }
+
+        vector<MapPoint *> vpMPs;
+        for (MapPoint *pMP : mpMap->GetAllMapPoints())
+            if (!pMP->isBad())
+                vpMPs.push_back(pMP);
+
+        vector<MapLine *> vpMLs;
+        for (MapLine *pML : mpMap->GetAllMapLines())
+            if (!pML->isBad())
+                vpMLs.push_back(pML);
+
+        vector<MapPlane *> vpMPls;
+        for (MapPlane *pMP : mpMap->GetAllMapPlanes())
+            if (!pMP->isBad())
+                vpMPls.push_back(pMP);
+
+        // Elements refer to each other by their index in the file
+        unordered_map<KeyFrame *, uint32_t> kfIndices;
+        unordered_map<MapPoint *, uint32_t> mpIndices;
+        unordered_map<MapLine *, uint32_t> mlIndices;
+        unordered_map<MapPlane *, uint32_t> planeIndices;
+        for (size_t i = 0; i < vpKFs.size(); i++)
+            kfIndices[vpKFs[i]] = i;
+        for (size_t i = 0; i < vpMPs.size(); i++)
+            mpIndices[vpMPs[i]] = i;
+        for (size_t i = 0; i < vpMLs.size(); i++)
+            mlIndices[vpMLs[i]] = i;
+        for (size_t i = 0; i < vpMPls.size(); i++)
+            planeIndices[vpMPls[i]] = i;
+
+        os.write(MAGIC, sizeof(MAGIC));
+        Write(os, VERSION);
+
+        Write(os, uint64_t(Frame::nNextId));
+        Write(os, uint64_t(KeyFrame::nNextId));
+        Write(os, uint64_t(MapPoint::nNextId));
+        Write(os, uint64_t(MapLine::nNextId));
+        Write(os, uint64_t(MapPlane::nNextId));
+
+        // Calibration and scale pyramid, shared by all the keyframes
+        const KeyFrame *pKF0 = vpKFs.front();
+        Write(os, pKF0->fx);
+        Write(os, pKF0->fy);
+        Write(os, pKF0->cx);
+        Write(os, pKF0->cy);
+        Write(os, pKF0->mbf);
+        Write(os, pKF0->mb);
+        Write(os, pKF0->mThDepth);
+        WriteMat(os, pKF0->mK);
+        Write(os, float(pKF0->mnMinX));
+        Write(os, float(pKF0->mnMinY));
+        Write(os, float(pKF0->mnMaxX));
+        Write(os, float(pKF0->mnMaxY));
+        Write(os, pKF0->mfGridElementWidthInv);
+        Write(os, pKF0->mfGridElementHeightInv);
+        Write(os, int32_t(pKF0->mnScaleLevels));
+        Write(os, pKF0->mfScaleFactor);
+        Write(os, pKF0->mfLogScaleFactor);
+        WriteVector(os, pKF0->mvScaleFactors);
+        WriteVector(os, pKF0->mvLevelSigma2);
+        WriteVector(os, pKF0->mvInvLevelSigma2);
+
+        // Relocalization arrays, written after the records
+        const uint64_t descriptorBytes = pKF0->mDescriptors.cols;
+        vector<uint64_t> vKFOffsets, vBowBegin(1, 0), vCovisiblesBegin(1, 0), vNodesBegin(1, 0);
+        vector<uint64_t> vNodeFeaturesBegin(1, 0), vFeaturesBegin(1, 0), vFramesBegin(1, 0);
+        vector<uint32_t> vBowWords, vCovisibles, vNodes, vNodeFeatures, vFeatureMapPoints, vFramePlanes;
+        vector<double> vBowValues;
+        vector<float> vAngles;
+        vector<uint8_t> vDescriptors;
+        map<uint32_t, vector<uint32_t> > invertedFile;
+
+        // Manhattan frames of the saved keyframes and planes, by keyframe
+        vector<vector<ManhattanFrame> > vvFrames(vpKFs.size());
+        size_t nFrames = 0;
+        for (const ManhattanFrame &frame : mpMap->GetAllManhattanFrames()) {
+            bool bSaved = kfIndices.count(frame.mpKF) > 0;
+            for (MapPlane *pMP : frame.mvpPlanes)
+                if (pMP && !planeIndices.count(pMP))
+                    bSaved = false;
+            if (bSaved) {
+                vvFrames[kfIndices[frame.mpKF]].push_back(frame);
+                nFrames++;
+            }
+        }
+
+        for (size_t k = 0; k < vpKFs.size(); k++) {
+            KeyFrame *pKF = vpKFs[k];
+
+            Align(os);
+            vKFOffsets.push_back(os.tellp());
+            Write(os, uint64_t(pKF->mnId));
+            Write(os, pKF->mTimeStamp);
+            WriteMat(os, pKF->GetPose());
+
+            WriteKeyPoints(os, pKF->mvKeys);
+            WriteKeyPoints(os, pKF->mvKeysUn);
+            WriteVector(os, pKF->mvuRight);
+            WriteVector(os, pKF->mvDepth);
+
+            WriteKeyLines(os, pKF->mvKeyLines);
+            WriteMat(os, pKF->mLineDescriptors);
+            WriteVector(os, pKF->mvKeyLineFunctions);
+            WriteVector(os, IndicesOf(pKF->GetMapLineMatches(), mlIndices));
+
+            const vector<MapPlane *> vpPlanes = pKF->GetMapPlaneMatches();
+            Write(os, uint64_t(pKF->mnPlaneNum));
+            for (int i = 0; i < pKF->mnPlaneNum; i++) {
+                WriteMat(os, pKF->mvPlaneCoefficients[i]);
+                WriteCloud(os, pKF->mvPlanePoints[i]);
+                Write(os, IndexOf(vpPlanes[i], planeIndices));
+                Write(os, IndexOf(pKF->mvpParallelPlanes[i], planeIndices));
+                Write(os, IndexOf(pKF->mvpVerticalPlanes[i], planeIndices));
+            }
+
+            Write(os, IndexOf(pKF->GetParent(), kfIndices));
+            {
+                unique_lock<mutex> lockCon(pKF->mMutexConnections);
+                Write(os, uint8_t(pKF->mbNotErase));
+
+                vector<IndexAndWeight> vConnections;
+                for (const auto &connection : pKF->mConnectedKeyFrameWeights)
+                    if (kfIndices.count(connection.first))
+                        vConnections.push_back({kfIndices[connection.first], uint32_t(connection.second)});
+                WriteVector(os, vConnections);
+            }
+
+            for (const auto &word : pKF->mBowVec) {
+                vBowWords.push_back(word.first);
+                vBowValues.push_back(word.second);
+                invertedFile[word.first].push_back(k);
+            }
+            vBowBegin.push_back(vBowWords.size());
+
+            for (KeyFrame *pCovisible : pKF->GetBestCovisibilityKeyFrames(10))
+                if (kfIndices.count(pCovisible))
+                    vCovisibles.push_back(kfIndices[pCovisible]);
+            vCovisiblesBegin.push_back(vCovisibles.size());
+
+            for (const auto &node : pKF->mFeatVec) {
+                vNodes.push_back(node.first);
+                vNodeFeatures.insert(vNodeFeatures.end(), node.second.begin(), node.second.end());
+                vNodeFeaturesBegin.push_back(vNodeFeatures.size());
+            }
+            vNodesBegin.push_back(vNodes.size());
+
+            const vector<MapPoint *> vpMapPoints = pKF->GetMapPointMatches();
+            for (int i = 0; i < pKF->N; i++) {
+                vAngles.push_back(pKF->mvKeysUn[i].angle);
+                vFeatureMapPoints.push_back(IndexOf(vpMapPoints[i], mpIndices));
+                const uint8_t *pDescriptor = pKF->mDescriptors.ptr<uint8_t>(i);
+                vDescriptors.insert(vDescriptors.end(), pDescriptor, pDescriptor + descriptorBytes);
+            }
+            vFeaturesBegin.push_back(vAngles.size());
+
+            for (const ManhattanFrame &frame : vvFrames[k])
+                for (MapPlane *pMP : frame.mvpPlanes)
+                    vFramePlanes.push_back(IndexOf(pMP, planeIndices));
+            vFramesBegin.push_back(vFramePlanes.size() / 3);
+        }
+
+        vector<uint64_t> vMPOffsets;
+        for (MapPoint *pMP : vpMPs) {
+            Align(os);
+            vMPOffsets.push_back(os.tellp());
+            Write(os, uint64_t(pMP->mnId));
+            Write(os, int64_t(pMP->mnFirstKFid));
+            unique_lock<mutex> lockFeatures(pMP->mMutexFeatures);
+            unique_lock<mutex> lockPos(pMP->mMutexPos);
+            Write(os, IndexOf(pMP->mpRefKF, kfIndices));
+            WriteMat(os, pMP->mWorldPos);
+            WriteMat(os, pMP->mNormalVector);
+            WriteMat(os, pMP->mDescriptor);
+            Write(os, pMP->mfMinDistance);
+            Write(os, pMP->mfMaxDistance);
+            Write(os, int32_t(pMP->mnVisible));
+            Write(os, int32_t(pMP->mnFound));
+        }
+
+        vector<uint64_t> vMLOffsets;
+        for (MapLine *pML : vpMLs) {
+            Align(os);
+            vMLOffsets.push_back(os.tellp());
+            Write(os, uint64_t(pML->mnId));
+            unique_lock<mutex> lockFeatures(pML->mMutexFeatures);
+            unique_lock<mutex> lockPos(pML->mMutexPos);
+            Write(os, IndexOf(pML->mpRefKF, kfIndices));
+            Write(os, pML->mWorldPos);
+            Write(os, pML->mNormalVector);
+            WriteMat(os, pML->mLDescriptor);
+            Write(os, pML->mfMinDistance);
+            Write(os, pML->mfMaxDistance);
+            Write(os, int32_t(pML->mnVisible));
+            Write(os, int32_t(pML->mnFound));
+        }
+
+        vector<uint64_t> vPlaneOffsets;
+        for (MapPlane *pMP : vpMPls) {
+            Align(os);
+            vPlaneOffsets.push_back(os.tellp());
+            Write(os, uint64_t(pMP->mnId));
+            Write(os, int64_t(pMP->mnFirstKFid));
+            unique_lock<mutex> lockFeatures(pMP->mMutexFeatures);
+            Write(os, IndexOf(pMP->mpRefKF, kfIndices));
+            {
+                unique_lock<mutex> lockPos(pMP->mMutexPos);
+                WriteMat(os, pMP->mWorldPos);
+            }
+            Write(os, int32_t(pMP->mRed));
+            Write(os, int32_t(pMP->mGreen));
+            Write(os, int32_t(pMP->mBlue));
+            Write(os, int32_t(pMP->mnVisible));
+            Write(os, int32_t(pMP->mnFound));
+            WriteCloud(os, *pMP->mvPlanePoints);
+        }
+
+        vector<uint32_t> vInvertedWords, vInvertedKeyFrames;
+        vector<uint64_t> vInvertedBegin(1, 0);
+        for (const auto &word : invertedFile) {
+            vInvertedWords.push_back(word.first);
+            vInvertedKeyFrames.insert(vInvertedKeyFrames.end(), word.second.begin(), word.second.end());
+            vInvertedBegin.push_back(vInvertedKeyFrames.size());
+        }
+
+        vector<uint32_t> vOrigins;
+        for (KeyFrame *pKF : mpMap->mvpKeyFrameOrigins)
+            if (kfIndices.count(pKF))
+                vOrigins.push_back(kfIndices[pKF]);
+
+        Align(os);
+        const uint64_t indexOffset = os.tellp();
+        WriteVector(os, vKFOffsets);
+        WriteVector(os, vMPOffsets);
+        WriteVector(os, vMLOffsets);
+        WriteVector(os, vPlaneOffsets);
+        WriteVector(os, vBowBegin);
+        WriteVector(os, vBowWords);
+        WriteVector(os, vBowValues);
+        WriteVector(os, vInvertedWords);
+        WriteVector(os, vInvertedBegin);
+        WriteVector(os, vInvertedKeyFrames);
+        WriteVector(os, vCovisiblesBegin);
+        WriteVector(os, vCovisibles);
+        WriteVector(os, vNodesBegin);
+        WriteVector(os, vNodes);
+        WriteVector(os, vNodeFeaturesBegin);
+        WriteVector(os, vNodeFeatures);
+        WriteVector(os, vFeaturesBegin);
+        WriteVector(os, vAngles);
+        WriteVector(os, vFeatureMapPoints);
+        Write(os, descriptorBytes);
+        WriteVector(os, vDescriptors);
+        WriteVector(os, vFramesBegin);
+        WriteVector(os, vFramePlanes);
+        WriteVector(os, vOrigins);
+
+        Write(os, indexOffset);
+        os.write(MAGIC, sizeof(MAGIC));
+
+        os.close();
+        if (!os.good() || rename(tmpFilename.c_str(), filename.c_str()) != 0) {
+            cerr << "Failed to write map file: " << filename << endl;
+            remove(tmpFilename.c_str());
+            return false;
+        }
+
+        cout << "Map saved: " << vpKFs.size() << " keyframes, " << vpMPs.size() << " points, " << vpMLs.size()
+             << " lines, " << vpMPls.size() << " planes, " << nFrames << " Manhattan frames" << endl;
+
+        return true;
+    }
+
+    bool MapSerializer::Load(const string &filename, const cv::Mat &K, float bf, int nScaleLevels,
+                             float scaleFactor) {
+        if (mpMap->KeyFramesInMap() > 0 || mpKeyFrameDB->GetMappedMap()) {
+            cerr << "A map can only be loaded into an empty map" << endl;
+            return false;
+        }
+
+        shared_ptr<MappedMap> pMappedMap = make_shared<MappedMap>(mpMap, mpKeyFrameDB, mpVocabulary);
+        MappedMap &M = *pMappedMap;
+
+        M.mpFile = MapFile(filename, M.mnSize);
+        if (!M.mpFile) {
+            cerr << "Failed to open map file: " << filename << endl;
+            return false;
+        }
+        M.mpData = static_cast<const char *>(M.mpFile.get());
+        MappedReader is(M.mpData, M.mnSize);
+
+        const char *magic = is.Take(sizeof(MAGIC));
+        uint32_t version;
+        if (!magic || memcmp(magic, MAGIC, sizeof(MAGIC)) != 0 || !Read(is, version)) {
+            cerr << filename << " is not a map file" << endl;
+            return false;
+        }
+        if (version != VERSION) {
+            cerr << "Unsupported map file version " << version << " (expected " << VERSION << ")" << endl;
+            return false;
+        }
+
+        uint64_t nNextFrameId, nNextKFId, nNextMPId, nNextMLId, nNextPlaneId;
+        Read(is, nNextFrameId);
+        Read(is, nNextKFId);
+        Read(is, nNextMPId);
+        Read(is, nNextMLId);
+        Read(is, nNextPlaneId);
+
+        int32_t nFileScaleLevels;
+        Read(is, M.fx);
+        Read(is, M.fy);
+        Read(is, M.cx);
+        Read(is, M.cy);
+        Read(is, M.mbf);
+        Read(is, M.mb);
+        Read(is, M.mThDepth);
+        ReadMat(is, M.mK);
+        Read(is, M.mnMinX);
+        Read(is, M.mnMinY);
+        Read(is, M.mnMaxX);
+        Read(is, M.mnMaxY);
+        Read(is, M.mfGridElementWidthInv);
+        Read(is, M.mfGridElementHeightInv);
+        Read(is, nFileScaleLevels);
+        M.mnScaleLevels = nFileScaleLevels;
+        Read(is, M.mfScaleFactor);
+        Read(is, M.mfLogScaleFactor);
+        ReadVector(is, M.mvScaleFactors);
+        ReadVector(is, M.mvLevelSigma2);
+        if (!ReadVector(is, M.mvInvLevelSigma2)) {
+            cerr << "Corrupted map file: " << filename << endl;
+            return false;
+        }
+
+        // The keyframes are matched against the frames of the running camera, which must be the one of the map.
+        // Image bounds are only known once a frame has been processed, otherwise they are checked when the first
+        // keyframe is built.
+        bool bSameCalibration = SameValue(M.fx, K.at<float>(0, 0)) && SameValue(M.fy, K.at<float>(1, 1)) &&
+                                SameValue(M.cx, K.at<float>(0, 2)) && SameValue(M.cy, K.at<float>(1, 2)) &&
+                                SameValue(M.mbf, bf) && M.mnScaleLevels == nScaleLevels &&
+                                SameValue(M.mfScaleFactor, scaleFactor);
+        if (!Frame::mbInitialComputations)
+            bSameCalibration = bSameCalibration && SameValue(M.mnMinX, Frame::mnMinX) &&
+                               SameValue(M.mnMinY, Frame::mnMinY) && SameValue(M.mnMaxX, Frame::mnMaxX) &&
+                               SameValue(M.mnMaxY, Frame::mnMaxY);
+        if (!bSameCalibration) {
+            cerr << "The map was built with another calibration or scale pyramid than the settings" << endl;
+            return false;
+        }
+
+        // Relocalization arrays, located by the offset at the end of the file
+        uint64_t indexOffset = 0;
+        MappedReader footer(M.mpData, M.mnSize);
+        bool bOK = M.mnSize >= sizeof(indexOffset) + sizeof(MAGIC) &&
+                   footer.Seek(M.mnSize - sizeof(indexOffset) - sizeof(MAGIC)) && Read(footer, indexOffset) &&
+                   memcmp(footer.Take(sizeof(MAGIC)), MAGIC, sizeof(MAGIC)) == 0 && is.Seek(indexOffset);
+
+        uint64_t nBowBegin, nBowWords, nBowValues, nInvertedBegin, nInvertedKeyFrames, nCovisiblesBegin;
+        uint64_t nCovisibles, nNodesBegin, nNodeFeaturesBegin, nFeaturesBegin, nAngles, nDescriptors;
+        uint64_t nFramesBegin, nFramePlanes, descriptorBytes;
+        bOK = bOK && ReadArray(is, M.mpKeyFrameOffsets, M.mnKeyFrames) &&
+              ReadArray(is, M.mpMapPointOffsets, M.mnMapPoints) && ReadArray(is, M.mpMapLineOffsets, M.mnMapLines) &&
+              ReadArray(is, M.mpMapPlaneOffsets, M.mnMapPlanes) && ReadArray(is, M.mpBowBegin, nBowBegin) &&
+              ReadArray(is, M.mpBowWords, nBowWords) && ReadArray(is, M.mpBowValues, nBowValues) &&
+              ReadArray(is, M.mpInvertedWords, M.mnInvertedWords) &&
+              ReadArray(is, M.mpInvertedBegin, nInvertedBegin) &&
+              ReadArray(is, M.mpInvertedKeyFrames, nInvertedKeyFrames) &&
+              ReadArray(is, M.mpCovisiblesBegin, nCovisiblesBegin) && ReadArray(is, M.mpCovisibles, nCovisibles) &&
+              ReadArray(is, M.mpNodesBegin, nNodesBegin) && ReadArray(is, M.mpNodes, M.mnNodes) &&
+              ReadArray(is, M.mpNodeFeaturesBegin, nNodeFeaturesBegin) &&
+              ReadArray(is, M.mpNodeFeatures, M.mnNodeFeatures) &&
+              ReadArray(is, M.mpFeaturesBegin, nFeaturesBegin) && ReadArray(is, M.mpAngles, nAngles) &&
+              ReadArray(is, M.mpFeatureMapPoints, M.mnFeatures) && Read(is, descriptorBytes) &&
+              ReadArray(is, M.mpDescriptors, nDescriptors) && ReadArray(is, M.mpFramesBegin, nFramesBegin) &&
+              ReadArray(is, M.mpFramePlanes, nFramePlanes) && ReadArray(is, M.mpOrigins, M.mnOrigins);
+
+        // Sizes of the arrays, the ranges they hold are checked when used
+        const uint64_t nKFs = M.mnKeyFrames;
+        bOK = bOK && nKFs > 0 && nBowBegin == nKFs + 1 && M.mpBowBegin[nKFs] == nBowWords &&
+              nBowValues == nBowWords && nInvertedBegin == M.mnInvertedWords + 1 &&
+              M.mpInvertedBegin[M.mnInvertedWords] == nInvertedKeyFrames && nCovisiblesBegin == nKFs + 1 &&
+              M.mpCovisiblesBegin[nKFs] == nCovisibles && nNodesBegin == nKFs + 1 &&
+              nNodeFeaturesBegin == M.mnNodes + 1 && nFeaturesBegin == nKFs + 1 && nAngles == M.mnFeatures &&
+              descriptorBytes > 0 && nDescriptors == M.mnFeatures * descriptorBytes && nFramesBegin == nKFs + 1 &&
+              nFramePlanes % 3 == 0;
+        if (!bOK) {
+            cerr << "Corrupted map file: " << filename << endl;
+            return false;
+        }
+        M.mnDescriptorBytes = descriptorBytes;
+        M.mnFrames = nFramePlanes / 3;
+
+        mpKeyFrameDB->SetMappedMap(pMappedMap);
+
+        // Keeps the file mapped as long as the elements built from it
+        mpMap->AddStorage(pMappedMap);
+
+        Frame::nNextId = max<uint64_t>(Frame::nNextId, nNextFrameId);
+        KeyFrame::nNextId = max<uint64_t>(KeyFrame::nNextId, nNextKFId);
+        MapPoint::nNextId = max<uint64_t>(MapPoint::nNextId, nNextMPId);
+        MapLine::nNextId = max<uint64_t>(MapLine::nNextId, nNextMLId);
+        MapPlane::nNextId = max<uint64_t>(MapPlane::nNextId, nNextPlaneId);
+
+        cout << "Map opened: " << nKFs << " keyframes, " << M.mnMapPoints << " points, " << M.mnMapLines
+             << " lines, " << M.mnMapPlanes << " planes, " << M.mnFrames
+             << " Manhattan frames, built as relocalization needs them" << endl;
+
+        return true;
+    }
+
+} //namespace ORB_SLAM
@@ -19,11 +19,14 @@
 */
 
 #include "ORBmatcher.h"
+#include "HammingDistance.h"
+#include "MapSerializer.h"
 
 #include<opencv2/core/core.hpp>
 
 #include "Thirdparty/DBoW2/DBoW2/FeatureVector.h"
 
+#include<algorithm>
 #include<stdint-gcc.h>
 
 using namespace std;
@@ -42,6 +45,9 @@ namespace ORB_SLAM2 {
 
         const bool bFactor = th != 1.0;
 
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         for (size_t iMP = 0; iMP < vpMapPoints.size(); iMP++) {
             MapPoint *pMP = vpMapPoints[iMP];
             if (!pMP->mbTrackInView)
@@ -67,6 +73,29 @@ namespace ORB_SLAM2 {
 
             const cv::Mat MPdescriptor = pMP->GetDescriptor();
 
+            // Keep the keypoints that can still be matched and compute all their distances in one pass
+            vCandidates.clear();
+            for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
+                const size_t idx = *vit;
+
+                if (F.mvpMapPoints[idx])
+                    if (F.mvpMapPoints[idx]->Observations() > 0)
+                        continue;
+
+                if (F.mvuRight[idx] > 0) {
+                    const float er = fabs(pMP->mTrackProjXR - F.mvuRight[idx]);
+                    if (er > r * F.mvScaleFactors[nPredictedLevel])
+                        continue;
+                }
+
+                vCandidates.push_back(idx);
+            }
+
+            vDistances.resize(vCandidates.size());
+            HammingDistance::DistanceToMany(MPdescriptor.ptr<uint8_t>(), F.mDescriptors.ptr<uint8_t>(),
+                                            F.mDescriptors.step[0], vCandidates.data(), vCandidates.size(),
+                                            vDistances.data());
+
             int bestDist = 256;
             int bestLevel = -1;
             int bestDist2 = 256;
@@ -74,6 +103,68 @@ namespace ORB_SLAM2 {
             int bestIdx = -1;
 
             // Get best and second matches with near keypoints
+            for (size_t iC = 0; iC < vCandidates.size(); iC++) {
+                const size_t idx = vCandidates[iC];
+                const int dist = vDistances[iC];
+
+                if (dist < bestDist) {
+                    bestDist2 = bestDist;
+                    bestDist = dist;
+                    bestLevel2 = bestLevel;
+                    bestLevel = F.mvKeysUn[idx].octave;
+                    bestIdx = idx;
+                } else if (dist < bestDist2) {
+                    bestLevel2 = F.mvKeysUn[idx].octave;
+                    bestDist2 = dist;
+                }
+            }
+
+            // Apply ratio to second match (only if best and second are in the same scale level)
+            if (bestDist <= TH_HIGH) {
+                if (bestLevel == bestLevel2 && bestDist > mfNNratio * bestDist2)
+                    continue;
+
+                F.mvpMapPoints[bestIdx] = pMP;
+                nmatches++;
+            }
+        }
+
+        return nmatches;
+    }
+
+    int ORBmatcher::SearchByProjection(Frame &F, const LocalMapPoints &localMapPoints, const float th) {
+        int nmatches = 0;
+
+        const bool bFactor = th != 1.0;
+
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
+        for (size_t k = 0; k < localMapPoints.NumVisible(); k++) {
+            const int iMP = localMapPoints.mvnVisible[k];
+            MapPoint *pMP = localMapPoints.mvpMapPoints[iMP];
+            if (pMP->isBad())
+                continue;
+
+            const int &nPredictedLevel = localMapPoints.mvnScaleLevel[k];
+
+            // The size of the window will depend on the viewing direction
+            float r = RadiusByViewingCos(localMapPoints.mvViewCos[k]);
+
+            if (bFactor)
+                r *= th;
+
+            const vector<size_t> vIndices =
+                    F.GetFeaturesInArea(localMapPoints.mvProjX[k], localMapPoints.mvProjY[k],
+                                        r * F.mvScaleFactors[nPredictedLevel], nPredictedLevel - 1, nPredictedLevel);
+
+            if (vIndices.empty())
+                continue;
+
+            const uchar *pMPdescriptor = localMapPoints.mDescriptors.ptr<uchar>(iMP);
+
+            // Keep the keypoints that can still be matched and compute all their distances in one pass
+            vCandidates.clear();
             for (vector<size_t>::const_iterator vit = vIndices.begin(), vend = vIndices.end(); vit != vend; vit++) {
                 const size_t idx = *vit;
 
@@ -82,14 +173,28 @@ namespace ORB_SLAM2 {
                         continue;
 
                 if (F.mvuRight[idx] > 0) {
-                    const float er = fabs(pMP->mTrackProjXR - F.mvuRight[idx]);
+                    const float er = fabs(localMapPoints.mvProjXR[k] - F.mvuRight[idx]);
                     if (er > r * F.mvScaleFactors[nPredictedLevel])
                         continue;
                 }
 
-                const cv::Mat &d = F.mDescriptors.row(idx);
+                vCandidates.push_back(idx);
+            }
+
+            vDistances.resize(vCandidates.size());
+            HammingDistance::DistanceToMany(pMPdescriptor, F.mDescriptors.ptr<uint8_t>(), F.mDescriptors.step[0],
+                                            vCandidates.data(), vCandidates.size(), vDistances.data());
+
+            int bestDist = 256;
+            int bestLevel = -1;
+            int bestDist2 = 256;
+            int bestLevel2 = -1;
+            int bestIdx = -1;
 
-                const int dist = DescriptorDistance(MPdescriptor, d);
+            // Get best and second matches with near keypoints
+            for (size_t iC = 0; iC < vCandidates.size(); iC++) {
+                const size_t idx = vCandidates[iC];
+                const int dist = vDistances[iC];
 
                 if (dist < bestDist) {
                     bestDist2 = bestDist;
@@ -162,6 +267,9 @@ namespace ORB_SLAM2 {
         DBoW2::FeatureVector::const_iterator KFend = vFeatVecKF.end();
         DBoW2::FeatureVector::const_iterator Fend = F.mFeatVec.end();
 
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         while (KFit != KFend && Fit != Fend) {
             if (KFit->first == Fit->first) {
                 const vector<unsigned int> vIndicesKF = KFit->second;
@@ -178,21 +286,25 @@ namespace ORB_SLAM2 {
                     if (pMP->isBad())
                         continue;
 
-                    const cv::Mat &dKF = pKF->mDescriptors.row(realIdxKF);
+                    // Frame keypoints of the node not matched yet, all scored in one pass
+                    vCandidates.clear();
+                    for (size_t iF = 0; iF < vIndicesF.size(); iF++) {
+                        if (!vpMapPointMatches[vIndicesF[iF]])
+                            vCandidates.push_back(vIndicesF[iF]);
+                    }
+
+                    vDistances.resize(vCandidates.size());
+                    HammingDistance::DistanceToMany(pKF->mDescriptors.ptr<uint8_t>(realIdxKF),
+                                                    F.mDescriptors.ptr<uint8_t>(), F.mDescriptors.step[0],
+                                                    vCandidates.data(), vCandidates.size(), vDistances.data());
 
                     int bestDist1 = 256;
                     int bestIdxF = -1;
                     int bestDist2 = 256;
 
-                    for (size_t iF = 0; iF < vIndicesF.size(); iF++) {
-                        const unsigned int realIdxF = vIndicesF[iF];
-
-                        if (vpMapPointMatches[realIdxF])
-                            continue;
-
-                        const cv::Mat &dF = F.mDescriptors.row(realIdxF);
-
-                        const int dist = DescriptorDistance(dKF, dF);
+                    for (size_t iC = 0; iC < vCandidates.size(); iC++) {
+                        const size_t realIdxF = vCandidates[iC];
+                        const int dist = vDistances[iC];
 
                         if (dist < bestDist1) {
                             bestDist2 = bestDist1;
@@ -254,6 +366,112 @@ namespace ORB_SLAM2 {
         return nmatches;
     }
 
+    int ORBmatcher::SearchByBoW(const MappedKeyFrame &KF, Frame &F, vector<int> &vnMatchesKF) {
+        vnMatchesKF = vector<int>(F.N, -1);
+
+        int nmatches = 0;
+
+        vector<int> rotHist[HISTO_LENGTH];
+        for (int i = 0; i < HISTO_LENGTH; i++)
+            rotHist[i].reserve(500);
+        const float factor = 1.0f / HISTO_LENGTH;
+
+        // Nodes of the keyframe are stored sorted, as in its feature vector
+        uint64_t nKF = 0;
+        DBoW2::FeatureVector::const_iterator Fit = F.mFeatVec.begin();
+        DBoW2::FeatureVector::const_iterator Fend = F.mFeatVec.end();
+
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
+        while (nKF < KF.nNodes && Fit != Fend) {
+            if (KF.pNodes[nKF] == Fit->first) {
+                const vector<unsigned int> &vIndicesF = Fit->second;
+
+                for (uint64_t iKF = KF.pNodeBegin[nKF]; iKF < KF.pNodeBegin[nKF + 1]; iKF++) {
+                    const unsigned int realIdxKF = KF.pFeatures[iKF];
+
+                    if (KF.pMapPoints[realIdxKF] == MappedKeyFrame::NO_LANDMARK)
+                        continue;
+
+                    // Frame keypoints of the node not matched yet, all scored in one pass
+                    vCandidates.clear();
+                    for (size_t iF = 0; iF < vIndicesF.size(); iF++) {
+                        if (vnMatchesKF[vIndicesF[iF]] < 0)
+                            vCandidates.push_back(vIndicesF[iF]);
+                    }
+
+                    vDistances.resize(vCandidates.size());
+                    HammingDistance::DistanceToMany(KF.pDescriptors + realIdxKF * KF.descriptorStep,
+                                                    F.mDescriptors.ptr<uint8_t>(), F.mDescriptors.step[0],
+                                                    vCandidates.data(), vCandidates.size(), vDistances.data());
+
+                    int bestDist1 = 256;
+                    int bestIdxF = -1;
+                    int bestDist2 = 256;
+
+                    for (size_t iC = 0; iC < vCandidates.size(); iC++) {
+                        const size_t realIdxF = vCandidates[iC];
+                        const int dist = vDistances[iC];
+
+                        if (dist < bestDist1) {
+                            bestDist2 = bestDist1;
+                            bestDist1 = dist;
+                            bestIdxF = realIdxF;
+                        } else if (dist < bestDist2) {
+                            bestDist2 = dist;
+                        }
+                    }
+
+                    if (bestDist1 <= TH_LOW) {
+                        if (static_cast<float>(bestDist1) < mfNNratio * static_cast<float>(bestDist2)) {
+                            vnMatchesKF[bestIdxF] = realIdxKF;
+
+                            if (mbCheckOrientation) {
+                                float rot = KF.pAngles[realIdxKF] - F.mvKeys[bestIdxF].angle;
+                                if (rot < 0.0)
+                                    rot += 360.0f;
+                                int bin = round(rot * factor);
+                                if (bin == HISTO_LENGTH)
+                                    bin = 0;
+                                assert(bin >= 0 && bin < HISTO_LENGTH);
+                                rotHist[bin].push_back(bestIdxF);
+                            }
+                            nmatches++;
+                        }
+                    }
+
+                }
+
+                nKF++;
+                Fit++;
+            } else if (KF.pNodes[nKF] < Fit->first) {
+                nKF = lower_bound(KF.pNodes + nKF, KF.pNodes + KF.nNodes, Fit->first) - KF.pNodes;
+            } else {
+                Fit = F.mFeatVec.lower_bound(KF.pNodes[nKF]);
+            }
+        }
+
+        if (mbCheckOrientation) {
+            int ind1 = -1;
+            int ind2 = -1;
+            int ind3 = -1;
+
+            ComputeThreeMaxima(rotHist, HISTO_LENGTH, ind1, ind2, ind3);
+
+            for (int i = 0; i < HISTO_LENGTH; i++) {
+                if (i == ind1 || i == ind2 || i == ind3)
+                    continue;
+                for (size_t j = 0, jend = rotHist[i].size(); j < jend; j++) {
+                    vnMatchesKF[rotHist[i][j]] = -1;
+                    nmatches--;
+                }
+            }
+        }
+
+        return nmatches;
+    }
+
     int ORBmatcher::SearchForTriangulation(KeyFrame *pKF1, KeyFrame *pKF2, cv::Mat F12,
                                            vector<pair<size_t, size_t> > &vMatchedPairs, const bool bOnlyStereo) {
         const DBoW2::FeatureVector &vFeatVec1 = pKF1->mFeatVec;
@@ -287,6 +505,9 @@ namespace ORB_SLAM2 {
         DBoW2::FeatureVector::const_iterator f1end = vFeatVec1.end();
         DBoW2::FeatureVector::const_iterator f2end = vFeatVec2.end();
 
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         while (f1it != f1end && f2it != f2end) {
             if (f1it->first == f2it->first) {
                 for (size_t i1 = 0, iend1 = f1it->second.size(); i1 < iend1; i1++) {
@@ -306,11 +527,8 @@ namespace ORB_SLAM2 {
 
                     const cv::KeyPoint &kp1 = pKF1->mvKeysUn[idx1];
 
-                    const cv::Mat &d1 = pKF1->mDescriptors.row(idx1);
-
-                    int bestDist = TH_LOW;
-                    int bestIdx2 = -1;
-
+                    // Keypoints of the node in the second keyframe that can be matched, all scored in one pass
+                    vCandidates.clear();
                     for (size_t i2 = 0, iend2 = f2it->second.size(); i2 < iend2; i2++) {
                         size_t idx2 = f2it->second[i2];
 
@@ -320,15 +538,26 @@ namespace ORB_SLAM2 {
                         if (vbMatched2[idx2] || pMP2)
                             continue;
 
-                        const bool bStereo2 = pKF2->mvuRight[idx2] >= 0;
-
                         if (bOnlyStereo)
-                            if (!bStereo2)
+                            if (pKF2->mvuRight[idx2] < 0)
                                 continue;
 
-                        const cv::Mat &d2 = pKF2->mDescriptors.row(idx2);
+                        vCandidates.push_back(idx2);
+                    }
+
+                    vDistances.resize(vCandidates.size());
+                    HammingDistance::DistanceToMany(pKF1->mDescriptors.ptr<uint8_t>(idx1),
+                                                    pKF2->mDescriptors.ptr<uint8_t>(), pKF2->mDescriptors.step[0],
+                                                    vCandidates.data(), vCandidates.size(), vDistances.data());
+
+                    int bestDist = TH_LOW;
+                    int bestIdx2 = -1;
+
+                    for (size_t iC = 0; iC < vCandidates.size(); iC++) {
+                        const size_t idx2 = vCandidates[iC];
+                        const bool bStereo2 = pKF2->mvuRight[idx2] >= 0;
 
-                        const int dist = DescriptorDistance(d1, d2);
+                        const int dist = vDistances[iC];
 
                         if (dist > TH_LOW || dist > bestDist)
                             continue;
@@ -406,8 +635,8 @@ namespace ORB_SLAM2 {
     }
 
     int ORBmatcher::Fuse(KeyFrame *pKF, const vector<MapPoint *> &vpMapPoints, const float th) {
-        cv::Mat Rcw = pKF->GetRotation();
-        cv::Mat tcw = pKF->GetTranslation();
+        const Eigen::Matrix3f Rcw = pKF->GetRotationEigen();
+        const Eigen::Vector3f tcw = pKF->GetTranslationEigen();
 
         const float &fx = pKF->fx;
         const float &fy = pKF->fy;
@@ -415,7 +644,7 @@ namespace ORB_SLAM2 {
         const float &cy = pKF->cy;
         const float &bf = pKF->mbf;
 
-        cv::Mat Ow = pKF->GetCameraCenter();
+        const Eigen::Vector3f Ow = pKF->GetCameraCenterEigen();
 
         int nFused = 0;
 
@@ -430,16 +659,16 @@ namespace ORB_SLAM2 {
             if (pMP->isBad() || pMP->IsInKeyFrame(pKF))
                 continue;
 
-            cv::Mat p3Dw = pMP->GetWorldPos();
-            cv::Mat p3Dc = Rcw * p3Dw + tcw;
+            const Eigen::Vector3f p3Dw = pMP->GetWorldPosEigen();
+            const Eigen::Vector3f p3Dc = Rcw * p3Dw + tcw;
 
             // Depth must be positive
-            if (p3Dc.at<float>(2) < 0.0f)
+            if (p3Dc(2) < 0.0f)
                 continue;
 
-            const float invz = 1 / p3Dc.at<float>(2);
-            const float x = p3Dc.at<float>(0) * invz;
-            const float y = p3Dc.at<float>(1) * invz;
+            const float invz = 1 / p3Dc(2);
+            const float x = p3Dc(0) * invz;
+            const float y = p3Dc(1) * invz;
 
             const float u = fx * x + cx;
             const float v = fy * y + cy;
@@ -452,15 +681,15 @@ namespace ORB_SLAM2 {
 
             const float maxDistance = pMP->GetMaxDistanceInvariance();
             const float minDistance = pMP->GetMinDistanceInvariance();
-            cv::Mat PO = p3Dw - Ow;
-            const float dist3D = cv::norm(PO);
+            const Eigen::Vector3f PO = p3Dw - Ow;
+            const float dist3D = PO.norm();
 
             // Depth must be inside the scale pyramid of the image
             if (dist3D < minDistance || dist3D > maxDistance)
                 continue;
 
             // Viewing angle must be less than 60 deg
-            cv::Mat Pn = pMP->GetNormal();
+            const Eigen::Vector3f Pn = pMP->GetNormalEigen();
 
             if (PO.dot(Pn) < 0.5 * dist3D)
                 continue;
@@ -554,18 +783,18 @@ namespace ORB_SLAM2 {
             rotHist[i].reserve(500);
         const float factor = 1.0f / HISTO_LENGTH;
 
-        const cv::Mat Rcw = CurrentFrame.mTcw.rowRange(0, 3).colRange(0, 3);
-        const cv::Mat tcw = CurrentFrame.mTcw.rowRange(0, 3).col(3);
+        const Eigen::Matrix3f &Rcw = CurrentFrame.GetRotationEigen();
+        const Eigen::Vector3f &tcw = CurrentFrame.GetTranslationEigen();
 
-        const cv::Mat twc = -Rcw.t() * tcw;
+        const Eigen::Vector3f &twc = CurrentFrame.GetCameraCenterEigen();
 
-        const cv::Mat Rlw = LastFrame.mTcw.rowRange(0, 3).colRange(0, 3);
-        const cv::Mat tlw = LastFrame.mTcw.rowRange(0, 3).col(3);
+        const Eigen::Vector3f tlc = LastFrame.GetRotationEigen() * twc + LastFrame.GetTranslationEigen();
 
-        const cv::Mat tlc = Rlw * twc + tlw;
+        const bool bForward = tlc(2) > CurrentFrame.mb;
+        const bool bBackward = -tlc(2) > CurrentFrame.mb;
 
-        const bool bForward = tlc.at<float>(2) > CurrentFrame.mb;
-        const bool bBackward = -tlc.at<float>(2) > CurrentFrame.mb;
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
 
         for (int i = 0; i < LastFrame.N; i++) {
             MapPoint *pMP = LastFrame.mvpMapPoints[i];
@@ -573,12 +802,12 @@ namespace ORB_SLAM2 {
             if (pMP) {
                 if (!LastFrame.mvbOutlier[i]) {
                     // Project
-                    cv::Mat x3Dw = pMP->GetWorldPos();
-                    cv::Mat x3Dc = Rcw * x3Dw + tcw;
+                    const Eigen::Vector3f x3Dw = pMP->GetWorldPosEigen();
+                    const Eigen::Vector3f x3Dc = Rcw * x3Dw + tcw;
 
-                    const float xc = x3Dc.at<float>(0);
-                    const float yc = x3Dc.at<float>(1);
-                    const float invzc = 1.0 / x3Dc.at<float>(2);
+                    const float xc = x3Dc(0);
+                    const float yc = x3Dc(1);
+                    const float invzc = 1.0 / x3Dc(2);
 
                     if (invzc < 0)
                         continue;
@@ -610,9 +839,7 @@ namespace ORB_SLAM2 {
 
                     const cv::Mat dMP = pMP->GetDescriptor();
 
-                    int bestDist = 256;
-                    int bestIdx2 = -1;
-
+                    vCandidates.clear();
                     for (vector<size_t>::const_iterator vit = vIndices2.begin(), vend = vIndices2.end();
                          vit != vend; vit++) {
                         const size_t i2 = *vit;
@@ -627,13 +854,21 @@ namespace ORB_SLAM2 {
                                 continue;
                         }
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
+                        vCandidates.push_back(i2);
+                    }
 
-                        const int dist = DescriptorDistance(dMP, d);
+                    vDistances.resize(vCandidates.size());
+                    HammingDistance::DistanceToMany(dMP.ptr<uint8_t>(), CurrentFrame.mDescriptors.ptr<uint8_t>(),
+                                                    CurrentFrame.mDescriptors.step[0], vCandidates.data(),
+                                                    vCandidates.size(), vDistances.data());
 
-                        if (dist < bestDist) {
-                            bestDist = dist;
-                            bestIdx2 = i2;
+                    int bestDist = 256;
+                    int bestIdx2 = -1;
+
+                    for (size_t iC = 0; iC < vCandidates.size(); iC++) {
+                        if (vDistances[iC] < bestDist) {
+                            bestDist = vDistances[iC];
+                            bestIdx2 = vCandidates[iC];
                         }
                     }
 
@@ -681,9 +916,9 @@ namespace ORB_SLAM2 {
                                        const float th, const int ORBdist) {
         int nmatches = 0;
 
-        const cv::Mat Rcw = CurrentFrame.mTcw.rowRange(0, 3).colRange(0, 3);
-        const cv::Mat tcw = CurrentFrame.mTcw.rowRange(0, 3).col(3);
-        const cv::Mat Ow = -Rcw.t() * tcw;
+        const Eigen::Matrix3f &Rcw = CurrentFrame.GetRotationEigen();
+        const Eigen::Vector3f &tcw = CurrentFrame.GetTranslationEigen();
+        const Eigen::Vector3f &Ow = CurrentFrame.GetCameraCenterEigen();
 
         // Rotation Histogram (to check rotation consistency)
         vector<int> rotHist[HISTO_LENGTH];
@@ -693,18 +928,21 @@ namespace ORB_SLAM2 {
 
         const vector<MapPoint *> vpMPs = pKF->GetMapPointMatches();
 
+        vector<size_t> vCandidates;
+        vector<int> vDistances;
+
         for (size_t i = 0, iend = vpMPs.size(); i < iend; i++) {
             MapPoint *pMP = vpMPs[i];
 
             if (pMP) {
                 if (!pMP->isBad() && !sAlreadyFound.count(pMP)) {
                     //Project
-                    cv::Mat x3Dw = pMP->GetWorldPos();
-                    cv::Mat x3Dc = Rcw * x3Dw + tcw;
+                    const Eigen::Vector3f x3Dw = pMP->GetWorldPosEigen();
+                    const Eigen::Vector3f x3Dc = Rcw * x3Dw + tcw;
 
-                    const float xc = x3Dc.at<float>(0);
-                    const float yc = x3Dc.at<float>(1);
-                    const float invzc = 1.0 / x3Dc.at<float>(2);
+                    const float xc = x3Dc(0);
+                    const float yc = x3Dc(1);
+                    const float invzc = 1.0 / x3Dc(2);
 
                     const float u = CurrentFrame.fx * xc * invzc + CurrentFrame.cx;
                     const float v = CurrentFrame.fy * yc * invzc + CurrentFrame.cy;
@@ -715,8 +953,7 @@ namespace ORB_SLAM2 {
                         continue;
 
                     // Compute predicted scale level
-                    cv::Mat PO = x3Dw - Ow;
-                    float dist3D = cv::norm(PO);
+                    const float dist3D = (x3Dw - Ow).norm();
 
                     const float maxDistance = pMP->GetMaxDistanceInvariance();
                     const float minDistance = pMP->GetMinDistanceInvariance();
@@ -738,21 +975,24 @@ namespace ORB_SLAM2 {
 
                     const cv::Mat dMP = pMP->GetDescriptor();
 
-                    int bestDist = 256;
-                    int bestIdx2 = -1;
-
+                    vCandidates.clear();
                     for (vector<size_t>::const_iterator vit = vIndices2.begin(); vit != vIndices2.end(); vit++) {
-                        const size_t i2 = *vit;
-                        if (CurrentFrame.mvpMapPoints[i2])
-                            continue;
+                        if (!CurrentFrame.mvpMapPoints[*vit])
+                            vCandidates.push_back(*vit);
+                    }
 
-                        const cv::Mat &d = CurrentFrame.mDescriptors.row(i2);
+                    vDistances.resize(vCandidates.size());
+                    HammingDistance::DistanceToMany(dMP.ptr<uint8_t>(), CurrentFrame.mDescriptors.ptr<uint8_t>(),
+                                                    CurrentFrame.mDescriptors.step[0], vCandidates.data(),
+                                                    vCandidates.size(), vDistances.data());
 
-                        const int dist = DescriptorDistance(dMP, d);
+                    int bestDist = 256;
+                    int bestIdx2 = -1;
 
-                        if (dist < bestDist) {
-                            bestDist = dist;
-                            bestIdx2 = i2;
+                    for (size_t iC = 0; iC < vCandidates.size(); iC++) {
+                        if (vDistances[iC] < bestDist) {
+                            bestDist = vDistances[iC];
+                            bestIdx2 = vCandidates[iC];
                         }
                     }
 
@@ -830,22 +1070,8 @@ namespace ORB_SLAM2 {
     }
 
 
-// Bit set count operation from
-// http://graphics.stanford.edu/~seander/bithacks.html#CountBitsSetParallel
     int ORBmatcher::DescriptorDistance(const cv::Mat &a, const cv::Mat &b) {
-        const int *pa = a.ptr<int32_t>();
-        const int *pb = b.ptr<int32_t>();
-
-        int dist = 0;
-
-        for (int i = 0; i < 8; i++, pa++, pb++) {
-            unsigned int v = *pa ^ *pb;
-            v = v - ((v >> 1) & 0x55555555);
-            v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
-            dist += (((v + (v >> 4)) & 0xF0F0F0F) * 0x1010101) >> 24;
-        }
-
-        return dist;
+        return HammingDistance::Distance(a, b);
     }
 
 } //namespace ORB_SLAM
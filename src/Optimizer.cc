@@ -25,6 +25,7 @@
 #include "Thirdparty/g2o/g2o/types/types_six_dof_expmap.h"
 #include "Thirdparty/g2o/g2o/core/robust_kernel_impl.h"
 #include "Thirdparty/g2o/g2o/solvers/linear_solver_dense.h"
+#include "Thirdparty/g2o/g2o/solvers/linear_solver_eigen.h"
 #include "Thirdparty/g2o/g2o/types/plane_3d.h"
 
 #include<Eigen/StdVector>
@@ -44,14 +45,10 @@ using namespace g2o;
 namespace ORB_SLAM2 {
 
     Optimizer::Optimizer(double angleInfo, double disInfo, double parInfo, double verInfo, double planeChi,
-                         double planeChiVP, double aTh, double parTh) : angleInfo(angleInfo), disInfo(disInfo),
-                                                                        parInfo(parInfo),
-                                                                        verInfo(verInfo), planeChi(planeChi),
-                                                                        planeChiVP(planeChiVP), aTh(aTh),
-                                                                        parTh(parTh) {}
-
-    int Optimizer::PoseOptimization(Frame *pFrame) {
-        g2o::SparseOptimizer optimizer;
+                         double planeChiVP, double aTh, double parTh, bool bG2oPoseOptimization)
+            : angleInfo(angleInfo), disInfo(disInfo), parInfo(parInfo), verInfo(verInfo), planeChi(planeChi),
+              planeChiVP(planeChiVP), aTh(aTh), parTh(parTh), mbG2oPoseOptimization(bG2oPoseOptimization),
+              mPoseSolver(angleInfo, disInfo, parInfo, verInfo, planeChi, planeChiVP, aTh, parTh) {
         g2o::BlockSolver_6_3::LinearSolverType *linearSolver;
 
         linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
@@ -59,16 +56,58 @@ namespace ORB_SLAM2 {
         g2o::BlockSolver_6_3 *solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
 
         g2o::OptimizationAlgorithmLevenberg *solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-        optimizer.setAlgorithm(solver);
+        mPoseOptimizer.setAlgorithm(solver);
+
+        mpPoseVertex = new g2o::VertexSE3Expmap();
+        mpPoseVertex->setId(0);
+        mpPoseVertex->setFixed(false);
+        mPoseOptimizer.addVertex(mpPoseVertex);
+
+        g2o::BlockSolver_6_3::LinearSolverType *linearSolverBA;
+
+        linearSolverBA = new g2o::LinearSolverEigen<g2o::BlockSolver_6_3::PoseMatrixType>();
+
+        g2o::BlockSolver_6_3 *solver_ptr_BA = new g2o::BlockSolver_6_3(linearSolverBA);
+
+        g2o::OptimizationAlgorithmLevenberg *solverBA = new g2o::OptimizationAlgorithmLevenberg(solver_ptr_BA);
+        mLocalBAOptimizer.setAlgorithm(solverBA);
+    }
+
+    void Optimizer::ResetPosePools() {
+        mPoolMono.Reset();
+        mPoolStereo.Reset();
+        mPoolLine.Reset();
+        mPoolPlane.Reset();
+        mPoolParPlane.Reset();
+        mPoolVerPlane.Reset();
+        mPoolMonoTrans.Reset();
+        mPoolStereoTrans.Reset();
+        mPoolLineTrans.Reset();
+        mPoolPlaneTrans.Reset();
+    }
+
+    size_t Optimizer::NumPoseEdges() const {
+        return mPoolMono.size() + mPoolStereo.size() + mPoolLine.size() + mPoolPlane.size() + mPoolParPlane.size() +
+               mPoolVerPlane.size() + mPoolMonoTrans.size() + mPoolStereoTrans.size() + mPoolLineTrans.size() +
+               mPoolPlaneTrans.size();
+    }
+
+    int Optimizer::PoseOptimization(Frame *pFrame) {
+        if (mbG2oPoseOptimization)
+            return PoseOptimizationG2o(pFrame);
+
+        return mPoseSolver.PoseOptimization(pFrame);
+    }
+
+    int Optimizer::PoseOptimizationG2o(Frame *pFrame) {
+        g2o::SparseOptimizer &optimizer = mPoseOptimizer;
+        ResetPosePools();
 
         int nInitialCorrespondences = 0;
 
         // Set Frame vertex
-        g2o::VertexSE3Expmap *vSE3 = new g2o::VertexSE3Expmap();
+        g2o::VertexSE3Expmap *vSE3 = mpPoseVertex;
         vSE3->setEstimate(Converter::toSE3Quat(pFrame->mTcw));
-        vSE3->setId(0);
-        vSE3->setFixed(false);
-        optimizer.addVertex(vSE3);
 
         // Set MapPoint vertices
         const int N = pFrame->N;
@@ -105,16 +144,13 @@ namespace ORB_SLAM2 {
                         const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
                         obs << kpUn.pt.x, kpUn.pt.y;
 
-                        g2o::EdgeSE3ProjectXYZOnlyPose *e = new g2o::EdgeSE3ProjectXYZOnlyPose();
+                        g2o::EdgeSE3ProjectXYZOnlyPose *e = mPoolMono.Get(optimizer, vSE3);
 
-                        e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
                         e->setMeasurement(obs);
                         const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
                         e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
 
-                        g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                        e->setRobustKernel(rk);
-                        rk->setDelta(deltaMono);
+                        e->robustKernel()->setDelta(deltaMono);
 
                         e->fx = pFrame->fx;
                         e->fy = pFrame->fy;
@@ -125,8 +161,6 @@ namespace ORB_SLAM2 {
                         e->Xw[1] = Xw.at<float>(1);
                         e->Xw[2] = Xw.at<float>(2);
 
-                        optimizer.addEdge(e);
-
                         vpEdgesMono.push_back(e);
                         vnIndexEdgeMono.push_back(i);
                     } else  // Stereo observation
@@ -140,17 +174,14 @@ namespace ORB_SLAM2 {
                         const float &kp_ur = pFrame->mvuRight[i];
                         obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-                        g2o::EdgeStereoSE3ProjectXYZOnlyPose *e = new g2o::EdgeStereoSE3ProjectXYZOnlyPose();
+                        g2o::EdgeStereoSE3ProjectXYZOnlyPose *e = mPoolStereo.Get(optimizer, vSE3);
 
-                        e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
                         e->setMeasurement(obs);
                         const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
                         Eigen::Matrix3d Info = Eigen::Matrix3d::Identity() * invSigma2;
                         e->setInformation(Info);
 
-                        g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                        e->setRobustKernel(rk);
-                        rk->setDelta(deltaStereo);
+                        e->robustKernel()->setDelta(deltaStereo);
 
                         e->fx = pFrame->fx;
                         e->fy = pFrame->fy;
@@ -162,8 +193,6 @@ namespace ORB_SLAM2 {
                         e->Xw[1] = Xw.at<float>(1);
                         e->Xw[2] = Xw.at<float>(2);
 
-                        optimizer.addEdge(e);
-
                         vpEdgesStereo.push_back(e);
                         vnIndexEdgeStereo.push_back(i);
                     }
@@ -202,15 +231,12 @@ namespace ORB_SLAM2 {
                     Eigen::Vector3d line_obs;
                     line_obs = pFrame->mvKeyLineFunctions[i];
 
-                    EdgeLineProjectXYZOnlyPose *els = new EdgeLineProjectXYZOnlyPose();
+                    EdgeLineProjectXYZOnlyPose *els = mPoolLine.Get(optimizer, vSE3);
 
-                    els->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
                     els->setMeasurement(line_obs);
                     els->setInformation(Eigen::Matrix3d::Identity() * 1);
 
-                    g2o::RobustKernelHuber *rk_line_s = new g2o::RobustKernelHuber;
-                    els->setRobustKernel(rk_line_s);
-                    rk_line_s->setDelta(deltaStereo);
+                    els->robustKernel()->setDelta(deltaStereo);
 
                     els->fx = pFrame->fx;
                     els->fy = pFrame->fy;
@@ -218,20 +244,16 @@ namespace ORB_SLAM2 {
                     els->cy = pFrame->cy;
 
                     els->Xw = pML->mWorldPos.head(3);
-                    optimizer.addEdge(els);
 
                     vpEdgesLineSp.push_back(els);
                     vnIndexLineEdgeSp.push_back(i);
 
-                    EdgeLineProjectXYZOnlyPose *ele = new EdgeLineProjectXYZOnlyPose();
+                    EdgeLineProjectXYZOnlyPose *ele = mPoolLine.Get(optimizer, vSE3);
 
-                    ele->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
                     ele->setMeasurement(line_obs);
                     ele->setInformation(Eigen::Matrix3d::Identity() * 1);
 
-                    g2o::RobustKernelHuber *rk_line_e = new g2o::RobustKernelHuber;
-                    ele->setRobustKernel(rk_line_e);
-                    rk_line_e->setDelta(deltaStereo);
+                    ele->robustKernel()->setDelta(deltaStereo);
 
                     ele->fx = pFrame->fx;
                     ele->fy = pFrame->fy;
@@ -240,8 +262,6 @@ namespace ORB_SLAM2 {
 
                     ele->Xw = pML->mWorldPos.tail(3);
 
-                    optimizer.addEdge(ele);
-
                     vpEdgesLineEp.push_back(ele);
                     vnIndexLineEdgeEp.push_back(i);
                 }
@@ -274,8 +294,7 @@ namespace ORB_SLAM2 {
                     nInitialCorrespondences++;
                     pFrame->mvbPlaneOutlier[i] = false;
 
-                    g2o::EdgePlaneOnlyPose *e = new g2o::EdgePlaneOnlyPose();
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
+                    g2o::EdgePlaneOnlyPose *e = mPoolPlane.Get(optimizer, vSE3);
                     e->setMeasurement(Converter::toPlane3D(pFrame->mvPlaneCoefficients[i]));
                     Eigen::Matrix3d Info;
                     Info << angleInfo, 0, 0,
@@ -283,9 +302,7 @@ namespace ORB_SLAM2 {
                             0, 0, disInfo;
                     e->setInformation(Info);
 
-                    g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(sqrt(planeChi));
+                    e->robustKernel()->setDelta(sqrt(planeChi));
 
                     Isometry3D trans = static_cast<const VertexSE3Expmap *>(optimizer.vertex(0))->estimate();
                     cv::Mat Pc3D = pFrame->mvPlaneCoefficients[i];
@@ -306,8 +323,6 @@ namespace ORB_SLAM2 {
 
                     e->Xw = Pw3D;
 
-                    optimizer.addEdge(e);
-
                     vpEdgesPlane.push_back(e);
                     vnIndexEdgePlane.push_back(i);
 
@@ -322,8 +337,7 @@ namespace ORB_SLAM2 {
                     nInitialCorrespondences++;
                     pFrame->mvbParPlaneOutlier[i] = false;
 
-                    g2o::EdgeParallelPlaneOnlyPose *e = new g2o::EdgeParallelPlaneOnlyPose();
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
+                    g2o::EdgeParallelPlaneOnlyPose *e = mPoolParPlane.Get(optimizer, vSE3);
                     e->setMeasurement(Converter::toPlane3D(pFrame->mvPlaneCoefficients[i]));
                     Eigen::Matrix2d Info;
                     Info << parInfo, 0,
@@ -331,9 +345,7 @@ namespace ORB_SLAM2 {
 
                     e->setInformation(Info);
 
-                    g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(sqrt(planeChiVP));
+                    e->robustKernel()->setDelta(sqrt(planeChiVP));
 
                     Isometry3D trans = static_cast<const VertexSE3Expmap *>(optimizer.vertex(0))->estimate();
                     cv::Mat Pc3D = pFrame->mvPlaneCoefficients[i];
@@ -354,8 +366,6 @@ namespace ORB_SLAM2 {
 
                     e->Xw = Pw3D;
 
-                    optimizer.addEdge(e);
-
                     vpEdgesParPlane.push_back(e);
                     vnIndexEdgeParPlane.push_back(i);
 
@@ -370,8 +380,7 @@ namespace ORB_SLAM2 {
                     nInitialCorrespondences++;
                     pFrame->mvbVerPlaneOutlier[i] = false;
 
-                    g2o::EdgeVerticalPlaneOnlyPose *e = new g2o::EdgeVerticalPlaneOnlyPose();
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
+                    g2o::EdgeVerticalPlaneOnlyPose *e = mPoolVerPlane.Get(optimizer, vSE3);
                     e->setMeasurement(Converter::toPlane3D(pFrame->mvPlaneCoefficients[i]));
                     Eigen::Matrix2d Info;
                     Info << verInfo, 0,
@@ -379,14 +388,10 @@ namespace ORB_SLAM2 {
 
                     e->setInformation(Info);
 
-                    g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    rk->setDelta(sqrt(planeChiVP));
+                    e->robustKernel()->setDelta(sqrt(planeChiVP));
 
                     e->Xw = Converter::toPlane3D(pMP->GetWorldPos());
 
-                    optimizer.addEdge(e);
-
                     vpEdgesVerPlane.push_back(e);
                     vnIndexEdgeVerPlane.push_back(i);
 
@@ -436,7 +441,7 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2)
-                    e->setRobustKernel(0);
+                    DisableRobustKernel(e);
             }
 
             for (size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++) {
@@ -461,7 +466,7 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2)
-                    e->setRobustKernel(0);
+                    DisableRobustKernel(e);
             }
             for (size_t i = 0, iend = vpEdgesLineSp.size(); i < iend; i++) {
                 EdgeLineProjectXYZOnlyPose *e1 = vpEdgesLineSp[i];
@@ -494,8 +499,8 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2) {
-                    e1->setRobustKernel(0);
-                    e2->setRobustKernel(0);
+                    DisableRobustKernel(e1);
+                    DisableRobustKernel(e2);
                 }
             }
 
@@ -526,7 +531,7 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2)
-                    e->setRobustKernel(0);
+                    DisableRobustKernel(e);
             }
 
             for (size_t i = 0, iend = vpEdgesParPlane.size(); i < iend; i++) {
@@ -550,7 +555,7 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2)
-                    e->setRobustKernel(0);
+                    DisableRobustKernel(e);
             }
 
             for (size_t i = 0, iend = vpEdgesVerPlane.size(); i < iend; i++) {
@@ -574,10 +579,10 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2)
-                    e->setRobustKernel(0);
+                    DisableRobustKernel(e);
             }
 
-            if (optimizer.edges().size() < 10)
+            if (NumPoseEdges() < 10)
                 break;
         }
 
@@ -590,24 +595,14 @@ namespace ORB_SLAM2 {
     }
 
     int Optimizer::TranslationOptimization(ORB_SLAM2::Frame *pFrame) {
-        g2o::SparseOptimizer optimizer;
-        g2o::BlockSolver_6_3::LinearSolverType *linearSolver;
-
-        linearSolver = new g2o::LinearSolverDense<g2o::BlockSolver_6_3::PoseMatrixType>();
-
-        g2o::BlockSolver_6_3 *solver_ptr = new g2o::BlockSolver_6_3(linearSolver);
-
-        g2o::OptimizationAlgorithmLevenberg *solver = new g2o::OptimizationAlgorithmLevenberg(solver_ptr);
-        optimizer.setAlgorithm(solver);
+        g2o::SparseOptimizer &optimizer = mPoseOptimizer;
+        ResetPosePools();
 
         int nInitialCorrespondences = 0;
 
         // Set Frame vertex
-        g2o::VertexSE3Expmap *vSE3 = new g2o::VertexSE3Expmap();
+        g2o::VertexSE3Expmap *vSE3 = mpPoseVertex;
         vSE3->setEstimate(Converter::toSE3Quat(pFrame->mTcw));
-        vSE3->setId(0);
-        vSE3->setFixed(false);
-        optimizer.addVertex(vSE3);
 
         // Set MapPoint vertices
         const int N = pFrame->N;
@@ -644,16 +639,13 @@ namespace ORB_SLAM2 {
                         const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
                         obs << kpUn.pt.x, kpUn.pt.y;
 
-                        g2o::EdgeSE3ProjectXYZOnlyTranslation *e = new g2o::EdgeSE3ProjectXYZOnlyTranslation();
+                        g2o::EdgeSE3ProjectXYZOnlyTranslation *e = mPoolMonoTrans.Get(optimizer, vSE3);
 
-                        e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
                         e->setMeasurement(obs);
                         const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
                         e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
 
-                        g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                        e->setRobustKernel(rk);
-                        rk->setDelta(deltaMono);
+                        e->robustKernel()->setDelta(deltaMono);
 
                         e->fx = pFrame->fx;
                         e->fy = pFrame->fy;
@@ -667,8 +659,6 @@ namespace ORB_SLAM2 {
                         e->Xc[2] = Xc.at<float>(2);
 
 
-                        optimizer.addEdge(e);
-
                         vpEdgesMono.push_back(e);
                         vnIndexEdgeMono.push_back(i);
                     } else  // Stereo observation
@@ -682,17 +672,14 @@ namespace ORB_SLAM2 {
                         const float &kp_ur = pFrame->mvuRight[i];
                         obs << kpUn.pt.x, kpUn.pt.y, kp_ur;
 
-                        g2o::EdgeStereoSE3ProjectXYZOnlyTranslation *e = new g2o::EdgeStereoSE3ProjectXYZOnlyTranslation();
+                        g2o::EdgeStereoSE3ProjectXYZOnlyTranslation *e = mPoolStereoTrans.Get(optimizer, vSE3);
 
-                        e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
                         e->setMeasurement(obs);
                         const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
                         Eigen::Matrix3d Info = Eigen::Matrix3d::Identity() * invSigma2;
                         e->setInformation(Info);
 
-                        g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                        e->setRobustKernel(rk);
-                        rk->setDelta(deltaStereo);
+                        e->robustKernel()->setDelta(deltaStereo);
 
                         e->fx = pFrame->fx;
                         e->fy = pFrame->fy;
@@ -706,8 +693,6 @@ namespace ORB_SLAM2 {
                         e->Xc[1] = Xc.at<float>(1);
                         e->Xc[2] = Xc.at<float>(2);
 
-                        optimizer.addEdge(e);
-
                         vpEdgesStereo.push_back(e);
                         vnIndexEdgeStereo.push_back(i);
                     }
@@ -737,15 +722,12 @@ namespace ORB_SLAM2 {
                     Eigen::Vector3d line_obs;
                     line_obs = pFrame->mvKeyLineFunctions[i];
 
-                    EdgeLineProjectXYZOnlyTranslation *els = new EdgeLineProjectXYZOnlyTranslation();
+                    EdgeLineProjectXYZOnlyTranslation *els = mPoolLineTrans.Get(optimizer, vSE3);
 
-                    els->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
                     els->setMeasurement(line_obs);
                     els->setInformation(Eigen::Matrix3d::Identity() * 1);//*vSteroStartPointInfo[i]);
 
-                    g2o::RobustKernelHuber *rk_line_s = new g2o::RobustKernelHuber;
-                    els->setRobustKernel(rk_line_s);
-                    rk_line_s->setDelta(deltaStereo);
+                    els->robustKernel()->setDelta(deltaStereo);
 
                     els->fx = pFrame->fx;
                     els->fy = pFrame->fy;
@@ -758,20 +740,15 @@ namespace ORB_SLAM2 {
                     els->Xc[1] = Xc.at<float>(1);
                     els->Xc[2] = Xc.at<float>(2);
 
-                    optimizer.addEdge(els);
-
                     vpEdgesLineSp.push_back(els);
                     vnIndexLineEdgeSp.push_back(i);
 
-                    EdgeLineProjectXYZOnlyTranslation *ele = new EdgeLineProjectXYZOnlyTranslation();
+                    EdgeLineProjectXYZOnlyTranslation *ele = mPoolLineTrans.Get(optimizer, vSE3);
 
-                    ele->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
                     ele->setMeasurement(line_obs);
                     ele->setInformation(Eigen::Matrix3d::Identity() * 1);//vSteroEndPointInfo[i]);
 
-                    g2o::RobustKernelHuber *rk_line_e = new g2o::RobustKernelHuber;
-                    ele->setRobustKernel(rk_line_e);
-                    rk_line_e->setDelta(deltaStereo);
+                    ele->robustKernel()->setDelta(deltaStereo);
 
                     ele->fx = pFrame->fx;
                     ele->fy = pFrame->fy;
@@ -785,8 +762,6 @@ namespace ORB_SLAM2 {
                     ele->Xc[2] = Xc.at<float>(2);
 
 
-                    optimizer.addEdge(ele);
-
                     vpEdgesLineEp.push_back(ele);
                 }
             }
@@ -823,8 +798,7 @@ namespace ORB_SLAM2 {
                 if (pMP) {
                     pFrame->mvbPlaneOutlier[i] = false;
 
-                    g2o::EdgePlaneOnlyTranslation *e = new g2o::EdgePlaneOnlyTranslation();
-                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(0)));
+                    g2o::EdgePlaneOnlyTranslation *e = mPoolPlaneTrans.Get(optimizer, vSE3);
                     e->setMeasurement(Converter::toPlane3D(pFrame->mvPlaneCoefficients[i]));
                     //TODO
                     Eigen::Matrix3d Info;
@@ -853,12 +827,7 @@ namespace ORB_SLAM2 {
                     Pw3D.rotateNormal(Converter::toMatrix3d(R_cw));
                     e->Xc = Pw3D;
 
-                    g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
-                    e->setRobustKernel(rk);
-                    //TODO
-                    rk->setDelta(sqrt(planeChi));
-
-                    optimizer.addEdge(e);
+                    e->robustKernel()->setDelta(sqrt(planeChi));
 
                     vpEdgesPlane.push_back(e);
                     vnIndexEdgePlane.push_back(i);
@@ -906,7 +875,7 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2)
-                    e->setRobustKernel(0);
+                    DisableRobustKernel(e);
             }
 
             for (size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++) {
@@ -930,7 +899,7 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2)
-                    e->setRobustKernel(0);
+                    DisableRobustKernel(e);
             }
 
             nLineBad = 0;
@@ -960,8 +929,8 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2) {
-                    e1->setRobustKernel(0);
-                    e2->setRobustKernel(0);
+                    DisableRobustKernel(e1);
+                    DisableRobustKernel(e2);
                 }
             }
 
@@ -992,10 +961,10 @@ namespace ORB_SLAM2 {
                 }
 
                 if (it == 2)
-                    e->setRobustKernel(0);
+                    DisableRobustKernel(e);
             }
 
-            if (optimizer.edges().size() < 10)
+            if (NumPoseEdges() < 10)
                 break;
         }
 
@@ -1007,4 +976,550 @@ namespace ORB_SLAM2 {
 
         return nInitialCorrespondences - nBad;
     }
+
+    void Optimizer::LocalBundleAdjustment(KeyFrame *pKF, bool *pbStopFlag, Map *pMap) {
+        // Local KeyFrames: First Breath Search from Current Keyframe
+        list<KeyFrame *> lLocalKeyFrames;
+
+        lLocalKeyFrames.push_back(pKF);
+        pKF->mnBALocalForKF = pKF->mnId;
+
+        const vector<KeyFrame *> vNeighKFs = pKF->GetVectorCovisibleKeyFrames();
+        for (auto pKFi : vNeighKFs) {
+            pKFi->mnBALocalForKF = pKF->mnId;
+            if (!pKFi->isBad())
+                lLocalKeyFrames.push_back(pKFi);
+        }
+
+        // Local MapPoints and MapLines seen in Local KeyFrames
+        list<MapPoint *> lLocalMapPoints;
+        list<MapLine *> lLocalMapLines;
+        for (auto pKFi : lLocalKeyFrames) {
+            vector<MapPoint *> vpMPs = pKFi->GetMapPointMatches();
+            for (auto pMP : vpMPs) {
+                if (pMP && !pMP->isBad() && pMP->mnBALocalForKF != pKF->mnId) {
+                    lLocalMapPoints.push_back(pMP);
+                    pMP->mnBALocalForKF = pKF->mnId;
+                }
+            }
+
+            vector<MapLine *> vpMLs = pKFi->GetMapLineMatches();
+            for (auto pML : vpMLs) {
+                if (pML && !pML->isBad() && pML->mnBALocalForKF != pKF->mnId) {
+                    lLocalMapLines.push_back(pML);
+                    pML->mnBALocalForKF = pKF->mnId;
+                }
+            }
+        }
+
+        // Fixed Keyframes. Keyframes that see Local MapPoints or MapLines but that are not Local Keyframes
+        list<KeyFrame *> lFixedCameras;
+        auto addFixedCameras = [&](const map<KeyFrame *, size_t> &observations) {
+            for (const auto &obs : observations) {
+                KeyFrame *pKFi = obs.first;
+                if (pKFi->mnBALocalForKF != pKF->mnId && pKFi->mnBAFixedForKF != pKF->mnId) {
+                    pKFi->mnBAFixedForKF = pKF->mnId;
+                    if (!pKFi->isBad())
+                        lFixedCameras.push_back(pKFi);
+                }
+            }
+        };
+        for (auto pMP : lLocalMapPoints)
+            addFixedCameras(pMP->GetObservations());
+        for (auto pML : lLocalMapLines)
+            addFixedCameras(pML->GetObservations());
+
+        // Setup optimizer, dropping the graph of the previous call
+        g2o::SparseOptimizer &optimizer = mLocalBAOptimizer;
+        optimizer.clear();
+        optimizer.setForceStopFlag(pbStopFlag);
+
+        unsigned long maxKFid = 0;
+
+        // Set Local KeyFrame vertices
+        for (auto pKFi : lLocalKeyFrames) {
+            g2o::VertexSE3Expmap *vSE3 = new g2o::VertexSE3Expmap();
+            vSE3->setEstimate(Converter::toSE3Quat(pKFi->GetPose()));
+            vSE3->setId(pKFi->mnId);
+            vSE3->setFixed(pKFi->mnId == 0);
+            optimizer.addVertex(vSE3);
+            if (pKFi->mnId > maxKFid)
+                maxKFid = pKFi->mnId;
+        }
+
+        // Set Fixed KeyFrame vertices
+        for (auto pKFi : lFixedCameras) {
+            g2o::VertexSE3Expmap *vSE3 = new g2o::VertexSE3Expmap();
+            vSE3->setEstimate(Converter::toSE3Quat(pKFi->GetPose()));
+            vSE3->setId(pKFi->mnId);
+            vSE3->setFixed(true);
+            optimizer.addVertex(vSE3);
+            if (pKFi->mnId > maxKFid)
+                maxKFid = pKFi->mnId;
+        }
+
+        // MapLine endpoints are numbered after every MapPoint created so far
+        unsigned long maxMPid;
+        {
+            unique_lock<mutex> lock(pMap->mMutexPointCreation);
+            maxMPid = MapPoint::nNextId;
+        }
+        const unsigned long lineIdOffset = maxKFid + 1 + maxMPid;
+
+        const float thHuberMono = sqrt(5.991);
+        const float thHuberStereo = sqrt(7.815);
+        // Information of the line endpoint priors, weak next to the pixel residuals of the line observations
+        const double lineEndpointPriorInfo = 1.0;
+
+        // Set MapPoint vertices
+        const int nExpectedSize = (lLocalKeyFrames.size() + lFixedCameras.size()) * lLocalMapPoints.size();
+
+        vector<g2o::EdgeSE3ProjectXYZ *> vpEdgesMono;
+        vpEdgesMono.reserve(nExpectedSize);
+        vector<KeyFrame *> vpEdgeKFMono;
+        vpEdgeKFMono.reserve(nExpectedSize);
+        vector<MapPoint *> vpMapPointEdgeMono;
+        vpMapPointEdgeMono.reserve(nExpectedSize);
+        vector<size_t> vnIndexEdgeMono;
+        vnIndexEdgeMono.reserve(nExpectedSize);
+
+        vector<g2o::EdgeStereoSE3ProjectXYZ *> vpEdgesStereo;
+        vpEdgesStereo.reserve(nExpectedSize);
+        vector<KeyFrame *> vpEdgeKFStereo;
+        vpEdgeKFStereo.reserve(nExpectedSize);
+        vector<MapPoint *> vpMapPointEdgeStereo;
+        vpMapPointEdgeStereo.reserve(nExpectedSize);
+        vector<size_t> vnIndexEdgeStereo;
+        vnIndexEdgeStereo.reserve(nExpectedSize);
+
+        for (auto pMP : lLocalMapPoints) {
+            g2o::VertexSBAPointXYZ *vPoint = new g2o::VertexSBAPointXYZ();
+            cv::Mat Xw = pMP->GetWorldPos();
+            vPoint->setEstimate(Vector3d(Xw.at<float>(0), Xw.at<float>(1), Xw.at<float>(2)));
+            const int id = pMP->mnId + maxKFid + 1;
+            vPoint->setId(id);
+            vPoint->setMarginalized(true);
+            optimizer.addVertex(vPoint);
+
+            const map<KeyFrame *, size_t> observations = pMP->GetObservations();
+
+            //Set edges
+            for (const auto &obs : observations) {
+                KeyFrame *pKFi = obs.first;
+
+                if (pKFi->isBad())
+                    continue;
+
+                const cv::KeyPoint &kpUn = pKFi->mvKeysUn[obs.second];
+
+                // Monocular observation
+                if (pKFi->mvuRight[obs.second] < 0) {
+                    Eigen::Matrix<double, 2, 1> obs2d;
+                    obs2d << kpUn.pt.x, kpUn.pt.y;
+
+                    g2o::EdgeSE3ProjectXYZ *e = new g2o::EdgeSE3ProjectXYZ();
+
+                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(id)));
+                    e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(pKFi->mnId)));
+                    e->setMeasurement(obs2d);
+                    const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
+                    e->setInformation(Eigen::Matrix2d::Identity() * invSigma2);
+
+                    g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
+                    e->setRobustKernel(rk);
+                    rk->setDelta(thHuberMono);
+
+                    e->fx = pKFi->fx;
+                    e->fy = pKFi->fy;
+                    e->cx = pKFi->cx;
+                    e->cy = pKFi->cy;
+
+                    optimizer.addEdge(e);
+                    vpEdgesMono.push_back(e);
+                    vpEdgeKFMono.push_back(pKFi);
+                    vpMapPointEdgeMono.push_back(pMP);
+                    vnIndexEdgeMono.push_back(obs.second);
+                } else // Stereo observation
+                {
+                    Eigen::Matrix<double, 3, 1> obs3d;
+                    const float kp_ur = pKFi->mvuRight[obs.second];
+                    obs3d << kpUn.pt.x, kpUn.pt.y, kp_ur;
+
+                    g2o::EdgeStereoSE3ProjectXYZ *e = new g2o::EdgeStereoSE3ProjectXYZ();
+
+                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(id)));
+                    e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(pKFi->mnId)));
+                    e->setMeasurement(obs3d);
+                    const float &invSigma2 = pKFi->mvInvLevelSigma2[kpUn.octave];
+                    Eigen::Matrix3d Info = Eigen::Matrix3d::Identity() * invSigma2;
+                    e->setInformation(Info);
+
+                    g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
+                    e->setRobustKernel(rk);
+                    rk->setDelta(thHuberStereo);
+
+                    e->fx = pKFi->fx;
+                    e->fy = pKFi->fy;
+                    e->cx = pKFi->cx;
+                    e->cy = pKFi->cy;
+                    e->bf = pKFi->mbf;
+
+                    optimizer.addEdge(e);
+                    vpEdgesStereo.push_back(e);
+                    vpEdgeKFStereo.push_back(pKFi);
+                    vpMapPointEdgeStereo.push_back(pMP);
+                    vnIndexEdgeStereo.push_back(obs.second);
+                }
+            }
+        }
+
+        // Set MapLine vertices, one per endpoint, both observed through the line function in each keyframe
+        vector<EdgeLineProjectXYZ *> vpEdgesLineSp;
+        vector<EdgeLineProjectXYZ *> vpEdgesLineEp;
+        vector<KeyFrame *> vpEdgeKFLine;
+        vector<MapLine *> vpMapLineEdge;
+        vector<size_t> vnIndexEdgeLine;
+
+        for (auto pML : lLocalMapLines) {
+            const Vector6d Pos = pML->GetWorldPos();
+            const int idStart = lineIdOffset + 2 * pML->mnId;
+            const int idEnd = idStart + 1;
+
+            g2o::VertexSBAPointXYZ *vStart = new g2o::VertexSBAPointXYZ();
+            vStart->setEstimate(Pos.head(3));
+            vStart->setId(idStart);
+            vStart->setMarginalized(true);
+            optimizer.addVertex(vStart);
+
+            g2o::VertexSBAPointXYZ *vEnd = new g2o::VertexSBAPointXYZ();
+            vEnd->setEstimate(Pos.tail(3));
+            vEnd->setId(idEnd);
+            vEnd->setMarginalized(true);
+            optimizer.addVertex(vEnd);
+
+            // Anchor each endpoint along the line, the only direction the line observations do not constrain
+            const Vector3d direction = (Pos.tail(3) - Pos.head(3)).normalized();
+            if (direction.allFinite()) {
+                g2o::VertexSBAPointXYZ *vertices[2] = {vStart, vEnd};
+                for (int k = 0; k < 2; k++) {
+                    EdgeLineEndpointPrior *e = new EdgeLineEndpointPrior();
+                    e->setVertex(0, vertices[k]);
+                    e->setMeasurement(vertices[k]->estimate());
+                    e->direction = direction;
+                    e->setInformation(Eigen::Matrix<double, 1, 1>::Identity() * lineEndpointPriorInfo);
+                    optimizer.addEdge(e);
+                }
+            }
+
+            const map<KeyFrame *, size_t> observations = pML->GetObservations();
+
+            for (const auto &obs : observations) {
+                KeyFrame *pKFi = obs.first;
+
+                if (pKFi->isBad())
+                    continue;
+
+                const Eigen::Vector3d &line_obs = pKFi->mvKeyLineFunctions[obs.second];
+
+                EdgeLineProjectXYZ *edges[2];
+                const int ids[2] = {idStart, idEnd};
+                for (int k = 0; k < 2; k++) {
+                    EdgeLineProjectXYZ *e = new EdgeLineProjectXYZ();
+                    e->setVertex(0, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(ids[k])));
+                    e->setVertex(1, dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(pKFi->mnId)));
+                    e->setMeasurement(line_obs);
+                    e->setInformation(Eigen::Matrix3d::Identity() * 1);
+
+                    g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
+                    e->setRobustKernel(rk);
+                    rk->setDelta(thHuberStereo);
+
+                    e->fx = pKFi->fx;
+                    e->fy = pKFi->fy;
+                    e->cx = pKFi->cx;
+                    e->cy = pKFi->cy;
+
+                    optimizer.addEdge(e);
+                    edges[k] = e;
+                }
+
+                vpEdgesLineSp.push_back(edges[0]);
+                vpEdgesLineEp.push_back(edges[1]);
+                vpEdgeKFLine.push_back(pKFi);
+                vpMapLineEdge.push_back(pML);
+                vnIndexEdgeLine.push_back(obs.second);
+            }
+        }
+
+        // Plane observations of the local keyframes. MapPlanes are refitted from their point clouds,
+        // so here they constrain the keyframe poses only.
+        vector<g2o::EdgePlaneOnlyPose *> vpEdgesPlane;
+        vector<KeyFrame *> vpEdgeKFPlane;
+        vector<int> vnIndexEdgePlane;
+
+        vector<g2o::EdgeParallelPlaneOnlyPose *> vpEdgesParPlane;
+        vector<KeyFrame *> vpEdgeKFParPlane;
+        vector<int> vnIndexEdgeParPlane;
+
+        vector<g2o::EdgeVerticalPlaneOnlyPose *> vpEdgesVerPlane;
+        vector<KeyFrame *> vpEdgeKFVerPlane;
+        vector<int> vnIndexEdgeVerPlane;
+
+        {
+            unique_lock<mutex> lock(MapPlane::mGlobalMutex);
+
+            // Bring the map plane to the keyframe and flip it if it faces away from the observation
+            auto alignedPlane = [](const Isometry3D &trans, MapPlane *pMP, const cv::Mat &Pc3D, double th) {
+                Plane3D Pw3D = Converter::toPlane3D(pMP->GetWorldPos());
+                Vector4D Pw = Pw3D._coeffs;
+                Vector3D nc = trans.rotation() * Pw.head<3>();
+                double angle = nc(0) * Pc3D.at<float>(0) + nc(1) * Pc3D.at<float>(1) + nc(2) * Pc3D.at<float>(2);
+                if (angle < -th) {
+                    Pw = -Pw;
+                    Pw3D.fromVector(Pw);
+                }
+                return Pw3D;
+            };
+
+            Eigen::Matrix3d PlaneInfo;
+            PlaneInfo << angleInfo, 0, 0,
+                    0, angleInfo, 0,
+                    0, 0, disInfo;
+            Eigen::Matrix2d ParInfo = Eigen::Matrix2d::Identity() * parInfo;
+            Eigen::Matrix2d VerInfo = Eigen::Matrix2d::Identity() * verInfo;
+
+            for (auto pKFi : lLocalKeyFrames) {
+                g2o::OptimizableGraph::Vertex *vSE3 = dynamic_cast<g2o::OptimizableGraph::Vertex *>(optimizer.vertex(
+                        pKFi->mnId));
+                const Isometry3D trans = static_cast<const VertexSE3Expmap *>(vSE3)->estimate();
+                const vector<MapPlane *> vpMPs = pKFi->GetMapPlaneMatches();
+
+                for (int i = 0; i < pKFi->mnPlaneNum; ++i) {
+                    const cv::Mat &Pc3D = pKFi->mvPlaneCoefficients[i];
+
+                    MapPlane *pMP = vpMPs[i];
+                    if (pMP && !pMP->isBad()) {
+                        g2o::EdgePlaneOnlyPose *e = new g2o::EdgePlaneOnlyPose();
+                        e->setVertex(0, vSE3);
+                        e->setMeasurement(Converter::toPlane3D(Pc3D));
+                        e->setInformation(PlaneInfo);
+
+                        g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
+                        e->setRobustKernel(rk);
+                        rk->setDelta(sqrt(planeChi));
+
+                        e->Xw = alignedPlane(trans, pMP, Pc3D, aTh);
+
+                        optimizer.addEdge(e);
+                        vpEdgesPlane.push_back(e);
+                        vpEdgeKFPlane.push_back(pKFi);
+                        vnIndexEdgePlane.push_back(i);
+                    }
+
+                    pMP = pKFi->mvpParallelPlanes[i];
+                    if (pMP && !pMP->isBad()) {
+                        g2o::EdgeParallelPlaneOnlyPose *e = new g2o::EdgeParallelPlaneOnlyPose();
+                        e->setVertex(0, vSE3);
+                        e->setMeasurement(Converter::toPlane3D(Pc3D));
+                        e->setInformation(ParInfo);
+
+                        g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
+                        e->setRobustKernel(rk);
+                        rk->setDelta(sqrt(planeChiVP));
+
+                        e->Xw = alignedPlane(trans, pMP, Pc3D, parTh);
+
+                        optimizer.addEdge(e);
+                        vpEdgesParPlane.push_back(e);
+                        vpEdgeKFParPlane.push_back(pKFi);
+                        vnIndexEdgeParPlane.push_back(i);
+                    }
+
+                    pMP = pKFi->mvpVerticalPlanes[i];
+                    if (pMP && !pMP->isBad()) {
+                        g2o::EdgeVerticalPlaneOnlyPose *e = new g2o::EdgeVerticalPlaneOnlyPose();
+                        e->setVertex(0, vSE3);
+                        e->setMeasurement(Converter::toPlane3D(Pc3D));
+                        e->setInformation(VerInfo);
+
+                        g2o::RobustKernelHuber *rk = new g2o::RobustKernelHuber;
+                        e->setRobustKernel(rk);
+                        rk->setDelta(sqrt(planeChiVP));
+
+                        e->Xw = Converter::toPlane3D(pMP->GetWorldPos());
+
+                        optimizer.addEdge(e);
+                        vpEdgesVerPlane.push_back(e);
+                        vpEdgeKFVerPlane.push_back(pKFi);
+                        vnIndexEdgeVerPlane.push_back(i);
+                    }
+                }
+            }
+        }
+
+        if (pbStopFlag && *pbStopFlag)
+            return;
+
+        optimizer.initializeOptimization();
+        optimizer.optimize(5);
+
+        bool bDoMore = !(pbStopFlag && *pbStopFlag);
+
+        if (bDoMore) {
+            // Check inlier observations
+            for (size_t i = 0, iend = vpEdgesMono.size(); i < iend; i++) {
+                g2o::EdgeSE3ProjectXYZ *e = vpEdgesMono[i];
+                if (e->chi2() > 5.991 || !e->isDepthPositive())
+                    e->setLevel(1);
+                e->setRobustKernel(0);
+            }
+
+            for (size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++) {
+                g2o::EdgeStereoSE3ProjectXYZ *e = vpEdgesStereo[i];
+                if (e->chi2() > 7.815 || !e->isDepthPositive())
+                    e->setLevel(1);
+                e->setRobustKernel(0);
+            }
+
+            for (size_t i = 0, iend = vpEdgesLineSp.size(); i < iend; i++) {
+                EdgeLineProjectXYZ *e1 = vpEdgesLineSp[i];
+                EdgeLineProjectXYZ *e2 = vpEdgesLineEp[i];
+                if (e1->chiline() > 2 * 5.991 || e2->chiline() > 2 * 5.991) {
+                    e1->setLevel(1);
+                    e2->setLevel(1);
+                }
+                e1->setRobustKernel(0);
+                e2->setRobustKernel(0);
+            }
+
+            for (auto e : vpEdgesPlane) {
+                if (e->chi2() > planeChi)
+                    e->setLevel(1);
+                e->setRobustKernel(0);
+            }
+
+            for (auto e : vpEdgesParPlane) {
+                if (e->chi2() > planeChiVP)
+                    e->setLevel(1);
+                e->setRobustKernel(0);
+            }
+
+            for (auto e : vpEdgesVerPlane) {
+                if (e->chi2() > planeChiVP)
+                    e->setLevel(1);
+                e->setRobustKernel(0);
+            }
+
+            // Optimize again without the outliers
+            optimizer.initializeOptimization(0);
+            optimizer.optimize(10);
+        }
+
+        // Check inlier observations
+        vector<size_t> vMonoToErase, vStereoToErase;
+
+        for (size_t i = 0, iend = vpEdgesMono.size(); i < iend; i++) {
+            g2o::EdgeSE3ProjectXYZ *e = vpEdgesMono[i];
+            if (e->chi2() > 5.991 || !e->isDepthPositive())
+                vMonoToErase.push_back(i);
+        }
+
+        for (size_t i = 0, iend = vpEdgesStereo.size(); i < iend; i++) {
+            g2o::EdgeStereoSE3ProjectXYZ *e = vpEdgesStereo[i];
+            if (e->chi2() > 7.815 || !e->isDepthPositive())
+                vStereoToErase.push_back(i);
+        }
+
+        vector<size_t> vLineToErase;
+        for (size_t i = 0, iend = vpEdgesLineSp.size(); i < iend; i++) {
+            EdgeLineProjectXYZ *e1 = vpEdgesLineSp[i];
+            EdgeLineProjectXYZ *e2 = vpEdgesLineEp[i];
+            e1->computeError();
+            e2->computeError();
+            if (e1->chiline() > 2 * 5.991 || e2->chiline() > 2 * 5.991)
+                vLineToErase.push_back(i);
+        }
+
+        // Get Map Mutex
+        unique_lock<mutex> lock(pMap->mMutexMapUpdate);
+
+        for (auto i : vMonoToErase) {
+            KeyFrame *pKFi = vpEdgeKFMono[i];
+            pKFi->EraseMapPointMatch(vnIndexEdgeMono[i]);
+            vpMapPointEdgeMono[i]->EraseObservation(pKFi);
+        }
+
+        for (auto i : vStereoToErase) {
+            KeyFrame *pKFi = vpEdgeKFStereo[i];
+            pKFi->EraseMapPointMatch(vnIndexEdgeStereo[i]);
+            vpMapPointEdgeStereo[i]->EraseObservation(pKFi);
+        }
+
+        for (auto i : vLineToErase) {
+            KeyFrame *pKFi = vpEdgeKFLine[i];
+            MapLine *pMLi = vpMapLineEdge[i];
+            pKFi->EraseMapLineMatch(vnIndexEdgeLine[i]);
+            pMLi->EraseObservation(pKFi);
+        }
+
+        for (size_t i = 0, iend = vpEdgesPlane.size(); i < iend; i++) {
+            g2o::EdgePlaneOnlyPose *e = vpEdgesPlane[i];
+            if (e->chi2() > planeChi) {
+                KeyFrame *pKFi = vpEdgeKFPlane[i];
+                MapPlane *pMP = pKFi->GetMapPlaneMatches()[vnIndexEdgePlane[i]];
+                pKFi->EraseMapPlaneMatch(vnIndexEdgePlane[i]);
+                if (pMP)
+                    pMP->EraseObservation(pKFi);
+            }
+        }
+
+        for (size_t i = 0, iend = vpEdgesParPlane.size(); i < iend; i++) {
+            g2o::EdgeParallelPlaneOnlyPose *e = vpEdgesParPlane[i];
+            if (e->chi2() > planeChiVP) {
+                KeyFrame *pKFi = vpEdgeKFParPlane[i];
+                MapPlane *pMP = pKFi->mvpParallelPlanes[vnIndexEdgeParPlane[i]];
+                pKFi->EraseMapParallelPlaneMatch(vnIndexEdgeParPlane[i]);
+                if (pMP)
+                    pMP->EraseParObservation(pKFi);
+            }
+        }
+
+        for (size_t i = 0, iend = vpEdgesVerPlane.size(); i < iend; i++) {
+            g2o::EdgeVerticalPlaneOnlyPose *e = vpEdgesVerPlane[i];
+            if (e->chi2() > planeChiVP) {
+                KeyFrame *pKFi = vpEdgeKFVerPlane[i];
+                MapPlane *pMP = pKFi->mvpVerticalPlanes[vnIndexEdgeVerPlane[i]];
+                pKFi->EraseMapVerticalPlaneMatch(vnIndexEdgeVerPlane[i]);
+                if (pMP)
+                    pMP->EraseVerObservation(pKFi);
+            }
+        }
+
+        // Recover optimized data
+
+        //Keyframes
+        for (auto pKFi : lLocalKeyFrames) {
+            g2o::VertexSE3Expmap *vSE3 = static_cast<g2o::VertexSE3Expmap *>(optimizer.vertex(pKFi->mnId));
+            pKFi->SetPose(Converter::toCvMat(vSE3->estimate()));
+        }
+
+        //Points
+        for (auto pMP : lLocalMapPoints) {
+            g2o::VertexSBAPointXYZ *vPoint = static_cast<g2o::VertexSBAPointXYZ *>(optimizer.vertex(
+                    pMP->mnId + maxKFid + 1));
+            pMP->SetWorldPos(Converter::toCvVec(vPoint->estimate()));
+            pMP->UpdateNormalAndDepth();
+        }
+
+        //Lines
+        for (auto pML : lLocalMapLines) {
+            const int idStart = lineIdOffset + 2 * pML->mnId;
+            g2o::VertexSBAPointXYZ *vStart = static_cast<g2o::VertexSBAPointXYZ *>(optimizer.vertex(idStart));
+            g2o::VertexSBAPointXYZ *vEnd = static_cast<g2o::VertexSBAPointXYZ *>(optimizer.vertex(idStart + 1));
+            Vector6d Pos;
+            Pos << vStart->estimate(), vEnd->estimate();
+            pML->SetWorldPos(Pos);
+            pML->UpdateAverageDir();
+        }
+    }
 } //namespace ORB_SLAM
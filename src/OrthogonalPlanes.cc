@@ -0,0 +1,62 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OrthogonalPlanes.h"
+#include "MapPlane.h"
+
+using namespace std;
+
+namespace ORB_SLAM2 {
+
+    void OrthogonalPlanes::Compute(const vector<cv::Mat> &vCoefficients, const vector<MapPlane *> &vpMapPlanes,
+                                   float verTh) {
+        const int N = static_cast<int>(vCoefficients.size());
+        mfVerTh = verTh;
+        mvNormals.assign(N, Eigen::Vector3f::Zero());
+        mvCluster.assign(N, -1);
+        mvClusterPlanes.clear();
+
+        vector<Eigen::Vector3f> vClusterDirections;
+
+        // Greedy clustering, every normal is within CLUSTER_RADIUS of the first normal of its cluster (up to sign)
+        const float clusterCos = cos(CLUSTER_RADIUS);
+        for (int i = 0; i < N; i++) {
+            MapPlane *pMP = vpMapPlanes[i];
+            if (!pMP || pMP->isBad())
+                continue;
+
+            const cv::Mat &p3D = vCoefficients[i];
+            mvNormals[i] = Eigen::Vector3f(p3D.at<float>(0), p3D.at<float>(1), p3D.at<float>(2));
+
+            size_t c = 0;
+            for (; c < vClusterDirections.size(); c++)
+                if (fabs(mvNormals[i].dot(vClusterDirections[c])) >= clusterCos)
+                    break;
+
+            if (c == vClusterDirections.size()) {
+                vClusterDirections.push_back(mvNormals[i]);
+                mvClusterPlanes.emplace_back();
+            }
+            mvClusterPlanes[c].push_back(i);
+            mvCluster[i] = static_cast<int>(c);
+        }
+    }
+
+} //namespace ORB_SLAM
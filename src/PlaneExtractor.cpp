@@ -27,7 +27,6 @@ using namespace Eigen;
 PlaneDetection::PlaneDetection() {}
 
 PlaneDetection::~PlaneDetection() {
-    cloud.vertices.clear();
     seg_img_.release();
     color_img_.release();
 }
@@ -41,41 +40,56 @@ bool PlaneDetection::readColorImage(cv::Mat RGBImg) {
     return true;
 }
 
-bool PlaneDetection::readDepthImage(const cv::Mat depthImg, const cv::Mat &K, const float &depthMapFactor) {
-    cv::Mat depth_img = depthImg;
-    if (depth_img.empty() || depth_img.depth() != CV_16U) {
-        cout << "WARNING: cannot read depth image. No such a file, or the image format is not 16UC1" << endl;
+bool PlaneDetection::readPointCloud(const cv::Mat &pointCloud) {
+    if (pointCloud.empty() || pointCloud.type() != CV_32FC3) {
+        cout << "WARNING: cannot read point cloud. The image format is not 32FC3" << endl;
         return false;
     }
 
-    double width = ceil(depthImg.cols / 2.0);
-    double height = ceil(depthImg.rows / 2.0);
-    cloud.vertices.resize(height * width);
-    cloud.verticesColour.resize(height * width);
-    cloud.w = width;
-    cloud.h = height;
+    // The point cloud is back-projected once per frame (see DepthPreprocessor), here it is only subsampled
+    // by 2 and split into coordinate arrays.
+    const int width = (pointCloud.cols + 1) / 2;
+    const int height = (pointCloud.rows + 1) / 2;
+    cloud.resize(width, height);
 
     seg_img_ = cv::Mat(height, width, CV_8UC3);
 
-    int rows = depth_img.rows, cols = depth_img.cols;
-    int vertex_idx = 0;
-    for (int i = 0; i < rows; i += 2) {
-        for (int j = 0; j < cols; j += 2) {
-            double z = (double) (depth_img.at<unsigned short>(i, j)) * depthMapFactor;
-            if (_isnan(z)) {
-                cloud.vertices[vertex_idx++] = VertexType(0, 0, z);
-                continue;
-            }
-            double x = ((double) j - K.at<float>(0, 2)) * z / K.at<float>(0, 0);
-            double y = ((double) i - K.at<float>(1, 2)) * z / K.at<float>(1, 1);
-            cloud.verticesColour[vertex_idx] = color_img_.at<cv::Vec3b>(i, j);
-            cloud.vertices[vertex_idx++] = VertexType(x, y, z);
+    float *px = cloud.x.data();
+    float *py = cloud.y.data();
+    float *pz = cloud.z.data();
+    cv::Vec3b *pColour = cloud.colours.data();
+    for (int i = 0; i < height; i++) {
+        const cv::Vec3f *points = pointCloud.ptr<cv::Vec3f>(2 * i);
+        const cv::Vec3b *colours = color_img_.ptr<cv::Vec3b>(2 * i);
+        for (int j = 0; j < width; j++) {
+            const cv::Vec3f &p = points[2 * j];
+            px[j] = p[0];
+            py[j] = p[1];
+            pz[j] = p[2];
+            pColour[j] = colours[2 * j];
         }
+        px += width;
+        py += width;
+        pz += width;
+        pColour += width;
     }
     return true;
 }
 
-void PlaneDetection::runPlaneDetection() {
+void PlaneDetection::runPlaneDetection(const ahc::PlanePrior *pPrior) {
+    plane_filter.prior = pPrior;
     plane_filter.run(&cloud, &plane_vertices_, &seg_img_);
+    plane_filter.prior = NULL;
     plane_num_ = (int) plane_vertices_.size();
 }
+
+void PlaneDetection::exportPrior(ahc::PlanePrior &prior, const cv::Mat &K) const {
+    plane_filter.exportPrior(prior);
+    prior.setMotion(NULL, NULL);
+
+    // The cloud is subsampled by 2, pixel (u,v) of the cloud is pixel (2u,2v) of the image
+    prior.fx = 0.5 * K.at<float>(0, 0);
+    prior.fy = 0.5 * K.at<float>(1, 1);
+    prior.cx = 0.5 * K.at<float>(0, 2);
+    prior.cy = 0.5 * K.at<float>(1, 2);
+}
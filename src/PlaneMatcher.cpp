@@ -20,6 +20,9 @@
 
 #include "PlaneMatcher.h"
 
+#include <algorithm>
+#include <limits>
+
 using namespace std;
 using namespace cv;
 using namespace Eigen;
@@ -34,62 +37,90 @@ namespace ORB_SLAM2 {
         int nmatches = 0;
 
         for (int i = 0; i < pF.mnPlaneNum; ++i) {
+            cv::Mat pM = pF.ComputePlaneWorldCoeff(i);
+
+            if (SearchPlane(pF, i, pM, vpMapPlanes)) {
+                nmatches++;
+            }
+        }
+
+        return nmatches;
+    }
 
+    int PlaneMatcher::SearchMapByCoefficients(Frame &pF, Map *pMap) {
+        pF.mbNewPlane = false;
+
+        int nmatches = 0;
+
+        for (int i = 0; i < pF.mnPlaneNum; ++i) {
             cv::Mat pM = pF.ComputePlaneWorldCoeff(i);
+            const Eigen::Vector3f normal(pM.at<float>(0), pM.at<float>(1), pM.at<float>(2));
 
-            float ldTh = dTh;
-            float lverTh = verTh;
-            float lparTh = parTh;
+            // Only these planes can pass one of the angle tests of SearchPlane, kept in map order so the
+            // association is the same as with the whole map
+            vector<MapPlane *> vpCandidates = pMap->GetMapPlanesByNormal(normal, min(aTh, parTh), 2.0f);
+            vector<MapPlane *> vpVertical = pMap->GetMapPlanesByNormal(normal, -verTh, verTh);
+            vector<MapPlane *> vpOpposite = pMap->GetMapPlanesByNormal(normal, -2.0f, -parTh);
 
-            bool found = false;
-            int j = 0;
-            for (auto vpMapPlane : vpMapPlanes) {
-                if (vpMapPlane->isBad()) {
-                    j++;
-                    continue;
-                }
+            vpCandidates.insert(vpCandidates.end(), vpVertical.begin(), vpVertical.end());
+            vpCandidates.insert(vpCandidates.end(), vpOpposite.begin(), vpOpposite.end());
+            sort(vpCandidates.begin(), vpCandidates.end());
+            vpCandidates.erase(unique(vpCandidates.begin(), vpCandidates.end()), vpCandidates.end());
 
-                cv::Mat pW = vpMapPlane->GetWorldPos();
-
-                float angle = pM.at<float>(0) * pW.at<float>(0) +
-                              pM.at<float>(1) * pW.at<float>(1) +
-                              pM.at<float>(2) * pW.at<float>(2);
-                j++;
-
-                // Associate plane
-                if (angle > aTh) {
-                    double dis = PointDistanceFromPlane(pM, vpMapPlane->mvPlanePoints);
-                    if (dis < ldTh) {
-                        ldTh = dis;
-                        pF.mvpMapPlanes[i] = static_cast<MapPlane *>(nullptr);
-                        pF.mvpMapPlanes[i] = vpMapPlane;
-                        found = true;
-                        continue;
-                    }
-                }
+            if (SearchPlane(pF, i, pM, vpCandidates)) {
+                nmatches++;
+            }
+        }
+
+        return nmatches;
+    }
+
+    bool PlaneMatcher::SearchPlane(Frame &pF, int i, const cv::Mat &pM, const vector<MapPlane *> &vpMapPlanes) {
+        float ldTh = dTh;
+        float lverTh = verTh;
+        float lparTh = parTh;
+
+        bool found = false;
+        for (auto vpMapPlane : vpMapPlanes) {
+            if (vpMapPlane->isBad()) {
+                continue;
+            }
+
+            cv::Mat pW = vpMapPlane->GetWorldPos();
 
-                // Vertical planes
-                if (angle < lverTh && angle > -lverTh) {
-                    lverTh = abs(angle);
-                    pF.mvpVerticalPlanes[i] = static_cast<MapPlane *>(nullptr);
-                    pF.mvpVerticalPlanes[i] = vpMapPlane;
+            float angle = pM.at<float>(0) * pW.at<float>(0) +
+                          pM.at<float>(1) * pW.at<float>(1) +
+                          pM.at<float>(2) * pW.at<float>(2);
+
+            // Associate plane
+            if (angle > aTh && PointDistanceLowerBound(pM, vpMapPlane) < ldTh) {
+                double dis = PointDistanceFromPlane(pM, vpMapPlane->mvPlanePoints);
+                if (dis < ldTh) {
+                    ldTh = dis;
+                    pF.mvpMapPlanes[i] = static_cast<MapPlane *>(nullptr);
+                    pF.mvpMapPlanes[i] = vpMapPlane;
+                    found = true;
                     continue;
                 }
+            }
 
-                // Parallel planes
-                if (angle > lparTh || angle < -lparTh) {
-                    lparTh = abs(angle);
-                    pF.mvpParallelPlanes[i] = static_cast<MapPlane *>(nullptr);
-                    pF.mvpParallelPlanes[i] = vpMapPlane;
-                }
+            // Vertical planes
+            if (angle < lverTh && angle > -lverTh) {
+                lverTh = abs(angle);
+                pF.mvpVerticalPlanes[i] = static_cast<MapPlane *>(nullptr);
+                pF.mvpVerticalPlanes[i] = vpMapPlane;
+                continue;
             }
 
-            if (found) {
-                nmatches++;
+            // Parallel planes
+            if (angle > lparTh || angle < -lparTh) {
+                lparTh = abs(angle);
+                pF.mvpParallelPlanes[i] = static_cast<MapPlane *>(nullptr);
+                pF.mvpParallelPlanes[i] = vpMapPlane;
             }
         }
 
-        return nmatches;
+        return found;
     }
 
     double PlaneMatcher::PointDistanceFromPlane(const cv::Mat &plane, PointCloud::Ptr pointCloud) {
@@ -105,4 +136,25 @@ namespace ORB_SLAM2 {
         return res;
     }
 
+    double PlaneMatcher::PointDistanceLowerBound(const cv::Mat &plane, MapPlane *pMP) {
+        Eigen::Vector3f minPt, maxPt;
+        if (!pMP->GetBoundingBox(minPt, maxPt))
+            return numeric_limits<double>::max();
+
+        // Range of the signed distance over the box, from the corner extremal along each axis
+        double lo = plane.at<float>(3, 0), hi = plane.at<float>(3, 0);
+        for (int k = 0; k < 3; k++) {
+            const double a = plane.at<float>(k, 0) * minPt(k);
+            const double b = plane.at<float>(k, 0) * maxPt(k);
+            lo += min(a, b);
+            hi += max(a, b);
+        }
+
+        if (lo > 0)
+            return lo;
+        if (hi < 0)
+            return -hi;
+        return 0;
+    }
+
 }
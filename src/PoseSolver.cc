@@ -0,0 +1,567 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PoseSolver.h"
+
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+#include "Converter.h"
+#include "MapPoint.h"
+#include "MapLine.h"
+#include "MapPlane.h"
+
+using namespace std;
+using namespace Eigen;
+
+namespace ORB_SLAM2 {
+
+    namespace {
+
+        // Step of the numeric plane Jacobians, the one used by g2o::BaseUnaryEdge
+        const double NUMERIC_DELTA = 1e-9;
+
+        // Huber cost of a squared error, w is set to the weight of its normal equations
+        inline double RobustCost(double e2, double delta, bool bRobust, double &w) {
+            if (!bRobust || e2 <= delta * delta) {
+                w = 1.0;
+                return e2;
+            }
+            const double e = sqrt(e2);
+            w = delta / e;
+            return 2 * e * delta - delta * delta;
+        }
+
+        inline Vector3d PlaneError(const Isometry3d &T, const g2o::Plane3D &Xw, const g2o::Plane3D &obs) {
+            g2o::Plane3D localPlane = T * Xw;
+            return localPlane.ominus(obs);
+        }
+
+        inline Vector2d ParallelPlaneError(const Isometry3d &T, const g2o::Plane3D &Xw, const g2o::Plane3D &obs) {
+            g2o::Plane3D localPlane = T * Xw;
+            return localPlane.ominus_par(obs);
+        }
+
+        inline Vector2d VerticalPlaneError(const Isometry3d &T, const g2o::Plane3D &Xw, const g2o::Plane3D &obs) {
+            g2o::Plane3D localPlane = T * Xw;
+            return localPlane.ominus_ver(obs);
+        }
+
+        // Map plane in world coordinates, flipped when its normal seen from T points away from the observed one
+        g2o::Plane3D OrientedWorldPlane(const cv::Mat &worldPos, const cv::Mat &Pc3D, const Isometry3d &T,
+                                        double th) {
+            g2o::Plane3D Pw3D = Converter::toPlane3D(worldPos);
+            Vector4d Pw = Pw3D._coeffs;
+            const Vector3d nc = T.rotation() * Pw.head<3>();
+
+            double angle = nc(0) * Pc3D.at<float>(0) + nc(1) * Pc3D.at<float>(1) + nc(2) * Pc3D.at<float>(2);
+            if (angle < -th) {
+                Pw = -Pw;
+                Pw3D.fromVector(Pw);
+            }
+            return Pw3D;
+        }
+
+    }
+
+    void PoseSolver::PointTerms::Clear() {
+        vX.clear();
+        vY.clear();
+        vZ.clear();
+        vM0.clear();
+        vM1.clear();
+        vM2.clear();
+        vInfo.clear();
+        vChi2.clear();
+        vbInlier.clear();
+        vnIndex.clear();
+    }
+
+    void PoseSolver::PointTerms::Add(const Vector3d &Xw, double m0, double m1, double m2, double info, size_t idx) {
+        vX.push_back(Xw[0]);
+        vY.push_back(Xw[1]);
+        vZ.push_back(Xw[2]);
+        vM0.push_back(m0);
+        vM1.push_back(m1);
+        vM2.push_back(m2);
+        vInfo.push_back(info);
+        vChi2.push_back(0);
+        vbInlier.push_back(true);
+        vnIndex.push_back(idx);
+    }
+
+    void PoseSolver::PlaneTerms::Clear() {
+        vXw.clear();
+        vObs.clear();
+        vChi2.clear();
+        vbInlier.clear();
+        vnIndex.clear();
+    }
+
+    void PoseSolver::PlaneTerms::Add(const g2o::Plane3D &Xw, const g2o::Plane3D &obs, size_t idx) {
+        vXw.push_back(Xw);
+        vObs.push_back(obs);
+        vChi2.push_back(0);
+        vbInlier.push_back(true);
+        vnIndex.push_back(idx);
+    }
+
+    PoseSolver::PoseSolver(double angleInfo, double disInfo, double parInfo, double verInfo, double planeChi,
+                           double planeChiVP, double aTh, double parTh) : angleInfo(angleInfo), disInfo(disInfo),
+                                                                          parInfo(parInfo), verInfo(verInfo),
+                                                                          planeChi(planeChi), planeChiVP(planeChiVP),
+                                                                          aTh(aTh), parTh(parTh), mbRobust(true) {
+    }
+
+    int PoseSolver::PoseOptimization(Frame *pFrame) {
+        mMono.Clear();
+        mStereo.Clear();
+        mLines.Clear();
+        mPlanes.Clear();
+        mParPlanes.Clear();
+        mVerPlanes.Clear();
+
+        fx = pFrame->fx;
+        fy = pFrame->fy;
+        cx = pFrame->cx;
+        cy = pFrame->cy;
+        bf = pFrame->mbf;
+
+        const g2o::SE3Quat T0 = Converter::toSE3Quat(pFrame->mTcw);
+
+        int nInitialCorrespondences = 0;
+
+        {
+            unique_lock<mutex> lock(MapPoint::mGlobalMutex);
+
+            for (int i = 0; i < pFrame->N; i++) {
+                MapPoint *pMP = pFrame->mvpMapPoints[i];
+                if (!pMP)
+                    continue;
+
+                nInitialCorrespondences++;
+                pFrame->mvbOutlier[i] = false;
+
+                const cv::KeyPoint &kpUn = pFrame->mvKeysUn[i];
+                const float invSigma2 = pFrame->mvInvLevelSigma2[kpUn.octave];
+                const cv::Mat Xw = pMP->GetWorldPos();
+                const Vector3d Xw3D(Xw.at<float>(0), Xw.at<float>(1), Xw.at<float>(2));
+
+                if (pFrame->mvuRight[i] < 0)
+                    mMono.Add(Xw3D, kpUn.pt.x, kpUn.pt.y, 0, invSigma2, i);
+                else
+                    mStereo.Add(Xw3D, kpUn.pt.x, kpUn.pt.y, pFrame->mvuRight[i], invSigma2, i);
+            }
+        }
+
+        {
+            unique_lock<mutex> lock(MapLine::mGlobalMutex);
+
+            for (int i = 0; i < pFrame->NL; i++) {
+                MapLine *pML = pFrame->mvpMapLines[i];
+                if (!pML)
+                    continue;
+
+                nInitialCorrespondences++;
+                pFrame->mvbLineOutlier[i] = false;
+
+                // Both endpoints must lie on the observed line
+                const Vector3d &line_obs = pFrame->mvKeyLineFunctions[i];
+                mLines.Add(pML->mWorldPos.head(3), line_obs(0), line_obs(1), line_obs(2), 1, i);
+                mLines.Add(pML->mWorldPos.tail(3), line_obs(0), line_obs(1), line_obs(2), 1, i);
+            }
+        }
+
+        {
+            unique_lock<mutex> lock(MapPlane::mGlobalMutex);
+
+            const Isometry3d T = T0;
+
+            for (int i = 0; i < pFrame->mnPlaneNum; i++) {
+                const g2o::Plane3D obs = Converter::toPlane3D(pFrame->mvPlaneCoefficients[i]);
+
+                MapPlane *pMP = pFrame->mvpMapPlanes[i];
+                if (pMP) {
+                    nInitialCorrespondences++;
+                    pFrame->mvbPlaneOutlier[i] = false;
+                    mPlanes.Add(OrientedWorldPlane(pMP->GetWorldPos(), pFrame->mvPlaneCoefficients[i], T, aTh), obs,
+                                i);
+                }
+
+                pMP = pFrame->mvpParallelPlanes[i];
+                if (pMP) {
+                    nInitialCorrespondences++;
+                    pFrame->mvbParPlaneOutlier[i] = false;
+                    mParPlanes.Add(OrientedWorldPlane(pMP->GetWorldPos(), pFrame->mvPlaneCoefficients[i], T, parTh),
+                                   obs, i);
+                }
+
+                pMP = pFrame->mvpVerticalPlanes[i];
+                if (pMP) {
+                    nInitialCorrespondences++;
+                    pFrame->mvbVerPlaneOutlier[i] = false;
+                    mVerPlanes.Add(Converter::toPlane3D(pMP->GetWorldPos()), obs, i);
+                }
+            }
+        }
+
+        if (nInitialCorrespondences < 3)
+            return 0;
+
+        // We perform 4 optimizations, after each optimization we classify observation as inlier/outlier
+        // At the next optimization, outliers are not included, but at the end they can be classified as inliers again.
+        const int its[4] = {10, 10, 10, 10};
+
+        g2o::SE3Quat T = T0;
+        mbRobust = true;
+        int nBad = 0;
+
+        for (size_t it = 0; it < 4; it++) {
+            T = T0;
+            Optimize(T, its[it]);
+
+            // Rejected steps leave the errors of their trial pose behind
+            Evaluate(T, false);
+            nBad = Classify(pFrame);
+
+            if (it == 2)
+                mbRobust = false;
+
+            if (NumTerms() < 10)
+                break;
+        }
+
+        pFrame->SetPose(Converter::toCvMat(T));
+
+        return nInitialCorrespondences - nBad;
+    }
+
+    void PoseSolver::Optimize(g2o::SE3Quat &T, int nIterations) {
+        double lambda = 0;
+        double ni = 2;
+        int nBad = 0;
+
+        for (int iter = 0; iter < nIterations; iter++) {
+            const double iniChi = Evaluate(T, true);
+            double currentChi = iniChi;
+
+            if (iter == 0) {
+                lambda = 1e-5 * mH.diagonal().cwiseAbs().maxCoeff();
+                ni = 2;
+                nBad = 0;
+            }
+
+            double rho = 0;
+            int nTrials = 0;
+            do {
+                Matrix6d H = mH;
+                H.diagonal().array() += lambda;
+                mLDLT.compute(H);
+                const Vector6d dx = mLDLT.solve(mb);
+
+                const g2o::SE3Quat Tnew = g2o::SE3Quat::exp(dx) * T;
+                double tempChi = Evaluate(Tnew, false);
+                if (mLDLT.info() != Eigen::Success || !mLDLT.isPositive())
+                    tempChi = numeric_limits<double>::max();
+
+                rho = (currentChi - tempChi) / (dx.dot(lambda * dx + mb) + 1e-3);
+
+                if (rho > 0 && std::isfinite(tempChi)) {
+                    const double alpha = min(1. - pow(2 * rho - 1, 3), 2. / 3.);
+                    lambda *= max(1. / 3., alpha);
+                    ni = 2;
+                    currentChi = tempChi;
+                    T = Tnew;
+                } else {
+                    lambda *= ni;
+                    ni *= 2;
+                }
+                nTrials++;
+            } while (rho < 0 && nTrials < 10);
+
+            if (nTrials == 10 || rho == 0)
+                break;
+
+            // Same early stop as the g2o solver
+            if ((iniChi - currentChi) * 1e3 < iniChi)
+                nBad++;
+            else
+                nBad = 0;
+
+            if (nBad >= 3)
+                break;
+        }
+    }
+
+    double PoseSolver::Evaluate(const g2o::SE3Quat &T, bool bLinearize) {
+        if (bLinearize) {
+            mH.setZero();
+            mb.setZero();
+        }
+
+        const Matrix3d R = T.rotation().toRotationMatrix();
+        const Vector3d t = T.translation();
+
+        double chi2 = EvaluateMono(R, t, bLinearize) + EvaluateStereo(R, t, bLinearize) +
+                      EvaluateLines(R, t, bLinearize);
+
+        if (mPlanes.Size() + mParPlanes.Size() + mVerPlanes.Size() == 0)
+            return chi2;
+
+        if (bLinearize) {
+            Vector6d d = Vector6d::Zero();
+            for (int k = 0; k < 6; k++) {
+                d[k] = NUMERIC_DELTA;
+                mTPlus[k] = g2o::SE3Quat::exp(d) * T;
+                mTMinus[k] = g2o::SE3Quat::exp(-d) * T;
+                d[k] = 0;
+            }
+        }
+
+        const Isometry3d Tiso = T;
+
+        const Matrix3d planeInfo = Vector3d(angleInfo, angleInfo, disInfo).asDiagonal();
+        const Matrix2d parInfoMat = Matrix2d::Identity() * parInfo;
+        const Matrix2d verInfoMat = Matrix2d::Identity() * verInfo;
+
+        chi2 += EvaluatePlanes<3>(mPlanes, Tiso, planeInfo, sqrt(planeChi), PlaneError, bLinearize);
+        chi2 += EvaluatePlanes<2>(mParPlanes, Tiso, parInfoMat, sqrt(planeChiVP), ParallelPlaneError, bLinearize);
+        chi2 += EvaluatePlanes<2>(mVerPlanes, Tiso, verInfoMat, sqrt(planeChiVP), VerticalPlaneError, bLinearize);
+
+        return chi2;
+    }
+
+    double PoseSolver::EvaluateMono(const Matrix3d &R, const Vector3d &t, bool bLinearize) {
+        const double delta = sqrt(5.991);
+        const PointTerms &terms = mMono;
+        double chi2 = 0;
+
+        for (size_t i = 0, iend = terms.Size(); i < iend; i++) {
+            const double x = R(0, 0) * terms.vX[i] + R(0, 1) * terms.vY[i] + R(0, 2) * terms.vZ[i] + t[0];
+            const double y = R(1, 0) * terms.vX[i] + R(1, 1) * terms.vY[i] + R(1, 2) * terms.vZ[i] + t[1];
+            const double z = R(2, 0) * terms.vX[i] + R(2, 1) * terms.vY[i] + R(2, 2) * terms.vZ[i] + t[2];
+            const double invz = 1.0 / z;
+
+            const Vector2d e(terms.vM0[i] - (fx * x * invz + cx), terms.vM1[i] - (fy * y * invz + cy));
+            const double e2 = terms.vInfo[i] * e.squaredNorm();
+            mMono.vChi2[i] = e2;
+
+            if (!terms.vbInlier[i])
+                continue;
+
+            double w;
+            chi2 += RobustCost(e2, delta, mbRobust, w);
+
+            if (!bLinearize)
+                continue;
+
+            const double invz_2 = invz * invz;
+            Matrix<double, 2, 6> J;
+            J << x * y * invz_2 * fx, -(1 + (x * x * invz_2)) * fx, y * invz * fx, -invz * fx, 0, x * invz_2 * fx,
+                    (1 + y * y * invz_2) * fy, -x * y * invz_2 * fy, -x * invz * fy, 0, -invz * fy, y * invz_2 * fy;
+
+            const double wInfo = w * terms.vInfo[i];
+            mH.noalias() += wInfo * J.transpose() * J;
+            mb.noalias() -= wInfo * J.transpose() * e;
+        }
+
+        return chi2;
+    }
+
+    double PoseSolver::EvaluateStereo(const Matrix3d &R, const Vector3d &t, bool bLinearize) {
+        const double delta = sqrt(7.815);
+        const PointTerms &terms = mStereo;
+        double chi2 = 0;
+
+        for (size_t i = 0, iend = terms.Size(); i < iend; i++) {
+            const double x = R(0, 0) * terms.vX[i] + R(0, 1) * terms.vY[i] + R(0, 2) * terms.vZ[i] + t[0];
+            const double y = R(1, 0) * terms.vX[i] + R(1, 1) * terms.vY[i] + R(1, 2) * terms.vZ[i] + t[1];
+            const double z = R(2, 0) * terms.vX[i] + R(2, 1) * terms.vY[i] + R(2, 2) * terms.vZ[i] + t[2];
+            const double invz = 1.0 / z;
+
+            const double u = fx * x * invz + cx;
+            const Vector3d e(terms.vM0[i] - u, terms.vM1[i] - (fy * y * invz + cy), terms.vM2[i] - (u - bf * invz));
+            const double e2 = terms.vInfo[i] * e.squaredNorm();
+            mStereo.vChi2[i] = e2;
+
+            if (!terms.vbInlier[i])
+                continue;
+
+            double w;
+            chi2 += RobustCost(e2, delta, mbRobust, w);
+
+            if (!bLinearize)
+                continue;
+
+            const double invz_2 = invz * invz;
+            Matrix<double, 3, 6> J;
+            J.row(0) << x * y * invz_2 * fx, -(1 + (x * x * invz_2)) * fx, y * invz * fx, -invz * fx, 0,
+                    x * invz_2 * fx;
+            J.row(1) << (1 + y * y * invz_2) * fy, -x * y * invz_2 * fy, -x * invz * fy, 0, -invz * fy,
+                    y * invz_2 * fy;
+            J.row(2) << J(0, 0) - bf * y * invz_2, J(0, 1) + bf * x * invz_2, J(0, 2), J(0, 3), 0,
+                    J(0, 5) - bf * invz_2;
+
+            const double wInfo = w * terms.vInfo[i];
+            mH.noalias() += wInfo * J.transpose() * J;
+            mb.noalias() -= wInfo * J.transpose() * e;
+        }
+
+        return chi2;
+    }
+
+    double PoseSolver::EvaluateLines(const Matrix3d &R, const Vector3d &t, bool bLinearize) {
+        const double delta = sqrt(7.815);
+        const PointTerms &terms = mLines;
+        double chi2 = 0;
+
+        for (size_t i = 0, iend = terms.Size(); i < iend; i++) {
+            const double x = R(0, 0) * terms.vX[i] + R(0, 1) * terms.vY[i] + R(0, 2) * terms.vZ[i] + t[0];
+            const double y = R(1, 0) * terms.vX[i] + R(1, 1) * terms.vY[i] + R(1, 2) * terms.vZ[i] + t[1];
+            const double z = R(2, 0) * terms.vX[i] + R(2, 1) * terms.vY[i] + R(2, 2) * terms.vZ[i] + t[2];
+            const double invz = 1.0 / z;
+
+            const double lx = terms.vM0[i];
+            const double ly = terms.vM1[i];
+
+            // Distance of the projected endpoint to the observed line
+            const double e = lx * (fx * x * invz + cx) + ly * (fy * y * invz + cy) + terms.vM2[i];
+            const double e2 = terms.vInfo[i] * e * e;
+            mLines.vChi2[i] = e2;
+
+            if (!terms.vbInlier[i])
+                continue;
+
+            double w;
+            chi2 += RobustCost(e2, delta, mbRobust, w);
+
+            if (!bLinearize)
+                continue;
+
+            const double invz_2 = invz * invz;
+            Matrix<double, 1, 6> J;
+            J << -fy * ly - fx * lx * x * y * invz_2 - fy * ly * y * y * invz_2,
+                    fx * lx + fx * lx * x * x * invz_2 + fy * ly * x * y * invz_2,
+                    -fx * lx * y * invz + fy * ly * x * invz,
+                    fx * lx * invz,
+                    fy * ly * invz,
+                    -(fx * lx * x + fy * ly * y) * invz_2;
+
+            const double wInfo = w * terms.vInfo[i];
+            mH.noalias() += wInfo * J.transpose() * J;
+            mb.noalias() -= (wInfo * e) * J.transpose();
+        }
+
+        return chi2;
+    }
+
+    template<int D, class ErrorFunction>
+    double PoseSolver::EvaluatePlanes(PlaneTerms &terms, const Isometry3d &T, const Matrix<double, D, D> &info,
+                                      double delta, ErrorFunction error, bool bLinearize) {
+        typedef Matrix<double, D, 1> VectorD;
+
+        const double scalar = 1.0 / (2 * NUMERIC_DELTA);
+        double chi2 = 0;
+
+        for (size_t i = 0, iend = terms.Size(); i < iend; i++) {
+            const VectorD e = error(T, terms.vXw[i], terms.vObs[i]);
+            const double e2 = e.dot(info * e);
+            terms.vChi2[i] = e2;
+
+            if (!terms.vbInlier[i])
+                continue;
+
+            double w;
+            chi2 += RobustCost(e2, delta, mbRobust, w);
+
+            if (!bLinearize)
+                continue;
+
+            Matrix<double, D, 6> J;
+            for (int k = 0; k < 6; k++)
+                J.col(k) = scalar * (error(mTPlus[k], terms.vXw[i], terms.vObs[i]) -
+                                     error(mTMinus[k], terms.vXw[i], terms.vObs[i]));
+
+            mH.noalias() += w * J.transpose() * info * J;
+            mb.noalias() -= w * J.transpose() * (info * e);
+        }
+
+        return chi2;
+    }
+
+    int PoseSolver::Classify(Frame *pFrame) {
+        const double chi2Mono = 5.991;
+        const double chi2Stereo = 7.815;
+
+        int nBad = 0;
+
+        for (size_t i = 0, iend = mMono.Size(); i < iend; i++) {
+            const bool bOutlier = mMono.vChi2[i] > chi2Mono;
+            mMono.vbInlier[i] = !bOutlier;
+            pFrame->mvbOutlier[mMono.vnIndex[i]] = bOutlier;
+            nBad += bOutlier;
+        }
+
+        for (size_t i = 0, iend = mStereo.Size(); i < iend; i++) {
+            const bool bOutlier = mStereo.vChi2[i] > chi2Stereo;
+            mStereo.vbInlier[i] = !bOutlier;
+            pFrame->mvbOutlier[mStereo.vnIndex[i]] = bOutlier;
+            nBad += bOutlier;
+        }
+
+        // The two endpoints of a line are classified together
+        for (size_t i = 0, iend = mLines.Size(); i < iend; i += 2) {
+            const bool bOutlier = mLines.vChi2[i] > 2 * chi2Mono || mLines.vChi2[i + 1] > 2 * chi2Mono;
+            mLines.vbInlier[i] = mLines.vbInlier[i + 1] = !bOutlier;
+            pFrame->mvbLineOutlier[mLines.vnIndex[i]] = bOutlier;
+            nBad += bOutlier;
+        }
+
+        for (size_t i = 0, iend = mPlanes.Size(); i < iend; i++) {
+            const bool bOutlier = mPlanes.vChi2[i] > planeChi;
+            mPlanes.vbInlier[i] = !bOutlier;
+            pFrame->mvbPlaneOutlier[mPlanes.vnIndex[i]] = bOutlier;
+            nBad += bOutlier;
+        }
+
+        for (size_t i = 0, iend = mParPlanes.Size(); i < iend; i++) {
+            const bool bOutlier = mParPlanes.vChi2[i] > planeChiVP;
+            mParPlanes.vbInlier[i] = !bOutlier;
+            pFrame->mvbParPlaneOutlier[mParPlanes.vnIndex[i]] = bOutlier;
+            nBad += bOutlier;
+        }
+
+        for (size_t i = 0, iend = mVerPlanes.Size(); i < iend; i++) {
+            const bool bOutlier = mVerPlanes.vChi2[i] > planeChiVP;
+            mVerPlanes.vbInlier[i] = !bOutlier;
+            pFrame->mvbVerPlaneOutlier[mVerPlanes.vnIndex[i]] = bOutlier;
+            nBad += bOutlier;
+        }
+
+        return nBad;
+    }
+
+    size_t PoseSolver::NumTerms() const {
+        return mMono.Size() + mStereo.Size() + mLines.Size() + mPlanes.Size() + mParPlanes.Size() +
+               mVerPlanes.Size();
+    }
+
+} //namespace ORB_SLAM
@@ -23,17 +23,17 @@
  */
 
 #include "SurfelFusion.h"
-#include <thread>
 #include <cmath>
 
 SurfelFusion::SurfelFusion(int width, int height,
                            float _fx, float _fy, float _cx, float _cy,
-                           float _fuseFar, float _fuseNear) : imageWidth(width), imageHeight(height),
+                           float _fuseFar, float _fuseNear, ORB_SLAM2::ThreadPool *_threadPool) :
+                           imageWidth(width), imageHeight(height),
                            spWidth(imageWidth / SP_SIZE), spHeight(imageHeight / SP_SIZE), fx(_fx),
-                           fy(_fy), cx(_cx), cy(_cy), fuseFar(_fuseFar), fuseNear(_fuseNear) {
+                           fy(_fy), cx(_cx), cy(_cy), fuseFar(_fuseFar), fuseNear(_fuseNear),
+                           threadPool(_threadPool) {
     superpixelSeeds.resize(spWidth * spHeight);
     superpixelIndex.resize(imageWidth * imageHeight);
-    spaceMap.resize(imageWidth * imageHeight * 3);
     normMap.resize(imageWidth * imageHeight * 3);
 }
 
@@ -41,12 +41,14 @@ void SurfelFusion::fuseInitializeMap(
         const int referenceFrameIndex,
         const cv::Mat &inputImage,
         const cv::Mat &inputDepth,
+        const cv::Mat &inputPointCloud,
         const cv::Mat &inputPlaneMembershipImg,
         const Eigen::Matrix4f &pose,
         std::vector<Surfel> &localSurfels,
         std::vector<Surfel> &newSurfels) {
     image = inputImage;
     depth = inputDepth;
+    pointCloud = inputPointCloud;
 
     planeMembershipImg = inputPlaneMembershipImg;
 
@@ -57,21 +59,21 @@ void SurfelFusion::fuseInitializeMap(
 
     // Fuse
     Eigen::Matrix4f invPose = pose.inverse();
-    std::vector<std::thread> threadPool;
-    for (int i = 0; i < THREAD_NUM; i++) {
-        std::thread this_thread(
-                &SurfelFusion::fuseSurfelsKernel, this, i, THREAD_NUM,
-                referenceFrameIndex, pose, invPose);
-        threadPool.push_back(std::move(this_thread));
-    }
-    for (auto &thread : threadPool)
-        if (thread.joinable())
-            thread.join();
+    parallelFor(0, localSurfels.size(), SURFEL_GRAIN, [&](int begin, int end) {
+        fuseSurfelsKernel(begin, end, referenceFrameIndex, pose, invPose);
+    });
 
     // Initialize
     initializeSurfels(referenceFrameIndex, pose);
 }
 
+void SurfelFusion::parallelFor(int begin, int end, int grain, const std::function<void(int, int)> &kernel) {
+    if (threadPool)
+        threadPool->ParallelFor(begin, end, grain, kernel);
+    else if (begin < end)
+        kernel(begin, end);
+}
+
 void SurfelFusion::project(float &x, float &y, float &z, float &u, float &v) {
     u = x * fx / z + cx;
     v = y * fy / z + cy;
@@ -165,18 +167,12 @@ void SurfelFusion::getHuberNorm(
 }
 
 void SurfelFusion::fuseSurfelsKernel(
-        const int thread, const int threadNum,
+        const int begin, const int end,
         const int referenceFrameIndex, const Eigen::Matrix4f &pose, const Eigen::Matrix4f &invPose) {
 
     std::vector<Surfel> &localSurfels = *localSurfelsPtr;
 
-    int step = localSurfels.size() / threadNum;
-    int beginIndex = step * thread;
-    int endIndex = beginIndex + step;
-    if (thread == threadNum - 1)
-        endIndex = localSurfels.size();
-
-    for (int i = beginIndex; i < endIndex; i++) {
+    for (int i = begin; i < end; i++) {
         // remove unstable
         if (referenceFrameIndex - localSurfels[i].lastUpdate > 5 && localSurfels[i].updateTimes < 5) {
             localSurfels[i].updateTimes = 0;
@@ -354,14 +350,8 @@ bool SurfelFusion::calculateCost(
     return false;
 }
 
-void SurfelFusion::updatePixelsKernel(
-        int thread, int threadNum) {
-    int stepRow = imageHeight / threadNum;
-    int startRow = stepRow * thread;
-    int endRow = startRow + stepRow;
-    if (thread == threadNum - 1)
-        endRow = imageHeight;
-    for (int rowI = startRow; rowI < endRow; rowI++)
+void SurfelFusion::updatePixelsKernel(int begin, int end) {
+    for (int rowI = begin; rowI < end; rowI++)
         for (int colI = 0; colI < imageWidth; colI++) {
             if (planeMembershipImg.at<int>(rowI / 2, colI / 2) != -1) {
                 continue;
@@ -415,24 +405,11 @@ void SurfelFusion::updatePixelsKernel(
 }
 
 void SurfelFusion::updatePixels() {
-    std::vector<std::thread> threadPool;
-    for (int i = 0; i < THREAD_NUM; i++) {
-        std::thread thisThread(&SurfelFusion::updatePixelsKernel, this, i, THREAD_NUM);
-        threadPool.push_back(std::move(thisThread));
-    }
-    for (int i = 0; i < threadPool.size(); i++)
-        if (threadPool[i].joinable())
-            threadPool[i].join();
+    parallelFor(0, imageHeight, ROW_GRAIN, [this](int begin, int end) { updatePixelsKernel(begin, end); });
 }
 
-void SurfelFusion::updateSeedsKernel(
-        int thread, int threadNum) {
-    int step = superpixelSeeds.size() / threadNum;
-    int beginIndex = step * thread;
-    int endIndex = beginIndex + step;
-    if (thread == threadNum - 1)
-        endIndex = superpixelSeeds.size();
-    for (int seedI = beginIndex; seedI < endIndex; seedI++) {
+void SurfelFusion::updateSeedsKernel(int begin, int end) {
+    for (int seedI = begin; seedI < end; seedI++) {
         if (!superpixelSeeds[seedI].use)
             continue;
         if (superpixelSeeds[seedI].stable)
@@ -515,24 +492,11 @@ void SurfelFusion::updateSeedsKernel(
 }
 
 void SurfelFusion::updateSeeds() {
-    std::vector<std::thread> threadPool;
-    for (int i = 0; i < THREAD_NUM; i++) {
-        std::thread thisThread(&SurfelFusion::updateSeedsKernel, this, i, THREAD_NUM);
-        threadPool.push_back(std::move(thisThread));
-    }
-    for (int i = 0; i < threadPool.size(); i++)
-        if (threadPool[i].joinable())
-            threadPool[i].join();
+    parallelFor(0, superpixelSeeds.size(), SEED_GRAIN, [this](int begin, int end) { updateSeedsKernel(begin, end); });
 }
 
-void SurfelFusion::initializeSeedsKernel(
-        int thread, int threadNum) {
-    int step = superpixelSeeds.size() / threadNum;
-    int beginIndex = step * thread;
-    int endIndex = beginIndex + step;
-    if (thread == threadNum - 1)
-        endIndex = superpixelSeeds.size();
-    for (int seedI = beginIndex; seedI < endIndex; seedI++) {
+void SurfelFusion::initializeSeedsKernel(int begin, int end) {
+    for (int seedI = begin; seedI < end; seedI++) {
         int spX = seedI % spWidth;
         int spY = seedI / spWidth;
         int imageX = spX * SP_SIZE + SP_SIZE / 2;
@@ -584,56 +548,27 @@ void SurfelFusion::initializeSeedsKernel(
 }
 
 void SurfelFusion::initializeSeeds() {
-    std::vector<std::thread> threadPool;
-    for (int i = 0; i < THREAD_NUM; i++) {
-        std::thread thisThread(&SurfelFusion::initializeSeedsKernel, this, i, THREAD_NUM);
-        threadPool.push_back(std::move(thisThread));
-    }
-    for (int i = 0; i < threadPool.size(); i++)
-        if (threadPool[i].joinable())
-            threadPool[i].join();
-}
-
-void SurfelFusion::calculateSpacesKernel(int thread, int threadNum) {
-    int stepRow = imageHeight / threadNum;
-    int startRow = stepRow * thread;
-    int endRow = startRow + stepRow;
-    if (thread == threadNum - 1)
-        endRow = imageHeight;
-    for (int rowI = startRow; rowI < endRow; rowI++)
-        for (int colI = 0; colI < imageWidth; colI++) {
-            int myIndex = rowI * imageWidth + colI;
-            float myDepth = depth.at<float>(rowI, colI);
-            double x, y, z;
-            backProject(colI, rowI, myDepth, x, y, z);
-            spaceMap[myIndex * 3] = x;
-            spaceMap[myIndex * 3 + 1] = y;
-            spaceMap[myIndex * 3 + 2] = z;
-        }
+    parallelFor(0, superpixelSeeds.size(), SEED_GRAIN, [this](int begin, int end) { initializeSeedsKernel(begin, end); });
 }
 
-void SurfelFusion::calculatePixelsNormsKernel(int thread, int threadNum) {
-    int stepRow = imageHeight / threadNum;
-    int startRow = stepRow * thread;
-    startRow = startRow > 1 ? startRow : 1;
-    int endRow = startRow + stepRow;
-    if (thread == threadNum - 1)
-        endRow = imageHeight - 1;
-    for (int rowI = startRow; rowI < endRow; rowI++)
+void SurfelFusion::calculatePixelsNormsKernel(int begin, int end) {
+    for (int rowI = begin; rowI < end; rowI++) {
+        const cv::Vec3f *points = pointCloud.ptr<cv::Vec3f>(rowI);
+        const cv::Vec3f *downPoints = pointCloud.ptr<cv::Vec3f>(rowI + 1);
         for (int colI = 1; colI < imageWidth - 1; colI++) {
             int myIndex = rowI * imageWidth + colI;
             float myX, myY, myZ;
-            myX = spaceMap[myIndex * 3];
-            myY = spaceMap[myIndex * 3 + 1];
-            myZ = spaceMap[myIndex * 3 + 2];
+            myX = points[colI][0];
+            myY = points[colI][1];
+            myZ = points[colI][2];
             float rightX, rightY, rightZ;
-            rightX = spaceMap[myIndex * 3 + 3];
-            rightY = spaceMap[myIndex * 3 + 4];
-            rightZ = spaceMap[myIndex * 3 + 5];
+            rightX = points[colI + 1][0];
+            rightY = points[colI + 1][1];
+            rightZ = points[colI + 1][2];
             float downX, downY, downZ;
-            downX = spaceMap[myIndex * 3 + imageWidth * 3];
-            downY = spaceMap[myIndex * 3 + imageWidth * 3 + 1];
-            downZ = spaceMap[myIndex * 3 + imageWidth * 3 + 2];
+            downX = downPoints[colI][0];
+            downY = downPoints[colI][1];
+            downZ = downPoints[colI][2];
             if (myZ < 0.1 || rightZ < 0.1 || downZ < 0.1)
                 continue;
             rightX = rightX - myX;
@@ -658,15 +593,11 @@ void SurfelFusion::calculatePixelsNormsKernel(int thread, int threadNum) {
             normMap[myIndex * 3 + 1] = normY;
             normMap[myIndex * 3 + 2] = normZ;
         }
+    }
 }
 
-void SurfelFusion::calculateSpDepthNormsKernel(int thread, int threadNum) {
-    int step = superpixelSeeds.size() / threadNum;
-    int beginIndex = step * thread;
-    int endIndex = beginIndex + step;
-    if (thread == threadNum - 1)
-        endIndex = superpixelSeeds.size();
-    for (int seedI = beginIndex; seedI < endIndex; seedI++) {
+void SurfelFusion::calculateSpDepthNormsKernel(int begin, int end) {
+    for (int seedI = begin; seedI < end; seedI++) {
         int spX = seedI % spWidth;
         int spY = seedI / spWidth;
         int checkXBegin = spX * SP_SIZE + SP_SIZE / 2 - SP_SIZE;
@@ -696,9 +627,10 @@ void SurfelFusion::calculateSpDepthNormsKernel(int thread, int threadNum) {
                         pixelNorms.push_back(normMap[pixelIndex * 3 + 1]);
                         pixelNorms.push_back(normMap[pixelIndex * 3 + 2]);
                         validDepthNum += 1;
-                        pixelPositions.push_back(spaceMap[pixelIndex * 3]);
-                        pixelPositions.push_back(spaceMap[pixelIndex * 3 + 1]);
-                        pixelPositions.push_back(spaceMap[pixelIndex * 3 + 2]);
+                        const cv::Vec3f &point = pointCloud.ptr<cv::Vec3f>()[pixelIndex];
+                        pixelPositions.push_back(point[0]);
+                        pixelPositions.push_back(point[1]);
+                        pixelPositions.push_back(point[2]);
                     }
                 }
             }
@@ -773,33 +705,14 @@ void SurfelFusion::calculateSpDepthNormsKernel(int thread, int threadNum) {
 }
 
 void SurfelFusion::calculateNorms() {
-    std::vector<std::thread> threadPool;
-    for (int i = 0; i < THREAD_NUM; i++) {
-        std::thread thisThread(&SurfelFusion::calculateSpacesKernel, this, i, THREAD_NUM);
-        threadPool.push_back(std::move(thisThread));
-    }
-    for (int i = 0; i < threadPool.size(); i++)
-        if (threadPool[i].joinable())
-            threadPool[i].join();
-    threadPool.clear();
-
-    for (int i = 0; i < THREAD_NUM; i++) {
-        std::thread thisThread(&SurfelFusion::calculatePixelsNormsKernel, this, i, THREAD_NUM);
-        threadPool.push_back(std::move(thisThread));
-    }
-    for (int i = 0; i < threadPool.size(); i++)
-        if (threadPool[i].joinable())
-            threadPool[i].join();
-    threadPool.clear();
-
-    for (int i = 0; i < THREAD_NUM; i++) {
-        std::thread thisThread(&SurfelFusion::calculateSpDepthNormsKernel, this, i, THREAD_NUM);
-        threadPool.push_back(std::move(thisThread));
-    }
-    for (int i = 0; i < threadPool.size(); i++)
-        if (threadPool[i].joinable())
-            threadPool[i].join();
-    threadPool.clear();
+    // Border rows have no complete neighbourhood
+    parallelFor(1, imageHeight - 1, ROW_GRAIN, [this](int begin, int end) {
+        calculatePixelsNormsKernel(begin, end);
+    });
+
+    parallelFor(0, superpixelSeeds.size(), SEED_GRAIN, [this](int begin, int end) {
+        calculateSpDepthNormsKernel(begin, end);
+    });
 }
 
 void SurfelFusion::generateSuperPixels() {
@@ -26,7 +26,10 @@
 
 namespace ORB_SLAM2 {
     SurfelMapping::SurfelMapping(Map *map, const string &strSettingPath) : mMap(map),
-                                                                           mbStop(false), driftFreePoses(10) {
+                                                                           mbStop(false), mbWakeUp(false),
+                                                                           mnInsertedKeyFrames(0),
+                                                                           mnDroppedKeyFrames(0),
+                                                                           driftFreePoses(10) {
         cv::FileStorage fSettings(strSettingPath, cv::FileStorage::READ);
 
         float fx = fSettings["Camera.fx"];
@@ -40,7 +43,20 @@ namespace ORB_SLAM2 {
         float distanceFar = fSettings["Surfel.distanceFar"];
         float distanceNear = fSettings["Surfel.distanceNear"];
 
-        mSurfelFusion = new SurfelFusion(imgWidth, imgHeight, fx, fy, cx, cy, distanceFar, distanceNear);
+        // Threads running the fusion kernels, including the Surfel Mapping thread itself.
+        // With 1 (or less) the kernels run sequentially in the Surfel Mapping thread.
+        int nThreads = fSettings["Surfel.Threads"];
+        mThreadPool = nThreads > 1 ? new ThreadPool(nThreads - 1) : static_cast<ThreadPool *>(NULL);
+
+        mSurfelFusion = new SurfelFusion(imgWidth, imgHeight, fx, fy, cx, cy, distanceFar, distanceNear,
+                                         mThreadPool);
+
+        mnMaxQueuedKeyFrames = max(0, static_cast<int>(fSettings["Surfel.QueueSize"]));
+        mnQueuePolicy = fSettings["Surfel.QueuePolicy"];
+        if (mnQueuePolicy < QUEUE_BLOCK || mnQueuePolicy > QUEUE_NEWEST_PER_REFERENCE) {
+            cerr << "Unknown Surfel.QueuePolicy " << mnQueuePolicy << ", dropping the oldest keyframes" << endl;
+            mnQueuePolicy = QUEUE_DROP_OLDEST;
+        }
     }
 
     void SurfelMapping::Run() {
@@ -56,12 +72,16 @@ namespace ORB_SLAM2 {
                     break;
                 }
             }
+
+            if (!CheckNewKeyFrames())
+                WaitForWork();
         }
     }
 
     pcl::PointCloud<pcl::PointSurfel>::Ptr SurfelMapping::Stop() {
         unique_lock<mutex> lock(mMutexStop);
         mbStop = true;
+        WakeUp();
 
         pcl::PointCloud<pcl::PointSurfel>::Ptr pointCloud(new pcl::PointCloud<pcl::PointSurfel>());
         for (int surfelIt = 0, surfel_end = mMap->mvLocalSurfels.size(); surfelIt < surfel_end; surfelIt++) {
@@ -134,10 +154,73 @@ namespace ORB_SLAM2 {
         return pointCloud;
     }
 
-    void SurfelMapping::InsertKeyFrame(const cv::Mat &imRGB, const cv::Mat &imDepth, const cv::Mat planeMembershipImg,
-                                       const cv::Mat &pose, const int referenceIndex) {
+    void SurfelMapping::InsertKeyFrame(const FrameBuffer::Ptr &pFrameBuffer, const cv::Mat &pose,
+                                       const int referenceIndex) {
+        {
+            unique_lock<mutex> lock(mMutexNewKFs);
+
+            KeyFrameElement keyFrame;
+            keyFrame.pFrameBuffer = pFrameBuffer;
+            keyFrame.pose = pose;
+            keyFrame.referenceIndex = referenceIndex;
+            keyFrame.sequenceIndex = mnInsertedKeyFrames++;
+
+            if (mnMaxQueuedKeyFrames > 0) {
+                mvKeyFramePoseIndex.push_back(-1);
+
+                if (mnQueuePolicy != QUEUE_BLOCK) {
+                    if (mnQueuePolicy == QUEUE_NEWEST_PER_REFERENCE) {
+                        for (auto lit = mlNewKeyFrames.begin(); lit != mlNewKeyFrames.end(); lit++) {
+                            if (lit->referenceIndex == referenceIndex) {
+                                mlNewKeyFrames.erase(lit);
+                                mnDroppedKeyFrames++;
+                                break;
+                            }
+                        }
+                    }
+
+                    while (mlNewKeyFrames.size() >= mnMaxQueuedKeyFrames) {
+                        mlNewKeyFrames.pop_front();
+                        mnDroppedKeyFrames++;
+                    }
+                }
+            }
+
+            mlNewKeyFrames.push_back(keyFrame);
+        }
+        WakeUp();
+    }
+
+    void SurfelMapping::WaitForQueueSpace() {
+        if (mnMaxQueuedKeyFrames <= 0 || mnQueuePolicy != QUEUE_BLOCK)
+            return;
+
+        unique_lock<mutex> lock(mMutexNewKFs);
+        while (mlNewKeyFrames.size() >= mnMaxQueuedKeyFrames)
+            mCondQueueSpace.wait(lock);
+    }
+
+    int SurfelMapping::KeyframesInQueue() {
+        unique_lock<mutex> lock(mMutexNewKFs);
+        return mlNewKeyFrames.size();
+    }
+
+    int SurfelMapping::DroppedKeyFrames() {
         unique_lock<mutex> lock(mMutexNewKFs);
-        mlNewKeyFrames.emplace_back(imRGB, imDepth, planeMembershipImg, pose, referenceIndex);
+        return mnDroppedKeyFrames;
+    }
+
+    void SurfelMapping::WakeUp() {
+        unique_lock<mutex> lock(mMutexWakeUp);
+        mbWakeUp = true;
+        mCondWakeUp.notify_one();
+    }
+
+    void SurfelMapping::WaitForWork() {
+        unique_lock<mutex> lock(mMutexWakeUp);
+        while (!mbWakeUp)
+            mCondWakeUp.wait(lock);
+        mbWakeUp = false;
     }
 
     bool SurfelMapping::CheckNewKeyFrames() {
@@ -146,21 +229,33 @@ namespace ORB_SLAM2 {
     }
 
     void SurfelMapping::ProcessNewKeyFrame() {
-        std::tuple<cv::Mat, cv::Mat, cv::Mat, cv::Mat, int> frame;
+        KeyFrameElement frame;
+        int index = posesDatabase.size();
+        int relativeIndex;
         {
             unique_lock<mutex> lock(mMutexNewKFs);
             frame = mlNewKeyFrames.front();
             mlNewKeyFrames.pop_front();
+            mCondQueueSpace.notify_one();
+
+            if (mvKeyFramePoseIndex.empty()) {
+                // Unbounded queue, keyframes are fused in insertion order
+                relativeIndex = frame.referenceIndex;
+            } else {
+                mvKeyFramePoseIndex[frame.sequenceIndex] = index;
+
+                // Link to the last fused keyframe if the reference was dropped from the queue
+                if (frame.referenceIndex >= 0 && frame.referenceIndex < mvKeyFramePoseIndex.size() &&
+                    mvKeyFramePoseIndex[frame.referenceIndex] >= 0)
+                    relativeIndex = mvKeyFramePoseIndex[frame.referenceIndex];
+                else
+                    relativeIndex = max(0, index - 1);
+            }
         }
 
-        cv::Mat image = std::get<0>(frame);
-        cv::Mat depth = std::get<1>(frame);
-        cv::Mat planeMembershipImg = std::get<2>(frame);
-        cv::Mat pose = std::get<3>(frame);
-        int relativeIndex = std::get<4>(frame);
+        cv::Mat pose = frame.pose;
 
         PoseElement poseElement;
-        int index = posesDatabase.size();
         if (!posesDatabase.empty()) {
             poseElement.linkedPoseIndex.push_back(relativeIndex);
             posesDatabase[relativeIndex].linkedPoseIndex.push_back(index);
@@ -188,7 +283,7 @@ namespace ORB_SLAM2 {
         poseEigen(2, 3) = pose.at<float>(2, 3);
         poseEigen(3, 3) = pose.at<float>(3, 3);
 
-        fuseMap(image, depth, planeMembershipImg, poseEigen, relativeIndex);
+        fuseMap(frame.pFrameBuffer, poseEigen, relativeIndex);
     }
 
     void SurfelMapping::moveAddSurfels(int referenceIndex) {
@@ -350,14 +445,14 @@ namespace ORB_SLAM2 {
         }
     }
 
-    void SurfelMapping::fuseMap(cv::Mat image, cv::Mat depth, cv::Mat planeMembershipImg, Eigen::Matrix4f poseInput,
-                                int referenceIndex) {
+    void SurfelMapping::fuseMap(const FrameBuffer::Ptr &pFrameBuffer, Eigen::Matrix4f poseInput, int referenceIndex) {
         vector<Surfel> newSurfels;
         mSurfelFusion->fuseInitializeMap(
                 referenceIndex,
-                image,
-                depth,
-                planeMembershipImg,
+                pFrameBuffer->GetGray(),
+                pFrameBuffer->GetDepth(),
+                pFrameBuffer->GetPointCloud(),
+                pFrameBuffer->GetPlaneMembership(),
                 poseInput,
                 mMap->mvLocalSurfels,
                 newSurfels
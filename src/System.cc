@@ -22,6 +22,7 @@
 
 #include "System.h"
 #include "Converter.h"
+#include "MapSerializer.h"
 #include <thread>
 #include <pangolin/pangolin.h>
 #include <iomanip>
@@ -37,7 +38,8 @@ using namespace Eigen;
 namespace ORB_SLAM2 {
 
     System::System(const string &strVocFile, const string &strSettingsFile,
-                   const bool bUseViewer) : mpViewer(static_cast<Viewer *>(NULL)), mbReset(false),
+                   const bool bUseViewer) : mpViewer(static_cast<Viewer *>(NULL)),
+                                            mptFrontEnd(static_cast<thread *>(NULL)), mbReset(false),
                                             mbActivateLocalizationMode(false),
                                             mbDeactivateLocalizationMode(false) {
         // Output welcome message
@@ -62,9 +64,11 @@ namespace ORB_SLAM2 {
         cout << endl << "Loading ORB Vocabulary. This could take a while..." << endl;
         clock_t tStart = clock();
         mpVocabulary = new ORBVocabulary();
-        bool bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
-        //else
-        //   bVocLoad = mpVocabulary->loadFromBinaryFile(strVocFile);
+        bool bVocLoad;
+        if (ORBVocabulary::isBinaryFile(strVocFile))
+            bVocLoad = mpVocabulary->loadFromBinaryFile(strVocFile);
+        else
+            bVocLoad = mpVocabulary->loadFromTextFile(strVocFile);
         if (!bVocLoad) {
             cerr << "Wrong path to vocabulary. " << endl;
             cerr << "Failed to open at: " << strVocFile << endl;
@@ -72,6 +76,12 @@ namespace ORB_SLAM2 {
         }
         //printf("Vocabulary loaded in %.2fs\n", (double)(clock() - tStart)/CLOCKS_PER_SEC);
         cout << "Vocabulary loaded!" << endl << endl;
+
+        //Create the worker threads shared by Tracking and Local Mapping
+        int nWorkerThreads = fsSettings["System.WorkerThreads"];
+        mpThreadPool = new ThreadPool(nWorkerThreads);
+        cout << "Worker threads: " << mpThreadPool->GetNumThreads() << endl << endl;
+
         //Create KeyFrame Database
         mpKeyFrameDatabase = new KeyFrameDatabase(*mpVocabulary);
 
@@ -88,10 +98,14 @@ namespace ORB_SLAM2 {
         //mpPointCloudMapping = make_shared<PointCloudMapping>( resolution );
 
         mpTracker = new Tracking(this, mpVocabulary, mpFrameDrawer, mpMapDrawer,
-                                 mpMap, mpKeyFrameDatabase, strSettingsFile);
+                                 mpMap, mpKeyFrameDatabase, mpThreadPool, strSettingsFile);
+
+        //Launch the Tracking front-end (frame extraction) if the pipeline is enabled
+        if (mpTracker->IsPipelined())
+            mptFrontEnd = new thread(&ORB_SLAM2::Tracking::RunFrontEnd, mpTracker);
 
         //Initialize the Local Mapping thread and launch
-        mpLocalMapper = new LocalMapping(mpMap, strSettingsFile);
+        mpLocalMapper = new LocalMapping(mpMap, mpThreadPool, strSettingsFile);
         mptLocalMapping = new thread(&ORB_SLAM2::LocalMapping::Run, mpLocalMapper);
 
         //Initialize the Surfel Mapping thread and launch
@@ -108,6 +122,7 @@ namespace ORB_SLAM2 {
 
         //Set pointers between threads
         mpTracker->SetLocalMapper(mpLocalMapper);
+        mpLocalMapper->SetOptimizer(mpTracker->GetOptimizer());
         mpTracker->SetSurfelMapper(mpSurfelMapper);
     }
 
@@ -165,9 +180,38 @@ namespace ORB_SLAM2 {
     }
 
     void System::Shutdown() {
+        // Track the frames still queued in the front-end pipeline
+        if (mpTracker->IsPipelined()) {
+            mpTracker->FlushPipeline();
+
+            Tracking::PipelineStats stats = mpTracker->GetPipelineStats();
+            if (stats.nFrames > 0) {
+                cout << endl << "Front-end pipeline latency (mean per frame):" << endl;
+                cout << "- extraction: " << stats.extraction / stats.nFrames << endl;
+                cout << "- queue: " << stats.queue / stats.nFrames << endl;
+                cout << "- tracking: " << stats.tracking / stats.nFrames << endl;
+                cout << "- end-to-end: " << stats.endToEnd / stats.nFrames << " (max " << stats.maxEndToEnd
+                     << ")" << endl;
+            }
+        }
+
+        if (PoseOptimizationCheck *pCheck = mpTracker->GetPoseOptimizationCheck()) {
+            PoseOptimizationCheck::Stats stats = pCheck->GetStats();
+            if (stats.nFrames > 0) {
+                cout << endl << "Pose optimization against the reference over " << stats.nFrames << " frames:" << endl;
+                cout << "- inlier count differs: " << stats.nInlierMismatches << " frames" << endl;
+                cout << "- rotation difference: " << stats.sumRotation / stats.nFrames << " deg (max "
+                     << stats.maxRotation << ")" << endl;
+                cout << "- translation difference: " << stats.sumTranslation / stats.nFrames << " m (max "
+                     << stats.maxTranslation << ")" << endl;
+            }
+        }
+
         mpLocalMapper->RequestFinish();
 
         pcl::PointCloud<pcl::PointSurfel>::Ptr pointCloud = mpSurfelMapper->Stop();
+        if (mpSurfelMapper->DroppedKeyFrames() > 0)
+            cout << "Surfel Mapping dropped " << mpSurfelMapper->DroppedKeyFrames() << " keyframes" << endl;
         saveSurfels(pointCloud);
 
         if (mpViewer) {
@@ -293,6 +337,29 @@ namespace ORB_SLAM2 {
         int x, y;
     };
 
+    bool System::SaveMap(const string &filename) {
+        cout << endl << "Saving map to " << filename << " ..." << endl;
+
+        MapSerializer serializer(mpMap, mpKeyFrameDatabase, mpVocabulary);
+        return serializer.Save(filename);
+    }
+
+    bool System::LoadMap(const string &filename) {
+        cout << endl << "Loading map from " << filename << " ..." << endl;
+
+        cv::Mat K;
+        float bf, scaleFactor;
+        int nScaleLevels;
+        mpTracker->GetCalibration(K, bf, nScaleLevels, scaleFactor);
+
+        MapSerializer serializer(mpMap, mpKeyFrameDatabase, mpVocabulary);
+        if (!serializer.Load(filename, K, bf, nScaleLevels, scaleFactor))
+            return false;
+
+        mpTracker->InformMapLoaded();
+        return true;
+    }
+
     void System::saveSurfels(pcl::PointCloud<pcl::PointSurfel>::Ptr pointCloud) {
         std::filebuf fb_ascii;
         fb_ascii.open("Surfels.ply", std::ios::out);
@@ -0,0 +1,144 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+using namespace std;
+
+namespace ORB_SLAM2 {
+
+    ThreadPool::ThreadPool(int nThreads) : mbFinish(false) {
+        if (nThreads <= 0)
+            nThreads = max(1, static_cast<int>(thread::hardware_concurrency()));
+
+        mvWorkers.reserve(nThreads);
+        for (int i = 0; i < nThreads; i++)
+            mvWorkers.emplace_back(&ThreadPool::WorkerLoop, this);
+    }
+
+    ThreadPool::~ThreadPool() {
+        {
+            unique_lock<mutex> lock(mMutexQueue);
+            mbFinish = true;
+        }
+        mCondQueue.notify_all();
+
+        for (auto &worker : mvWorkers)
+            worker.join();
+    }
+
+    void ThreadPool::Run(vector<function<void()> > &vTasks) {
+        if (vTasks.empty())
+            return;
+
+        if (vTasks.size() == 1 || mvWorkers.empty()) {
+            for (auto &task : vTasks)
+                task();
+            return;
+        }
+
+        shared_ptr<TaskGroup> pGroup = make_shared<TaskGroup>();
+        pGroup->vTasks.swap(vTasks);
+        const size_t nTasks = pGroup->vTasks.size();
+        pGroup->vbClaimed.reset(new atomic<bool>[nTasks]);
+        for (size_t i = 0; i < nTasks; i++)
+            pGroup->vbClaimed[i] = false;
+        pGroup->nRemaining = static_cast<int>(nTasks);
+
+        // The first task is kept for the calling thread
+        {
+            unique_lock<mutex> lock(mMutexQueue);
+            for (size_t i = 1; i < nTasks; i++)
+                mqTasks.emplace_back(pGroup, i);
+        }
+        if (nTasks > 2)
+            mCondQueue.notify_all();
+        else
+            mCondQueue.notify_one();
+
+        // Help with the tasks of this group not yet picked up by a worker
+        for (size_t i = 0; i < nTasks; i++)
+            ExecuteTask(pGroup, i);
+
+        unique_lock<mutex> lock(pGroup->mMutexDone);
+        while (pGroup->nRemaining > 0)
+            pGroup->mCondDone.wait(lock);
+
+        vTasks.swap(pGroup->vTasks);
+    }
+
+    void ThreadPool::ParallelFor(int begin, int end, int nGrain, const function<void(int, int)> &f) {
+        if (end <= begin)
+            return;
+
+        nGrain = max(1, nGrain);
+        const int nChunks = (end - begin + nGrain - 1) / nGrain;
+        const int nTasks = min(nChunks, GetNumThreads() + 1);
+        if (nTasks <= 1) {
+            f(begin, end);
+            return;
+        }
+
+        atomic<int> nNextChunk(0);
+        vector<function<void()> > vTasks(nTasks, [&] {
+            for (int chunk = nNextChunk++; chunk < nChunks; chunk = nNextChunk++) {
+                int chunkBegin = begin + chunk * nGrain;
+                f(chunkBegin, min(end, chunkBegin + nGrain));
+            }
+        });
+        Run(vTasks);
+    }
+
+    bool ThreadPool::ExecuteTask(const shared_ptr<TaskGroup> &pGroup, size_t idx) {
+        if (pGroup->vbClaimed[idx].exchange(true))
+            return false;
+
+        pGroup->vTasks[idx]();
+
+        if (--pGroup->nRemaining == 0) {
+            unique_lock<mutex> lock(pGroup->mMutexDone);
+            pGroup->mCondDone.notify_all();
+        }
+
+        return true;
+    }
+
+    void ThreadPool::WorkerLoop() {
+        while (1) {
+            pair<shared_ptr<TaskGroup>, size_t> task;
+            {
+                unique_lock<mutex> lock(mMutexQueue);
+                while (mqTasks.empty() && !mbFinish)
+                    mCondQueue.wait(lock);
+
+                if (mqTasks.empty())
+                    return;
+
+                task = mqTasks.front();
+                mqTasks.pop_front();
+            }
+
+            ExecuteTask(task.first, task.second);
+        }
+    }
+
+} //namespace ORB_SLAM
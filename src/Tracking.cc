@@ -25,6 +25,10 @@
 
 #include "Optimizer.h"
 #include "PnPsolver.h"
+#include "MapSerializer.h"
+
+#include <unordered_map>
+#include <unordered_set>
 
 
 using namespace std;
@@ -35,10 +39,11 @@ using namespace Eigen;
 namespace ORB_SLAM2 {
 
     Tracking::Tracking(System *pSys, ORBVocabulary *pVoc, FrameDrawer *pFrameDrawer, MapDrawer *pMapDrawer, Map *pMap,
-                       KeyFrameDatabase *pKFDB, const string &strSettingPath) :
-            mState(NO_IMAGES_YET), mbOnlyTracking(false), mbVO(false), mpORBVocabulary(pVoc),
-            mpKeyFrameDB(pKFDB), mpSystem(pSys), mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer),
-            mpMap(pMap), mnLastRelocFrameId(0) {
+                       KeyFrameDatabase *pKFDB, ThreadPool *pThreadPool, const string &strSettingPath) :
+            mState(NO_IMAGES_YET), mbOnlyTracking(false), mbVO(false), mbRelocalizeLoadedMap(false),
+            mpORBVocabulary(pVoc), mpKeyFrameDB(pKFDB), mpSystem(pSys), mpThreadPool(pThreadPool),
+            mpFrameDrawer(pFrameDrawer), mpMapDrawer(pMapDrawer), mpMap(pMap), mnLastRelocFrameId(0),
+            mbBuildingFrame(false), mbFrontEndFinishRequested(false), mbFrontEndFinished(true) {
 // Load camera parameters from settings file
 
         cv::FileStorage fSettings(strSettingPath, cv::FileStorage::READ);
@@ -127,6 +132,20 @@ namespace ORB_SLAM2 {
         cout << "- Initial Fast Threshold: " << fIniThFAST << endl;
         cout << "- Minimum Fast Threshold: " << fMinThFAST << endl;
 
+        // Load line parameters
+
+        int nLineFeatures = fSettings["LINEextractor.nFeatures"];
+        if (nLineFeatures <= 0)
+            nLineFeatures = 40;
+        int nLineGridCols = fSettings["LINEextractor.gridCols"];
+        int nLineGridRows = fSettings["LINEextractor.gridRows"];
+
+        mpLineSegment = new LineSegment(nLineFeatures, nLineGridCols, nLineGridRows);
+
+        cout << endl << "Line Extractor Parameters: " << endl;
+        cout << "- Number of Features: " << nLineFeatures << endl;
+        cout << "- Grid: " << max(1, nLineGridCols) << "x" << max(1, nLineGridRows) << endl;
+
         mThDepth = mbf * (float) fSettings["ThDepth"] / fx;
         cout << endl << "Depth Threshold (Close/Far Points): " << mThDepth << endl;
 
@@ -136,6 +155,8 @@ namespace ORB_SLAM2 {
         else
             mDepthMapFactor = 1.0f / mDepthMapFactor;
 
+        mpDepthPreprocessor = new DepthPreprocessor(mK, mDepthMapFactor);
+
         // Load plane parameters
 
         float mfDThRef = fSettings["Plane.AssociationDisRef"];
@@ -147,6 +168,8 @@ namespace ORB_SLAM2 {
         mfMFVerTh = fSettings["Plane.MFVerticalThreshold"];
         mfDisTh = fSettings["Plane.DistanceThreshold"];
 
+        mbPlaneWarmStart = (int) fSettings["Plane.WarmStart"];
+
         fullManhattanFound = false;
 
         // Initialize matchers
@@ -166,7 +189,23 @@ namespace ORB_SLAM2 {
         double planeChi = fSettings["Plane.Chi"];
         double planeChiVP = fSettings["Plane.VPChi"];
 
-        mpOptimizer = new Optimizer(angleInfo, disInfo, parInfo, verInfo, planeChi, planeChiVP, mfAThRef, mfParTh);
+        bool bG2oPoseOptimization = (int) fSettings["Tracking.G2oPoseOptimization"];
+        bool bCheckPoseOptimization = (int) fSettings["Tracking.CheckPoseOptimization"];
+
+        mpOptimizer = new Optimizer(angleInfo, disInfo, parInfo, verInfo, planeChi, planeChiVP, mfAThRef, mfParTh,
+                                    bG2oPoseOptimization);
+        mpPoseOptimizationCheck = bCheckPoseOptimization ?
+                                  new PoseOptimizationCheck(angleInfo, disInfo, parInfo, verInfo, planeChi, planeChiVP,
+                                                            mfAThRef, mfParTh) : NULL;
+
+        // Load front-end pipeline parameters
+
+        mnPipelineDepth = fSettings["Tracking.PipelineDepth"];
+        if (mnPipelineDepth < 0)
+            mnPipelineDepth = 0;
+
+        if (mnPipelineDepth > 0)
+            cout << endl << "Front-end pipeline depth: " << mnPipelineDepth << endl;
     }
 
 
@@ -182,35 +221,240 @@ namespace ORB_SLAM2 {
         mpViewer = pViewer;
     }
 
-    cv::Mat Tracking::GrabImage(const cv::Mat &imRGB, const cv::Mat &imD, const double &timestamp) {
-        mImRGB = imRGB;
-        mImGray = imRGB;
-        mImDepth = imD;
+    void Tracking::PreprocessImages(const cv::Mat &imRGB, const cv::Mat &imD, cv::Mat &imGray, cv::Mat &imDepth,
+                                    cv::Mat &imPointCloud) {
+        imGray = imRGB;
 
-        if (mImGray.channels() == 3) {
+        if (imGray.channels() == 3) {
             if (mbRGB)
-                cvtColor(mImGray, mImGray, CV_RGB2GRAY);
+                cvtColor(imGray, imGray, CV_RGB2GRAY);
             else
-                cvtColor(mImGray, mImGray, CV_BGR2GRAY);
-        } else if (mImGray.channels() == 4) {
+                cvtColor(imGray, imGray, CV_BGR2GRAY);
+        } else if (imGray.channels() == 4) {
             if (mbRGB)
-                cvtColor(mImGray, mImGray, CV_RGBA2GRAY);
+                cvtColor(imGray, imGray, CV_RGBA2GRAY);
             else
-                cvtColor(mImGray, mImGray, CV_BGRA2GRAY);
+                cvtColor(imGray, imGray, CV_BGRA2GRAY);
+        } else {
+            // The frame buffer must not share memory with the caller, which may reuse its image
+            imGray = imRGB.clone();
+        }
+
+        mpDepthPreprocessor->Process(imD, imDepth, imPointCloud);
+    }
+
+    cv::Mat Tracking::GrabImage(const cv::Mat &imRGB, const cv::Mat &imD, const double &timestamp) {
+        if (mnPipelineDepth > 0)
+            return GrabImagePipelined(imRGB, imD, timestamp);
+
+        mImRGB = imRGB;
+        PreprocessImages(imRGB, imD, mImGray, mImDepth, mImPointCloud);
+
+        mCurrentFrame = Frame(mImRGB, mImGray, mImDepth, mImPointCloud, timestamp, mpORBextractor, mpLineSegment,
+                              mpORBVocabulary, mK, mDistCoef, mbf, mThDepth, mfDisTh, mpThreadPool,
+                              PreparePlanePrior(mVelocity));
+        if (mbPlaneWarmStart)
+            mCurrentFrame.planeDetector.exportPrior(mPlanePrior, mK);
+        mpFrameBuffer = FrameBuffer::Create(mImGray, mImDepth, mImPointCloud,
+                                            mCurrentFrame.planeDetector.plane_filter.membershipImg);
+
+        Track();
+
+        // Outside Track(), which holds the map mutex while inserting keyframes
+        mpSurfelMapper->WaitForQueueSpace();
+
+        return mCurrentFrame.mTcw.clone();
+    }
+
+    cv::Mat Tracking::GrabImagePipelined(const cv::Mat &imRGB, const cv::Mat &imD, const double &timestamp) {
+        size_t nInFlight;
+        {
+            unique_lock<mutex> lock(mMutexPipeline);
+
+            PipelinedFrame item;
+            item.pFrame = static_cast<Frame *>(NULL);
+            item.imRGB = imRGB;
+            item.imDepth = imD;
+            item.timestamp = timestamp;
+            item.tGrab = std::chrono::steady_clock::now();
+            mlFramesToBuild.push_back(item);
+
+            nInFlight = mlFramesToBuild.size() + mlBuiltFrames.size() + (mbBuildingFrame ? 1 : 0);
         }
+        mCondFrontEnd.notify_one();
+
+        // The pipeline is still filling up
+        if (nInFlight <= static_cast<size_t>(mnPipelineDepth))
+            return cv::Mat();
+
+        // Back-pressure: the caller blocks here until the oldest frame has been built and tracked
+        return TrackNextPipelinedFrame();
+    }
 
-        mCurrentFrame = Frame(mImRGB, mImGray, mImDepth, timestamp, mpORBextractor, mpORBVocabulary, mK,
-                              mDistCoef, mbf, mThDepth, mDepthMapFactor, mfDisTh);
+    cv::Mat Tracking::TrackNextPipelinedFrame() {
+        PipelinedFrame item;
+        {
+            unique_lock<mutex> lock(mMutexPipeline);
+            while (mlBuiltFrames.empty())
+                mCondBuiltFrame.wait(lock);
 
-        if (mDepthMapFactor != 1 || mImDepth.type() != CV_32F) {
-            mImDepth.convertTo(mImDepth, CV_32F, mDepthMapFactor);
+            item = mlBuiltFrames.front();
+            mlBuiltFrames.pop_front();
         }
 
+        std::chrono::steady_clock::time_point tTrackStart = std::chrono::steady_clock::now();
+
+        mImRGB = item.imRGB;
+        mImGray = item.imGray;
+        mImDepth = item.imDepth;
+        mImPointCloud = item.imPointCloud;
+        mCurrentFrame = *item.pFrame;
+        delete item.pFrame;
+        mpFrameBuffer = FrameBuffer::Create(mImGray, mImDepth, mImPointCloud,
+                                            mCurrentFrame.planeDetector.plane_filter.membershipImg);
+
         Track();
 
+        // Outside Track(), which holds the map mutex while inserting keyframes
+        mpSurfelMapper->WaitForQueueSpace();
+
+        {
+            unique_lock<mutex> lock(mMutexPipeline);
+            mPipelineVelocity = mVelocity.clone();
+        }
+
+        std::chrono::steady_clock::time_point tTrackEnd = std::chrono::steady_clock::now();
+
+        {
+            unique_lock<mutex> lock(mMutexPipelineStats);
+            const double endToEnd = std::chrono::duration_cast<std::chrono::duration<double> >(
+                    tTrackEnd - item.tGrab).count();
+            mPipelineStats.nFrames++;
+            mPipelineStats.extraction += std::chrono::duration_cast<std::chrono::duration<double> >(
+                    item.tBuilt - item.tBuildStart).count();
+            mPipelineStats.queue += std::chrono::duration_cast<std::chrono::duration<double> >(
+                    tTrackStart - item.tBuilt).count();
+            mPipelineStats.tracking += std::chrono::duration_cast<std::chrono::duration<double> >(
+                    tTrackEnd - tTrackStart).count();
+            mPipelineStats.endToEnd += endToEnd;
+            mPipelineStats.maxEndToEnd = max(mPipelineStats.maxEndToEnd, endToEnd);
+        }
+
         return mCurrentFrame.mTcw.clone();
     }
 
+    void Tracking::RunFrontEnd() {
+        {
+            unique_lock<mutex> lock(mMutexPipeline);
+            mbFrontEndFinished = false;
+        }
+
+        while (1) {
+            PipelinedFrame item;
+            cv::Mat velocity;
+            {
+                unique_lock<mutex> lock(mMutexPipeline);
+                while (mlFramesToBuild.empty() && !mbFrontEndFinishRequested)
+                    mCondFrontEnd.wait(lock);
+
+                if (mlFramesToBuild.empty())
+                    break;
+
+                item = mlFramesToBuild.front();
+                mlFramesToBuild.pop_front();
+                mbBuildingFrame = true;
+                velocity = mPipelineVelocity;
+            }
+
+            item.tBuildStart = std::chrono::steady_clock::now();
+
+            cv::Mat imRawDepth = item.imDepth;
+            PreprocessImages(item.imRGB, imRawDepth, item.imGray, item.imDepth, item.imPointCloud);
+
+            item.pFrame = new Frame(item.imRGB, item.imGray, item.imDepth, item.imPointCloud, item.timestamp,
+                                    mpORBextractor, mpLineSegment, mpORBVocabulary, mK, mDistCoef, mbf, mThDepth,
+                                    mfDisTh, mpThreadPool, PreparePlanePrior(velocity));
+            if (mbPlaneWarmStart)
+                item.pFrame->planeDetector.exportPrior(mPlanePrior, mK);
+
+            item.tBuilt = std::chrono::steady_clock::now();
+
+            {
+                unique_lock<mutex> lock(mMutexPipeline);
+                mlBuiltFrames.push_back(item);
+                mbBuildingFrame = false;
+            }
+            mCondBuiltFrame.notify_all();
+        }
+
+        {
+            unique_lock<mutex> lock(mMutexPipeline);
+            mbFrontEndFinished = true;
+        }
+        mCondBuiltFrame.notify_all();
+    }
+
+    const ahc::PlanePrior *Tracking::PreparePlanePrior(const cv::Mat &velocity) {
+        if (!mbPlaneWarmStart || mPlanePrior.empty())
+            return static_cast<const ahc::PlanePrior *>(NULL);
+
+        if (velocity.empty()) {
+            mPlanePrior.setMotion(NULL, NULL);
+        } else {
+            // The velocity maps the last camera to the current one, the prior needs the inverse
+            const cv::Mat Rlc = velocity.rowRange(0, 3).colRange(0, 3).t();
+            const cv::Mat tlc = -Rlc * velocity.rowRange(0, 3).col(3);
+            double R[3][3], t[3];
+            for (int i = 0; i < 3; i++) {
+                for (int j = 0; j < 3; j++)
+                    R[i][j] = Rlc.at<float>(i, j);
+                t[i] = tlc.at<float>(i);
+            }
+            mPlanePrior.setMotion(R, t);
+        }
+
+        return &mPlanePrior;
+    }
+
+    void Tracking::FlushPipeline() {
+        if (mnPipelineDepth <= 0)
+            return;
+
+        while (1) {
+            {
+                unique_lock<mutex> lock(mMutexPipeline);
+                if (mlFramesToBuild.empty() && mlBuiltFrames.empty() && !mbBuildingFrame)
+                    break;
+            }
+            TrackNextPipelinedFrame();
+        }
+
+        unique_lock<mutex> lock(mMutexPipeline);
+        mbFrontEndFinishRequested = true;
+        mCondFrontEnd.notify_one();
+        while (!mbFrontEndFinished)
+            mCondBuiltFrame.wait(lock);
+    }
+
+    void Tracking::ClearPipeline() {
+        unique_lock<mutex> lock(mMutexPipeline);
+        mlFramesToBuild.clear();
+
+        // Let the front-end finish the frame it is building, it is discarded as well
+        while (mbBuildingFrame)
+            mCondBuiltFrame.wait(lock);
+
+        for (list<PipelinedFrame>::iterator lit = mlBuiltFrames.begin(), lend = mlBuiltFrames.end();
+             lit != lend; lit++)
+            delete lit->pFrame;
+        mlBuiltFrames.clear();
+    }
+
+    Tracking::PipelineStats Tracking::GetPipelineStats() {
+        unique_lock<mutex> lock(mMutexPipelineStats);
+        return mPipelineStats;
+    }
+
     void Tracking::Track() {
 
         if (mState == NO_IMAGES_YET) {
@@ -224,9 +468,7 @@ namespace ORB_SLAM2 {
 
         if (mState == NOT_INITIALIZED) {
             StereoInitialization();
-            mpSurfelMapper->InsertKeyFrame(mImGray.clone(), mImDepth.clone(),
-                                           mCurrentFrame.planeDetector.plane_filter.membershipImg.clone(),
-                                           mCurrentFrame.mTwc.clone(), 0);
+            mpSurfelMapper->InsertKeyFrame(mpFrameBuffer, mCurrentFrame.mTwc.clone(), 0);
 
             mpFrameDrawer->Update(this);
 
@@ -236,7 +478,11 @@ namespace ORB_SLAM2 {
             bool bOK = false;
             bool bManhattan = false;
             // Initial camera pose estimation using motion model or relocalization (if tracking is lost)
-            if (!mbOnlyTracking) {
+            if (mbRelocalizeLoadedMap) {
+                bOK = Relocalization();
+                if (bOK)
+                    mbRelocalizeLoadedMap = false;
+            } else if (!mbOnlyTracking) {
 
                 // Local Mapping is activated. This is the normal behaviour, unless
                 // you explicitly activate the "only tracking" mode.
@@ -250,7 +496,7 @@ namespace ORB_SLAM2 {
                     mCurrentFrame.SetPose(mVelocity * mLastFrame.mTcw);
                 }
 
-                mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mpMap->GetAllMapPlanes());
+                SearchPlanes();
 
                 bManhattan = DetectManhattan();
 
@@ -306,7 +552,7 @@ namespace ORB_SLAM2 {
                             mCurrentFrame.SetPose(mLastFrame.mTcw);
                         }
 
-                        mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mpMap->GetAllMapPlanes());
+                        SearchPlanes();
 
                         bManhattan = DetectManhattan();
 
@@ -362,7 +608,7 @@ namespace ORB_SLAM2 {
                         if (!mVelocity.empty()) {
                             mCurrentFrame.SetPose(mVelocity * mLastFrame.mTcw);
 
-                            mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mpMap->GetAllMapPlanes());
+                            SearchPlanes();
 
                             bManhattan = DetectManhattan();
 
@@ -493,9 +739,7 @@ namespace ORB_SLAM2 {
                         }
                     }
 
-                    mpSurfelMapper->InsertKeyFrame(mImGray.clone(), mImDepth.clone(),
-                                                   mCurrentFrame.planeDetector.plane_filter.membershipImg.clone(),
-                                                   mCurrentFrame.mTwc.clone(), referenceIndex);
+                    mpSurfelMapper->InsertKeyFrame(mpFrameBuffer, mCurrentFrame.mTwc.clone(), referenceIndex);
                 }
 
                 // We allow points with high innovation (considererd outliers by the Huber Function)
@@ -515,7 +759,8 @@ namespace ORB_SLAM2 {
 
             // Reset if the camera get lost soon after initialization
             if (mState == LOST) {
-                if (mpMap->KeyFramesInMap() <= 5) {
+                // A loaded map file only has the keyframes built so far in the map
+                if (mpMap->KeyFramesInMap() <= 5 && !mpKeyFrameDB->GetMappedMap()) {
                     cout << "Track lost soon after initialisation, reseting..." << endl;
                     mpSystem->Reset();
                     return;
@@ -535,7 +780,7 @@ namespace ORB_SLAM2 {
             mlpReferences.push_back(mpReferenceKF);
             mlFrameTimes.push_back(mCurrentFrame.mTimeStamp);
             mlbLost.push_back(mState == LOST);
-        } else {
+        } else if (!mlRelativeFramePoses.empty()) {
             // This can happen if tracking is lost
             mlRelativeFramePoses.push_back(mlRelativeFramePoses.back());
             mlpReferences.push_back(mlpReferences.back());
@@ -609,6 +854,7 @@ namespace ORB_SLAM2 {
             mvpLocalKeyFrames.push_back(pKFini);
             mvpLocalMapPoints = mpMap->GetAllMapPoints();
             mvpLocalMapLines = mpMap->GetAllMapLines();
+            mvpLocalMapPlanes = mpMap->GetAllMapPlanes();
 
             mpReferenceKF = pKFini;
             mCurrentFrame.mpReferenceKF = pKFini;
@@ -656,121 +902,82 @@ namespace ORB_SLAM2 {
 
         int id1, id2, id3 = -1;
 
+        // Frame plane of each matched map plane, the registered Manhattan frames are only kept if all their
+        // planes are seen again
+        unordered_map<MapPlane *, int> mPlaneIndices;
         for (size_t i = 0; i < mCurrentFrame.mnPlaneNum; i++) {
-            cv::Mat p3Dc1 = mCurrentFrame.mvPlaneCoefficients[i];
-            MapPlane *pMP1 = mCurrentFrame.mvpMapPlanes[i];
+            MapPlane *pMP = mCurrentFrame.mvpMapPlanes[i];
+            if (pMP && !pMP->isBad())
+                mPlaneIndices.emplace(pMP, i);
+        }
 
-            if (!pMP1 || pMP1->isBad()) {
+        auto isOrthogonal = [&](int i, int j) {
+            const cv::Mat &p1 = mCurrentFrame.mvPlaneCoefficients[i];
+            const cv::Mat &p2 = mCurrentFrame.mvPlaneCoefficients[j];
+            const float d = p1.at<float>(0) * p2.at<float>(0) + p1.at<float>(1) * p2.at<float>(1) +
+                            p1.at<float>(2) * p2.at<float>(2);
+            return std::abs(d) <= mfMFVerTh;
+        };
+
+        // Every frame is reached through each of its planes, it is scored once
+        unordered_set<unsigned long> sVisitedFrames;
+        for (size_t i = 0; i < mCurrentFrame.mnPlaneNum; i++) {
+            MapPlane *pMP = mCurrentFrame.mvpMapPlanes[i];
+            auto itIndex = mPlaneIndices.find(pMP);
+            if (itIndex == mPlaneIndices.end() || itIndex->second != int(i)) {
                 continue;
             }
 
-            for (size_t j = i + 1; j < mCurrentFrame.mnPlaneNum; j++) {
-                cv::Mat p3Dc2 = mCurrentFrame.mvPlaneCoefficients[j];
-                MapPlane *pMP2 = mCurrentFrame.mvpMapPlanes[j];
-
-                if (!pMP2 || pMP2->isBad()) {
+            for (const ManhattanFrame &frame : mpMap->GetManhattanFrames(pMP)) {
+                if (!sVisitedFrames.insert(frame.mnId).second) {
                     continue;
                 }
 
-                float angle12 = p3Dc1.at<float>(0) * p3Dc2.at<float>(0) +
-                                p3Dc1.at<float>(1) * p3Dc2.at<float>(1) +
-                                p3Dc1.at<float>(2) * p3Dc2.at<float>(2);
-
-                if (angle12 > mfMFVerTh || angle12 < -mfMFVerTh) {
-                    continue;
-                }
-
-                for (size_t k = j + 1; k < mCurrentFrame.mnPlaneNum; k++) {
-                    cv::Mat p3Dc3 = mCurrentFrame.mvPlaneCoefficients[k];
-                    MapPlane *pMP3 = mCurrentFrame.mvpMapPlanes[k];
-
-                    if (!pMP3 || pMP3->isBad()) {
-                        continue;
-                    }
-
-                    float angle13 = p3Dc1.at<float>(0) * p3Dc3.at<float>(0) +
-                                    p3Dc1.at<float>(1) * p3Dc3.at<float>(1) +
-                                    p3Dc1.at<float>(2) * p3Dc3.at<float>(2);
-
-                    float angle23 = p3Dc2.at<float>(0) * p3Dc3.at<float>(0) +
-                                    p3Dc2.at<float>(1) * p3Dc3.at<float>(1) +
-                                    p3Dc2.at<float>(2) * p3Dc3.at<float>(2);
-
-                    if (angle13 > mfMFVerTh || angle13 < -mfMFVerTh || angle23 > mfMFVerTh || angle23 < -mfMFVerTh) {
-                        continue;
-                    }
-
-                    KeyFrame *pKF = mpMap->GetManhattanObservation(pMP1, pMP2, pMP3);
-
-                    if (!pKF) {
-                        continue;
-                    }
-
-                    auto idx1 = pMP1->GetIndexInKeyFrame(pKF);
-                    auto idx2 = pMP2->GetIndexInKeyFrame(pKF);
-                    auto idx3 = pMP3->GetIndexInKeyFrame(pKF);
-
-                    if (idx1 == -1 || idx2 == -1 || idx3 == -1) {
-                        continue;
+                const bool bFull = frame.mvpPlanes[2] != nullptr;
+                const int nPlanes = bFull ? 3 : 2;
+                KeyFrame *pKF = frame.mpKF;
+
+                int vIndices[3], vKFIndices[3];
+                bool bValid = true;
+                for (int n = 0; n < nPlanes && bValid; n++) {
+                    auto it = mPlaneIndices.find(frame.mvpPlanes[n]);
+                    bValid = it != mPlaneIndices.end();
+                    if (bValid) {
+                        vIndices[n] = it->second;
+                        vKFIndices[n] = frame.mvpPlanes[n]->GetIndexInKeyFrame(pKF);
+                        bValid = vKFIndices[n] != -1;
                     }
-
-                    int score = pKF->mvPlanePoints[idx1].size() +
-                                pKF->mvPlanePoints[idx2].size() +
-                                pKF->mvPlanePoints[idx3].size() +
-                                mCurrentFrame.mvPlanePoints[i].size() +
-                                mCurrentFrame.mvPlanePoints[j].size() +
-                                mCurrentFrame.mvPlanePoints[k].size();
-
-                    if (score > maxScore) {
-                        maxScore = score;
-
-                        pKFCandidate = pKF;
-                        pMFc1 = p3Dc1;
-                        pMFc2 = p3Dc2;
-                        pMFc3 = p3Dc3;
-                        pMFm1 = pKF->mvPlaneCoefficients[idx1];
-                        pMFm2 = pKF->mvPlaneCoefficients[idx2];
-                        pMFm3 = pKF->mvPlaneCoefficients[idx3];
-
-                        id1 = pMP1->mnId;
-                        id2 = pMP2->mnId;
-                        id3 = pMP3->mnId;
-
-                        fullManhattanFound = true;
-                    }
-                }
-
-                KeyFrame *pKF = mpMap->GetPartialManhattanObservation(pMP1, pMP2);
-
-                if (!pKF) {
-                    continue;
                 }
-
-                auto idx1 = pMP1->GetIndexInKeyFrame(pKF);
-                auto idx2 = pMP2->GetIndexInKeyFrame(pKF);
-
-                if (idx1 == -1 || idx2 == -1) {
+                for (int n = 0; n < nPlanes && bValid; n++)
+                    for (int m = n + 1; m < nPlanes && bValid; m++)
+                        bValid = vIndices[n] != vIndices[m] && isOrthogonal(vIndices[n], vIndices[m]);
+                if (!bValid) {
                     continue;
                 }
 
-                int score = pKF->mvPlanePoints[idx1].size() +
-                            pKF->mvPlanePoints[idx2].size() +
-                            mCurrentFrame.mvPlanePoints[i].size() +
-                            mCurrentFrame.mvPlanePoints[j].size();
+                int score = 0;
+                for (int n = 0; n < nPlanes; n++)
+                    score += pKF->mvPlanePoints[vKFIndices[n]].size() + mCurrentFrame.mvPlanePoints[vIndices[n]].size();
 
                 if (score > maxScore) {
                     maxScore = score;
 
                     pKFCandidate = pKF;
-                    pMFc1 = p3Dc1;
-                    pMFc2 = p3Dc2;
-                    pMFm1 = pKF->mvPlaneCoefficients[idx1];
-                    pMFm2 = pKF->mvPlaneCoefficients[idx2];
-
-                    id1 = pMP1->mnId;
-                    id2 = pMP2->mnId;
+                    pMFc1 = mCurrentFrame.mvPlaneCoefficients[vIndices[0]];
+                    pMFc2 = mCurrentFrame.mvPlaneCoefficients[vIndices[1]];
+                    pMFm1 = pKF->mvPlaneCoefficients[vKFIndices[0]];
+                    pMFm2 = pKF->mvPlaneCoefficients[vKFIndices[1]];
+
+                    id1 = frame.mvpPlanes[0]->mnId;
+                    id2 = frame.mvpPlanes[1]->mnId;
+
+                    if (bFull) {
+                        pMFc3 = mCurrentFrame.mvPlaneCoefficients[vIndices[2]];
+                        pMFm3 = pKF->mvPlaneCoefficients[vKFIndices[2]];
+                        id3 = frame.mvpPlanes[2]->mnId;
+                    }
 
-                    fullManhattanFound = false;
+                    fullManhattanFound = bFull;
                 }
             }
         }
@@ -858,7 +1065,7 @@ namespace ORB_SLAM2 {
 
         int nmatches = matcher.SearchByBoW(mpReferenceKF, mCurrentFrame, vpMapPointMatches);
         int lmatches = mpLineMatcher->SearchByDescriptor(mpReferenceKF, mCurrentFrame, vpMapLineMatches);
-        int planeMatches = mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mpMap->GetAllMapPlanes());
+        int planeMatches = SearchPlanes();
 
         int initialMatches = nmatches + lmatches + planeMatches;
 
@@ -963,7 +1170,7 @@ namespace ORB_SLAM2 {
             nmatches = matcher.SearchByProjection(mCurrentFrame, mLastFrame, 4 * th);
         }
 
-        int planeMatches = mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mpMap->GetAllMapPlanes());
+        int planeMatches = SearchPlanes();
 
         int initialMatches = nmatches + lmatches + planeMatches;
 
@@ -1157,7 +1364,7 @@ namespace ORB_SLAM2 {
 
         int nmatches = matcher.SearchByBoW(mpReferenceKF, mCurrentFrame, vpMapPointMatches);
         int lmatches = mpLineMatcher->SearchByDescriptor(mpReferenceKF, mCurrentFrame, vpMapLineMatches);
-        int planeMatches = mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mpMap->GetAllMapPlanes());
+        int planeMatches = SearchPlanes();
 
         float initialMatches = nmatches + lmatches + planeMatches;
 
@@ -1168,7 +1375,7 @@ namespace ORB_SLAM2 {
         mCurrentFrame.mvpMapLines = vpMapLineMatches;
         mCurrentFrame.mvpMapPoints = vpMapPointMatches;
 
-        mpOptimizer->PoseOptimization(&mCurrentFrame);
+        PoseOptimization();
 
         // Discard outliers
 
@@ -1240,6 +1447,13 @@ namespace ORB_SLAM2 {
         return true;
     }
 
+    int Tracking::PoseOptimization() {
+        if (mpPoseOptimizationCheck)
+            return mpPoseOptimizationCheck->PoseOptimization(mpOptimizer, &mCurrentFrame);
+
+        return mpOptimizer->PoseOptimization(&mCurrentFrame);
+    }
+
     bool Tracking::TrackWithMotionModel() {
         ORBmatcher matcher(0.9, true);
 
@@ -1262,7 +1476,7 @@ namespace ORB_SLAM2 {
             nmatches = matcher.SearchByProjection(mCurrentFrame, mLastFrame, 4 * th);
         }
 
-        int planeMatches = mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mpMap->GetAllMapPlanes());
+        int planeMatches = SearchPlanes();
 
         int initialMatches = nmatches + lmatches + planeMatches;
 
@@ -1271,7 +1485,7 @@ namespace ORB_SLAM2 {
         }
 
         // Optimize frame pose with all matches
-        mpOptimizer->PoseOptimization(&mCurrentFrame);
+        PoseOptimization();
 
         // Discard outliers
         float nmatchesMap = 0;
@@ -1351,16 +1565,15 @@ namespace ORB_SLAM2 {
 
         UpdateLocalMap();
 
-        thread threadPoints(&Tracking::SearchLocalPoints, this);
-        thread threadLines(&Tracking::SearchLocalLines, this);
-        thread threadPlanes(&Tracking::SearchLocalPlanes, this);
-        threadPoints.join();
-        threadLines.join();
-        threadPlanes.join();
+        vector<function<void()> > vTasks;
+        vTasks.emplace_back([this] { SearchLocalPoints(); });
+        vTasks.emplace_back([this] { SearchLocalLines(); });
+        vTasks.emplace_back([this] { SearchLocalPlanes(); });
+        mpThreadPool->Run(vTasks);
 
-        mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mpMap->GetAllMapPlanes());
+        SearchPlanes();
 
-        mpOptimizer->PoseOptimization(&mCurrentFrame);
+        PoseOptimization();
 
         mnMatchesInliers = 0;
 
@@ -1497,6 +1710,7 @@ namespace ORB_SLAM2 {
             if (bLocalMappingIdle) {
                 return true;
             } else {
+                mpLocalMapper->InterruptBA();
                 if (mpLocalMapper->KeyframesInQueue() < 3)
                     return true;
                 else
@@ -1667,22 +1881,10 @@ namespace ORB_SLAM2 {
             }
         }
 
-        int nToMatch = 0;
-
-// Project points in frame and check its visibility
-        for (vector<MapPoint *>::iterator vit = mvpLocalMapPoints.begin(), vend = mvpLocalMapPoints.end();
-             vit != vend; vit++) {
-            MapPoint *pMP = *vit;
-            if (pMP->mnLastFrameSeen == mCurrentFrame.mnId)
-                continue;
-            if (pMP->isBad())
-                continue;
-            // Project (this fills MapPoint variables for matching)
-            if (mCurrentFrame.isInFrustum(pMP, 0.5)) {
-                pMP->IncreaseVisible();
-                nToMatch++; //将要match的
-            }
-        }
+// Project points in frame and check its visibility (this fills the snapshot variables for matching)
+        const int nToMatch = mLocalMapPoints.Project(mCurrentFrame, 0.5);
+        for (int k = 0; k < nToMatch; k++)
+            mLocalMapPoints.mvpMapPoints[mLocalMapPoints.mvnVisible[k]]->IncreaseVisible();
 
         if (nToMatch > 0) {
             ORBmatcher matcher(0.8);
@@ -1690,7 +1892,7 @@ namespace ORB_SLAM2 {
             // If the camera has been relocalised recently, perform a coarser search
             if (mCurrentFrame.mnId < mnLastRelocFrameId + 2)
                 th = 5;
-            matcher.SearchByProjection(mCurrentFrame, mvpLocalMapPoints, th);
+            matcher.SearchByProjection(mCurrentFrame, mLocalMapPoints, th);
         }
     }
 
@@ -1751,6 +1953,16 @@ namespace ORB_SLAM2 {
     }
 
 
+    int Tracking::SearchPlanes() {
+        if (!mvpLocalMapPlanes.empty() && mCurrentFrame.mnId >= mnLastRelocFrameId + 2) {
+            int nmatches = mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mvpLocalMapPlanes);
+            if (nmatches > 0 || mCurrentFrame.mnPlaneNum == 0)
+                return nmatches;
+        }
+
+        return mpPlaneMatcher->SearchMapByCoefficients(mCurrentFrame, mpMap);
+    }
+
     void Tracking::UpdateLocalMap() {
 // This is for visualization
         mpMap->SetReferenceMapPoints(mvpLocalMapPoints);
@@ -1761,6 +1973,7 @@ namespace ORB_SLAM2 {
 
         UpdateLocalPoints();
         UpdateLocalLines();
+        UpdateLocalPlanes();
     }
 
     void Tracking::UpdateLocalLines() {
@@ -1786,6 +1999,32 @@ namespace ORB_SLAM2 {
         }
     }
 
+    void Tracking::UpdateLocalPlanes() {
+        mvpLocalMapPlanes.clear();
+
+        for (vector<KeyFrame *>::const_iterator itKF = mvpLocalKeyFrames.begin(), itEndKF = mvpLocalKeyFrames.end();
+             itKF != itEndKF; itKF++) {
+            KeyFrame *pKF = *itKF;
+            const vector<MapPlane *> vpMPs = pKF->GetMapPlaneMatches();
+
+            for (vector<MapPlane *>::const_iterator itMP = vpMPs.begin(), itEndMP = vpMPs.end();
+                 itMP != itEndMP; itMP++) {
+                MapPlane *pMP = *itMP;
+                if (!pMP)
+                    continue;
+                if (pMP->mnTrackReferenceForFrame == mCurrentFrame.mnId)
+                    continue;
+                if (!pMP->isBad()) {
+                    mvpLocalMapPlanes.push_back(pMP);
+                    pMP->mnTrackReferenceForFrame = mCurrentFrame.mnId;
+                }
+            }
+        }
+
+        // Same order as the map, so that ties are resolved as in a global search
+        sort(mvpLocalMapPlanes.begin(), mvpLocalMapPlanes.end());
+    }
+
     void Tracking::UpdateLocalPoints() {
         mvpLocalMapPoints.clear();
 
@@ -1807,6 +2046,8 @@ namespace ORB_SLAM2 {
                 }
             }
         }
+
+        mLocalMapPoints.Update(mvpLocalMapPoints);
     }
 
 
@@ -1912,16 +2153,48 @@ namespace ORB_SLAM2 {
 
 // Relocalization is performed when tracking is lost
 // Track Lost: Query KeyFrame Database for keyframe candidates for relocalisation
-        vector<KeyFrame *> vpCandidateKFs = mpKeyFrameDB->DetectRelocalizationCandidates(&mCurrentFrame);
+        vector<size_t> vnMappedCandidates;
+        vector<KeyFrame *> vpCandidateKFs = mpKeyFrameDB->DetectRelocalizationCandidates(&mCurrentFrame,
+                                                                                          vnMappedCandidates);
+
+// We perform first an ORB matching with each candidate
+// If enough matches are found we setup a PnP solver
+        ORBmatcher matcher(0.75, true);
+
+// Candidates of a loaded map file are matched in place, and only built if they have enough matches. They are
+// appended to the candidates with their matches.
+        shared_ptr<MappedMap> pMappedMap = mpKeyFrameDB->GetMappedMap();
+        vector<vector<MapPoint *> > vvpMappedMatches;
+        vector<size_t> vnMappedIndices;
+        for (size_t idx : vnMappedCandidates) {
+            vector<int> vnMatchesKF;
+            if (matcher.SearchByBoW(pMappedMap->GetMappedKeyFrame(idx), mCurrentFrame, vnMatchesKF) < 15)
+                continue;
+
+            KeyFrame *pKF = pMappedMap->GetKeyFrame(idx);
+            if (!pKF || pKF->isBad())
+                continue;
+
+            const vector<MapPoint *> vpMapPointsKF = pKF->GetMapPointMatches();
+            vector<MapPoint *> vpMapPointMatches(mCurrentFrame.N, static_cast<MapPoint *>(NULL));
+            for (int i = 0; i < mCurrentFrame.N; i++) {
+                if (vnMatchesKF[i] < 0)
+                    continue;
+                MapPoint *pMP = vpMapPointsKF[vnMatchesKF[i]];
+                if (pMP && !pMP->isBad())
+                    vpMapPointMatches[i] = pMP;
+            }
+
+            vpCandidateKFs.push_back(pKF);
+            vvpMappedMatches.push_back(vpMapPointMatches);
+            vnMappedIndices.push_back(idx);
+        }
 
         if (vpCandidateKFs.empty())
             return false;
 
         const int nKFs = vpCandidateKFs.size();
-
-// We perform first an ORB matching with each candidate
-// If enough matches are found we setup a PnP solver
-        ORBmatcher matcher(0.75, true);
+        const int nFirstMapped = nKFs - vvpMappedMatches.size();
 
         vector<PnPsolver *> vpPnPsolvers;
         vpPnPsolvers.resize(nKFs);
@@ -1939,7 +2212,15 @@ namespace ORB_SLAM2 {
             if (pKF->isBad())
                 vbDiscarded[i] = true;
             else {
-                int nmatches = matcher.SearchByBoW(pKF, mCurrentFrame, vvpMapPointMatches[i]);
+                int nmatches = 0;
+                if (i < nFirstMapped)
+                    nmatches = matcher.SearchByBoW(pKF, mCurrentFrame, vvpMapPointMatches[i]);
+                else {
+                    vvpMapPointMatches[i] = vvpMappedMatches[i - nFirstMapped];
+                    for (MapPoint *pMP : vvpMapPointMatches[i])
+                        if (pMP)
+                            nmatches++;
+                }
                 if (nmatches < 15) {
                     vbDiscarded[i] = true;
                     continue;
@@ -1955,6 +2236,7 @@ namespace ORB_SLAM2 {
 // Alternatively perform some iterations of P4P RANSAC
 // Until we found a camera pose supported by enough inliers
         bool bMatch = false;
+        int nMatchedKF = -1;
         ORBmatcher matcher2(0.9, true);
 
         while (nCandidates > 0 && !bMatch) {
@@ -1992,7 +2274,7 @@ namespace ORB_SLAM2 {
                             mCurrentFrame.mvpMapPoints[j] = NULL;
                     }
 
-                    int nGood = mpOptimizer->PoseOptimization(&mCurrentFrame);
+                    int nGood = PoseOptimization();
 
                     if (nGood < 10)
                         continue;
@@ -2007,7 +2289,7 @@ namespace ORB_SLAM2 {
                                                                       100);
 
                         if (nadditional + nGood >= 50) {
-                            nGood = mpOptimizer->PoseOptimization(&mCurrentFrame);
+                            nGood = PoseOptimization();
 
                             // If many inliers but still not enough, search by projection again in a narrower window
                             // the camera has been already optimized with many points
@@ -2021,7 +2303,7 @@ namespace ORB_SLAM2 {
 
                                 // Final optimization
                                 if (nGood + nadditional >= 50) {
-                                    nGood = mpOptimizer->PoseOptimization(&mCurrentFrame);
+                                    nGood = PoseOptimization();
 
                                     for (int io = 0; io < mCurrentFrame.N; io++)
                                         if (mCurrentFrame.mvbOutlier[io])
@@ -2035,6 +2317,7 @@ namespace ORB_SLAM2 {
                     // If the pose is supported by enough inliers stop ransacs and continue
                     if (nGood >= 50) {
                         bMatch = true;
+                        nMatchedKF = i;
                         break;
                     }
                 }
@@ -2048,6 +2331,14 @@ namespace ORB_SLAM2 {
         if (!bMatch) {
             return false;
         } else {
+            // Build the neighbours of a keyframe of the map file, so that the local map can be tracked
+            if (nMatchedKF >= nFirstMapped) {
+                const uint32_t *pBegin, *pEnd;
+                pMappedMap->GetBestCovisibles(vnMappedIndices[nMatchedKF - nFirstMapped], pBegin, pEnd);
+                for (const uint32_t *p = pBegin; p != pEnd; p++)
+                    pMappedMap->GetKeyFrame(*p);
+            }
+
             mnLastRelocFrameId = mCurrentFrame.mnId;
             return true;
         }
@@ -2074,9 +2365,14 @@ namespace ORB_SLAM2 {
 // Clear Map (this erase MapPoints and KeyFrames)
         mpMap->clear();
 
+// Drop frames built with the old ids
+        if (mnPipelineDepth > 0)
+            ClearPipeline();
+
         KeyFrame::nNextId = 0;
         Frame::nNextId = 0;
         mState = NO_IMAGES_YET;
+        mbRelocalizeLoadedMap = false;
 
         mlRelativeFramePoses.clear();
         mlpReferences.clear();
@@ -2090,5 +2386,18 @@ namespace ORB_SLAM2 {
         mbOnlyTracking = flag;
     }
 
+    void Tracking::InformMapLoaded() {
+        mState = LOST;
+        mLastProcessedState = LOST;
+        mbRelocalizeLoadedMap = true;
+    }
+
+    void Tracking::GetCalibration(cv::Mat &K, float &bf, int &nScaleLevels, float &scaleFactor) {
+        K = mK.clone();
+        bf = mbf;
+        nScaleLevels = mpORBextractor->GetLevels();
+        scaleFactor = mpORBextractor->GetScaleFactor();
+    }
+
 
 } //namespace ORB_SLAM
@@ -0,0 +1,64 @@
+/**
+* This file is part of ManhattanSLAM.
+*
+* Copyright (C) 2021 Raza Yunus <razayunus31 at gmail dot com>
+* For more information see <https://github.com/razayunus/ManhattanSLAM>
+*
+* ManhattanSLAM is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* ManhattanSLAM is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with ManhattanSLAM. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <iostream>
+#include <chrono>
+
+#include "ORBVocabulary.h"
+
+using namespace std;
+
+// Converts a text ORB vocabulary (e.g. Vocabulary/ORBvoc.txt) to the binary format read by
+// TemplatedVocabulary::loadFromBinaryFile. The System detects the format of the vocabulary file by itself.
+int main(int argc, char **argv) {
+    if (argc != 3) {
+        cerr << endl << "Usage: ./bin_vocabulary path_to_text_vocabulary path_to_binary_vocabulary" << endl;
+        return 1;
+    }
+
+    ORB_SLAM2::ORBVocabulary voc;
+
+    chrono::steady_clock::time_point t1 = chrono::steady_clock::now();
+    if (!voc.loadFromTextFile(argv[1])) {
+        cerr << "Failed to load the text vocabulary at: " << argv[1] << endl;
+        return 1;
+    }
+    chrono::steady_clock::time_point t2 = chrono::steady_clock::now();
+    cout << "Text vocabulary loaded in " << chrono::duration_cast<chrono::duration<double> >(t2 - t1).count()
+         << "s: " << voc << endl;
+
+    if (!voc.saveToBinaryFile(argv[2])) {
+        cerr << "Failed to write the binary vocabulary at: " << argv[2] << endl;
+        return 1;
+    }
+
+    // Check that the written file reads back to the same vocabulary
+    ORB_SLAM2::ORBVocabulary binVoc;
+    t1 = chrono::steady_clock::now();
+    if (!binVoc.loadFromBinaryFile(argv[2]) || binVoc.size() != voc.size()) {
+        cerr << "The binary vocabulary written at " << argv[2] << " could not be read back" << endl;
+        return 1;
+    }
+    t2 = chrono::steady_clock::now();
+    cout << "Binary vocabulary saved, it loads in " << chrono::duration_cast<chrono::duration<double> >(t2 - t1).count()
+         << "s" << endl;
+
+    return 0;
+}